@@ -0,0 +1,173 @@
+/*
+ * cw_archive.c - Session archive tool
+ * Packs debug_serial captures into the compact columnar archive format
+ * (see cw_archive.h), unpacks them again, and summarizes archives from
+ * their chunk index without decoding the element data.
+ *
+ * Compile: clang -O2 -o cw_archive cw_archive.c
+ * Run: ./cw_archive pack lesson.cwcap lesson.cwarc
+ *      ./cw_archive unpack lesson.cwarc lesson.cwcap
+ *      ./cw_archive info lesson.cwarc [-c]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cw_capture.h"
+#include "cw_archive.h"
+
+#define DEFAULT_BAUD 115200
+
+static long long fileSize(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return -1;
+    fseek(f, 0, SEEK_END);
+    long long size = ftell(f);
+    fclose(f);
+    return size;
+}
+
+static int packLine(CwArcWriter *w, const char *line, uint64_t arrivalMs) {
+    int pauses[16], lengths[16];
+    int count = cwcap_parse_line(line, pauses, lengths, 16);
+    int rc = 0;
+    for (int k = 0; k < count && rc == 0; k++) {
+        rc = cwarc_writer_add(w, (uint32_t)pauses[k], (uint32_t)lengths[k], arrivalMs);
+    }
+    return rc;
+}
+
+// Capture -> archive. Only the S,pause,length elements are kept; any other
+// text the device sent is dropped.
+static int pack(const char *in, const char *out) {
+    FILE *f = fopen(in, "rb");
+    if (!f || cwcap_read_header(f, NULL) != 0) {
+        printf("[!] %s is not a capture file\n", in);
+        if (f) fclose(f);
+        return 1;
+    }
+    CwArcWriter *w = cwarc_writer_open(out);
+    if (!w) {
+        printf("[!] Cannot write %s\n", out);
+        fclose(f);
+        return 1;
+    }
+
+    static char chunk[CWCAP_MAX_CHUNK];
+    char line[256];
+    int linePos = 0, n, rc = 0;
+    uint64_t timeUs, firstUs = 0, arrivalMs = 0;
+    int haveFirst = 0;
+    while (rc == 0 && (n = cwcap_read_chunk(f, &timeUs, chunk)) >= 0) {
+        if (!haveFirst) { firstUs = timeUs; haveFirst = 1; }
+        arrivalMs = (timeUs - firstUs) / 1000;
+        for (int i = 0; i < n && rc == 0; i++) {
+            if (chunk[i] != '\r' && chunk[i] != '\n') {
+                if (linePos < (int)sizeof(line) - 1) line[linePos++] = chunk[i];
+                continue;
+            }
+            line[linePos] = '\0';
+            linePos = 0;
+            rc = packLine(w, line, arrivalMs);
+        }
+    }
+    // A capture cut off mid-line: keep what it has
+    if (rc == 0 && linePos > 0) {
+        line[linePos] = '\0';
+        rc = packLine(w, line, arrivalMs);
+    }
+    fclose(f);
+    uint64_t elements = w->totalElements;
+    if (cwarc_writer_close(w) != 0) rc = -1;
+    if (rc != 0) {
+        printf("[!] Write error on %s\n", out);
+        return 1;
+    }
+
+    long long inSize = fileSize(in), outSize = fileSize(out);
+    printf("[OK] %llu elements: %lld -> %lld bytes (%.1fx)\n", (unsigned long long)elements,
+           inSize, outSize, outSize > 0 ? (double)inSize / outSize : 0.0);
+    return 0;
+}
+
+// Archive -> capture, one canonical "S,pause,length" line per element
+static int unpack(const char *in, const char *out) {
+    CwArchive a;
+    if (cwarc_open(&a, in) != 0) {
+        printf("[!] %s is not an archive\n", in);
+        return 1;
+    }
+    FILE *f = fopen(out, "wb");
+    if (!f || cwcap_write_header(f, DEFAULT_BAUD) != 0) {
+        printf("[!] Cannot write %s\n", out);
+        if (f) fclose(f);
+        cwarc_close(&a);
+        return 1;
+    }
+    static CwArcElement elements[CWARC_CHUNK_ELEMENTS];
+    int rc = 0;
+    for (uint32_t c = 0; c < a.chunkCount && rc == 0; c++) {
+        int n = cwarc_decode_chunk(&a, c, elements);
+        if (n < 0) { printf("[!] Chunk %u is corrupt\n", c); rc = 1; break; }
+        for (int i = 0; i < n; i++) {
+            char text[48];
+            int len = snprintf(text, sizeof(text), "S,%u,%u\r\n", elements[i].pause, elements[i].length);
+            if (cwcap_write_chunk(f, elements[i].arrivalMs * 1000, text, (uint32_t)len) != 0) { rc = 1; break; }
+        }
+    }
+    if (fclose(f) != 0) rc = 1;
+    cwarc_close(&a);
+    if (rc == 0) printf("[OK] Wrote %s\n", out);
+    return rc;
+}
+
+// Summary from the index only; -c lists every chunk
+static int info(const char *in, int perChunk) {
+    CwArchive a;
+    if (cwarc_open(&a, in) != 0) {
+        printf("[!] %s is not an archive\n", in);
+        return 1;
+    }
+    unsigned long long dits = 0, dahs = 0, noise = 0;
+    double wpmSum = 0;
+    uint64_t lastMs = 0;
+    if (perChunk) printf("%6s %10s %8s %12s %12s %7s %7s %6s %6s\n",
+                         "CHUNK", "OFFSET", "BYTES", "FIRST(s)", "LAST(s)", "DITS", "DAHS", "NOISE", "WPM");
+    for (uint32_t c = 0; c < a.chunkCount; c++) {
+        CwArcChunkInfo ci;
+        cwarc_chunk_info(&a, c, &ci);
+        dits += ci.dits;
+        dahs += ci.dahs;
+        noise += ci.noise;
+        wpmSum += ci.wpmX10 / 10.0 * ci.count;
+        lastMs = ci.lastMs;
+        if (perChunk) printf("%6u %10llu %8u %12.1f %12.1f %7u %7u %6u %6.1f\n", c,
+                             (unsigned long long)ci.offset, ci.bytes, ci.firstMs / 1000.0, ci.lastMs / 1000.0,
+                             ci.dits, ci.dahs, ci.noise, ci.wpmX10 / 10.0);
+    }
+    printf("%s: %llu elements in %u chunks, %.1f min, %zu bytes (%.2f bytes/element)\n", in,
+           (unsigned long long)a.totalElements, a.chunkCount, lastMs / 60000.0, a.size,
+           a.totalElements ? (double)a.size / a.totalElements : 0.0);
+    printf("  %llu dits, %llu dahs, %llu noise, average %.1f WPM\n", dits, dahs, noise,
+           a.totalElements ? wpmSum / a.totalElements : 0.0);
+    cwarc_close(&a);
+    return 0;
+}
+
+static void printUsage(const char *progname) {
+    printf("CW Hotline session archive tool\n\n");
+    printf("Usage:\n");
+    printf("  %s pack <capture> <archive>     Compress a debug_serial -o capture\n", progname);
+    printf("  %s unpack <archive> <capture>   Expand back to a replayable capture\n", progname);
+    printf("  %s info <archive> [-c]          Summary from the index (-c: per chunk)\n", progname);
+    printf("\nArchives replay directly: serial_keyboard --replay <archive>\n");
+}
+
+int main(int argc, char *argv[]) {
+    if (argc >= 4 && strcmp(argv[1], "pack") == 0) return pack(argv[2], argv[3]);
+    if (argc >= 4 && strcmp(argv[1], "unpack") == 0) return unpack(argv[2], argv[3]);
+    if (argc >= 3 && strcmp(argv[1], "info") == 0) return info(argv[2], argc >= 4 && strcmp(argv[3], "-c") == 0);
+    printUsage(argv[0]);
+    return argc > 1 && strcmp(argv[1], "-h") != 0 && strcmp(argv[1], "--help") != 0;
+}
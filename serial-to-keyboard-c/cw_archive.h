@@ -0,0 +1,438 @@
+/*
+ * cw_archive.h
+ * Compact columnar archive of decoded-input elements (pause, length, arrival)
+ * for keeping months of sessions. Written by `cw_archive pack`, read by
+ * `cw_archive` and `serial_keyboard --replay`.
+ *
+ * Layout (all fixed-width integers little-endian):
+ *
+ *   Header (32 bytes)
+ *     "CWARC01\n" | u32 flags (0) | u32 chunkCount | u64 indexOffset | u64 totalElements
+ *   Chunk data, one block per chunk of up to CWARC_CHUNK_ELEMENTS elements:
+ *     varint arrivalBytes | varint pauseBytes | arrival column | pause column | length column
+ *   Index (chunkCount x 48 bytes, at indexOffset)
+ *     u64 offset | u32 bytes | u32 count | u64 firstMs | u64 lastMs |
+ *     u32 dits | u32 dahs | u32 noise | u16 wpmX10 | u16 reserved
+ *
+ * Columns hold one code per element, stored as varints:
+ *   arrival: zigzag(arrivalMs - (previous arrivalMs + pause + length)), i.e. only
+ *            the deviation from what the device's own timing predicts
+ *   pause, length: 0 = same as the last value, 1 = same as the one before that,
+ *            otherwise 2 + zigzag(value - last value)
+ * and a run of zero codes is written as one varint ((run << 1) | 1); literal
+ * codes are (code << 1). Keyer-generated traffic mostly collapses to
+ * single-byte codes and runs. Every chunk starts from fresh state, so any
+ * chunk decodes on its own and the index alone answers summary queries.
+ *
+ * The reader maps the whole file (mmap / MapViewOfFile) and decodes chunks in
+ * place.
+ */
+
+#ifndef CW_ARCHIVE_H
+#define CW_ARCHIVE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
+
+#define CWARC_MAGIC "CWARC01\n"
+#define CWARC_MAGIC_LEN 8
+#define CWARC_HEADER_LEN 32
+#define CWARC_INDEX_ENTRY_LEN 48
+#define CWARC_CHUNK_ELEMENTS 4096
+#define CWARC_NOISE_MS 30          // Same noise floor as the decoder's MIN_PULSE_LENGTH
+
+typedef struct {
+    uint32_t pause;      // ms of silence before the element
+    uint32_t length;     // ms the key was down
+    uint64_t arrivalMs;  // when the element's line arrived, ms since session start
+} CwArcElement;
+
+typedef struct {
+    uint64_t offset;
+    uint32_t bytes;
+    uint32_t count;
+    uint64_t firstMs;
+    uint64_t lastMs;
+    uint32_t dits;
+    uint32_t dahs;
+    uint32_t noise;
+    uint16_t wpmX10;
+} CwArcChunkInfo;
+
+// ============================================================
+// ENCODING PRIMITIVES
+// ============================================================
+
+static inline void cwarc_put16(unsigned char *p, uint32_t v) { p[0] = (unsigned char)v; p[1] = (unsigned char)(v >> 8); }
+static inline void cwarc_put32(unsigned char *p, uint32_t v) { cwarc_put16(p, v); cwarc_put16(p + 2, v >> 16); }
+static inline void cwarc_put64(unsigned char *p, uint64_t v) { cwarc_put32(p, (uint32_t)v); cwarc_put32(p + 4, (uint32_t)(v >> 32)); }
+static inline uint32_t cwarc_get16(const unsigned char *p) { return (uint32_t)p[0] | (uint32_t)p[1] << 8; }
+static inline uint32_t cwarc_get32(const unsigned char *p) { return cwarc_get16(p) | cwarc_get16(p + 2) << 16; }
+static inline uint64_t cwarc_get64(const unsigned char *p) { return (uint64_t)cwarc_get32(p) | (uint64_t)cwarc_get32(p + 4) << 32; }
+
+static inline uint64_t cwarc_zigzag(int64_t v) { return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63); }
+static inline int64_t cwarc_unzigzag(uint64_t v) { return (int64_t)(v >> 1) ^ -(int64_t)(v & 1); }
+
+static inline unsigned char *cwarc_put_varint(unsigned char *p, uint64_t v) {
+    while (v >= 0x80) { *p++ = (unsigned char)(v | 0x80); v >>= 7; }
+    *p++ = (unsigned char)v;
+    return p;
+}
+
+// Returns NULL on a varint running past end
+static inline const unsigned char *cwarc_get_varint(const unsigned char *p, const unsigned char *end, uint64_t *v) {
+    uint64_t result = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+        unsigned char b = *p++;
+        result |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) { *v = result; return p; }
+    }
+    return NULL;
+}
+
+// Column writer: codes with zero runs folded
+typedef struct {
+    unsigned char *p;
+    uint64_t zeroRun;
+} CwArcColumn;
+
+static inline void cwarc_column_flush(CwArcColumn *c) {
+    if (c->zeroRun) { c->p = cwarc_put_varint(c->p, (c->zeroRun << 1) | 1); c->zeroRun = 0; }
+}
+
+static inline void cwarc_column_put(CwArcColumn *c, uint64_t code) {
+    if (code == 0) { c->zeroRun++; return; }
+    cwarc_column_flush(c);
+    c->p = cwarc_put_varint(c->p, code << 1);
+}
+
+// Column reader
+typedef struct {
+    const unsigned char *p, *end;
+    uint64_t zeroRun;
+} CwArcColumnReader;
+
+static inline int cwarc_column_get(CwArcColumnReader *r, uint64_t *code) {
+    if (r->zeroRun) { r->zeroRun--; *code = 0; return 0; }
+    uint64_t v;
+    if (!(r->p = cwarc_get_varint(r->p, r->end, &v))) return -1;
+    if (v & 1) {
+        if ((v >> 1) == 0) return -1;
+        r->zeroRun = (v >> 1) - 1;
+        *code = 0;
+    } else {
+        *code = v >> 1;
+    }
+    return 0;
+}
+
+// Two-most-recent-values model for pause/length
+typedef struct { uint32_t last, before; } CwArcRecent;
+
+static inline uint64_t cwarc_recent_encode(CwArcRecent *m, uint32_t v) {
+    uint64_t code;
+    if (v == m->last) return 0;
+    if (v == m->before) code = 1;
+    else code = 2 + cwarc_zigzag((int64_t)v - (int64_t)m->last);
+    m->before = m->last;
+    m->last = v;
+    return code;
+}
+
+static inline uint32_t cwarc_recent_decode(CwArcRecent *m, uint64_t code) {
+    if (code == 0) return m->last;
+    uint32_t v = code == 1 ? m->before : (uint32_t)((int64_t)m->last + cwarc_unzigzag(code - 2));
+    m->before = m->last;
+    m->last = v;
+    return v;
+}
+
+// ============================================================
+// CHUNK STATISTICS
+// ============================================================
+
+// Split non-noise lengths into dits/dahs (two-means) and estimate WPM
+static inline void cwarc_chunk_stats(const CwArcElement *e, uint32_t n, CwArcChunkInfo *info) {
+    uint32_t lo = UINT32_MAX, hi = 0;
+    info->dits = info->dahs = info->noise = 0;
+    info->wpmX10 = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        if (e[i].length < CWARC_NOISE_MS) { info->noise++; continue; }
+        if (e[i].length < lo) lo = e[i].length;
+        if (e[i].length > hi) hi = e[i].length;
+    }
+    if (hi == 0) return;
+    double split = hi < lo * 2 ? hi + 1.0 : (lo + hi) / 2.0;
+    double dit = lo;
+    for (int iter = 0; iter < 4; iter++) {
+        double sumDit = 0, sumDah = 0;
+        uint32_t dits = 0, dahs = 0;
+        for (uint32_t i = 0; i < n; i++) {
+            if (e[i].length < CWARC_NOISE_MS) continue;
+            if (e[i].length < split) { sumDit += e[i].length; dits++; }
+            else { sumDah += e[i].length; dahs++; }
+        }
+        info->dits = dits;
+        info->dahs = dahs;
+        if (dits) dit = sumDit / dits;
+        if (!dahs || !dits) break;
+        split = (dit + sumDah / dahs) / 2.0;
+    }
+    double wpm = 1200.0 / dit;
+    info->wpmX10 = (uint16_t)(wpm * 10 > 65535 ? 65535 : wpm * 10 + 0.5);
+}
+
+// ============================================================
+// WRITER
+// ============================================================
+
+typedef struct {
+    FILE *f;
+    uint64_t offset;               // Where the next chunk goes
+    CwArcElement pending[CWARC_CHUNK_ELEMENTS];
+    uint32_t pendingCount;
+    CwArcChunkInfo *index;
+    uint32_t chunkCount, indexCap;
+    uint64_t totalElements;
+    // Column staging, worst case one 10-byte varint per element
+    unsigned char arrival[CWARC_CHUNK_ELEMENTS * 10];
+    unsigned char pause[CWARC_CHUNK_ELEMENTS * 10];
+    unsigned char length[CWARC_CHUNK_ELEMENTS * 10];
+} CwArcWriter;
+
+static inline int cwarc_write_header(CwArcWriter *w) {
+    unsigned char hdr[CWARC_HEADER_LEN];
+    memcpy(hdr, CWARC_MAGIC, CWARC_MAGIC_LEN);
+    cwarc_put32(hdr + 8, 0);
+    cwarc_put32(hdr + 12, w->chunkCount);
+    cwarc_put64(hdr + 16, w->offset);
+    cwarc_put64(hdr + 24, w->totalElements);
+    if (fseek(w->f, 0, SEEK_SET) != 0) return -1;
+    return fwrite(hdr, 1, sizeof(hdr), w->f) == sizeof(hdr) ? 0 : -1;
+}
+
+// Writer is large (~190KB): allocate it. Returns NULL on error.
+static inline CwArcWriter *cwarc_writer_open(const char *path) {
+    CwArcWriter *w = (CwArcWriter *)calloc(1, sizeof(CwArcWriter));
+    if (!w) return NULL;
+    w->f = fopen(path, "wb");
+    w->offset = CWARC_HEADER_LEN;
+    if (!w->f || cwarc_write_header(w) != 0) {
+        if (w->f) fclose(w->f);
+        free(w);
+        return NULL;
+    }
+    return w;
+}
+
+static inline int cwarc_writer_flush_chunk(CwArcWriter *w) {
+    uint32_t n = w->pendingCount;
+    if (n == 0) return 0;
+    const CwArcElement *e = w->pending;
+
+    CwArcColumn arrival = { w->arrival, 0 }, pause = { w->pause, 0 }, length = { w->length, 0 };
+    CwArcRecent pauseModel = { 0, 0 }, lengthModel = { 0, 0 };
+    uint64_t expected = e[0].arrivalMs;
+    for (uint32_t i = 0; i < n; i++) {
+        if (i > 0) expected = e[i - 1].arrivalMs + e[i].pause + e[i].length;
+        cwarc_column_put(&arrival, cwarc_zigzag((int64_t)(e[i].arrivalMs - expected)));
+        cwarc_column_put(&pause, cwarc_recent_encode(&pauseModel, e[i].pause));
+        cwarc_column_put(&length, cwarc_recent_encode(&lengthModel, e[i].length));
+    }
+    cwarc_column_flush(&arrival);
+    cwarc_column_flush(&pause);
+    cwarc_column_flush(&length);
+
+    size_t arrivalBytes = arrival.p - w->arrival, pauseBytes = pause.p - w->pause;
+    size_t lengthBytes = length.p - w->length;
+    unsigned char prefix[20];
+    unsigned char *pp = cwarc_put_varint(prefix, arrivalBytes);
+    pp = cwarc_put_varint(pp, pauseBytes);
+    size_t prefixBytes = pp - prefix;
+
+    CwArcChunkInfo info;
+    memset(&info, 0, sizeof(info));
+    info.offset = w->offset;
+    info.bytes = (uint32_t)(prefixBytes + arrivalBytes + pauseBytes + lengthBytes);
+    info.count = n;
+    info.firstMs = e[0].arrivalMs;
+    info.lastMs = e[n - 1].arrivalMs;
+    cwarc_chunk_stats(e, n, &info);
+
+    if (fwrite(prefix, 1, prefixBytes, w->f) != prefixBytes ||
+        fwrite(w->arrival, 1, arrivalBytes, w->f) != arrivalBytes ||
+        fwrite(w->pause, 1, pauseBytes, w->f) != pauseBytes ||
+        fwrite(w->length, 1, lengthBytes, w->f) != lengthBytes) return -1;
+
+    if (w->chunkCount == w->indexCap) {
+        uint32_t cap = w->indexCap ? w->indexCap * 2 : 64;
+        CwArcChunkInfo *grown = (CwArcChunkInfo *)realloc(w->index, cap * sizeof(CwArcChunkInfo));
+        if (!grown) return -1;
+        w->index = grown;
+        w->indexCap = cap;
+    }
+    w->index[w->chunkCount++] = info;
+    w->offset += info.bytes;
+    w->pendingCount = 0;
+    return 0;
+}
+
+// Elements must be added in arrival order. Returns 0 or -1 on write error.
+static inline int cwarc_writer_add(CwArcWriter *w, uint32_t pause, uint32_t length, uint64_t arrivalMs) {
+    CwArcElement *e = &w->pending[w->pendingCount++];
+    e->pause = pause;
+    e->length = length;
+    e->arrivalMs = arrivalMs;
+    w->totalElements++;
+    if (w->pendingCount == CWARC_CHUNK_ELEMENTS) return cwarc_writer_flush_chunk(w);
+    return 0;
+}
+
+// Writes the last chunk, the index and the final header; frees the writer
+static inline int cwarc_writer_close(CwArcWriter *w) {
+    int rc = cwarc_writer_flush_chunk(w);
+    for (uint32_t i = 0; rc == 0 && i < w->chunkCount; i++) {
+        const CwArcChunkInfo *c = &w->index[i];
+        unsigned char ent[CWARC_INDEX_ENTRY_LEN];
+        cwarc_put64(ent, c->offset);
+        cwarc_put32(ent + 8, c->bytes);
+        cwarc_put32(ent + 12, c->count);
+        cwarc_put64(ent + 16, c->firstMs);
+        cwarc_put64(ent + 24, c->lastMs);
+        cwarc_put32(ent + 32, c->dits);
+        cwarc_put32(ent + 36, c->dahs);
+        cwarc_put32(ent + 40, c->noise);
+        cwarc_put16(ent + 44, c->wpmX10);
+        cwarc_put16(ent + 46, 0);
+        if (fwrite(ent, 1, sizeof(ent), w->f) != sizeof(ent)) rc = -1;
+    }
+    if (rc == 0) rc = cwarc_write_header(w);
+    if (fclose(w->f) != 0) rc = -1;
+    free(w->index);
+    free(w);
+    return rc;
+}
+
+// ============================================================
+// READER
+// ============================================================
+
+typedef struct {
+    const unsigned char *base;
+    size_t size;
+    uint32_t chunkCount;
+    uint64_t totalElements;
+    const unsigned char *index;
+#ifdef _WIN32
+    HANDLE file, mapping;
+#endif
+} CwArchive;
+
+// Returns 1 if the first bytes of a file are an archive header
+static inline int cwarc_is_archive(const void *head, size_t len) {
+    return len >= CWARC_MAGIC_LEN && memcmp(head, CWARC_MAGIC, CWARC_MAGIC_LEN) == 0;
+}
+
+static inline void cwarc_close(CwArchive *a) {
+    if (!a->base) return;
+#ifdef _WIN32
+    UnmapViewOfFile(a->base);
+    CloseHandle(a->mapping);
+    CloseHandle(a->file);
+#else
+    munmap((void *)a->base, a->size);
+#endif
+    a->base = NULL;
+}
+
+// Map an archive read-only and validate its header and index.
+// Returns 0 on success, -1 if the file can't be mapped or isn't an archive.
+static inline int cwarc_open(CwArchive *a, const char *path) {
+    memset(a, 0, sizeof(*a));
+#ifdef _WIN32
+    a->file = CreateFile(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
+    if (a->file == INVALID_HANDLE_VALUE) return -1;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(a->file, &size) || size.QuadPart < CWARC_HEADER_LEN) { CloseHandle(a->file); return -1; }
+    a->mapping = CreateFileMapping(a->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!a->mapping) { CloseHandle(a->file); return -1; }
+    a->base = (const unsigned char *)MapViewOfFile(a->mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!a->base) { CloseHandle(a->mapping); CloseHandle(a->file); return -1; }
+    a->size = (size_t)size.QuadPart;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < CWARC_HEADER_LEN) { close(fd); return -1; }
+    void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) return -1;
+    a->base = (const unsigned char *)p;
+    a->size = (size_t)st.st_size;
+#endif
+    uint64_t indexOffset = cwarc_get64(a->base + 16);
+    a->chunkCount = cwarc_get32(a->base + 12);
+    a->totalElements = cwarc_get64(a->base + 24);
+    if (!cwarc_is_archive(a->base, a->size) || indexOffset > a->size ||
+        (a->size - indexOffset) / CWARC_INDEX_ENTRY_LEN < a->chunkCount) {
+        cwarc_close(a);
+        return -1;
+    }
+    a->index = a->base + indexOffset;
+    return 0;
+}
+
+static inline void cwarc_chunk_info(const CwArchive *a, uint32_t i, CwArcChunkInfo *c) {
+    const unsigned char *ent = a->index + (size_t)i * CWARC_INDEX_ENTRY_LEN;
+    c->offset = cwarc_get64(ent);
+    c->bytes = cwarc_get32(ent + 8);
+    c->count = cwarc_get32(ent + 12);
+    c->firstMs = cwarc_get64(ent + 16);
+    c->lastMs = cwarc_get64(ent + 24);
+    c->dits = cwarc_get32(ent + 32);
+    c->dahs = cwarc_get32(ent + 36);
+    c->noise = cwarc_get32(ent + 40);
+    c->wpmX10 = (uint16_t)cwarc_get16(ent + 44);
+}
+
+// Decode chunk i into out (room for CWARC_CHUNK_ELEMENTS).
+// Returns the element count, or -1 if the chunk is corrupt.
+static inline int cwarc_decode_chunk(const CwArchive *a, uint32_t i, CwArcElement *out) {
+    CwArcChunkInfo c;
+    cwarc_chunk_info(a, i, &c);
+    if (c.count > CWARC_CHUNK_ELEMENTS || c.offset > a->size || c.bytes > a->size - c.offset) return -1;
+    const unsigned char *p = a->base + c.offset, *end = p + c.bytes;
+    uint64_t arrivalBytes, pauseBytes;
+    if (!(p = cwarc_get_varint(p, end, &arrivalBytes))) return -1;
+    if (!(p = cwarc_get_varint(p, end, &pauseBytes))) return -1;
+    if (arrivalBytes > (uint64_t)(end - p) || pauseBytes > (uint64_t)(end - p) - arrivalBytes) return -1;
+
+    CwArcColumnReader arrival = { p, p + arrivalBytes, 0 };
+    CwArcColumnReader pause = { arrival.end, arrival.end + pauseBytes, 0 };
+    CwArcColumnReader length = { pause.end, end, 0 };
+    CwArcRecent pauseModel = { 0, 0 }, lengthModel = { 0, 0 };
+    uint64_t prev = c.firstMs;
+    for (uint32_t k = 0; k < c.count; k++) {
+        uint64_t ac, pc, lc;
+        if (cwarc_column_get(&arrival, &ac) || cwarc_column_get(&pause, &pc) || cwarc_column_get(&length, &lc)) return -1;
+        out[k].pause = cwarc_recent_decode(&pauseModel, pc);
+        out[k].length = cwarc_recent_decode(&lengthModel, lc);
+        uint64_t expected = k ? prev + out[k].pause + out[k].length : c.firstMs;
+        out[k].arrivalMs = expected + (uint64_t)cwarc_unzigzag(ac);
+        prev = out[k].arrivalMs;
+    }
+    return (int)c.count;
+}
+
+#endif // CW_ARCHIVE_H
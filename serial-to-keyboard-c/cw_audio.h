@@ -0,0 +1,546 @@
+/*
+ * cw_audio.h
+ * CW from audio: a WAV file, or raw PCM on stdin from an SDR/receiver
+ * pipeline, turned into the same pause/length elements a CW Hotline sends,
+ * so one decoder handles both the device and recorded on-air signals.
+ *
+ *   cwaudio_open()/cwaudio_read()  WAV (8/16/24/32-bit PCM, float) or raw
+ *                                  s16le -> mono float samples (or I/Q)
+ *   cwtone_feed()                  samples -> keying -> CwArcElement events
+ *
+ * The detector runs a bank of CWTONE_BINS Goertzel filters across the
+ * search band over short blocks. The bank follows the strongest carrier
+ * (long-term average per bin, with hysteresis), and the tracked bin's level
+ * keys against an adaptive threshold halfway between a noise floor and a
+ * peak envelope, in dB, so it is independent of audio level and squelched
+ * when nothing stands CWKEY_MIN_SNR_DB above the noise.
+ *
+ * The filter bank is updated 8 (AVX) or 4 (SSE2/NEON) bins per instruction;
+ * one core handles 48 kHz audio at hundreds of times real time.
+ */
+
+#ifndef CW_AUDIO_H
+#define CW_AUDIO_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef _WIN32
+    #include <io.h>
+    #include <fcntl.h>
+#endif
+
+#include "cw_archive.h"
+
+#if defined(__AVX__)
+    #include <immintrin.h>
+    #define CWTONE_KERNEL "avx"
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define CWTONE_SSE2 1
+    #define CWTONE_KERNEL "sse2"
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #include <arm_neon.h>
+    #define CWTONE_KERNEL "neon"
+#else
+    #define CWTONE_KERNEL "scalar"
+#endif
+
+// ============================================================
+// AUDIO INPUT
+// ============================================================
+
+#define CWAUDIO_DEFAULT_RATE 8000   // Raw PCM without --audio-rate
+#define CWAUDIO_READ_BYTES 16384
+
+typedef struct {
+    FILE *f;
+    int ownsFile;
+    int sampleRate;
+    int channels;
+    int bits;                  // Per sample: 8, 16, 24 or 32
+    int isFloat;               // 32-bit IEEE float samples
+    int raw;                   // Headerless PCM: format is whatever the caller said
+    uint64_t dataLeft;         // Sample bytes left in the data chunk (raw: UINT64_MAX)
+    uint8_t buf[CWAUDIO_READ_BYTES];
+    size_t bufLen, bufPos;     // Bytes read but not yet converted
+} CwAudioSource;
+
+static inline uint32_t cwaudio_le16(const uint8_t *p) { return p[0] | (uint32_t)p[1] << 8; }
+static inline uint32_t cwaudio_le32(const uint8_t *p) { return cwaudio_le16(p) | cwaudio_le16(p + 2) << 16; }
+
+// Read exactly n bytes; returns 0, or -1 at end of file
+static inline int cwaudio_read_exact(FILE *f, uint8_t *p, size_t n) {
+    return fread(p, 1, n, f) == n ? 0 : -1;
+}
+
+// Skip n bytes of a stream that may not be seekable (stdin)
+static inline int cwaudio_skip(FILE *f, uint32_t n) {
+    uint8_t scratch[256];
+    while (n > 0) {
+        size_t step = n < sizeof(scratch) ? n : sizeof(scratch);
+        if (cwaudio_read_exact(f, scratch, step) != 0) return -1;
+        n -= (uint32_t)step;
+    }
+    return 0;
+}
+
+// Walk the RIFF chunks after "RIFF....WAVE" up to the start of the samples
+static inline int cwaudio_parse_wav(CwAudioSource *a) {
+    uint8_t hdr[8], fmt[40];
+    int haveFmt = 0;
+    for (;;) {
+        if (cwaudio_read_exact(a->f, hdr, 8) != 0) return -1;
+        uint32_t size = cwaudio_le32(hdr + 4);
+        if (memcmp(hdr, "fmt ", 4) == 0) {
+            uint32_t keep = size < sizeof(fmt) ? size : (uint32_t)sizeof(fmt);
+            if (size < 16 || cwaudio_read_exact(a->f, fmt, keep) != 0) return -1;
+            if (cwaudio_skip(a->f, size - keep + (size & 1)) != 0) return -1;
+            uint32_t tag = cwaudio_le16(fmt);
+            if (tag == 0xFFFE && keep >= 26) tag = cwaudio_le16(fmt + 24);  // Extensible: sub-format GUID
+            a->channels = (int)cwaudio_le16(fmt + 2);
+            a->sampleRate = (int)cwaudio_le32(fmt + 4);
+            a->bits = (int)cwaudio_le16(fmt + 14);
+            a->isFloat = tag == 3;
+            if (tag != 1 && tag != 3) return -1;
+            if (a->isFloat ? a->bits != 32 : (a->bits != 8 && a->bits != 16 && a->bits != 24 && a->bits != 32)) return -1;
+            if (a->channels < 1 || a->sampleRate < 1000) return -1;
+            haveFmt = 1;
+        } else if (memcmp(hdr, "data", 4) == 0) {
+            if (!haveFmt) return -1;
+            // Streaming writers leave the size at 0 or 0xFFFFFFFF: read to EOF
+            a->dataLeft = (size == 0 || size == 0xFFFFFFFFu) ? UINT64_MAX : size;
+            return 0;
+        } else if (cwaudio_skip(a->f, size + (size & 1)) != 0) {
+            return -1;
+        }
+    }
+}
+
+// Open a WAV file, or raw signed 16-bit little-endian mono at rawRate
+// ("-" reads stdin, which may carry either). Returns 0, or -1 if the file
+// can't be opened or is a WAV this reader doesn't handle.
+static inline int cwaudio_open(CwAudioSource *a, const char *path, int rawRate) {
+    memset(a, 0, sizeof(*a));
+    if (strcmp(path, "-") == 0) {
+        a->f = stdin;
+#ifdef _WIN32
+        _setmode(_fileno(stdin), _O_BINARY);
+#endif
+    } else {
+        a->f = fopen(path, "rb");
+        if (!a->f) return -1;
+        a->ownsFile = 1;
+    }
+
+    // Sniff the header; raw input keeps those bytes as its first samples
+    a->bufLen = fread(a->buf, 1, 12, a->f);
+    if (a->bufLen == 12 && memcmp(a->buf, "RIFF", 4) == 0 && memcmp(a->buf + 8, "WAVE", 4) == 0) {
+        a->bufLen = 0;
+        if (cwaudio_parse_wav(a) == 0) return 0;
+    } else {
+        a->sampleRate = rawRate > 0 ? rawRate : CWAUDIO_DEFAULT_RATE;
+        a->raw = 1;
+        a->channels = 1;
+        a->bits = 16;
+        a->dataLeft = UINT64_MAX;
+        return 0;
+    }
+    if (a->ownsFile) fclose(a->f);
+    a->f = NULL;
+    return -1;
+}
+
+static inline void cwaudio_close(CwAudioSource *a) {
+    if (a->ownsFile && a->f) fclose(a->f);
+    a->f = NULL;
+}
+
+static inline float cwaudio_sample(const CwAudioSource *a, const uint8_t *p) {
+    switch (a->bits) {
+    case 8:  return ((int)p[0] - 128) / 128.0f;
+    case 16: return (int16_t)cwaudio_le16(p) / 32768.0f;
+    case 24: return (int32_t)(cwaudio_le16(p) << 8 | (uint32_t)p[2] << 24) / 2147483648.0f;
+    default: {
+        uint32_t v = cwaudio_le32(p);
+        if (a->isFloat) { float f; memcpy(&f, &v, sizeof(f)); return f; }
+        return (int32_t)v / 2147483648.0f;
+    }
+    }
+}
+
+// Make at least one whole frame available in buf; returns 0, or -1 at the
+// end of the audio
+static inline int cwaudio_fill(CwAudioSource *a, size_t frameBytes) {
+    if (a->bufLen - a->bufPos >= frameBytes) return 0;
+    // Keep the partial frame, top up the buffer
+    size_t keep = a->bufLen - a->bufPos;
+    memmove(a->buf, a->buf + a->bufPos, keep);
+    a->bufPos = 0;
+    a->bufLen = keep;
+    size_t want = sizeof(a->buf) - keep;
+    if (a->dataLeft < want) want = (size_t)a->dataLeft;
+    size_t got = want ? fread(a->buf + keep, 1, want, a->f) : 0;
+    if (a->dataLeft != UINT64_MAX) a->dataLeft -= got;
+    a->bufLen += got;
+    return a->bufLen >= frameBytes ? 0 : -1;
+}
+
+// Read up to max frames as mono samples in [-1, 1] (channels averaged).
+// Returns the number read; 0 at the end of the audio.
+static inline size_t cwaudio_read(CwAudioSource *a, float *out, size_t max) {
+    size_t sampleBytes = (size_t)(a->bits / 8), frameBytes = a->channels * sampleBytes;
+    size_t frames = 0;
+    while (frames < max && cwaudio_fill(a, frameBytes) == 0) {
+        const uint8_t *p = a->buf + a->bufPos;
+        float sum = 0;
+        for (int c = 0; c < a->channels; c++) sum += cwaudio_sample(a, p + c * sampleBytes);
+        out[frames++] = sum / a->channels;
+        a->bufPos += frameBytes;
+    }
+    return frames;
+}
+
+// Read up to max frames of a 2-channel I/Q stream (I left, Q right).
+// Returns the number read; 0 at the end of the audio.
+static inline size_t cwaudio_read_iq(CwAudioSource *a, float *i, float *q, size_t max) {
+    size_t sampleBytes = (size_t)(a->bits / 8), frameBytes = a->channels * sampleBytes;
+    size_t frames = 0;
+    while (frames < max && cwaudio_fill(a, frameBytes) == 0) {
+        const uint8_t *p = a->buf + a->bufPos;
+        i[frames] = cwaudio_sample(a, p);
+        q[frames] = a->channels > 1 ? cwaudio_sample(a, p + sampleBytes) : 0.0f;
+        frames++;
+        a->bufPos += frameBytes;
+    }
+    return frames;
+}
+
+// ============================================================
+// KEYING
+// ============================================================
+
+// One carrier's power, block by block -> key-down/key-up -> elements.
+// Used for the single tone below and for every carrier cw_skimmer follows.
+
+#define CWKEY_SMOOTH 3             // Blocks averaged for keying
+#define CWKEY_MIN_SNR_DB 8.0       // Squelch: to key down, peak must stand this far above the noise
+#define CWKEY_EDGE_DB 6.0          // Edges of a strong signal: this far below its peak
+#define CWKEY_FLOOR_DB 5.0         // Key-down threshold never below noise + this
+#define CWKEY_PEAK_MS 300          // Peak envelope follows a keyed-down signal this fast
+#define CWKEY_DECAY_MS 3000        // Peak decays toward the noise this fast in silence...
+#define CWKEY_HANG_MS 2500         // ...for this long (a word gap at 5 WPM is 1.7 s)...
+#define CWKEY_RELEASE_MS 250       // ...and then this fast
+#define CWKEY_NOISE_MS 200         // Noise floor averages over this in silence
+#define CWKEY_CREEP_MS 10000       // ...and over this while something is keyed
+#define CWKEY_WARMUP_MAX 64        // Blocks held back to seed it (CWKEY_NOISE_MS of 4 ms blocks)
+#define CWKEY_DEBOUNCE 2           // Blocks a new key state must hold
+
+typedef void (*CwKeyEmitFn)(void *ctx, const CwArcElement *e);
+
+typedef struct {
+    int sampleRate;
+    int blockLen;                  // Samples per block
+    double blockMs;
+    float history[CWKEY_SMOOTH];   // Power in the last few blocks
+
+    // Adaptive threshold, in dB of block power
+    double level, noise, peak;     // Last block, noise floor, peak envelope
+    double noisePower;             // Noise floor as linear power
+    int primed;                    // noise/peak seeded
+    float warmup[CWKEY_WARMUP_MAX]; // Blocks held back until then
+    int warmupCount;
+    int keyDown;
+    int pending;                   // Blocks in a row that disagree with keyDown
+
+    uint64_t blocks;               // Blocks processed (index of the next block)
+    uint64_t downBlock, upBlock;   // Block index of the last key-down / key-up edge
+    unsigned long elements;
+
+    CwKeyEmitFn emit;
+    void *ctx;
+} CwKeying;
+
+static inline void cwkey_init(CwKeying *k, int sampleRate, int blockLen, CwKeyEmitFn emit, void *ctx) {
+    memset(k, 0, sizeof(*k));
+    k->sampleRate = sampleRate;
+    k->blockLen = blockLen;
+    k->blockMs = 1000.0 * blockLen / sampleRate;
+    k->emit = emit;
+    k->ctx = ctx;
+}
+
+// Start keying at block index `block` of a longer stream (a carrier that
+// appears partway through), so element times are stream times
+static inline void cwkey_start(CwKeying *k, uint64_t block) {
+    k->blocks = k->downBlock = k->upBlock = block;
+}
+
+static inline unsigned long cwkey_ms(const CwKeying *k, uint64_t block) {
+    return (unsigned long)(block * (uint64_t)k->blockLen * 1000 / (uint64_t)k->sampleRate);
+}
+
+// Time processed so far, in ms
+static inline unsigned long cwkey_now(const CwKeying *k) {
+    return cwkey_ms(k, k->blocks + (uint64_t)k->warmupCount);
+}
+
+// Key released at the start of block: emit the element
+static inline void cwkey_up(CwKeying *k, uint64_t block) {
+    CwArcElement e;
+    e.pause = (uint32_t)(cwkey_ms(k, k->downBlock) - cwkey_ms(k, k->upBlock));
+    e.length = (uint32_t)(cwkey_ms(k, block) - cwkey_ms(k, k->downBlock));
+    e.arrivalMs = cwkey_ms(k, block);
+    k->upBlock = block;
+    k->elements++;
+    k->emit(k->ctx, &e);
+}
+
+// One block's power, once the noise floor is seeded
+static inline void cwkey_step(CwKeying *k, float power) {
+    // Key on a short moving average: a third of the noise variance, and both
+    // edges are delayed alike so lengths are not
+    k->history[k->blocks % CWKEY_SMOOTH] = power;
+    power = 0;
+    for (int i = 0; i < CWKEY_SMOOTH; i++) power += k->history[i];
+    power /= CWKEY_SMOOTH;
+    double level = 10.0 * log10(power + 1e-20);
+    k->level = level;
+
+    // Noise floor: mean power of the blocks that look like noise (a mean, not
+    // a minimum: one block of noise swings by 10 dB and more). Anything else
+    // only creeps in, in dB, so a carrier that never keys up still becomes
+    // noise
+    int quiet = !k->keyDown && level < k->noise + CWKEY_MIN_SNR_DB / 2;
+    if (quiet) k->noisePower += (power - k->noisePower) * k->blockMs / CWKEY_NOISE_MS;
+    else k->noisePower *= pow(10.0, (level - k->noise) * k->blockMs / CWKEY_CREEP_MS / 10.0);
+    k->noise = 10.0 * log10(k->noisePower + 1e-20);
+
+    // Peak envelope: half-way up in one block, so a lone noise spike only
+    // lifts it part of the way; down slowly between elements and words, and
+    // quickly once the signal has been gone for CWKEY_HANG_MS, which closes
+    // the squelch behind it
+    double decay = k->keyDown ? CWKEY_PEAK_MS : CWKEY_DECAY_MS;
+    if (!k->keyDown && (k->blocks - k->upBlock) * k->blockMs > CWKEY_HANG_MS) decay = CWKEY_RELEASE_MS;
+    if (level > k->peak) k->peak += (level - k->peak) / 2;
+    else k->peak += (level - k->peak) * k->blockMs / decay;
+
+    // Halfway between noise and peak, but no lower than the half-amplitude
+    // point of a strong signal (so filter smearing lengthens neither
+    // elements nor gaps); a little hysteresis; and never closer to the noise
+    // than CWKEY_FLOOR_DB (a fading peak would otherwise let the noise key)
+    double span = k->peak - k->noise;
+    double mid = k->noise + span / 2, hyst = span / 10;
+    if (mid < k->peak - CWKEY_EDGE_DB) mid = k->peak - CWKEY_EDGE_DB;
+    if (hyst > CWKEY_EDGE_DB / 4) hyst = CWKEY_EDGE_DB / 4;
+    double on = mid + hyst > k->noise + CWKEY_FLOOR_DB ? mid + hyst : k->noise + CWKEY_FLOOR_DB;
+    int down = k->keyDown;
+    if (level > on) down = k->keyDown || span >= CWKEY_MIN_SNR_DB;
+    else if (level < mid - hyst) down = 0;
+
+    // An edge needs CWKEY_DEBOUNCE blocks in a row; it is dated to the first
+    k->pending = down != k->keyDown ? k->pending + 1 : 0;
+    if (k->pending >= CWKEY_DEBOUNCE) {
+        uint64_t edge = k->blocks + 1 - CWKEY_DEBOUNCE;
+        if (down) k->downBlock = edge;
+        else cwkey_up(k, edge);
+        k->keyDown = down;
+        k->pending = 0;
+    }
+    k->blocks++;
+}
+
+// Seed the noise floor and peak from the warm-up blocks, then key them. A
+// signal already keying in the first CWKEY_NOISE_MS would lift a plain mean
+// to its own level and lose its first element, so the floor is the mean of
+// the blocks that look like noise, as in cwkey_step(): starting from the
+// plain mean, the blocks within CWKEY_MIN_SNR_DB / 2 of it, until that
+// drops no more. The peak starts at the loudest block, so the first element
+// keys at the same threshold as the rest.
+static inline void cwkey_prime(CwKeying *k) {
+    int n = k->warmupCount;
+    float sorted[CWKEY_WARMUP_MAX];
+    for (int i = 0; i < n; i++) {
+        // The same moving average keying uses
+        int from = i + 1 >= CWKEY_SMOOTH ? i + 1 - CWKEY_SMOOTH : 0;
+        float v = 0;
+        for (int j = from; j <= i; j++) v += k->warmup[j];
+        v /= (float)(i + 1 - from);
+        int at = i;
+        for (; at > 0 && sorted[at - 1] > v; at--) sorted[at] = sorted[at - 1];
+        sorted[at] = v;
+    }
+    double noise = 0, quiet = pow(10.0, CWKEY_MIN_SNR_DB / 20.0);
+    for (int i = 0; i < n; i++) noise += sorted[i];
+    noise = n ? noise / n : 0;
+    for (int count = n, last = n + 1; count && count < last;) {
+        double sum = 0;
+        last = count;
+        for (count = 0; count < n && sorted[count] < noise * quiet; count++) sum += sorted[count];
+        if (count) noise = sum / count;
+    }
+    k->noisePower = noise;
+    k->noise = 10.0 * log10(noise + 1e-20);
+    k->peak = n ? 10.0 * log10(sorted[n - 1] + 1e-20) : k->noise;
+    k->primed = 1;
+    k->warmupCount = 0;
+    for (int i = 0; i < n; i++) cwkey_step(k, k->warmup[i]);
+}
+
+// The next block's power (linear, any scale). The first CWKEY_NOISE_MS are
+// held back until the noise floor is seeded from them.
+static inline void cwkey_block(CwKeying *k, float power) {
+    if (k->primed) {
+        cwkey_step(k, power);
+        return;
+    }
+    k->warmup[k->warmupCount++] = power;
+    if (k->warmupCount * k->blockMs >= CWKEY_NOISE_MS || k->warmupCount == CWKEY_WARMUP_MAX) cwkey_prime(k);
+}
+
+// End of the audio: a key still held down ends here. Less than
+// CWKEY_NOISE_MS can't tell a signal from the noise, and keys nothing.
+static inline void cwkey_finish(CwKeying *k) {
+    if (!k->primed) k->warmupCount = 0;
+    if (k->keyDown) cwkey_up(k, k->blocks);
+    k->keyDown = 0;
+}
+
+// ============================================================
+// TONE DETECTOR
+// ============================================================
+
+#define CWTONE_BINS 16             // Filters across the search band (a multiple of 8)
+#define CWTONE_BLOCK_MS 4          // Detection block: timing resolution (and ~250 Hz bandwidth)
+#define CWTONE_TRACK_MS 500        // Frequency tracking time constant
+#define CWTONE_TRACK_HYST 1.4f     // A new bin must beat the tracked one by this factor
+
+typedef struct {
+    int sampleRate;
+    int blockLen;                  // Samples per detection block
+    int blockPos;
+    float coef[CWTONE_BINS];       // 2 cos(w) per bin
+    float s1[CWTONE_BINS], s2[CWTONE_BINS];
+    float freq[CWTONE_BINS];       // Hz
+    float avg[CWTONE_BINS];        // Long-term power per bin, for tracking
+    int track;                     // Bin being keyed
+    CwKeying key;                  // Keying of the tracked bin
+} CwTone;
+
+// Search band [lo, hi] Hz (e.g. 300-1200), clamped below Nyquist
+static inline void cwtone_init(CwTone *t, int sampleRate, double lo, double hi, CwKeyEmitFn emit, void *ctx) {
+    memset(t, 0, sizeof(*t));
+    t->sampleRate = sampleRate;
+    t->blockLen = sampleRate * CWTONE_BLOCK_MS / 1000;
+    if (t->blockLen < 8) t->blockLen = 8;
+    if (hi > sampleRate * 0.45) hi = sampleRate * 0.45;
+    if (lo >= hi) lo = hi / 2;
+    for (int b = 0; b < CWTONE_BINS; b++) {
+        double f = lo + (hi - lo) * b / (CWTONE_BINS - 1);
+        t->freq[b] = (float)f;
+        t->coef[b] = (float)(2.0 * cos(6.283185307179586 * f / sampleRate));
+    }
+    t->track = CWTONE_BINS / 2;
+    cwkey_init(&t->key, sampleRate, t->blockLen, emit, ctx);
+}
+
+// Audio time processed so far, in ms
+static inline unsigned long cwtone_now(const CwTone *t) {
+    return cwkey_now(&t->key);
+}
+
+// Goertzel recurrence for n samples across the whole bank
+static inline void cwtone_filter(CwTone *t, const float *x, int n) {
+    int b = 0;
+#if defined(__AVX__)
+    for (; b + 8 <= CWTONE_BINS; b += 8) {
+        __m256 coef = _mm256_loadu_ps(t->coef + b);
+        __m256 s1 = _mm256_loadu_ps(t->s1 + b), s2 = _mm256_loadu_ps(t->s2 + b);
+        for (int i = 0; i < n; i++) {
+            __m256 s0 = _mm256_sub_ps(_mm256_add_ps(_mm256_set1_ps(x[i]), _mm256_mul_ps(coef, s1)), s2);
+            s2 = s1;
+            s1 = s0;
+        }
+        _mm256_storeu_ps(t->s1 + b, s1);
+        _mm256_storeu_ps(t->s2 + b, s2);
+    }
+#elif defined(CWTONE_SSE2)
+    for (; b + 4 <= CWTONE_BINS; b += 4) {
+        __m128 coef = _mm_loadu_ps(t->coef + b);
+        __m128 s1 = _mm_loadu_ps(t->s1 + b), s2 = _mm_loadu_ps(t->s2 + b);
+        for (int i = 0; i < n; i++) {
+            __m128 s0 = _mm_sub_ps(_mm_add_ps(_mm_set1_ps(x[i]), _mm_mul_ps(coef, s1)), s2);
+            s2 = s1;
+            s1 = s0;
+        }
+        _mm_storeu_ps(t->s1 + b, s1);
+        _mm_storeu_ps(t->s2 + b, s2);
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    for (; b + 4 <= CWTONE_BINS; b += 4) {
+        float32x4_t coef = vld1q_f32(t->coef + b);
+        float32x4_t s1 = vld1q_f32(t->s1 + b), s2 = vld1q_f32(t->s2 + b);
+        for (int i = 0; i < n; i++) {
+            float32x4_t s0 = vsubq_f32(vaddq_f32(vdupq_n_f32(x[i]), vmulq_f32(coef, s1)), s2);
+            s2 = s1;
+            s1 = s0;
+        }
+        vst1q_f32(t->s1 + b, s1);
+        vst1q_f32(t->s2 + b, s2);
+    }
+#endif
+    for (; b < CWTONE_BINS; b++) {
+        float s1 = t->s1[b], s2 = t->s2[b], coef = t->coef[b];
+        for (int i = 0; i < n; i++) {
+            float s0 = x[i] + coef * s1 - s2;
+            s2 = s1;
+            s1 = s0;
+        }
+        t->s1[b] = s1;
+        t->s2[b] = s2;
+    }
+}
+
+// A block is complete: track the carrier, key its power
+static inline void cwtone_block(CwTone *t) {
+    float norm = 1.0f / ((float)t->blockLen * (float)t->blockLen);
+    float trackAlpha = (float)CWTONE_BLOCK_MS / CWTONE_TRACK_MS;
+    float power = 0;
+    int best = 0;
+    for (int b = 0; b < CWTONE_BINS; b++) {
+        float p = (t->s1[b] * t->s1[b] + t->s2[b] * t->s2[b] - t->coef[b] * t->s1[b] * t->s2[b]) * norm;
+        t->avg[b] += (p - t->avg[b]) * trackAlpha;
+        if (t->avg[b] > t->avg[best]) best = b;
+        if (b == t->track) power = p;
+        t->s1[b] = t->s2[b] = 0;
+    }
+    // Follow the strongest carrier between elements only, so an edge never
+    // straddles two bins
+    if (!t->key.keyDown && t->avg[best] > t->avg[t->track] * CWTONE_TRACK_HYST) t->track = best;
+    cwkey_block(&t->key, power);
+}
+
+// Feed n mono samples; elements are emitted as each key-up is detected
+static inline void cwtone_feed(CwTone *t, const float *x, size_t n) {
+    while (n > 0) {
+        int step = t->blockLen - t->blockPos;
+        if ((size_t)step > n) step = (int)n;
+        cwtone_filter(t, x, step);
+        t->blockPos += step;
+        x += step;
+        n -= step;
+        if (t->blockPos == t->blockLen) {
+            t->blockPos = 0;
+            cwtone_block(t);
+        }
+    }
+}
+
+// End of the audio: a key still held down ends here
+static inline void cwtone_finish(CwTone *t) {
+    cwkey_finish(&t->key);
+}
+
+#endif // CW_AUDIO_H
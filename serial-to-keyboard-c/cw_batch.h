@@ -0,0 +1,501 @@
+/*
+ * cw_batch.h
+ * Offline batch decoding of recorded sessions (captures and archives).
+ *
+ * Every input file becomes one task, loaded and decoded by the worker that
+ * runs it; a large file is also cut into segments at word gaps so a single
+ * session can use every core too. Tasks run on the work-stealing pool in
+ * cw_pool.h, biggest first, each worker with its own MorseDecoder, and the
+ * text of each file is stitched back together in segment order.
+ *
+ * Elements are decoded exactly as the live loop would have seen them: the
+ * character timeout is checked against each element's arrival time before
+ * the element itself is processed. A file decoded in one piece gives the
+ * text of a sequential replay. A segment's decoder cannot inherit the
+ * adaptive state of the one before it, so it warms up on the elements
+ * before its cut instead; its speed estimate has then converged and the
+ * text normally matches too, but it is not guaranteed to (an operator who
+ * changes speed right at a cut, or a learned classifier still training).
+ */
+
+#ifndef CW_BATCH_H
+#define CW_BATCH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <dirent.h>
+#endif
+
+#include "cw_capture.h"
+#include "cw_archive.h"
+#include "morse_decoder.h"
+#include "cw_pool.h"
+
+#define CWBATCH_SPLIT_GAP_MS 2000     // Always a safe place to cut, whatever the speed
+#define CWBATCH_MIN_SEGMENT 1024      // Never cut segments smaller than this
+#define CWBATCH_WARMUP 512            // Elements a segment's decoder sees, muted, before its own
+
+// ============================================================
+// LOADING
+// ============================================================
+
+typedef struct {
+    CwArcElement *el;
+    size_t count;
+    size_t cap;
+} CwElementList;
+
+static inline int cwbatch_push(CwElementList *l, uint32_t pause, uint32_t length, uint64_t arrivalMs) {
+    if (l->count == l->cap) {
+        size_t cap = l->cap ? l->cap * 2 : 4096;
+        CwArcElement *el = (CwArcElement *)realloc(l->el, cap * sizeof(CwArcElement));
+        if (!el) return -1;
+        l->el = el;
+        l->cap = cap;
+    }
+    CwArcElement *e = &l->el[l->count++];
+    e->pause = pause;
+    e->length = length;
+    e->arrivalMs = arrivalMs;
+    return 0;
+}
+
+static inline void cwbatch_free_list(CwElementList *l) {
+    free(l->el);
+    memset(l, 0, sizeof(*l));
+}
+
+static inline int cwbatch_load_archive(const char *path, CwElementList *out) {
+    CwArchive a;
+    if (cwarc_open(&a, path) != 0) return -1;
+    int rc = 0;
+    for (uint32_t c = 0; c < a.chunkCount && rc == 0; c++) {
+        CwArcChunkInfo ci;
+        cwarc_chunk_info(&a, c, &ci);
+        while (out->cap < out->count + ci.count) {
+            size_t cap = out->cap ? out->cap * 2 : CWARC_CHUNK_ELEMENTS;
+            CwArcElement *el = (CwArcElement *)realloc(out->el, cap * sizeof(CwArcElement));
+            if (!el) { rc = -1; break; }
+            out->el = el;
+            out->cap = cap;
+        }
+        if (rc == 0) {
+            int n = cwarc_decode_chunk(&a, c, out->el + out->count);
+            if (n < 0) rc = -1;
+            else out->count += n;
+        }
+    }
+    cwarc_close(&a);
+    return rc;
+}
+
+static inline int cwbatch_push_line(CwElementList *out, const char *line, uint64_t arrivalMs) {
+    int pauses[16], lengths[16];
+    int count = cwcap_parse_line(line, pauses, lengths, 16);
+    int rc = 0;
+    for (int k = 0; k < count && rc == 0; k++) {
+        rc = cwbatch_push(out, (uint32_t)pauses[k], (uint32_t)lengths[k], arrivalMs);
+    }
+    return rc;
+}
+
+// Captures are byte streams: assemble lines the way serial_keyboard does and
+// stamp each element with the arrival time of the chunk that completed it
+static inline int cwbatch_load_capture(const char *path, CwElementList *out) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return -1;
+    if (cwcap_read_header(f, NULL) != 0) { fclose(f); return -1; }
+    char *chunk = (char *)malloc(CWCAP_MAX_CHUNK);
+    if (!chunk) { fclose(f); return -1; }
+    char line[256];
+    int linePos = 0, n, rc = 0, haveFirst = 0;
+    uint64_t timeUs = 0, firstUs = 0;
+    while (rc == 0 && (n = cwcap_read_chunk(f, &timeUs, chunk)) >= 0) {
+        if (!haveFirst) { firstUs = timeUs; haveFirst = 1; }
+        for (int i = 0; i < n && rc == 0; i++) {
+            if (chunk[i] != '\r' && chunk[i] != '\n') {
+                if (linePos < (int)sizeof(line) - 1) line[linePos++] = chunk[i];
+                continue;
+            }
+            line[linePos] = '\0';
+            linePos = 0;
+            rc = cwbatch_push_line(out, line, (timeUs - firstUs) / 1000);
+        }
+    }
+    // A capture cut off mid-line: keep what it has
+    if (rc == 0 && linePos > 0) {
+        line[linePos] = '\0';
+        rc = cwbatch_push_line(out, line, (timeUs - firstUs) / 1000);
+    }
+    free(chunk);
+    fclose(f);
+    return rc;
+}
+
+// Load a capture or an archive (detected by magic). Returns 0 on success.
+static inline int cwbatch_load(const char *path, CwElementList *out) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return -1;
+    char magic[CWARC_MAGIC_LEN];
+    size_t got = fread(magic, 1, sizeof(magic), f);
+    fclose(f);
+    if (cwarc_is_archive(magic, got)) return cwbatch_load_archive(path, out);
+    return cwbatch_load_capture(path, out);
+}
+
+static inline int cwbatch_is_session_name(const char *name) {
+    const char *dot = strrchr(name, '.');
+    return dot && (strcmp(dot, ".cwcap") == 0 || strcmp(dot, ".cwarc") == 0);
+}
+
+// List the *.cwcap / *.cwarc files in dir as "dir/name" paths (caller frees
+// each entry and the array). Returns the count, or -1 if dir can't be read.
+static inline int cwbatch_list_dir(const char *dir, char ***paths) {
+    int count = 0, cap = 0;
+    *paths = NULL;
+#ifdef _WIN32
+    char pattern[MAX_PATH];
+    snprintf(pattern, sizeof(pattern), "%s\\*", dir);
+    WIN32_FIND_DATAA fd;
+    HANDLE h = FindFirstFileA(pattern, &fd);
+    if (h == INVALID_HANDLE_VALUE) return -1;
+    do {
+        const char *name = fd.cFileName;
+        if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) continue;
+#else
+    DIR *d = opendir(dir);
+    if (!d) return -1;
+    struct dirent *ent;
+    while ((ent = readdir(d))) {
+        const char *name = ent->d_name;
+#endif
+        if (!cwbatch_is_session_name(name)) continue;
+        if (count == cap) {
+            cap = cap ? cap * 2 : 64;
+            char **grown = (char **)realloc(*paths, cap * sizeof(char *));
+            if (!grown) break;
+            *paths = grown;
+        }
+        size_t len = strlen(dir) + strlen(name) + 2;
+        char *path = (char *)malloc(len);
+        if (!path) break;
+        snprintf(path, len, "%s/%s", dir, name);
+        (*paths)[count++] = path;
+#ifdef _WIN32
+    } while (FindNextFileA(h, &fd));
+    FindClose(h);
+#else
+    }
+    closedir(d);
+#endif
+    return count;
+}
+
+// ============================================================
+// DECODING
+// ============================================================
+
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} CwBatchText;
+
+typedef struct {
+    int file;             // Index into CwBatch.files
+    size_t first, count;  // Element range within the file
+    int seedDot;          // Dit estimate for segments that start mid-session (-1: learn)
+    int muted;            // Warming up: decoded text is not this task's
+    CwBatchText text;
+    MorseStats stats;
+    int dotTiming;        // Decoder's dit estimate when the segment ended
+    int lowercase;        // Fold decoded letters to lowercase
+} CwBatchTask;
+
+typedef struct {
+    const char *path;
+    int loaded;           // 0 = could not be read
+    size_t elementCount;
+    uint64_t durationMs;  // Arrival of the last element
+    CwBatchTask *tasks;   // In segment order
+    int taskCount;
+
+    long long bytes;      // Size on disk, for scheduling
+    CwElementList elements;  // Only while the file is being decoded
+} CwBatchFile;
+
+typedef struct {
+    CwBatchFile *files;
+    int fileCount;
+    int taskCount;        // Tasks run in all
+    int lowercase;        // Fold decoded letters to lowercase
+    const MorseParams *params;  // Decoder rules (NULL: defaults)
+
+    MorseDecoder *decoders;  // One per worker
+    long long splitBytes; // Files larger than this are cut into segments
+    CwBatchTask **segments;  // Segments of the files that were cut
+} CwBatch;
+
+static inline void cwbatch_on_char(void *ctx, char c) {
+    CwBatchTask *t = (CwBatchTask *)ctx;
+    if (t->muted) return;
+    if (t->lowercase && c >= 'A' && c <= 'Z') c = c - 'A' + 'a';
+    if (t->text.len + 1 >= t->text.cap) {
+        size_t cap = t->text.cap ? t->text.cap * 2 : 4096;
+        char *data = (char *)realloc(t->text.data, cap);
+        if (!data) return;
+        t->text.data = data;
+        t->text.cap = cap;
+    }
+    t->text.data[t->text.len++] = c;
+    t->text.data[t->text.len] = '\0';
+}
+
+static inline void cwbatch_feed(MorseDecoder *d, const CwArcElement *e) {
+    // +1 keeps arrival 0 distinct from "no activity yet"
+    unsigned long now = (unsigned long)e->arrivalMs + 1;
+    morseCheckTimeout(d, now);
+    d->lastActivityTime = now;
+    morseProcessElement(d, (int)e->pause, (int)e->length);
+}
+
+static inline void cwbatch_stats_sub(MorseStats *a, const MorseStats *b) {
+    a->elements -= b->elements;
+    a->noise -= b->noise;
+    a->dits -= b->dits;
+    a->dahs -= b->dahs;
+    a->chars -= b->chars;
+    a->words -= b->words;
+    a->unknown -= b->unknown;
+    a->timeouts -= b->timeouts;
+}
+
+/*
+ * Decode one segment. A segment after the first starts on a decoder that
+ * has just decoded the CWBATCH_WARMUP elements before it, muted, so its
+ * speed estimate is where a sequential decode would have it. The previous
+ * segment's last character belongs to that segment: the warm decoder
+ * finishes it silently, as the previous one finishes it out loud.
+ */
+static inline void cwbatch_run_segment(CwBatch *b, CwBatchTask *t, int worker) {
+    const CwElementList *l = &b->files[t->file].elements;
+    MorseDecoder *d = &b->decoders[worker];
+
+    morseInit(d, cwbatch_on_char, NULL, t);
+    if (b->params) d->params = *b->params;
+    if (t->seedDot > 0) {
+        d->dotTiming = t->seedDot;
+        d->dashTiming = t->seedDot * 3;
+    }
+    if (t->first > 0) {
+        size_t warm = t->first > CWBATCH_WARMUP ? t->first - CWBATCH_WARMUP : 0;
+        t->muted = 1;
+        for (size_t i = warm; i < t->first; i++) cwbatch_feed(d, &l->el[i]);
+        morseCheckTimeout(d, (unsigned long)l->el[t->first].arrivalMs + 1);
+        morseCompleteCharacter(d);
+        t->muted = 0;
+    }
+    MorseStats before = d->stats;
+
+    size_t end = t->first + t->count;
+    for (size_t i = t->first; i < end; i++) cwbatch_feed(d, &l->el[i]);
+    // What the next element would do to the last character (its timeout)
+    if (end < l->count) morseCheckTimeout(d, (unsigned long)l->el[end].arrivalMs + 1);
+    morseCompleteCharacter(d);
+    t->stats = d->stats;
+    cwbatch_stats_sub(&t->stats, &before);
+    t->dotTiming = d->dotTiming;
+}
+
+static inline CwBatchTask *cwbatch_add_task(CwBatch *b, int f, size_t first, size_t count) {
+    CwBatchFile *file = &b->files[f];
+    CwBatchTask *grown = (CwBatchTask *)realloc(file->tasks, (file->taskCount + 1) * sizeof(CwBatchTask));
+    if (!grown) return NULL;
+    file->tasks = grown;
+    CwBatchTask *t = &file->tasks[file->taskCount++];
+    memset(t, 0, sizeof(*t));
+    t->file = f;
+    t->first = first;
+    t->count = count;
+    t->seedDot = -1;
+    t->lowercase = b->lowercase;
+    return t;
+}
+
+// Cut file f into tasks of roughly target elements, at long silences only
+static inline int cwbatch_split(CwBatch *b, int f, size_t target) {
+    const CwElementList *l = &b->files[f].elements;
+    size_t start = 0;
+    while (start < l->count) {
+        // Cut at the first word gap (7 dits, or any long silence) past the
+        // target, so no character is split between two decoders
+        size_t end = start + target;
+        uint32_t cutGap = CWBATCH_SPLIT_GAP_MS;
+        if (end < l->count) {
+            CwArcChunkInfo ci;
+            cwarc_chunk_stats(l->el + end - CWBATCH_MIN_SEGMENT, CWBATCH_MIN_SEGMENT, &ci);
+            if (ci.wpmX10 && 7 * 12000u / ci.wpmX10 < cutGap) cutGap = 7 * 12000u / ci.wpmX10;
+        }
+        while (end < l->count && l->el[end].pause < cutGap) end++;
+        if (end > l->count || l->count - end < CWBATCH_MIN_SEGMENT) end = l->count;
+
+        CwBatchTask *t = cwbatch_add_task(b, f, start, end - start);
+        if (!t) return -1;
+        if (start > 0) {
+            // Start the warm-up from the speed around the cut, not from scratch
+            CwArcChunkInfo ci;
+            size_t warm = start > CWBATCH_WARMUP ? CWBATCH_WARMUP : start;
+            cwarc_chunk_stats(l->el + start - warm, (uint32_t)warm, &ci);
+            if (ci.wpmX10) t->seedDot = 12000 / ci.wpmX10;
+        }
+        start = end;
+    }
+    return 0;
+}
+
+// Load one file on a worker. A small file is decoded there and then, in one
+// piece, and dropped; a large one is cut into segments for the second pass.
+static inline void cwbatch_run_file(void *ctx, int f, int worker) {
+    CwBatch *b = (CwBatch *)ctx;
+    CwBatchFile *file = &b->files[f];
+    if (cwbatch_load(file->path, &file->elements) != 0) {
+        cwbatch_free_list(&file->elements);
+        return;
+    }
+    file->loaded = 1;
+    file->elementCount = file->elements.count;
+    file->durationMs = file->elements.count ? file->elements.el[file->elements.count - 1].arrivalMs : 0;
+
+    long long pieces = b->splitBytes > 0 ? file->bytes / b->splitBytes : 1;
+    size_t target = pieces > 1 ? file->elements.count / (size_t)pieces : file->elements.count;
+    if (target < CWBATCH_MIN_SEGMENT) target = CWBATCH_MIN_SEGMENT;
+    if (target < file->elements.count) {
+        if (cwbatch_split(b, f, target) == 0) return;
+        free(file->tasks);
+        file->tasks = NULL;
+        file->taskCount = 0;
+    }
+    CwBatchTask *t = cwbatch_add_task(b, f, 0, file->elements.count);
+    if (t) cwbatch_run_segment(b, t, worker);
+    else file->loaded = 0;
+    cwbatch_free_list(&file->elements);
+}
+
+static inline void cwbatch_run_split(void *ctx, int task, int worker) {
+    CwBatch *b = (CwBatch *)ctx;
+    cwbatch_run_segment(b, b->segments[task], worker);
+}
+
+typedef struct {
+    size_t key;
+    int index;
+} CwBatchOrder;
+
+// Biggest first
+static inline int cwbatch_order_cmp(const void *a, const void *b) {
+    size_t ka = ((const CwBatchOrder *)a)->key, kb = ((const CwBatchOrder *)b)->key;
+    if (ka != kb) return ka < kb ? 1 : -1;
+    return ((const CwBatchOrder *)a)->index - ((const CwBatchOrder *)b)->index;
+}
+
+// Task ids sorted by key, biggest first (caller frees)
+static inline int *cwbatch_order(CwBatchOrder *o, int n) {
+    int *order = (int *)malloc(sizeof(int) * (n > 0 ? n : 1));
+    if (!order) return NULL;
+    qsort(o, (size_t)n, sizeof(*o), cwbatch_order_cmp);
+    for (int i = 0; i < n; i++) order[i] = o[i].index;
+    return order;
+}
+
+static inline long long cwbatch_file_size(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return 0;
+    fseek(f, 0, SEEK_END);
+    long long size = ftell(f);
+    fclose(f);
+    return size > 0 ? size : 0;
+}
+
+/*
+ * Decode files[0..fileCount) on `workers` threads (<= 0: one per CPU).
+ * Files that can't be read are left with loaded = 0. Returns 0 on success.
+ *
+ * First pass: every file is a task, biggest first, and is loaded by the
+ * worker that runs it, so at most one file per worker is in memory. Files
+ * larger than a share of the corpus (one long session) are cut at word
+ * gaps instead and kept; the second pass decodes their segments on all
+ * workers.
+ */
+static inline int cwbatch_run(CwBatch *b, int workers) {
+    if (workers <= 0) workers = cwpool_cpu_count();
+    long long totalBytes = 0;
+    for (int f = 0; f < b->fileCount; f++) {
+        b->files[f].bytes = cwbatch_file_size(b->files[f].path);
+        totalBytes += b->files[f].bytes;
+    }
+    // About 16 tasks per worker keeps everyone busy without tiny segments
+    b->splitBytes = totalBytes / ((long long)workers * 16);
+
+    b->decoders = (MorseDecoder *)calloc(workers, sizeof(MorseDecoder));
+    CwBatchOrder *o = (CwBatchOrder *)malloc(sizeof(CwBatchOrder) * (b->fileCount > 0 ? b->fileCount : 1));
+    if (!b->decoders || !o) { free(o); return -1; }
+    for (int f = 0; f < b->fileCount; f++) {
+        o[f].key = (size_t)b->files[f].bytes;
+        o[f].index = f;
+    }
+    int *order = cwbatch_order(o, b->fileCount);
+    free(o);
+    if (!order || cwpool_run(b->fileCount, workers, order, cwbatch_run_file, b) != 0) { free(order); return -1; }
+    free(order);
+
+    // Second pass: the segments of the files that were cut
+    int count = 0;
+    for (int f = 0; f < b->fileCount; f++) {
+        if (b->files[f].elements.el) count += b->files[f].taskCount;
+    }
+    b->segments = (CwBatchTask **)malloc(sizeof(CwBatchTask *) * (count > 0 ? count : 1));
+    o = (CwBatchOrder *)malloc(sizeof(CwBatchOrder) * (count > 0 ? count : 1));
+    if (!b->segments || !o) { free(o); return -1; }
+    count = 0;
+    for (int f = 0; f < b->fileCount; f++) {
+        if (!b->files[f].elements.el) continue;
+        for (int i = 0; i < b->files[f].taskCount; i++) {
+            o[count].key = b->files[f].tasks[i].count;
+            o[count].index = count;
+            b->segments[count++] = &b->files[f].tasks[i];
+        }
+    }
+    order = cwbatch_order(o, count);
+    free(o);
+    int rc = order ? cwpool_run(count, workers, order, cwbatch_run_split, b) : -1;
+    free(order);
+    for (int f = 0; f < b->fileCount; f++) {
+        cwbatch_free_list(&b->files[f].elements);
+        b->taskCount += b->files[f].taskCount;
+    }
+    return rc;
+}
+
+static inline void cwbatch_free(CwBatch *b) {
+    for (int f = 0; f < b->fileCount; f++) {
+        CwBatchFile *file = &b->files[f];
+        cwbatch_free_list(&file->elements);
+        for (int i = 0; i < file->taskCount; i++) free(file->tasks[i].text.data);
+        free(file->tasks);
+        file->tasks = NULL;
+        file->taskCount = 0;
+    }
+    free(b->segments);
+    free(b->decoders);
+    b->segments = NULL;
+    b->decoders = NULL;
+    b->taskCount = 0;
+}
+
+#endif // CW_BATCH_H
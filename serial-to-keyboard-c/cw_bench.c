@@ -0,0 +1,305 @@
+/*
+ * cw_bench.c - Decoder accuracy benchmark
+ * Generates ground-truth sessions across a sweep of speeds, Farnsworth
+ * spacing, timing jitter and glitch rates (cw_gen.h), decodes them on a
+ * simulated clock (cw_score.h) and prints character error rate and latency
+ * for every cell. Deterministic for a given seed, so two runs of the matrix
+ * (e.g. before and after a decoder change, or with a tuned profile) can be
+ * compared cell by cell. --classifier decodes every cell both ways, with the
+ * tolerance rules and with the learned classifier (morse_decoder.h), and
+ * shows their error rates and decode time per element side by side.
+ * --contest locks the decoder to each cell's speed (contest mode), to set
+ * its error rate and latency against the adaptive decoder's. --fixed also
+ * classifies every cell in one batch against a fixed timing model at the
+ * cell's speed and spacing (morse_batch.h): the error rate a decoder that
+ * knew the speed all along would get, and what that costs per element.
+ *
+ * Compile: clang -O2 -o cw_bench cw_bench.c
+ * Run: ./cw_bench [--profile tuned.profile] [--csv results.csv] [--classifier] [--contest] [--fixed]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cw_batch.h"
+#include "cw_gen.h"
+#include "cw_score.h"
+#include "morse_batch.h"
+
+#define DEFAULT_CHARS 2000
+
+// ============================================================
+// SWEEP
+// ============================================================
+
+static const double sweepWpm[] = { 5, 10, 15, 20, 25, 30, 40, 50, 60 };
+static const double sweepFarnsworth[] = { 1.0, 1.5, 2.5 };
+static const double sweepJitter[] = { 0.0, 0.1, 0.2 };
+static const double sweepGlitch[] = { 0.0, 0.02 };
+
+#define COUNT(a) (int)(sizeof(a) / sizeof(a[0]))
+#define CELL_COUNT (COUNT(sweepFarnsworth) * COUNT(sweepWpm) * COUNT(sweepJitter) * COUNT(sweepGlitch))
+
+typedef struct {
+    CwGenParams gen;
+    unsigned long chars;      // Transcript length (normalized)
+    unsigned long errors;
+    double cer;
+    double latencyMs;
+    unsigned long elements;
+    double decodeUs;
+    // --classifier
+    unsigned long learnedErrors;
+    double learnedCer, learnedUs;
+    // --fixed
+    unsigned long fixedErrors;
+    double fixedCer, fixedUs;
+} Cell;
+
+typedef struct {
+    Cell *cells;
+    CwScorer *workers;
+    const MorseParams *params;
+    const MorseParams *learned;   // Also decode with this (--classifier), or NULL
+    int contest;                  // Lock the speed to each cell's WPM
+    int fixed;                    // Also classify with a fixed timing model
+    int chars;
+} Bench;
+
+static void collectElement(void *ctx, const CwArcElement *e) {
+    cwbatch_push((CwElementList *)ctx, e->pause, e->length, e->arrivalMs);
+}
+
+// Classify the cell in one batch against the model its generator used, and
+// walk the class bytes into s->text (normalized)
+static void fixedCell(CwScorer *s, Cell *c, const CwElementList *l, const MorseParams *params) {
+    size_t n = l->count;
+    int32_t *pauses = (int32_t *)malloc(sizeof(int32_t) * (n ? n : 1));
+    int32_t *lengths = (int32_t *)malloc(sizeof(int32_t) * (n ? n : 1));
+    uint8_t *classes = (uint8_t *)malloc(n ? n : 1);
+    if (s->cap < 2 * n + 2) {
+        char *text = (char *)realloc(s->text, 2 * n + 2);   // At most a character and a space per element
+        if (text) {
+            s->text = text;
+            s->cap = 2 * n + 2;
+        }
+    }
+    s->len = 0;
+    if (pauses && lengths && classes && s->cap >= 2 * n + 2) {
+        for (size_t i = 0; i < n; i++) {
+            pauses[i] = (int32_t)l->el[i].pause;
+            lengths[i] = (int32_t)l->el[i].length;
+        }
+        int dot = (int)(1200.0 / c->gen.wpm + 0.5);
+        MorseTimingModel m = morseModel(dot, (int)(dot * c->gen.dahRatio + 0.5), params);
+        m.wordGap = params->wordGap * c->gen.farnsworth * c->gen.wordSpacing;  // Character gaps stretch too
+        morseModelPrepare(&m);
+        MorseWalk walk = { 0, 0, 0 };
+        uint64_t t0 = cwcap_now_us();
+        morseClassifyBatch(&m, pauses, lengths, classes, n);
+        s->len = morseWalkBatch(&walk, classes, n, s->text, s->cap);
+        s->len += morseWalkBatch(&walk, NULL, 0, s->text + s->len, s->cap - s->len);
+        c->fixedUs = (double)(cwcap_now_us() - t0);
+    }
+    s->len = cwscore_normalize(s->text, s->len);
+    free(pauses);
+    free(lengths);
+    free(classes);
+}
+
+static void runCell(void *ctx, int task, int worker) {
+    Bench *b = (Bench *)ctx;
+    Cell *c = &b->cells[task];
+    CwScorer *s = &b->workers[worker];
+
+    // Transcript: random words from the same seed as the timing
+    CwGen g;
+    CwElementList elements = { NULL, 0, 0 };
+    cwgen_init(&g, &c->gen, collectElement, &elements);
+    char *label = (char *)malloc(b->chars + 32);
+    if (!label) return;
+    size_t len = cwgen_words(&g, label, (size_t)b->chars);
+    cwgen_text(&g, label);
+
+    s->latencySum = 0;
+    s->latencyCount = 0;
+    MorseParams params = *b->params;
+    if (b->contest) params.lockedWpm = c->gen.wpm;
+    uint64_t t0 = cwcap_now_us();
+    cwscore_decode(s, elements.el, elements.count, &params);
+    c->decodeUs = (double)(cwcap_now_us() - t0);
+    c->elements = (unsigned long)elements.count;
+    c->chars = (unsigned long)len;
+    c->errors = (unsigned long)cwscore_errors(s, label, len, (long)len + 16);
+    c->cer = 100.0 * c->errors / len;
+    c->latencyMs = s->latencyCount ? s->latencySum / s->latencyCount : 0.0;
+    if (b->learned) {
+        t0 = cwcap_now_us();
+        cwscore_decode(s, elements.el, elements.count, b->learned);
+        c->learnedUs = (double)(cwcap_now_us() - t0);
+        c->learnedErrors = (unsigned long)cwscore_errors(s, label, len, (long)len + 16);
+        c->learnedCer = 100.0 * c->learnedErrors / len;
+    }
+    if (b->fixed) {
+        fixedCell(s, c, &elements, b->params);
+        c->fixedErrors = (unsigned long)cwscore_errors(s, label, len, (long)len + 16);
+        c->fixedCer = 100.0 * c->fixedErrors / len;
+    }
+    cwbatch_free_list(&elements);
+    free(label);
+}
+
+// ============================================================
+// MAIN
+// ============================================================
+
+static void printUsage(const char *progname) {
+    printf("CW Hotline decoder accuracy benchmark\n\n");
+    printf("Usage: %s [options]\n\n", progname);
+    printf("Options:\n");
+    printf("  --profile <file>  Decoder timing rules to test (default: built-in)\n");
+    printf("  --chars <N>       Characters of text per cell (default: %d)\n", DEFAULT_CHARS);
+    printf("  --seed <N>        Base seed for text and timing (default: 1)\n");
+    printf("  --csv <file>      Also write every cell as CSV\n");
+    printf("  --classifier      Compare the tolerance rules with the learned classifier\n");
+    printf("  --contest         Lock the decoder to each cell's speed (contest mode)\n");
+    printf("  --fixed           Also classify each cell against a fixed model at its speed\n");
+    printf("  -j <N>            Worker threads (default: one per CPU)\n");
+}
+
+int main(int argc, char *argv[]) {
+    MorseParams params;
+    morseDefaultParams(&params);
+    const char *csvPath = NULL;
+    unsigned long long seed = 1;
+    int workers = 0, compare = 0;
+    Bench b;
+    memset(&b, 0, sizeof(b));
+    b.chars = DEFAULT_CHARS;
+    b.params = &params;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            if (morseLoadProfile(&params, argv[++i]) != 0) {
+                printf("Cannot load profile '%s'\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--chars") == 0 && i + 1 < argc) b.chars = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) seed = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--csv") == 0 && i + 1 < argc) csvPath = argv[++i];
+        else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) workers = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--classifier") == 0) compare = 1;
+        else if (strcmp(argv[i], "--contest") == 0) b.contest = 1;
+        else if (strcmp(argv[i], "--fixed") == 0) b.fixed = 1;
+        else { printUsage(argv[0]); return strcmp(argv[i], "-h") != 0 && strcmp(argv[i], "--help") != 0; }
+    }
+    if (b.chars < 1) b.chars = DEFAULT_CHARS;
+    MorseParams learned = params;
+    learned.classifier = 1;
+    if (compare) b.learned = &learned;
+
+    if (workers <= 0) workers = cwpool_cpu_count();
+    b.cells = (Cell *)calloc(CELL_COUNT, sizeof(Cell));
+    b.workers = (CwScorer *)calloc(workers, sizeof(CwScorer));
+    if (!b.cells || !b.workers) { printf("[!] Out of memory\n"); return 1; }
+    for (int i = 0; i < workers; i++) {
+        if (cwscore_init(&b.workers[i]) != 0) { printf("[!] Out of memory\n"); return 1; }
+    }
+
+    // Cell order: Farnsworth, WPM, jitter, glitch (matches the tables below)
+    int n = 0;
+    for (int f = 0; f < COUNT(sweepFarnsworth); f++)
+        for (int w = 0; w < COUNT(sweepWpm); w++)
+            for (int j = 0; j < COUNT(sweepJitter); j++)
+                for (int g = 0; g < COUNT(sweepGlitch); g++, n++) {
+                    CwGenParams *p = &b.cells[n].gen;
+                    cwgen_default_params(p);
+                    p->wpm = sweepWpm[w];
+                    p->farnsworth = sweepFarnsworth[f];
+                    p->jitter = sweepJitter[j];
+                    p->glitchRate = sweepGlitch[g];
+                    p->seed = seed + n;
+                }
+
+    unsigned long startMs = (unsigned long)(cwcap_now_us() / 1000);
+    if (cwpool_run(CELL_COUNT, workers, NULL, runCell, &b) != 0) {
+        printf("[!] Out of memory\n");
+        return 1;
+    }
+    unsigned long elapsedMs = (unsigned long)(cwcap_now_us() / 1000) - startMs;
+
+    printf("[*] Decoder: tolerance %d, min pulse %d, gaps %gx/%gx, corrections %gx/%gx\n",
+           params.tolerance, params.minPulse, params.charGap, params.wordGap,
+           params.ditCorrection, params.dahCorrection);
+    if (b.contest) printf("[*] Contest mode: speed locked to each cell's WPM\n");
+    if (compare) {
+        printf("[*] Classifier: weights %.2f %.2f %.2f %.2f bias %.2f, learning rate %g\n", learned.clfWeights[0],
+               learned.clfWeights[1], learned.clfWeights[2], learned.clfWeights[3], learned.clfWeights[4], learned.clfRate);
+    }
+    if (b.fixed) printf("[*] Fixed model: %s kernel\n", MORSE_BATCH_KERNEL);
+    printf("[*] %d cells x %d chars in %.2f s. Each cell: %s\n", CELL_COUNT, b.chars, elapsedMs / 1000.0,
+           compare ? "CER % with tolerance rules / with classifier" :
+           b.fixed ? "CER % decoded / with the fixed model" : "CER % / mean latency ms");
+
+    unsigned long totalErrors = 0, totalChars = 0, learnedErrors = 0, fixedErrors = 0, elements = 0;
+    double decodeUs = 0, learnedUs = 0, fixedUs = 0;
+    const Cell *c = b.cells;
+    for (int f = 0; f < COUNT(sweepFarnsworth); f++) {
+        printf("\nFarnsworth %.1fx\n%5s", sweepFarnsworth[f], "WPM");
+        for (int j = 0; j < COUNT(sweepJitter); j++)
+            for (int g = 0; g < COUNT(sweepGlitch); g++) {
+                char head[32];
+                snprintf(head, sizeof(head), "j%.0f%% g%.0f%%", sweepJitter[j] * 100, sweepGlitch[g] * 100);
+                printf(" %13s", head);
+            }
+        printf("\n");
+        for (int w = 0; w < COUNT(sweepWpm); w++) {
+            printf("%5.0f", sweepWpm[w]);
+            for (int k = 0; k < COUNT(sweepJitter) * COUNT(sweepGlitch); k++, c++) {
+                if (compare) printf("   %5.1f/%5.1f", c->cer, c->learnedCer);
+                else if (b.fixed) printf("   %5.1f/%5.1f", c->cer, c->fixedCer);
+                else printf("   %5.1f/%5.0f", c->cer, c->latencyMs);
+                totalErrors += c->errors;
+                totalChars += c->chars;
+                learnedErrors += c->learnedErrors;
+                fixedErrors += c->fixedErrors;
+                elements += c->elements;
+                decodeUs += c->decodeUs;
+                learnedUs += c->learnedUs;
+                fixedUs += c->fixedUs;
+            }
+            printf("\n");
+        }
+    }
+    printf("\n[*] Overall CER %.2f%%\n", totalChars ? 100.0 * totalErrors / totalChars : 0.0);
+    if (compare && elements) {
+        printf("[*] Classifier CER %.2f%%\n", totalChars ? 100.0 * learnedErrors / totalChars : 0.0);
+        printf("[*] Decode time per element: %.1f ns with tolerance rules, %.1f ns with classifier\n",
+               1000.0 * decodeUs / elements, 1000.0 * learnedUs / elements);
+    }
+    if (b.fixed && elements) {
+        printf("[*] Fixed model CER %.2f%%, %.1f ns per element against %.1f ns decoding\n",
+               totalChars ? 100.0 * fixedErrors / totalChars : 0.0, 1000.0 * fixedUs / elements,
+               1000.0 * decodeUs / elements);
+    }
+
+    if (csvPath) {
+        FILE *csv = fopen(csvPath, "w");
+        if (!csv) { perror("Error writing CSV"); return 1; }
+        fprintf(csv, "farnsworth,wpm,jitter,glitch,chars,errors,cer,latency_ms%s%s\n",
+                compare ? ",classifier_errors,classifier_cer" : "", b.fixed ? ",fixed_errors,fixed_cer" : "");
+        for (int i = 0; i < CELL_COUNT; i++) {
+            const Cell *e = &b.cells[i];
+            fprintf(csv, "%.1f,%.0f,%.2f,%.2f,%lu,%lu,%.2f,%.0f", e->gen.farnsworth, e->gen.wpm,
+                    e->gen.jitter, e->gen.glitchRate, e->chars, e->errors, e->cer, e->latencyMs);
+            if (compare) fprintf(csv, ",%lu,%.2f", e->learnedErrors, e->learnedCer);
+            if (b.fixed) fprintf(csv, ",%lu,%.2f", e->fixedErrors, e->fixedCer);
+            fprintf(csv, "\n");
+        }
+        if (fclose(csv) != 0) { perror("Error writing CSV"); return 1; }
+        printf("[OK] Wrote %s\n", csvPath);
+    }
+    return 0;
+}
@@ -0,0 +1,291 @@
+/*
+ * cw_calibrate.h
+ * Guided calibration: the operator sends a known text once, and their
+ * timing is measured from it and turned into a decoder profile.
+ *
+ *   cwcal_init()   the text to be sent
+ *   cwcal_add()    every element as received (noise included)
+ *   cwcal_fit()    align, measure, and derive MorseParams
+ *
+ * The received elements are aligned to the ones the text should produce
+ * (edit distance, where an element costs its dit/dah class and the class of
+ * the gap in front of it), so a missed or extra element only drops out of
+ * the statistics instead of shifting everything after it. The matched pairs
+ * give the operator's dit and dah (mean and spread), intra-character,
+ * character and word gaps, weighting and speed. From those come the match
+ * tolerance, gap thresholds between the measured gap clusters, and a warm
+ * start so the very first characters decode at the right speed.
+ */
+
+#ifndef CW_CALIBRATE_H
+#define CW_CALIBRATE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "cw_archive.h"
+#include "cw_gen.h"
+#include "morse_decoder.h"
+
+#define CWCAL_DEFAULT_TEXT "THE QUICK BROWN FOX JUMPS OVER THE LAZY DOG"
+#define CWCAL_MIN_MATCHED 0.85  // Share of the expected elements that must align
+
+enum { CWCAL_INTRA, CWCAL_CHAR, CWCAL_WORD };
+
+// One element the text should produce, and the gap in front of it
+typedef struct {
+    uint8_t dah;
+    uint8_t gap;        // CWCAL_INTRA/CHAR/WORD
+} CwCalElement;
+
+// Mean and standard deviation of one timing
+typedef struct {
+    double mean, sd;
+    unsigned long n;
+} CwCalStat;
+
+typedef struct {
+    CwCalElement *expected;
+    size_t nExpected;
+    CwArcElement *got;          // As received, noise included
+    size_t nGot, capGot;
+    unsigned long accepted;     // Received elements above the noise floor
+
+    // Results of cwcal_fit()
+    size_t matched, missed, extra;
+    CwCalStat dit, dah, gap[3];
+    double weight;              // 50 = standard
+    double wpm;
+    MorseParams params;
+} CwCalibration;
+
+// Returns 0, or -1 if the text has nothing sendable or memory ran out
+static inline int cwcal_init(CwCalibration *c, const char *text) {
+    memset(c, 0, sizeof(*c));
+    size_t len = strlen(text);
+    c->expected = (CwCalElement *)malloc(sizeof(CwCalElement) * (len * 6 + 1));
+    if (!c->expected) return -1;
+    int gap = -1;  // Nothing sent yet
+    for (size_t i = 0; i < len; i++) {
+        char code[8];
+        if (text[i] == ' ' || text[i] == '\n') {
+            if (gap >= 0) gap = CWCAL_WORD;
+            continue;
+        }
+        int n = cwgen_code(text[i], code);
+        for (int k = 0; k < n; k++) {
+            CwCalElement *e = &c->expected[c->nExpected++];
+            e->dah = code[k] == '-';
+            e->gap = (uint8_t)(k > 0 ? CWCAL_INTRA : gap < 0 ? CWCAL_CHAR : gap);
+        }
+        if (n) gap = CWCAL_CHAR;
+    }
+    if (!c->nExpected) {
+        free(c->expected);
+        c->expected = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+static inline void cwcal_free(CwCalibration *c) {
+    free(c->expected);
+    free(c->got);
+    memset(c, 0, sizeof(*c));
+}
+
+// Record one element. Returns 0, or -1 if memory ran out.
+static inline int cwcal_add(CwCalibration *c, uint32_t pause, uint32_t length, uint64_t arrivalMs, int minPulse) {
+    if (c->nGot == c->capGot) {
+        size_t cap = c->capGot ? c->capGot * 2 : 1024;
+        CwArcElement *got = (CwArcElement *)realloc(c->got, sizeof(CwArcElement) * cap);
+        if (!got) return -1;
+        c->got = got;
+        c->capGot = cap;
+    }
+    CwArcElement *e = &c->got[c->nGot++];
+    e->pause = pause;
+    e->length = length;
+    e->arrivalMs = arrivalMs;
+    if (length >= (uint32_t)minPulse) c->accepted++;
+    return 0;
+}
+
+static inline void cwcal_stat_add(CwCalStat *s, double *sumSq, double v) {
+    s->n++;
+    double d = v - s->mean;
+    s->mean += d / s->n;
+    *sumSq += d * (v - s->mean);
+}
+
+static inline void cwcal_stat_end(CwCalStat *s, double sumSq) {
+    s->sd = s->n > 1 ? sqrt(sumSq / (s->n - 1)) : 0;
+}
+
+// Where two timing clusters are equally far apart in standard deviations
+static inline double cwcal_boundary(const CwCalStat *a, const CwCalStat *b) {
+    double sa = a->sd > 1 ? a->sd : 1, sb = b->sd > 1 ? b->sd : 1;
+    return (a->mean * sb + b->mean * sa) / (sa + sb);
+}
+
+// Align the received elements to the text and fit params, starting from
+// base (for the rules calibration doesn't measure). Returns 0, or -1 if too
+// little of the text could be matched to measure it.
+static inline int cwcal_fit(CwCalibration *c, const MorseParams *base) {
+    c->params = *base;
+    c->params.dit = c->params.dah = 0;
+
+    // Received elements above the noise floor, and the silence before each
+    // one counting any noise pulses inside it
+    size_t n = 0;
+    uint32_t *pause = (uint32_t *)malloc(sizeof(uint32_t) * (c->accepted + 1));
+    uint32_t *length = (uint32_t *)malloc(sizeof(uint32_t) * (c->accepted + 1));
+    if (!pause || !length) { free(pause); free(length); return -1; }
+    uint32_t carry = 0;
+    for (size_t i = 0; i < c->nGot; i++) {
+        if (c->got[i].length < (uint32_t)base->minPulse) {
+            carry += c->got[i].pause + c->got[i].length;
+            continue;
+        }
+        pause[n] = c->got[i].pause + carry;
+        length[n++] = c->got[i].length;
+        carry = 0;
+    }
+    size_t m = c->nExpected;
+    if (n < 2) { free(pause); free(length); return -1; }
+
+    // Rough classes to align with: two-means split of the lengths, gaps at
+    // 2 and 5 dits (between the nominal 1, 3 and 7)
+    double lo = length[0], hi = length[0];
+    for (size_t i = 1; i < n; i++) {
+        if (length[i] < lo) lo = length[i];
+        if (length[i] > hi) hi = length[i];
+    }
+    for (int iter = 0; iter < 16; iter++) {
+        double split = (lo + hi) / 2, sum[2] = {0, 0};
+        unsigned long cnt[2] = {0, 0};
+        for (size_t i = 0; i < n; i++) {
+            int k = length[i] > split;
+            sum[k] += length[i];
+            cnt[k]++;
+        }
+        if (!cnt[0] || !cnt[1]) break;
+        lo = sum[0] / cnt[0];
+        hi = sum[1] / cnt[1];
+    }
+    double split = (lo + hi) / 2, roughDit = lo;
+
+    // Edit distance: a mismatched element costs 2, a mismatched gap 1,
+    // a missed or extra element 2
+    uint8_t *move = (uint8_t *)malloc((n + 1) * (m + 1));  // 0 diagonal, 1 extra, 2 missed
+    unsigned *prev = (unsigned *)malloc(sizeof(unsigned) * (m + 1));
+    unsigned *cur = (unsigned *)malloc(sizeof(unsigned) * (m + 1));
+    if (!move || !prev || !cur) {
+        free(pause); free(length); free(move); free(prev); free(cur);
+        return -1;
+    }
+    for (size_t j = 0; j <= m; j++) { prev[j] = (unsigned)(2 * j); move[j] = 2; }
+    for (size_t i = 1; i <= n; i++) {
+        cur[0] = (unsigned)(2 * i);
+        move[i * (m + 1)] = 1;
+        int dah = length[i - 1] > split;
+        int gap = pause[i - 1] > 5 * roughDit ? CWCAL_WORD : pause[i - 1] > 2 * roughDit ? CWCAL_CHAR : CWCAL_INTRA;
+        for (size_t j = 1; j <= m; j++) {
+            const CwCalElement *e = &c->expected[j - 1];
+            unsigned diag = prev[j - 1] + 2 * (dah != e->dah) + (i > 1 && j > 1 && gap != e->gap);
+            unsigned best = diag, how = 0;
+            if (prev[j] + 2 < best) { best = prev[j] + 2; how = 1; }
+            if (cur[j - 1] + 2 < best) { best = cur[j - 1] + 2; how = 2; }
+            cur[j] = best;
+            move[i * (m + 1) + j] = (uint8_t)how;
+        }
+        unsigned *t = prev; prev = cur; cur = t;
+    }
+
+    // Walk back; a pair counts when its class matches, and its gap counts
+    // when the pair before it matched too
+    double sq[5] = {0, 0, 0, 0, 0};
+    memset(&c->dit, 0, sizeof(c->dit));
+    memset(&c->dah, 0, sizeof(c->dah));
+    memset(c->gap, 0, sizeof(c->gap));
+    c->matched = c->missed = c->extra = 0;
+    size_t i = n, j = m;
+    int nextPaired = 0;    // The pair after this one (in time) matched
+    double nextPause = 0;  // ...and the pause in front of it
+    int nextGap = 0;
+    while (i > 0 || j > 0) {
+        int how = move[i * (m + 1) + j];
+        if (how == 0) {
+            const CwCalElement *e = &c->expected[j - 1];
+            int ok = (length[i - 1] > split) == e->dah;
+            if (ok) {
+                c->matched++;
+                if (e->dah) cwcal_stat_add(&c->dah, &sq[1], length[i - 1]);
+                else cwcal_stat_add(&c->dit, &sq[0], length[i - 1]);
+                if (nextPaired) cwcal_stat_add(&c->gap[nextGap], &sq[2 + nextGap], nextPause);
+            }
+            nextPaired = ok;
+            nextPause = pause[i - 1];
+            nextGap = e->gap;
+            i--; j--;
+        } else if (how == 1) {
+            c->extra++;
+            nextPaired = 0;
+            i--;
+        } else {
+            c->missed++;
+            nextPaired = 0;
+            j--;
+        }
+    }
+    cwcal_stat_end(&c->dit, sq[0]);
+    cwcal_stat_end(&c->dah, sq[1]);
+    for (int k = 0; k < 3; k++) cwcal_stat_end(&c->gap[k], sq[2 + k]);
+    free(pause); free(length); free(move); free(prev); free(cur);
+
+    if (c->matched < CWCAL_MIN_MATCHED * m || c->missed + c->extra > (1 - CWCAL_MIN_MATCHED) * m || c->dit.n < 2 || c->dah.n < 2 || c->gap[CWCAL_INTRA].n < 2 ||
+        c->gap[CWCAL_CHAR].n < 2)
+        return -1;
+
+    // Operator model
+    double dit = c->dit.mean, space = c->gap[CWCAL_INTRA].mean;
+    c->weight = 100 * dit / (dit + space);
+    c->wpm = 1200 / ((dit + space) / 2);
+
+    // Decoder rules: the tolerance covers both elements' spread without
+    // reaching the midpoint between them; gap thresholds sit between the
+    // measured gap clusters
+    MorseParams *p = &c->params;
+    double spread = 3 * (c->dit.sd > c->dah.sd ? c->dit.sd : c->dah.sd);
+    double room = (c->dah.mean - dit) / 2;
+    if (spread < 10) spread = 10;
+    if (spread > room) spread = room;
+    p->tolerance = (int)(spread + 0.5);
+    if (p->minPulse > dit / 2) p->minPulse = (int)(dit / 2);
+    p->charGap = cwcal_boundary(&c->gap[CWCAL_INTRA], &c->gap[CWCAL_CHAR]) / dit;
+    if (c->gap[CWCAL_WORD].n >= 2) p->wordGap = cwcal_boundary(&c->gap[CWCAL_CHAR], &c->gap[CWCAL_WORD]) / dit;
+    if (p->charGap < 1.5) p->charGap = 1.5;
+    if (p->charGap > 5) p->charGap = 5;
+    if (p->wordGap < p->charGap + 1) p->wordGap = p->charGap + 1;
+    p->charGap = floor(p->charGap * 100 + 0.5) / 100;
+    p->wordGap = floor(p->wordGap * 100 + 0.5) / 100;
+    p->dit = (int)(dit + 0.5);
+    p->dah = (int)(c->dah.mean + 0.5);
+    return 0;
+}
+
+// The fitted profile, with the measured model as comments
+static inline void cwcal_write(FILE *f, const CwCalibration *c) {
+    fprintf(f, "# Calibrated profile: %.1f WPM, weight %.0f, dah %.2f dits\n", c->wpm, c->weight,
+            c->dah.mean / c->dit.mean);
+    fprintf(f, "# Gaps (dits): element %.2f, character %.2f, word %.2f\n", c->gap[CWCAL_INTRA].mean / c->dit.mean,
+            c->gap[CWCAL_CHAR].mean / c->dit.mean, c->gap[CWCAL_WORD].n ? c->gap[CWCAL_WORD].mean / c->dit.mean : 0);
+    fprintf(f, "# Jitter (ms): dit %.1f, dah %.1f, element gap %.1f, character gap %.1f\n", c->dit.sd, c->dah.sd,
+            c->gap[CWCAL_INTRA].sd, c->gap[CWCAL_CHAR].sd);
+    fprintf(f, "# %zu of %zu elements matched (%zu missed, %zu extra)\n", c->matched, c->nExpected, c->missed, c->extra);
+    morseWriteProfile(f, &c->params);
+}
+
+#endif // CW_CALIBRATE_H
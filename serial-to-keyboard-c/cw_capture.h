@@ -0,0 +1,131 @@
+/*
+ * cw_capture.h
+ * Binary capture format shared by debug_serial (writer) and
+ * serial_keyboard --replay (reader).
+ *
+ * Layout (all integers little-endian):
+ *   Header  : "CWCAP01\n" | u32 baud | u32 flags (0)
+ *   Chunk   : u64 time_us | u32 length | length bytes
+ *
+ * time_us is monotonic microseconds since the capture started. One chunk is
+ * one read() from the serial port, so replay sees the same byte boundaries
+ * and gaps the live decoder saw.
+ */
+
+#ifndef CW_CAPTURE_H
+#define CW_CAPTURE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <time.h>
+#endif
+
+#define CWCAP_MAGIC "CWCAP01\n"
+#define CWCAP_MAGIC_LEN 8
+#define CWCAP_HEADER_LEN 16
+#define CWCAP_MAX_CHUNK 65536
+
+// Monotonic microseconds (arbitrary epoch)
+static inline uint64_t cwcap_now_us(void) {
+#ifdef _WIN32
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER now;
+    if (!freq.QuadPart) QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    return (uint64_t)(now.QuadPart / freq.QuadPart) * 1000000u +
+           (uint64_t)(now.QuadPart % freq.QuadPart) * 1000000u / freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+#endif
+}
+
+static inline void cwcap_put32(unsigned char *p, uint32_t v) {
+    p[0] = (unsigned char)v; p[1] = (unsigned char)(v >> 8);
+    p[2] = (unsigned char)(v >> 16); p[3] = (unsigned char)(v >> 24);
+}
+
+static inline uint32_t cwcap_get32(const unsigned char *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+// Returns 0 on success, -1 on write error
+static inline int cwcap_write_header(FILE *f, uint32_t baud) {
+    unsigned char hdr[CWCAP_HEADER_LEN];
+    memcpy(hdr, CWCAP_MAGIC, CWCAP_MAGIC_LEN);
+    cwcap_put32(hdr + 8, baud);
+    cwcap_put32(hdr + 12, 0);
+    return fwrite(hdr, 1, sizeof(hdr), f) == sizeof(hdr) ? 0 : -1;
+}
+
+static inline int cwcap_write_chunk(FILE *f, uint64_t timeUs, const void *data, uint32_t len) {
+    unsigned char rec[12];
+    cwcap_put32(rec, (uint32_t)timeUs);
+    cwcap_put32(rec + 4, (uint32_t)(timeUs >> 32));
+    cwcap_put32(rec + 8, len);
+    if (fwrite(rec, 1, sizeof(rec), f) != sizeof(rec)) return -1;
+    return fwrite(data, 1, len, f) == len ? 0 : -1;
+}
+
+// Returns 0 if f starts with a capture header (baud may be NULL)
+static inline int cwcap_read_header(FILE *f, uint32_t *baud) {
+    unsigned char hdr[CWCAP_HEADER_LEN];
+    if (fread(hdr, 1, sizeof(hdr), f) != sizeof(hdr)) return -1;
+    if (memcmp(hdr, CWCAP_MAGIC, CWCAP_MAGIC_LEN) != 0) return -1;
+    if (baud) *baud = cwcap_get32(hdr + 8);
+    return 0;
+}
+
+// Reads the next chunk into buf (at least CWCAP_MAX_CHUNK bytes).
+// Returns its length, or -1 at end of file / on a truncated or bad record.
+static inline int cwcap_read_chunk(FILE *f, uint64_t *timeUs, void *buf) {
+    unsigned char rec[12];
+    if (fread(rec, 1, sizeof(rec), f) != sizeof(rec)) return -1;
+    uint32_t len = cwcap_get32(rec + 8);
+    if (len > CWCAP_MAX_CHUNK) return -1;
+    *timeUs = (uint64_t)cwcap_get32(rec) | (uint64_t)cwcap_get32(rec + 4) << 32;
+    if (fread(buf, 1, len, f) != len) return -1;
+    return (int)len;
+}
+
+// Digits only, as morseProcessCommandWithComma() reads them: no sign, no
+// leading space. Returns the value (-1 if there are none) and sets *end.
+static inline long cwcap_digits(const char *p, const char **end) {
+    long v = -1;
+    for (int n = 0; *p >= '0' && *p <= '9' && n < 9; n++, p++) v = (v < 0 ? 0 : v * 10) + (*p - '0');
+    *end = p;
+    return v;
+}
+
+// Extract the elements of one device line: every 'S' (or 's') followed within
+// 20 chars by ",<pause>...,<length>", the same framing serial_keyboard's
+// handleLine() accepts. Returns the number of elements stored.
+static inline int cwcap_parse_line(const char *line, int *pauses, int *lengths, int max) {
+    int count = 0;
+    for (const char *s = strpbrk(line, "Ss"); s && count < max; s = strpbrk(s + 1, "Ss")) {
+        const char *comma = strchr(s, ',');
+        if (!comma) break;
+        if (comma - s > 20) continue;
+        const char *end;
+        long pause = cwcap_digits(comma + 1, &end);
+        if (pause < 0) continue;
+        const char *second = strchr(comma + 1, ',');
+        if (!second) continue;
+        long length = cwcap_digits(second + 1, &end);
+        if (length <= 0) continue;
+        pauses[count] = (int)pause;
+        lengths[count] = (int)length;
+        count++;
+        s = end - 1;
+    }
+    return count;
+}
+
+#endif // CW_CAPTURE_H
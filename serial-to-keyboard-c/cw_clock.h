@@ -0,0 +1,72 @@
+/*
+ * cw_clock.h
+ * The clock behind every timing decision and sleep in serial_keyboard's
+ * decode and key-injection paths.
+ *
+ * The real clock reads a monotonic timer and really sleeps. The virtual
+ * clock only moves when something sleeps on it (or it is set), and then
+ * instantly, so a replay exercises exactly the live timeout logic -
+ * CHARACTER_TIMEOUT_MS included - in milliseconds of wall time, with the
+ * same result every run.
+ */
+
+#ifndef CW_CLOCK_H
+#define CW_CLOCK_H
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <time.h>
+    #include <unistd.h>
+#endif
+
+typedef struct CwClock CwClock;
+
+struct CwClock {
+    unsigned long (*now)(CwClock *c);            // Milliseconds, arbitrary epoch
+    void (*sleep)(CwClock *c, unsigned long ms);
+    unsigned long virtualMs;                     // Virtual clock: current time
+};
+
+static inline unsigned long cwclock_real_now(CwClock *c) {
+    (void)c;
+#ifdef _WIN32
+    return GetTickCount();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long)ts.tv_sec * 1000 + (unsigned long)(ts.tv_nsec / 1000000);
+#endif
+}
+
+static inline void cwclock_real_sleep(CwClock *c, unsigned long ms) {
+    (void)c;
+#ifdef _WIN32
+    Sleep(ms);
+#else
+    usleep(ms * 1000);
+#endif
+}
+
+static inline unsigned long cwclock_virtual_now(CwClock *c) {
+    return c->virtualMs;
+}
+
+static inline void cwclock_virtual_sleep(CwClock *c, unsigned long ms) {
+    c->virtualMs += ms;
+}
+
+#define CWCLOCK_REAL { cwclock_real_now, cwclock_real_sleep, 0 }
+
+// Starts at 1 s so no timestamp is ever 0 ("no activity yet" to the decoder)
+#define CWCLOCK_VIRTUAL { cwclock_virtual_now, cwclock_virtual_sleep, 1000 }
+
+static inline unsigned long cwclock_now(CwClock *c) {
+    return c->now(c);
+}
+
+static inline void cwclock_sleep(CwClock *c, unsigned long ms) {
+    c->sleep(c, ms);
+}
+
+#endif // CW_CLOCK_H
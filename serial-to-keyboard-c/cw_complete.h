@@ -0,0 +1,245 @@
+/*
+ * cw_complete.h
+ * Word completion for keyboard mode: while a word is being sent, offer the
+ * most likely whole word for what has been decoded so far, so a paddle
+ * operator typing a document can send a prosign instead of the rest.
+ *
+ *   cwcomp_char()     feed every decoded character; updates the offer
+ *   cwcomp_accept()   take the offer: the rest of the word to inject
+ *   cwcomp_load()     the operator's history ("WORD count" lines)...
+ *   cwcomp_save()     ...and back, at the end of the session
+ *
+ * Words live in a trie of first-child/next-sibling nodes in one array.
+ * Every node keeps the best-scoring word below it, so a lookup is a walk
+ * down the prefix (a few sibling hops per letter) with no search of the
+ * subtree. Scores only grow (a base word counts 1, each time the operator
+ * finishes a word CWCOMP_HISTORY_WEIGHT), so learning a word only has to
+ * compare it against the best along its own path.
+ */
+
+#ifndef CW_COMPLETE_H
+#define CW_COMPLETE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CWCOMP_MAX_WORD 32
+#define CWCOMP_MIN_PREFIX 2          // Offer nothing for a single letter
+#define CWCOMP_HISTORY_WEIGHT 4      // One use by the operator outweighs the base list
+
+// Common English, then words that come up on the air. Earlier wins ties.
+static const char *const cwcomp_base_words[] = {
+    "THE", "AND", "THAT", "HAVE", "FOR", "NOT", "WITH", "YOU", "THIS", "BUT", "HIS", "FROM", "THEY",
+    "SAY", "HER", "SHE", "WILL", "ONE", "ALL", "WOULD", "THERE", "THEIR", "WHAT", "ABOUT", "WHICH",
+    "WHEN", "MAKE", "CAN", "LIKE", "TIME", "JUST", "KNOW", "TAKE", "PEOPLE", "INTO", "YEAR", "YOUR",
+    "GOOD", "SOME", "COULD", "THEM", "SEE", "OTHER", "THAN", "THEN", "NOW", "LOOK", "ONLY", "COME",
+    "ITS", "OVER", "THINK", "ALSO", "BACK", "AFTER", "USE", "TWO", "HOW", "OUR", "WORK", "FIRST",
+    "WELL", "WAY", "EVEN", "NEW", "WANT", "BECAUSE", "ANY", "THESE", "GIVE", "DAY", "MOST", "VERY",
+    "THROUGH", "BEFORE", "SHOULD", "WHERE", "AGAIN", "NEVER", "MORNING", "EVENING", "AFTERNOON",
+    "TODAY", "TOMORROW", "TONIGHT", "WEEK", "MESSAGE", "PLEASE", "THANKS", "THANK", "HELLO",
+    "NAME", "HERE", "STATION", "ANTENNA", "DIPOLE", "VERTICAL", "BEAM", "RADIO", "RIG",
+    "POWER", "WATTS", "WEATHER", "SUNNY", "CLOUDY", "RAINING", "SNOWING", "WINDY", "COLD", "WARM",
+    "SIGNAL", "SIGNALS", "REPORT", "CONDITIONS", "NOISE", "FADING", "COPY", "SOLID", "RECEIVED",
+    "SPEED", "PRACTICE", "CONTACT", "CONTEST", "FREQUENCY", "BAND", "KEYER", "PADDLE", "STRAIGHT",
+    "LOCATION", "QTH", "QSL", "QSO", "QRZ", "QRM", "QRN", "QSB", "RST", "TEST",
+};
+
+typedef struct {
+    uint32_t child;   // First child (0 = none; the root is never a child)
+    uint32_t next;    // Next sibling
+    uint32_t best;    // Best-scoring word node in this subtree, 0 = none
+    uint32_t word;    // Word nodes: offset of the word in the pool, plus 1
+    uint32_t hist;    // Word nodes: times the operator finished it
+    uint8_t base;     // Word nodes: in the base vocabulary
+    char c;
+} CwCompNode;
+
+typedef struct {
+    CwCompNode *nodes;
+    uint32_t count, cap;
+    uint32_t words;
+    char *pool;
+    size_t poolLen, poolCap;
+
+    // The word being decoded
+    char word[CWCOMP_MAX_WORD + 1];
+    int len;
+    int broken;           // Not a word we complete (punctuation, too long)
+    uint32_t offer;       // Word node offered for it, 0 = none
+} CwComplete;
+
+static inline uint32_t cwcomp_score(const CwCompNode *n) {
+    return n->hist * CWCOMP_HISTORY_WEIGHT + n->base;
+}
+
+// Letters (either case), digits and '/' (callsigns). Returns the uppercase
+// character, or 0 for anything else.
+static inline char cwcomp_norm(char c) {
+    if (c >= 'a' && c <= 'z') return (char)(c - 'a' + 'A');
+    if ((c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '/') return c;
+    return 0;
+}
+
+static inline uint32_t cwcomp_new_node(CwComplete *c, char ch) {
+    if (c->count == c->cap) {
+        uint32_t cap = c->cap ? c->cap * 2 : 1024;
+        CwCompNode *n = (CwCompNode *)realloc(c->nodes, cap * sizeof(CwCompNode));
+        if (!n) return 0;
+        c->nodes = n;
+        c->cap = cap;
+    }
+    memset(&c->nodes[c->count], 0, sizeof(CwCompNode));
+    c->nodes[c->count].c = ch;
+    return c->count++;
+}
+
+static inline const char *cwcomp_word(const CwComplete *c, uint32_t node) {
+    return c->pool + c->nodes[node].word - 1;
+}
+
+// Add a word, or add to its counts. Returns its node, or 0 if it isn't a
+// word we complete or memory ran out.
+static inline uint32_t cwcomp_add(CwComplete *c, const char *word, size_t len, uint32_t hist, int base) {
+    if (len == 0 || len > CWCOMP_MAX_WORD) return 0;
+    char w[CWCOMP_MAX_WORD + 1];
+    for (size_t i = 0; i < len; i++) {
+        if (!(w[i] = cwcomp_norm(word[i]))) return 0;
+    }
+    w[len] = '\0';
+
+    uint32_t node = 0;
+    for (size_t i = 0; i < len; i++) {
+        uint32_t *link = &c->nodes[node].child;
+        while (*link && c->nodes[*link].c != w[i]) link = &c->nodes[*link].next;
+        if (!*link) {
+            uint32_t n = cwcomp_new_node(c, w[i]);  // May move c->nodes
+            if (!n) return 0;
+            link = &c->nodes[node].child;
+            while (*link) link = &c->nodes[*link].next;
+            *link = n;
+        }
+        node = *link;
+    }
+
+    CwCompNode *t = &c->nodes[node];
+    if (!t->word) {
+        if (c->poolLen + len + 1 > c->poolCap) {
+            size_t cap = c->poolCap ? c->poolCap * 2 : 4096;
+            while (cap < c->poolLen + len + 1) cap *= 2;
+            char *p = (char *)realloc(c->pool, cap);
+            if (!p) return 0;
+            c->pool = p;
+            c->poolCap = cap;
+        }
+        memcpy(c->pool + c->poolLen, w, len + 1);
+        t->word = (uint32_t)c->poolLen + 1;
+        c->poolLen += len + 1;
+        c->words++;
+    }
+    t->hist += hist;
+    if (base) t->base = 1;
+
+    // Bring the best words along the path up to date
+    uint32_t score = cwcomp_score(t), at = 0;
+    for (size_t i = 0;; i++) {
+        CwCompNode *n = &c->nodes[at];
+        if (!n->best || cwcomp_score(&c->nodes[n->best]) < score) n->best = node;
+        if (i == len) break;
+        at = n->child;
+        while (c->nodes[at].c != w[i]) at = c->nodes[at].next;
+    }
+    return node;
+}
+
+static inline int cwcomp_init(CwComplete *c) {
+    memset(c, 0, sizeof(*c));
+    if (cwcomp_new_node(c, '\0') != 0) return -1;  // The root
+    if (c->count != 1) return -1;
+    for (size_t i = 0; i < sizeof(cwcomp_base_words) / sizeof(cwcomp_base_words[0]); i++) {
+        const char *w = cwcomp_base_words[i];
+        if (!cwcomp_add(c, w, strlen(w), 0, 1)) return -1;
+    }
+    return 0;
+}
+
+static inline void cwcomp_free(CwComplete *c) {
+    free(c->nodes);
+    free(c->pool);
+    memset(c, 0, sizeof(*c));
+}
+
+// The best word starting with prefix and longer than it, 0 if none
+static inline uint32_t cwcomp_lookup(const CwComplete *c, const char *prefix, size_t len) {
+    uint32_t node = 0;
+    for (size_t i = 0; i < len; i++) {
+        char ch = cwcomp_norm(prefix[i]);
+        node = c->nodes[node].child;
+        while (node && c->nodes[node].c != ch) node = c->nodes[node].next;
+        if (!node) return 0;
+    }
+    uint32_t best = c->nodes[node].best;
+    return best && best != node ? best : 0;
+}
+
+// One decoded character. Returns 1 if the offer changed.
+static inline int cwcomp_char(CwComplete *c, char ch) {
+    uint32_t was = c->offer;
+    if (ch == ' ' || ch == '\n') {
+        // A finished word goes into the history
+        if (!c->broken && c->len >= CWCOMP_MIN_PREFIX) cwcomp_add(c, c->word, (size_t)c->len, 1, 0);
+        c->len = 0;
+        c->broken = 0;
+    } else if (!c->broken && c->len < CWCOMP_MAX_WORD && cwcomp_norm(ch)) {
+        c->word[c->len++] = cwcomp_norm(ch);
+    } else {
+        c->broken = 1;
+    }
+    c->word[c->len] = '\0';
+    c->offer = c->broken || c->len < CWCOMP_MIN_PREFIX ? 0 : cwcomp_lookup(c, c->word, (size_t)c->len);
+    return c->offer != was;
+}
+
+// The rest of the offered word (uppercase), which now counts as sent, or
+// NULL if nothing is offered. The caller follows it with a space.
+static inline const char *cwcomp_accept(CwComplete *c) {
+    if (!c->offer) return NULL;
+    const char *w = cwcomp_word(c, c->offer);
+    const char *rest = w + c->len;
+    c->len = (int)strlen(w);
+    memcpy(c->word, w, (size_t)c->len + 1);
+    c->offer = 0;
+    return rest;
+}
+
+// Merge a history file. Returns 0, or -1 if it can't be read.
+static inline int cwcomp_load(CwComplete *c, const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    char line[128], w[CWCOMP_MAX_WORD + 1];
+    unsigned long n;
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "%32s %lu", w, &n) == 2 && n > 0) cwcomp_add(c, w, strlen(w), (uint32_t)n, 0);
+    }
+    fclose(f);
+    return 0;
+}
+
+// Every word the operator has finished, with its count. Written to a
+// temporary file and renamed over the old one. Returns 0 or -1.
+static inline int cwcomp_save(const CwComplete *c, const char *path) {
+    char tmp[1024];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "w");
+    if (!f) return -1;
+    for (uint32_t i = 1; i < c->count; i++) {
+        const CwCompNode *n = &c->nodes[i];
+        if (n->word && n->hist) fprintf(f, "%s %u\n", cwcomp_word(c, i), (unsigned)n->hist);
+    }
+    if (fclose(f) != 0) return -1;
+    remove(path);  // Windows rename() won't replace
+    return rename(tmp, path) == 0 ? 0 : -1;
+}
+
+#endif // CW_COMPLETE_H
@@ -0,0 +1,333 @@
+/*
+ * cw_expand.h
+ * Abbreviation and macro expansion on the decoded stream: "TNX" becomes
+ * "THANKS", "73" a sign-off, and any snippet the operator defines comes out
+ * of a few characters of CW. A key matches only as whole words (it may span
+ * several), so "TNX" expands but "ATNXB" does not.
+ *
+ *   cwexp_add()      a key and its expansion (built-ins: cwexp_init())
+ *   cwexp_load()     "KEY = expansion" lines from a file
+ *   cwexp_compile()  build the automaton (after the last add)
+ *   cwexp_char()     one decoded character in...
+ *   cwexp_flush()    ...or the end of the stream (counts as a word gap)
+ *
+ * Output collects in outText/outLen for the caller to drain, so an expansion
+ * and whatever surrounds it can be injected as one sequence.
+ *
+ * All keys, each followed by a word gap, go into one Aho-Corasick
+ * automaton compiled to a full transition table, so each character costs
+ * one table lookup whatever the number of keys. Only characters that could
+ * still be the start of a key at a word start are held back; everything
+ * else is released as soon as it arrives.
+ */
+
+#ifndef CW_EXPAND_H
+#define CW_EXPAND_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CWEXP_MAX_KEY 32
+#define CWEXP_MAX_TEXT 512
+
+// Built in; a macro file can replace any of them
+static const char *const cwexp_builtin[][2] = {
+    { "TNX", "THANKS" }, { "TKS", "THANKS" }, { "TU", "THANK YOU" }, { "PSE", "PLEASE" },
+    { "UR", "YOUR" }, { "FB", "FINE BUSINESS" }, { "GM", "GOOD MORNING" }, { "GA", "GOOD AFTERNOON" },
+    { "GE", "GOOD EVENING" }, { "WX", "WEATHER" }, { "HR", "HERE" }, { "ES", "AND" },
+    { "OM", "OLD MAN" }, { "CUL", "SEE YOU LATER" }, { "AGN", "AGAIN" }, { "ABT", "ABOUT" },
+    { "HW", "HOW" }, { "NR", "NUMBER" }, { "PWR", "POWER" }, { "RCVD", "RECEIVED" },
+    { "SIGS", "SIGNALS" }, { "WKD", "WORKED" }, { "73", "BEST REGARDS" },
+};
+
+typedef struct {
+    char key[CWEXP_MAX_KEY + 2];   // Normalized, plus the closing word gap
+    char *text;
+} CwExpMacro;
+
+typedef struct {
+    CwExpMacro *macros;
+    int count, cap;
+
+    // Automaton: state x symbol -> state. Symbol 0 is any character no key
+    // uses, which always leads back to the root.
+    unsigned char sym[128];
+    int symbols;
+    uint16_t *next;
+    uint16_t *fail;
+    uint8_t *depth;
+    int16_t *match;     // Macro whose key ends here (longest), -1 = none
+    uint16_t *out;      // Nearest state down the fail chain with a match, 0 = none
+    int states;
+
+    // Stream
+    int state;
+    char held[CWEXP_MAX_KEY + 2];   // Not yet released, as received
+    int heldLen;
+    char recent[CWEXP_MAX_KEY + 2]; // Normalized history, recent[k] = k+1 characters back
+    unsigned long pos;
+
+    char *outText;                  // Released, for the caller to drain (outLen = 0)
+    size_t outLen, outCap;
+} CwExpand;
+
+// Word gaps (space, newline) are one symbol; letters match either case
+static inline char cwexp_norm(char c) {
+    if (c == '\n') return ' ';
+    if (c >= 'a' && c <= 'z') return (char)(c - 'a' + 'A');
+    return c;
+}
+
+// Add or replace a macro. Returns 0, or -1 if the key is unusable.
+static inline int cwexp_add(CwExpand *e, const char *key, const char *text) {
+    size_t len = strlen(key);
+    if (len == 0 || len > CWEXP_MAX_KEY || strlen(text) > CWEXP_MAX_TEXT) return -1;
+    char k[CWEXP_MAX_KEY + 2];
+    for (size_t i = 0; i < len; i++) {
+        k[i] = cwexp_norm(key[i]);
+        if ((unsigned char)k[i] >= 128 || k[i] < ' ') return -1;
+    }
+    k[len] = ' ';
+    k[len + 1] = '\0';
+
+    int i = 0;
+    while (i < e->count && strcmp(e->macros[i].key, k) != 0) i++;
+    if (i == e->count) {
+        if (e->count == e->cap) {
+            int cap = e->cap ? e->cap * 2 : 32;
+            CwExpMacro *m = (CwExpMacro *)realloc(e->macros, cap * sizeof(CwExpMacro));
+            if (!m) return -1;
+            e->macros = m;
+            e->cap = cap;
+        }
+        memcpy(e->macros[i].key, k, len + 2);
+        e->macros[i].text = NULL;
+        e->count++;
+    }
+    char *t = (char *)malloc(strlen(text) + 1);
+    if (!t) return -1;
+    strcpy(t, text);
+    free(e->macros[i].text);
+    e->macros[i].text = t;
+    return 0;
+}
+
+static inline int cwexp_init(CwExpand *e) {
+    memset(e, 0, sizeof(*e));
+    for (size_t i = 0; i < sizeof(cwexp_builtin) / sizeof(cwexp_builtin[0]); i++) {
+        if (cwexp_add(e, cwexp_builtin[i][0], cwexp_builtin[i][1]) != 0) return -1;
+    }
+    return 0;
+}
+
+static inline void cwexp_free(CwExpand *e) {
+    for (int i = 0; i < e->count; i++) free(e->macros[i].text);
+    free(e->macros);
+    free(e->next);
+    free(e->fail);
+    free(e->depth);
+    free(e->match);
+    free(e->out);
+    free(e->outText);
+    memset(e, 0, sizeof(*e));
+}
+
+/*
+ * A macro file is "KEY = expansion" lines; '#' at the start of a line is a
+ * comment and "\n" in an expansion is a new line:
+ *   QTH = MY QTH IS SPRINGFIELD, OREGON
+ *   SK = 73 AND GOOD DX\nSK
+ * Returns 0, or -1 if the file can't be read or a line is bad.
+ */
+static inline int cwexp_load(CwExpand *e, const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    char line[CWEXP_MAX_TEXT + CWEXP_MAX_KEY + 16];
+    int rc = 0;
+    while (fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        char *p = line;
+        while (*p == ' ' || *p == '\t') p++;
+        if (*p == '\0' || *p == '#') continue;
+        char *eq = strchr(p, '=');
+        if (!eq) { rc = -1; continue; }
+        char *end = eq;
+        while (end > p && (end[-1] == ' ' || end[-1] == '\t')) end--;
+        *end = '\0';
+        char *text = eq + 1;
+        while (*text == ' ' || *text == '\t') text++;
+
+        // Unescape \n in place
+        char *w = text;
+        for (char *r = text; *r; r++) {
+            if (r[0] == '\\' && r[1] == 'n') { *w++ = '\n'; r++; }
+            else *w++ = *r;
+        }
+        *w = '\0';
+        if (cwexp_add(e, p, text) != 0) rc = -1;
+    }
+    fclose(f);
+    return rc;
+}
+
+// Build the automaton from the macros. Returns 0, or -1 if out of memory.
+static inline int cwexp_compile(CwExpand *e) {
+    memset(e->sym, 0, sizeof(e->sym));
+    e->symbols = 1;
+    int maxStates = 1;
+    for (int i = 0; i < e->count; i++) {
+        for (const char *k = e->macros[i].key; *k; k++) {
+            if (!e->sym[(unsigned char)*k]) e->sym[(unsigned char)*k] = (unsigned char)e->symbols++;
+            maxStates++;
+        }
+    }
+    if (maxStates > 65535) return -1;
+    size_t S = (size_t)maxStates, A = (size_t)e->symbols;
+    free(e->next); free(e->fail); free(e->depth); free(e->match); free(e->out);
+    e->next = (uint16_t *)calloc(S * A, sizeof(uint16_t));
+    e->fail = (uint16_t *)calloc(S, sizeof(uint16_t));
+    e->depth = (uint8_t *)calloc(S, 1);
+    e->match = (int16_t *)malloc(S * sizeof(int16_t));
+    e->out = (uint16_t *)calloc(S, sizeof(uint16_t));
+    uint16_t *queue = (uint16_t *)malloc(S * sizeof(uint16_t));
+    if (!e->next || !e->fail || !e->depth || !e->match || !e->out || !queue) {
+        free(queue);
+        return -1;
+    }
+    for (size_t s = 0; s < S; s++) e->match[s] = -1;
+
+    // Trie of the keys (0 = no edge yet; the root is never a target)
+    e->states = 1;
+    for (int i = 0; i < e->count; i++) {
+        int s = 0;
+        for (const char *k = e->macros[i].key; *k; k++) {
+            uint16_t *t = &e->next[s * A + e->sym[(unsigned char)*k]];
+            if (!*t) {
+                *t = (uint16_t)e->states;
+                e->depth[e->states] = (uint8_t)(e->depth[s] + 1);
+                e->states++;
+            }
+            s = *t;
+        }
+        e->match[s] = (int16_t)i;
+    }
+
+    // Breadth first: fail links, output links, and the missing edges
+    // filled in from the fail state's
+    int head = 0, tail = 0;
+    for (size_t a = 0; a < A; a++) {
+        if (e->next[a]) queue[tail++] = e->next[a];
+    }
+    while (head < tail) {
+        int s = queue[head++];
+        int f = e->fail[s];
+        e->out[s] = e->match[f] >= 0 ? (uint16_t)f : e->out[f];
+        for (size_t a = 0; a < A; a++) {
+            uint16_t *t = &e->next[s * A + a];
+            if (*t) {
+                e->fail[*t] = e->next[f * A + a];
+                queue[tail++] = *t;
+            } else {
+                *t = e->next[f * A + a];
+            }
+        }
+    }
+    free(queue);
+    e->state = 0;
+    e->heldLen = 0;
+    e->pos = 0;
+    return 0;
+}
+
+static inline void cwexp_emit(CwExpand *e, const char *s, size_t n) {
+    if (n == 0) return;
+    if (e->outLen + n > e->outCap) {
+        size_t cap = e->outCap ? e->outCap * 2 : 256;
+        while (cap < e->outLen + n) cap *= 2;
+        char *o = (char *)realloc(e->outText, cap);
+        if (!o) return;  // Dropped rather than typed out of order
+        e->outText = o;
+        e->outCap = cap;
+    }
+    memcpy(e->outText + e->outLen, s, n);
+    e->outLen += n;
+}
+
+// Does a key of len characters, ending with the current one, start a word?
+static inline int cwexp_word_start(const CwExpand *e, int len) {
+    return e->pos <= (unsigned long)len || e->recent[len] == ' ';
+}
+
+// The held characters, then this macro's expansion in place of its key
+static inline void cwexp_expand(CwExpand *e, int m, int keyLen) {
+    cwexp_emit(e, e->held, (size_t)(e->heldLen - keyLen));
+    cwexp_emit(e, e->macros[m].text, strlen(e->macros[m].text));
+}
+
+// One character in. Returns 1 if it completed a key.
+static inline int cwexp_char(CwExpand *e, char c) {
+    char n = cwexp_norm(c);
+    unsigned char a = (unsigned char)n < 128 ? e->sym[(unsigned char)n] : 0;
+    e->state = e->next[e->state * e->symbols + a];
+    memmove(e->recent + 1, e->recent, CWEXP_MAX_KEY + 1);
+    e->recent[0] = n;
+    e->pos++;
+    e->held[e->heldLen++] = c;
+
+    // Longest key at a word start ending here
+    for (int s = e->match[e->state] >= 0 ? e->state : e->out[e->state]; s; s = e->out[s]) {
+        if (cwexp_word_start(e, e->depth[s])) {
+            e->heldLen--;  // The word gap itself stays as sent
+            cwexp_expand(e, e->match[s], e->depth[s] - 1);
+            cwexp_emit(e, &c, 1);
+            e->heldLen = 0;
+            e->state = 0;
+            return 1;
+        }
+    }
+
+    // Hold only what could still grow into a key at a word start
+    int keep = 0;
+    for (int s = e->state; s; s = e->fail[s]) {
+        if (cwexp_word_start(e, e->depth[s])) {
+            keep = e->depth[s];
+            break;
+        }
+    }
+    if (keep < e->heldLen) {
+        cwexp_emit(e, e->held, (size_t)(e->heldLen - keep));
+        memmove(e->held, e->held + e->heldLen - keep, (size_t)keep);
+        e->heldLen = keep;
+    }
+    return 0;
+}
+
+// End of stream, or a long enough silence: a key still held is complete.
+// Releases everything. Returns 1 if it expanded.
+static inline int cwexp_flush(CwExpand *e) {
+    int expanded = 0;
+    if (e->heldLen) {
+        // As if a word gap followed, without sending one
+        int s = e->next[e->state * e->symbols + e->sym[' ']];
+        int m = e->match[s] >= 0 ? s : e->out[s];
+        for (; m; m = e->out[m]) {
+            if (e->depth[m] - 1 <= e->heldLen && cwexp_word_start(e, e->depth[m] - 1)) break;
+        }
+        if (m) {
+            cwexp_expand(e, e->match[m], e->depth[m] - 1);
+            expanded = 1;
+        } else {
+            cwexp_emit(e, e->held, (size_t)e->heldLen);
+        }
+    }
+    e->heldLen = 0;
+    e->state = 0;
+    memmove(e->recent + 1, e->recent, CWEXP_MAX_KEY + 1);
+    e->recent[0] = ' ';
+    e->pos++;
+    return expanded;
+}
+
+#endif // CW_EXPAND_H
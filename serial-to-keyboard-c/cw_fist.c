@@ -0,0 +1,826 @@
+/*
+ * cw_fist.c - Fist analytics over session archives
+ * Measures the keying in every recorded session (speed and its drift,
+ * dah:dit ratio, gap ratios, timing spread, error prosigns, and, when a
+ * transcript sits next to the session, character error rate and the most
+ * common misdecodes) on every core, and keeps the results in a compact
+ * index. Reports read only the index: a table per operator, or one
+ * operator's sessions in date order to follow a student's progress.
+ *
+ * Sessions in a subdirectory belong to the operator it is named after
+ * (archive/alice/0412.cwarc); other sessions to the part of their name
+ * before the first '_' (alice_0412.cwarc). Rescanning only analyzes
+ * sessions that are new or whose size or time changed.
+ *
+ * Compile: clang -O2 -o cw_fist cw_fist.c
+ * Run: ./cw_fist scan archive/ -o fist.idx
+ *      ./cw_fist report fist.idx [--operator alice] [--csv]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "cw_batch.h"
+#include "cw_score.h"
+
+#define DEFAULT_INDEX "fist.idx"
+#define FIST_MAGIC "CWFIST1\n"
+#define FIST_PATH 128
+#define FIST_OP 32
+#define FIST_MIS 6                 // Misdecodes kept per session
+#define ERROR_PROSIGN_DITS 6       // A character of this many dits or more is an error (HH)
+#define MAX_ALIGN_CELLS (64u << 20)
+
+// ============================================================
+// INDEX
+// ============================================================
+
+enum {
+    F_MINUTES, F_ELEMENTS, F_NOISE, F_CHARS, F_UNKNOWN, F_ERRORS,
+    F_WPM, F_DRIFT, F_WPM_SD, F_DAH_RATIO, F_GAP_ELEMENT, F_GAP_CHAR, F_GAP_WORD,
+    F_DIT_CV, F_DAH_CV, F_GAP_CV, F_CER, FIELD_COUNT
+};
+
+// Stored as 32-bit integers of value x scale
+static const struct { const char *name; double scale; } fields[FIELD_COUNT] = {
+    { "minutes", 100 }, { "elements", 1 }, { "noise", 1 }, { "chars", 1 }, { "unknown", 1 },
+    { "error_prosigns", 1 }, { "wpm", 100 }, { "drift_wpm_per_min", 1000 }, { "wpm_sd", 100 },
+    { "dah_dit", 1000 }, { "gap_element", 1000 }, { "gap_char", 1000 }, { "gap_word", 1000 },
+    { "dit_cv", 10000 }, { "dah_cv", 10000 }, { "gap_cv", 10000 }, { "cer", 10000 },
+};
+
+typedef struct {
+    char want, got;            // Sent, decoded
+    uint16_t count;
+} Misdecode;
+
+typedef struct {
+    char path[FIST_PATH];      // Relative to the archive root
+    char op[FIST_OP];
+    uint64_t size, mtime;
+    double v[FIELD_COUNT];     // F_CER < 0: no transcript
+    Misdecode mis[FIST_MIS];   // Most common first; count 0 = unused
+} FistRecord;
+
+#define RECORD_BYTES (FIST_PATH + FIST_OP + 16 + 4 * FIELD_COUNT + 4 * FIST_MIS)
+
+static void encodeRecord(const FistRecord *r, unsigned char *p) {
+    memcpy(p, r->path, FIST_PATH);
+    memcpy(p + FIST_PATH, r->op, FIST_OP);
+    p += FIST_PATH + FIST_OP;
+    cwarc_put64(p, r->size);
+    cwarc_put64(p + 8, r->mtime);
+    p += 16;
+    for (int f = 0; f < FIELD_COUNT; f++, p += 4) {
+        cwarc_put32(p, (uint32_t)(int32_t)floor(r->v[f] * fields[f].scale + 0.5));
+    }
+    for (int k = 0; k < FIST_MIS; k++, p += 4) {
+        p[0] = (unsigned char)r->mis[k].want;
+        p[1] = (unsigned char)r->mis[k].got;
+        cwarc_put16(p + 2, r->mis[k].count);
+    }
+}
+
+static void decodeRecord(const unsigned char *p, FistRecord *r) {
+    memcpy(r->path, p, FIST_PATH);
+    memcpy(r->op, p + FIST_PATH, FIST_OP);
+    r->path[FIST_PATH - 1] = r->op[FIST_OP - 1] = '\0';
+    p += FIST_PATH + FIST_OP;
+    r->size = cwarc_get64(p);
+    r->mtime = cwarc_get64(p + 8);
+    p += 16;
+    for (int f = 0; f < FIELD_COUNT; f++, p += 4) r->v[f] = (int32_t)cwarc_get32(p) / fields[f].scale;
+    for (int k = 0; k < FIST_MIS; k++, p += 4) {
+        r->mis[k].want = (char)p[0];
+        r->mis[k].got = (char)p[1];
+        r->mis[k].count = (uint16_t)cwarc_get16(p + 2);
+    }
+}
+
+// Returns the record count (records malloc'd), or -1 if path isn't an index
+// (or was written with a different layout)
+static int loadIndex(const char *path, FistRecord **records) {
+    *records = NULL;
+    FILE *f = fopen(path, "rb");
+    if (!f) return -1;
+    unsigned char head[16], buf[RECORD_BYTES];
+    if (fread(head, 1, sizeof(head), f) != sizeof(head) || memcmp(head, FIST_MAGIC, 8) != 0 ||
+        cwarc_get32(head + 8) != RECORD_BYTES) {
+        fclose(f);
+        return -1;
+    }
+    int count = (int)cwarc_get32(head + 12), n = 0;
+    *records = (FistRecord *)calloc(count ? count : 1, sizeof(FistRecord));
+    if (!*records) { fclose(f); return -1; }
+    while (n < count && fread(buf, 1, sizeof(buf), f) == sizeof(buf)) decodeRecord(buf, &(*records)[n++]);
+    fclose(f);
+    return n;
+}
+
+// Written to a temporary file and renamed over the old index
+static int writeIndex(const char *path, const FistRecord *records, int count) {
+    char tmp[1024];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "wb");
+    if (!f) return -1;
+    unsigned char head[16], buf[RECORD_BYTES];
+    memcpy(head, FIST_MAGIC, 8);
+    cwarc_put32(head + 8, RECORD_BYTES);
+    cwarc_put32(head + 12, (uint32_t)count);
+    int rc = fwrite(head, 1, sizeof(head), f) == sizeof(head) ? 0 : -1;
+    for (int i = 0; i < count && rc == 0; i++) {
+        encodeRecord(&records[i], buf);
+        if (fwrite(buf, 1, sizeof(buf), f) != sizeof(buf)) rc = -1;
+    }
+    if (fclose(f) != 0) rc = -1;
+    if (rc == 0) {
+        remove(path);  // Windows rename() won't replace
+        if (rename(tmp, path) != 0) rc = -1;
+    }
+    return rc;
+}
+
+// ============================================================
+// SESSION ANALYSIS
+// ============================================================
+
+enum { GAP_ELEMENT, GAP_CHAR, GAP_WORD, GAP_NONE };
+
+typedef struct {
+    double n, sum, sumSq;
+} Acc;
+
+static void accAdd(Acc *a, double v) {
+    a->n++;
+    a->sum += v;
+    a->sumSq += v * v;
+}
+
+static double accMean(const Acc *a) {
+    return a->n ? a->sum / a->n : 0;
+}
+
+static double accSd(const Acc *a) {
+    if (a->n < 2) return 0;
+    double m = a->sum / a->n, var = (a->sumSq - a->n * m * m) / (a->n - 1);
+    return var > 0 ? sqrt(var) : 0;
+}
+
+// Per worker
+typedef struct {
+    MorseDecoder decoder;
+    char *text;
+    size_t len, cap;
+
+    // Element being decoded, as the decoder met it
+    int pause, length, dit, gap;
+    uint64_t arrivalMs;
+
+    int charElements, charDits;
+    unsigned long errors;
+    Acc dits, dahs, gaps[3];      // Multiples of the decoder's running dit
+    Acc *minutes;                 // WPM of each minute's dits
+    size_t minuteCount;
+
+    unsigned char *moves;         // Alignment traceback
+    size_t movesCap;
+    int *rows;
+    size_t rowsCap;
+    unsigned mis[64][64];         // Sent x decoded, ASCII 32-95
+} Analyzer;
+
+static void endCharacter(Analyzer *a) {
+    if (a->charElements && a->charDits == a->charElements && a->charDits >= ERROR_PROSIGN_DITS) a->errors++;
+    a->charElements = a->charDits = 0;
+}
+
+static void onAnalyzedKeying(void *ctx, int pauseTime, int charLength) {
+    Analyzer *a = (Analyzer *)ctx;
+    const MorseDecoder *d = &a->decoder;
+    if (charLength < d->params.minPulse) return;
+    a->pause = pauseTime;
+    a->length = charLength;
+    a->dit = d->dotTiming;
+    if (d->dotTiming <= 0) a->gap = GAP_NONE;
+    else if (pauseTime > d->dotTiming * d->params.wordGap) a->gap = GAP_WORD;
+    else if (pauseTime > d->dotTiming * d->params.charGap) a->gap = GAP_CHAR;
+    else a->gap = GAP_ELEMENT;
+    if (a->gap == GAP_CHAR || a->gap == GAP_WORD) endCharacter(a);
+}
+
+static void onAnalyzedElement(void *ctx, int isDash) {
+    Analyzer *a = (Analyzer *)ctx;
+    a->charElements++;
+    if (!isDash) a->charDits++;
+    if (a->dit <= 0) return;  // Still learning the speed
+    double units = (double)a->length / a->dit;
+    accAdd(isDash ? &a->dahs : &a->dits, units);
+    if (a->gap != GAP_NONE) accAdd(&a->gaps[a->gap], (double)a->pause / a->dit);
+    size_t minute = (size_t)(a->arrivalMs / 60000);
+    if (!isDash && minute < a->minuteCount) accAdd(&a->minutes[minute], 1200.0 / a->length);
+}
+
+static void onAnalyzedChar(void *ctx, char c) {
+    Analyzer *a = (Analyzer *)ctx;
+    if (a->len + 1 >= a->cap) {
+        size_t cap = a->cap ? a->cap * 2 : 8192;
+        char *text = (char *)realloc(a->text, cap);
+        if (!text) return;
+        a->text = text;
+        a->cap = cap;
+    }
+    a->text[a->len++] = c;
+}
+
+// Align the decoded text with the transcript (edit distance in a diagonal
+// band wide enough for their length difference) and count each
+// substitution as sent -> decoded
+static void countMisdecodes(Analyzer *a, const char *text, long n, const char *label, long m) {
+    long band = 32 + labs(n - m), width = 2 * band + 1;
+    if ((size_t)(n + 1) * width > MAX_ALIGN_CELLS) return;
+    if ((size_t)(n + 1) * width > a->movesCap) {
+        unsigned char *moves = (unsigned char *)realloc(a->moves, (size_t)(n + 1) * width);
+        if (!moves) return;
+        a->moves = moves;
+        a->movesCap = (size_t)(n + 1) * width;
+    }
+    if ((size_t)(2 * width) > a->rowsCap) {
+        int *rows = (int *)realloc(a->rows, sizeof(int) * 2 * width);
+        if (!rows) return;
+        a->rows = rows;
+        a->rowsCap = (size_t)(2 * width);
+    }
+    // Row i, column j at k = j - i + band. Moves: 0 both, 1 extra decoded, 2 sent missing
+    int *prev = a->rows, *cur = a->rows + width, inf = 1 << 30;
+    for (long k = 0; k < width; k++) {
+        long j = k - band;
+        prev[k] = (j >= 0 && j <= m) ? (int)j : inf;
+        a->moves[k] = 2;
+    }
+    for (long i = 1; i <= n; i++) {
+        unsigned char *mv = a->moves + (size_t)i * width;
+        for (long k = 0; k < width; k++) {
+            long j = i + k - band;
+            if (j < 0 || j > m) { cur[k] = inf; continue; }
+            if (j == 0) { cur[k] = (int)i; mv[k] = 1; continue; }
+            int v = prev[k] + (text[i - 1] != label[j - 1]), how = 0;
+            if (k + 1 < width && prev[k + 1] + 1 < v) { v = prev[k + 1] + 1; how = 1; }
+            if (k > 0 && cur[k - 1] + 1 < v) { v = cur[k - 1] + 1; how = 2; }
+            cur[k] = v > inf ? inf : v;
+            mv[k] = (unsigned char)how;
+        }
+        int *t = prev; prev = cur; cur = t;
+    }
+    long i = n, j = m;
+    while (i > 0 && j > 0) {
+        int how = a->moves[(size_t)i * width + (j - i + band)];
+        if (how == 0) {
+            unsigned char want = (unsigned char)label[j - 1], got = (unsigned char)text[i - 1];
+            if (want != got && want > ' ' && want < 96 && got > ' ' && got < 96) a->mis[want - 32][got - 32]++;
+            i--; j--;
+        } else if (how == 1) {
+            i--;
+        } else {
+            j--;
+        }
+    }
+}
+
+static void analyzeSession(Analyzer *a, const MorseParams *params, const CwElementList *l,
+                           const char *label, size_t labelLen, FistRecord *r) {
+    MorseDecoder *d = &a->decoder;
+    morseInit(d, onAnalyzedChar, onAnalyzedElement, a);
+    d->params = *params;
+    d->onKeying = onAnalyzedKeying;
+    a->len = 0;
+    a->charElements = a->charDits = 0;
+    a->errors = 0;
+    memset(&a->dits, 0, sizeof(a->dits));
+    memset(&a->dahs, 0, sizeof(a->dahs));
+    memset(a->gaps, 0, sizeof(a->gaps));
+    memset(a->mis, 0, sizeof(a->mis));
+    uint64_t lastMs = l->count ? l->el[l->count - 1].arrivalMs : 0;
+    a->minuteCount = (size_t)(lastMs / 60000) + 1;
+    a->minutes = (Acc *)calloc(a->minuteCount, sizeof(Acc));
+    if (!a->minutes) a->minuteCount = 0;
+
+    // Decoded exactly as the live loop would (see cwscore_decode)
+    for (size_t i = 0; i < l->count; i++) {
+        unsigned long now = (unsigned long)l->el[i].arrivalMs + 1;
+        if (d->lastActivityTime && now - d->lastActivityTime > CHARACTER_TIMEOUT_MS)
+            morseCheckTimeout(d, d->lastActivityTime + CHARACTER_TIMEOUT_MS + 1);
+        d->lastActivityTime = now;
+        a->arrivalMs = l->el[i].arrivalMs;
+        morseProcessElement(d, (int)l->el[i].pause, (int)l->el[i].length);
+    }
+    morseCompleteCharacter(d);
+    endCharacter(a);
+    a->len = a->text ? cwscore_normalize(a->text, a->len) : 0;
+
+    const MorseStats *st = &d->stats;
+    double ditUnits = accMean(&a->dits);
+    r->v[F_MINUTES] = lastMs / 60000.0;
+    r->v[F_ELEMENTS] = (double)st->elements;
+    r->v[F_NOISE] = (double)st->noise;
+    r->v[F_CHARS] = (double)st->chars;
+    r->v[F_UNKNOWN] = (double)st->unknown;
+    r->v[F_ERRORS] = (double)a->errors;
+    r->v[F_DAH_RATIO] = ditUnits > 0 ? accMean(&a->dahs) / ditUnits : 0;
+    r->v[F_GAP_ELEMENT] = accMean(&a->gaps[GAP_ELEMENT]);
+    r->v[F_GAP_CHAR] = accMean(&a->gaps[GAP_CHAR]);
+    r->v[F_GAP_WORD] = accMean(&a->gaps[GAP_WORD]);
+    r->v[F_DIT_CV] = ditUnits > 0 ? accSd(&a->dits) / ditUnits : 0;
+    r->v[F_DAH_CV] = accMean(&a->dahs) > 0 ? accSd(&a->dahs) / accMean(&a->dahs) : 0;
+    r->v[F_GAP_CV] = r->v[F_GAP_ELEMENT] > 0 ? accSd(&a->gaps[GAP_ELEMENT]) / r->v[F_GAP_ELEMENT] : 0;
+
+    // Speed: mean of the per-minute WPM, its spread, and the least-squares
+    // trend across minutes
+    Acc wpm = {0, 0, 0};
+    double sx = 0, sy = 0, sxx = 0, sxy = 0, k = 0;
+    for (size_t i = 0; i < a->minuteCount; i++) {
+        if (a->minutes[i].n < 5) continue;  // Too little sent that minute
+        double y = accMean(&a->minutes[i]);
+        accAdd(&wpm, y);
+        sx += i; sy += y; sxx += (double)i * i; sxy += i * y; k++;
+    }
+    r->v[F_WPM] = accMean(&wpm);
+    r->v[F_WPM_SD] = accSd(&wpm);
+    r->v[F_DRIFT] = k >= 2 && k * sxx - sx * sx > 0 ? (k * sxy - sx * sy) / (k * sxx - sx * sx) : 0;
+    free(a->minutes);
+    a->minutes = NULL;
+
+    r->v[F_CER] = -1;
+    if (label) {
+        CwScorer s;
+        if (cwscore_init(&s) == 0) {
+            s.text = (char *)realloc(s.text, a->len + 1);
+            if (s.text) {
+                memcpy(s.text, a->text ? a->text : "", a->len);
+                s.len = a->len;
+                long cap = (long)(a->len + labelLen);
+                r->v[F_CER] = labelLen ? (double)cwscore_errors(&s, label, labelLen, cap) / labelLen : 0;
+            }
+            cwscore_free(&s);
+        }
+        countMisdecodes(a, a->text ? a->text : "", (long)a->len, label, (long)labelLen);
+        // Keep the most common
+        for (int m = 0; m < FIST_MIS; m++) {
+            unsigned best = 0;
+            int bw = 0, bg = 0;
+            for (int w = 0; w < 64; w++) {
+                for (int g = 0; g < 64; g++) {
+                    if (a->mis[w][g] > best) { best = a->mis[w][g]; bw = w; bg = g; }
+                }
+            }
+            if (!best) break;
+            r->mis[m].want = (char)(bw + 32);
+            r->mis[m].got = (char)(bg + 32);
+            r->mis[m].count = (uint16_t)(best > 65535 ? 65535 : best);
+            a->mis[bw][bg] = 0;
+        }
+    }
+}
+
+// ============================================================
+// SCAN
+// ============================================================
+
+typedef struct {
+    const char *root;
+    char **paths;              // Full paths, one per record
+    FistRecord *records;
+    int *todo;                 // Records to (re)analyze
+    Analyzer *workers;
+    MorseParams params;
+    unsigned long failed;
+    cw_mutex_t lock;
+} Scanner;
+
+static void scanTask(void *ctx, int task, int worker) {
+    Scanner *s = (Scanner *)ctx;
+    int i = s->todo[task];
+    FistRecord *r = &s->records[i];
+    CwElementList l = {0};
+    if (cwbatch_load(s->paths[i], &l) != 0) {
+        cw_mutex_lock(&s->lock);
+        printf("[!] %s: not a capture or archive, skipped\n", s->paths[i]);
+        s->failed++;
+        cw_mutex_unlock(&s->lock);
+        r->path[0] = '\0';
+        cwbatch_free_list(&l);
+        return;
+    }
+    size_t labelLen = 0;
+    char *label = cwscore_read_label(s->paths[i], &labelLen);
+    analyzeSession(&s->workers[worker], &s->params, &l, label, labelLen, r);
+    free(label);
+    cwbatch_free_list(&l);
+}
+
+// Subdirectories of root (caller frees each name and the array)
+static int listSubdirs(const char *root, char ***names) {
+    int count = 0, cap = 0;
+    *names = NULL;
+#ifdef _WIN32
+    char pattern[MAX_PATH];
+    snprintf(pattern, sizeof(pattern), "%s\\*", root);
+    WIN32_FIND_DATAA fd;
+    HANDLE h = FindFirstFileA(pattern, &fd);
+    if (h == INVALID_HANDLE_VALUE) return -1;
+    do {
+        const char *name = fd.cFileName;
+        if (!(fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) continue;
+#else
+    DIR *d = opendir(root);
+    if (!d) return -1;
+    struct dirent *ent;
+    while ((ent = readdir(d))) {
+        const char *name = ent->d_name;
+        char full[1024];
+        struct stat st;
+        snprintf(full, sizeof(full), "%s/%s", root, name);
+        if (stat(full, &st) != 0 || !S_ISDIR(st.st_mode)) continue;
+#endif
+        if (name[0] == '.') continue;
+        if (count == cap) {
+            cap = cap ? cap * 2 : 16;
+            char **grown = (char **)realloc(*names, cap * sizeof(char *));
+            if (!grown) break;
+            *names = grown;
+        }
+        (*names)[count] = strdup(name);
+        if ((*names)[count]) count++;
+#ifdef _WIN32
+    } while (FindNextFileA(h, &fd));
+    FindClose(h);
+#else
+    }
+    closedir(d);
+#endif
+    return count;
+}
+
+// Add every session under root (and one level of operator directories)
+static int collectSessions(const char *root, char ***paths, char ***ops) {
+    char **top = NULL, **subs = NULL;
+    int n = cwbatch_list_dir(root, &top);
+    if (n < 0) return -1;
+    int subCount = listSubdirs(root, &subs), count = 0, cap = n > 0 ? n : 16;
+    *paths = (char **)malloc(cap * sizeof(char *));
+    *ops = (char **)malloc(cap * sizeof(char *));
+    if (!*paths || !*ops) return -1;
+    for (int i = 0; i < n; i++) {
+        // Operator: the name up to the first '_'
+        const char *base = top[i] + strlen(root) + 1;
+        const char *us = strchr(base, '_');
+        char op[FIST_OP];
+        if (us && us > base) snprintf(op, sizeof(op), "%.*s", (int)(us - base), base);
+        else snprintf(op, sizeof(op), "unassigned");
+        (*paths)[count] = top[i];
+        (*ops)[count++] = strdup(op);
+    }
+    free(top);
+    for (int s = 0; s < subCount; s++) {
+        char dir[1024];
+        snprintf(dir, sizeof(dir), "%s/%s", root, subs[s]);
+        char **files = NULL;
+        int m = cwbatch_list_dir(dir, &files);
+        for (int i = 0; i < m; i++) {
+            if (count == cap) {
+                cap *= 2;
+                char **p = (char **)realloc(*paths, cap * sizeof(char *));
+                char **o = p ? (char **)realloc(*ops, cap * sizeof(char *)) : NULL;
+                if (p) *paths = p;
+                if (!p || !o) return -1;
+                *ops = o;
+            }
+            (*paths)[count] = files[i];
+            (*ops)[count++] = strdup(subs[s]);
+        }
+        free(files);
+        free(subs[s]);
+    }
+    free(subs);
+    return count;
+}
+
+static const FistRecord *sortRecords;
+
+static int biggerFirst(const void *a, const void *b) {
+    uint64_t sa = sortRecords[*(const int *)a].size, sb = sortRecords[*(const int *)b].size;
+    return sa < sb ? 1 : sa > sb ? -1 : 0;
+}
+
+static int byPath(const void *a, const void *b) {
+    return strcmp(((const FistRecord *)a)->path, ((const FistRecord *)b)->path);
+}
+
+static int scan(const char *root, const char *indexPath, const char *profile, int workers) {
+    Scanner s;
+    memset(&s, 0, sizeof(s));
+    s.root = root;
+    morseDefaultParams(&s.params);
+    if (profile && morseLoadProfile(&s.params, profile) != 0) {
+        printf("[!] Cannot load profile '%s'\n", profile);
+        return 1;
+    }
+
+    char **ops = NULL;
+    int count = collectSessions(root, &s.paths, &ops);
+    if (count <= 0) {
+        printf("[!] No .cwcap or .cwarc files in %s\n", root);
+        return 1;
+    }
+    FistRecord *old = NULL;
+    int oldCount = loadIndex(indexPath, &old);
+    if (oldCount > 0) qsort(old, oldCount, sizeof(FistRecord), byPath);
+    s.records = (FistRecord *)calloc(count, sizeof(FistRecord));
+    s.todo = (int *)malloc(sizeof(int) * count);
+    if (!s.records || !s.todo) { printf("[!] Out of memory\n"); return 1; }
+
+    int todo = 0, tooLong = 0;
+    size_t rootLen = strlen(root) + 1;
+    for (int i = 0; i < count; i++) {
+        FistRecord *r = &s.records[i];
+        if (strlen(s.paths[i] + rootLen) >= sizeof(r->path)) {
+            // The index would keep a cut-off name that matches nothing
+            printf("[!] %s: path longer than %d characters, skipped\n", s.paths[i], FIST_PATH - 1);
+            tooLong++;
+            free(ops[i]);
+            continue;
+        }
+        snprintf(r->path, sizeof(r->path), "%s", s.paths[i] + rootLen);
+        snprintf(r->op, sizeof(r->op), "%s", ops[i] ? ops[i] : "unassigned");
+        struct stat st;
+        if (stat(s.paths[i], &st) == 0) {
+            r->size = (uint64_t)st.st_size;
+            r->mtime = (uint64_t)st.st_mtime;
+        }
+        const FistRecord *prev = oldCount > 0 ? (const FistRecord *)bsearch(r, old, oldCount, sizeof(FistRecord), byPath) : NULL;
+        if (prev && prev->size == r->size && prev->mtime == r->mtime) {
+            memcpy(r->v, prev->v, sizeof(r->v));
+            memcpy(r->mis, prev->mis, sizeof(r->mis));
+        } else {
+            s.todo[todo++] = i;
+        }
+        free(ops[i]);
+    }
+    free(ops);
+    free(old);
+
+    if (workers <= 0) workers = cwpool_cpu_count();
+    s.workers = (Analyzer *)calloc(workers, sizeof(Analyzer));
+    if (!s.workers) { printf("[!] Out of memory\n"); return 1; }
+    sortRecords = s.records;
+    qsort(s.todo, todo, sizeof(int), biggerFirst);
+    cw_mutex_init(&s.lock);
+    unsigned long startMs = (unsigned long)(cwcap_now_us() / 1000);
+    if (todo && cwpool_run(todo, workers, NULL, scanTask, &s) != 0) {
+        printf("[!] Out of memory\n");
+        return 1;
+    }
+    unsigned long elapsedMs = (unsigned long)(cwcap_now_us() / 1000) - startMs;
+    cw_mutex_destroy(&s.lock);
+
+    // Drop sessions that failed to load
+    int kept = 0;
+    for (int i = 0; i < count; i++) {
+        if (s.records[i].path[0]) s.records[kept++] = s.records[i];
+    }
+    printf("[*] %d sessions: %d analyzed in %.2f s on %d threads, %d unchanged\n",
+           kept, todo - (int)s.failed, elapsedMs / 1000.0, workers < todo ? workers : (todo ? todo : 1), count - todo - tooLong);
+    if (writeIndex(indexPath, s.records, kept) != 0) {
+        printf("[!] Cannot write %s\n", indexPath);
+        return 1;
+    }
+    printf("[OK] Wrote %s (%d bytes per session)\n", indexPath, RECORD_BYTES);
+
+    for (int i = 0; i < workers; i++) {
+        free(s.workers[i].text);
+        free(s.workers[i].moves);
+        free(s.workers[i].rows);
+    }
+    for (int i = 0; i < count; i++) free(s.paths[i]);
+    free(s.paths);
+    free(s.workers);
+    free(s.records);
+    free(s.todo);
+    return 0;
+}
+
+// ============================================================
+// REPORTS
+// ============================================================
+
+// Operator totals: timing fields weighted by elements, rates by characters
+typedef struct {
+    char op[FIST_OP];
+    int sessions;
+    double minutes, elements, chars, unknown, errors;
+    double timing[FIELD_COUNT];     // Sum of value x elements
+    double driftMinutes;            // Sum of drift x minutes
+    double cerChars, cerErrors;     // Over sessions with transcripts
+    Misdecode mis[64];
+    int misCount;
+} OperatorTotals;
+
+static void addMisdecodes(Misdecode *into, int *count, int max, const Misdecode *from, int n) {
+    for (int k = 0; k < n && from[k].count; k++) {
+        int i = 0;
+        while (i < *count && (into[i].want != from[k].want || into[i].got != from[k].got)) i++;
+        if (i == *count) {
+            if (*count == max) continue;
+            into[i] = from[k];
+            into[i].count = 0;
+            (*count)++;
+        }
+        into[i].count = (uint16_t)(into[i].count + from[k].count > 65535 ? 65535 : into[i].count + from[k].count);
+    }
+}
+
+static int byOperator(const void *a, const void *b) {
+    return strcmp(((const OperatorTotals *)a)->op, ((const OperatorTotals *)b)->op);
+}
+
+static int moreCommon(const void *a, const void *b) {
+    return (int)((const Misdecode *)b)->count - (int)((const Misdecode *)a)->count;
+}
+
+static void formatMisdecodes(char *out, size_t size, const Misdecode *mis, int n, int show) {
+    size_t len = 0;
+    out[0] = '\0';
+    for (int k = 0; k < n && k < show && mis[k].count && len + 16 < size; k++) {
+        len += snprintf(out + len, size - len, "%s%c>%c x%u", k ? ", " : "", mis[k].want, mis[k].got, mis[k].count);
+    }
+    if (!len) snprintf(out, size, "-");
+}
+
+static void printCsv(const FistRecord *records, int count, const char *op) {
+    printf("operator,session,date");
+    for (int f = 0; f < FIELD_COUNT; f++) printf(",%s", fields[f].name);
+    printf(",misdecodes\n");
+    for (int i = 0; i < count; i++) {
+        const FistRecord *r = &records[i];
+        if (op && strcmp(r->op, op) != 0) continue;
+        char date[32], mis[128];
+        time_t t = (time_t)r->mtime;
+        strftime(date, sizeof(date), "%Y-%m-%d %H:%M", localtime(&t));
+        formatMisdecodes(mis, sizeof(mis), r->mis, FIST_MIS, FIST_MIS);
+        printf("%s,%s,%s", r->op, r->path, date);
+        for (int f = 0; f < FIELD_COUNT; f++) printf(",%g", r->v[f]);
+        printf(",\"%s\"\n", mis);
+    }
+}
+
+static const FistRecord *sortByTime;
+
+static int olderFirst(const void *a, const void *b) {
+    const FistRecord *x = &sortByTime[*(const int *)a], *y = &sortByTime[*(const int *)b];
+    if (x->mtime != y->mtime) return x->mtime < y->mtime ? -1 : 1;
+    return strcmp(x->path, y->path);
+}
+
+// One operator, session by session
+static int reportOperator(const FistRecord *records, int count, const char *op) {
+    int *order = (int *)malloc(sizeof(int) * (count ? count : 1)), n = 0;
+    if (!order) return 1;
+    for (int i = 0; i < count; i++) {
+        if (strcmp(records[i].op, op) == 0) order[n++] = i;
+    }
+    if (!n) {
+        printf("[!] No sessions for operator '%s'\n", op);
+        free(order);
+        return 1;
+    }
+    sortByTime = records;
+    qsort(order, n, sizeof(int), olderFirst);
+    printf("%s: %d sessions\n\n", op, n);
+    printf("%-16s %-22s %6s %6s %6s %5s %15s %6s %6s %5s %6s  %s\n", "DATE", "SESSION", "MIN", "WPM", "DRIFT",
+           "DAH", "GAPS el/ch/wd", "DIT+-", "DAH+-", "ERR%", "CER%", "MISDECODES");
+    for (int k = 0; k < n; k++) {
+        const FistRecord *r = &records[order[k]];
+        char date[32], mis[128], gaps[32];
+        time_t t = (time_t)r->mtime;
+        strftime(date, sizeof(date), "%Y-%m-%d %H:%M", localtime(&t));
+        formatMisdecodes(mis, sizeof(mis), r->mis, FIST_MIS, 3);
+        snprintf(gaps, sizeof(gaps), "%.1f/%.1f/%.1f", r->v[F_GAP_ELEMENT], r->v[F_GAP_CHAR], r->v[F_GAP_WORD]);
+        char cer[16];
+        if (r->v[F_CER] >= 0) snprintf(cer, sizeof(cer), "%.1f", r->v[F_CER] * 100);
+        else snprintf(cer, sizeof(cer), "-");
+        printf("%-16s %-22.22s %6.1f %6.1f %+6.2f %5.2f %15s %5.0f%% %5.0f%% %5.1f %6s  %s\n", date, r->path,
+               r->v[F_MINUTES], r->v[F_WPM], r->v[F_DRIFT], r->v[F_DAH_RATIO], gaps, r->v[F_DIT_CV] * 100,
+               r->v[F_DAH_CV] * 100, r->v[F_CHARS] ? 100 * r->v[F_ERRORS] / r->v[F_CHARS] : 0, cer, mis);
+    }
+    free(order);
+    return 0;
+}
+
+// Every operator, one row each
+static int reportOperators(const FistRecord *records, int count) {
+    OperatorTotals *ops = (OperatorTotals *)calloc(count ? count : 1, sizeof(OperatorTotals));
+    int n = 0;
+    if (!ops) return 1;
+    for (int i = 0; i < count; i++) {
+        const FistRecord *r = &records[i];
+        int k = 0;
+        while (k < n && strcmp(ops[k].op, r->op) != 0) k++;
+        OperatorTotals *o = &ops[k];
+        if (k == n) snprintf(ops[n++].op, FIST_OP, "%s", r->op);
+        o->sessions++;
+        o->minutes += r->v[F_MINUTES];
+        o->elements += r->v[F_ELEMENTS];
+        o->chars += r->v[F_CHARS];
+        o->unknown += r->v[F_UNKNOWN];
+        o->errors += r->v[F_ERRORS];
+        for (int f = F_WPM; f < F_CER; f++) o->timing[f] += r->v[f] * r->v[F_ELEMENTS];
+        o->driftMinutes += r->v[F_DRIFT] * r->v[F_MINUTES];
+        if (r->v[F_CER] >= 0) {
+            o->cerChars += r->v[F_CHARS];
+            o->cerErrors += r->v[F_CER] * r->v[F_CHARS];
+        }
+        addMisdecodes(o->mis, &o->misCount, 64, r->mis, FIST_MIS);
+    }
+    qsort(ops, n, sizeof(OperatorTotals), byOperator);
+    printf("%-16s %5s %7s %6s %6s %5s %15s %6s %6s %5s %5s %6s  %s\n", "OPERATOR", "SESS", "MIN", "WPM", "DRIFT",
+           "DAH", "GAPS el/ch/wd", "DIT+-", "DAH+-", "ERR%", "UNK%", "CER%", "TOP MISDECODES");
+    for (int k = 0; k < n; k++) {
+        OperatorTotals *o = &ops[k];
+        double e = o->elements > 0 ? o->elements : 1;
+        char gaps[32], cer[16], mis[128];
+        snprintf(gaps, sizeof(gaps), "%.1f/%.1f/%.1f", o->timing[F_GAP_ELEMENT] / e, o->timing[F_GAP_CHAR] / e,
+                 o->timing[F_GAP_WORD] / e);
+        if (o->cerChars > 0) snprintf(cer, sizeof(cer), "%.1f", 100 * o->cerErrors / o->cerChars);
+        else snprintf(cer, sizeof(cer), "-");
+        qsort(o->mis, o->misCount, sizeof(Misdecode), moreCommon);
+        formatMisdecodes(mis, sizeof(mis), o->mis, o->misCount, 3);
+        printf("%-16s %5d %7.1f %6.1f %+6.2f %5.2f %15s %5.0f%% %5.0f%% %5.1f %5.1f %6s  %s\n", o->op, o->sessions,
+               o->minutes, o->timing[F_WPM] / e, o->minutes > 0 ? o->driftMinutes / o->minutes : 0,
+               o->timing[F_DAH_RATIO] / e, gaps, 100 * o->timing[F_DIT_CV] / e, 100 * o->timing[F_DAH_CV] / e,
+               o->chars ? 100 * o->errors / o->chars : 0,
+               o->chars + o->unknown ? 100 * o->unknown / (o->chars + o->unknown) : 0, cer, mis);
+    }
+    free(ops);
+    return 0;
+}
+
+static int report(const char *indexPath, const char *op, int csv) {
+    FistRecord *records = NULL;
+    int count = loadIndex(indexPath, &records);
+    if (count < 0) {
+        printf("[!] %s is not a fist index (run: cw_fist scan <dir> -o %s)\n", indexPath, indexPath);
+        return 1;
+    }
+    int rc = 0;
+    if (csv) printCsv(records, count, op);
+    else if (op) rc = reportOperator(records, count, op);
+    else rc = reportOperators(records, count);
+    free(records);
+    return rc;
+}
+
+// ============================================================
+// MAIN
+// ============================================================
+
+static void printUsage(const char *progname) {
+    printf("CW Hotline fist analytics\n\n");
+    printf("Usage: %s scan <archive-dir> [options]\n", progname);
+    printf("       %s report [index] [--operator <name>] [--csv]\n\n", progname);
+    printf("scan measures every .cwcap/.cwarc session (operators are subdirectories,\n");
+    printf("or the name before '_') and updates the index; sessions with a .txt\n");
+    printf("transcript also get CER and misdecodes. Unchanged sessions are skipped.\n\n");
+    printf("Options:\n");
+    printf("  -o <file>             Index to write or read (default: %s)\n", DEFAULT_INDEX);
+    printf("  -j <N>                Worker threads (default: one per CPU)\n");
+    printf("  --profile <file>      Decoder timing rules to measure with\n");
+    printf("  --operator <name>     Report one operator session by session\n");
+    printf("  --csv                 Report every session as CSV\n");
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) { printUsage(argv[0]); return 1; }
+    const char *cmd = argv[1];
+    const char *target = NULL;
+    const char *indexPath = DEFAULT_INDEX;
+    const char *profile = NULL;
+    const char *op = NULL;
+    int workers = 0, csv = 0;
+
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) indexPath = argv[++i];
+        else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) workers = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) profile = argv[++i];
+        else if (strcmp(argv[i], "--operator") == 0 && i + 1 < argc) op = argv[++i];
+        else if (strcmp(argv[i], "--csv") == 0) csv = 1;
+        else target = argv[i];
+    }
+
+    if (strcmp(cmd, "scan") == 0 && target) return scan(target, indexPath, profile, workers);
+    if (strcmp(cmd, "report") == 0) return report(target ? target : indexPath, op, csv);
+    printUsage(argv[0]);
+    return 1;
+}
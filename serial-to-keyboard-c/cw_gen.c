@@ -0,0 +1,636 @@
+/*
+ * cw_gen.c - Text to CW Hotline element streams
+ * Turns text (or random QSO words) into the device's "S,<pause>,<length>"
+ * lines through cw_gen.h's operator model (speed, spacing, weighting,
+ * jitter, speed drift, glitches, seed), and writes them:
+ *   - as device lines, a debug_serial capture (.cwcap) or an archive
+ *     (.cwarc), for --replay and the offline tools
+ *   - live into a pseudo-terminal, paced like the device, so serial_keyboard
+ *     decodes it with -p exactly as if a CW Hotline were attached
+ *   - as a labelled corpus: many sessions, each with its transcript
+ *     (gen00001.cwarc + gen00001.txt, the layout cw_tune reads) and a
+ *     corpus.csv of the operator behind each, generated on every core
+ *
+ * Operator settings take a single value or a range (--wpm 12-35); a corpus
+ * draws each session's operator from the ranges, from its own seed.
+ *
+ * Compile: clang -O2 -o cw_gen cw_gen.c -lpthread -lm
+ * Run: ./cw_gen lesson.txt -o lesson.cwarc --wpm 18 --jitter 0.1
+ *      ./cw_gen --corpus corpus/ --sessions 1000 --wpm 12-35 --jitter 0-0.2
+ *      ./cw_gen lesson.txt --pty
+ */
+
+#ifdef __linux__
+    #define _GNU_SOURCE    // glibc hides posix_openpt() and friends otherwise
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <poll.h>
+    #include <termios.h>
+    #include <unistd.h>
+    #include <sys/stat.h>
+#else
+    #include <direct.h>
+#endif
+
+#include "cw_capture.h"
+#include "cw_archive.h"
+#include "cw_clock.h"
+#include "cw_gen.h"
+#include "cw_pool.h"
+
+#define DEFAULT_BAUD 115200
+#define DEFAULT_CORPUS_CHARS 2000
+#define TEXT_BLOCK 65536            // Text generated/read per cwgen_text() call
+#define LINE_BUF (1 << 20)
+
+// ============================================================
+// OPERATOR
+// ============================================================
+
+typedef struct { double lo, hi; } Range;
+
+typedef struct {
+    Range wpm, farnsworth, wordSpacing, weight, jitter, drift, glitch;
+    uint64_t seed;
+} Operator;
+
+// "x" or "lo-hi". Returns 0, or -1 if malformed.
+static int parseRange(const char *s, Range *r) {
+    char *end;
+    r->lo = strtod(s, &end);
+    if (end == s) return -1;
+    r->hi = r->lo;
+    if (*end == '-') {
+        const char *hi = end + 1;
+        r->hi = strtod(hi, &end);
+        if (end == hi || r->hi < r->lo) return -1;
+    }
+    return *end ? -1 : 0;
+}
+
+static double pickRange(CwGen *rng, Range r) {
+    return r.lo == r.hi ? r.lo : r.lo + (r.hi - r.lo) * cwgen_uniform(rng);
+}
+
+// Session parameters: each range sampled from a stream of the session's own
+static void pickOperator(const Operator *op, uint64_t seed, CwGenParams *p) {
+    CwGen rng;
+    CwGenParams seedOnly;
+    cwgen_default_params(&seedOnly);
+    seedOnly.seed = seed ^ 0x5DEECE66Dull;
+    cwgen_init(&rng, &seedOnly, NULL, NULL);
+    cwgen_default_params(p);
+    p->wpm = pickRange(&rng, op->wpm);
+    p->farnsworth = pickRange(&rng, op->farnsworth);
+    p->wordSpacing = pickRange(&rng, op->wordSpacing);
+    p->weight = pickRange(&rng, op->weight);
+    p->jitter = pickRange(&rng, op->jitter);
+    p->drift = pickRange(&rng, op->drift);
+    p->glitchRate = pickRange(&rng, op->glitch);
+    p->seed = seed;
+}
+
+// What cwgen_text() actually sends, as a transcript: coded characters in
+// upper case, whitespace runs as one space. *space carries the state from
+// one block to the next (start at -1). out needs n + 2 bytes.
+static size_t labelText(const CwGen *g, const char *in, size_t n, char *out, int *space) {
+    size_t len = 0;
+    for (size_t i = 0; i < n; i++) {
+        unsigned char c = (unsigned char)in[i];
+        if (isspace(c)) { if (*space == 0) *space = 1; continue; }
+        if (c >= 128 || !g->codes[c][0]) continue;
+        if (*space == 1) out[len++] = ' ';
+        *space = 0;
+        out[len++] = (char)toupper(c);
+    }
+    out[len] = '\0';
+    return len;
+}
+
+// ============================================================
+// OUTPUT
+// ============================================================
+
+enum { FMT_LINES, FMT_CAPTURE, FMT_ARCHIVE };
+
+typedef struct {
+    int format;
+    FILE *f;
+    CwArcWriter *arc;
+    char *buf;                     // Device lines waiting to be written
+    size_t len;
+    unsigned long long elements;
+    uint64_t lastMs;
+    int error;
+    // Live pseudo-terminal: pacing against the real clock
+    int pty;
+    double speed;                  // 1 = real time, 0 = as fast as it is read
+    CwClock clock;
+    unsigned long startMs;
+} Sink;
+
+static int formatOf(const char *path) {
+    size_t n = strlen(path);
+    if (n > 6 && strcmp(path + n - 6, ".cwarc") == 0) return FMT_ARCHIVE;
+    if (n > 6 && strcmp(path + n - 6, ".cwcap") == 0) return FMT_CAPTURE;
+    return FMT_LINES;
+}
+
+// "S,<pause>,<length>\r\n" without printf: this is the hot path for corpora
+static int formatLine(char *p, uint32_t pause, uint32_t length) {
+    char digits[10];
+    int len = 0, n;
+    p[len++] = 'S';
+    p[len++] = ',';
+    n = 0; do { digits[n++] = (char)('0' + pause % 10); pause /= 10; } while (pause);
+    while (n) p[len++] = digits[--n];
+    p[len++] = ',';
+    n = 0; do { digits[n++] = (char)('0' + length % 10); length /= 10; } while (length);
+    while (n) p[len++] = digits[--n];
+    p[len++] = '\r';
+    p[len++] = '\n';
+    return len;
+}
+
+static void sinkFlush(Sink *s) {
+    if (!s->len) return;
+#ifndef _WIN32
+    if (s->pty) {
+        size_t off = 0;
+        while (off < s->len && !s->error) {
+            ssize_t n = write(fileno(s->f), s->buf + off, s->len - off);
+            if (n > 0) off += (size_t)n;
+            else if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+                struct pollfd pfd = { fileno(s->f), POLLOUT, 0 };
+                poll(&pfd, 1, 100);
+            }
+            else s->error = 1;      // EIO: the reader went away
+        }
+        s->len = 0;
+        return;
+    }
+#endif
+    if (!s->error && fwrite(s->buf, 1, s->len, s->f) != s->len) s->error = 1;
+    s->len = 0;
+}
+
+static void sinkElement(void *ctx, const CwArcElement *e) {
+    Sink *s = (Sink *)ctx;
+    if (s->error) return;
+    s->elements++;
+    s->lastMs = e->arrivalMs;
+    if (s->format == FMT_ARCHIVE) {
+        if (cwarc_writer_add(s->arc, e->pause, e->length, e->arrivalMs) != 0) s->error = 1;
+        return;
+    }
+    if (s->format == FMT_CAPTURE) {
+        char line[32];
+        int len = formatLine(line, e->pause, e->length);
+        if (cwcap_write_chunk(s->f, e->arrivalMs * 1000, line, (uint32_t)len) != 0) s->error = 1;
+        return;
+    }
+    if (s->pty && s->speed > 0) {
+        // The device sends each element when the key comes up
+        unsigned long due = s->startMs + (unsigned long)(e->arrivalMs / s->speed);
+        long left = (long)(due - cwclock_now(&s->clock));
+        if (left > 0) {
+            sinkFlush(s);
+            cwclock_sleep(&s->clock, (unsigned long)left);
+        }
+    }
+    s->len += formatLine(s->buf + s->len, e->pause, e->length);
+    if (s->len > LINE_BUF - 64 || (s->pty && s->speed > 0)) sinkFlush(s);
+}
+
+// Open path (FMT_* from its extension; "-" is device lines on stdout)
+static int sinkOpen(Sink *s, const char *path) {
+    memset(s, 0, sizeof(*s));
+    s->format = strcmp(path, "-") == 0 ? FMT_LINES : formatOf(path);
+    if (s->format == FMT_ARCHIVE) {
+        s->arc = cwarc_writer_open(path);
+        return s->arc ? 0 : -1;
+    }
+    s->f = strcmp(path, "-") == 0 ? stdout : fopen(path, "wb");
+    if (!s->f) return -1;
+    if (s->format == FMT_CAPTURE) return cwcap_write_header(s->f, DEFAULT_BAUD);
+    s->buf = (char *)malloc(LINE_BUF);
+    return s->buf ? 0 : -1;
+}
+
+// Returns 0, or -1 if anything failed to write
+static int sinkClose(Sink *s) {
+    int rc = s->error ? -1 : 0;
+    if (s->arc && cwarc_writer_close(s->arc) != 0) rc = -1;
+    if (s->buf) sinkFlush(s);
+    if (s->error) rc = -1;
+    if (s->f && s->f != stdout && fclose(s->f) != 0) rc = -1;
+    if (s->f == stdout && fflush(stdout) != 0) rc = -1;
+    free(s->buf);
+    return rc;
+}
+
+// ============================================================
+// SENDING
+// ============================================================
+
+// Send text from f, or `randomChars` of random words when f is NULL, in
+// blocks cut at whitespace (so a block boundary is a word gap, as in the
+// text). label (optional) receives the transcript. Returns characters sent.
+static unsigned long long sendText(CwGen *g, FILE *f, unsigned long long randomChars, FILE *label) {
+    static char text[TEXT_BLOCK + 64], sentText[TEXT_BLOCK + 64];
+    size_t carry = 0;
+    unsigned long long sent = 0, made = 0;
+    int space = -1;
+    while (1) {
+        size_t n;
+        if (f) {
+            n = carry + fread(text + carry, 1, TEXT_BLOCK - carry, f);
+            if (n == 0) break;
+        } else {
+            if (made >= randomChars) break;
+            unsigned long long want = randomChars - made;
+            n = cwgen_words(g, text, want < TEXT_BLOCK ? (size_t)want : TEXT_BLOCK);
+            made += n + 1;
+            text[n++] = ' ';
+        }
+        // Keep an unfinished last word for the next block
+        size_t cut = n;
+        if (f && n == TEXT_BLOCK) {
+            while (cut > 0 && !isspace((unsigned char)text[cut - 1])) cut--;
+            if (cut == 0) cut = n;
+        }
+        char keep = text[cut];
+        text[cut] = '\0';
+        sent += cwgen_text(g, text);
+        if (label) fwrite(sentText, 1, labelText(g, text, cut, sentText, &space), label);
+        text[cut] = keep;
+        carry = n - cut;
+        memmove(text, text + cut, carry);
+    }
+    return sent;
+}
+
+// ============================================================
+// CORPUS
+// ============================================================
+
+typedef struct {
+    CwGenParams params;
+    const char *text;              // Slice of the input text, or NULL for random words
+    size_t textLen;
+    unsigned long long textChars;  // In the transcript, spaces included (what --chars slices)
+    unsigned long long chars, elements;  // Keyed
+    uint64_t lastMs;
+    int failed;
+} Session;
+
+typedef struct {
+    Session *sessions;
+    const char *dir;
+    const char *ext;
+    int chars;
+} Corpus;
+
+static void genSession(void *ctx, int task, int worker) {
+    (void)worker;
+    Corpus *c = (Corpus *)ctx;
+    Session *s = &c->sessions[task];
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/gen%05d%s", c->dir, task + 1, c->ext);
+
+    Sink sink;
+    if (sinkOpen(&sink, path) != 0) { s->failed = 1; return; }
+    CwGen g;
+    cwgen_init(&g, &s->params, sinkElement, &sink);
+
+    char *text;
+    size_t len;
+    if (s->text) {
+        text = (char *)malloc(s->textLen + 1);
+        if (!text) { s->failed = 1; sinkClose(&sink); return; }
+        memcpy(text, s->text, s->textLen);
+        text[s->textLen] = '\0';
+        len = s->textLen;
+    } else {
+        text = (char *)malloc((size_t)c->chars + 32);
+        if (!text) { s->failed = 1; sinkClose(&sink); return; }
+        len = cwgen_words(&g, text, (size_t)c->chars);
+    }
+    s->chars = cwgen_text(&g, text);
+    s->elements = sink.elements;
+    s->lastMs = sink.lastMs;
+    if (sinkClose(&sink) != 0) s->failed = 1;
+
+    // Transcript next to the session
+    char *label = (char *)malloc(len + 2);
+    int space = -1;
+    snprintf(path, sizeof(path), "%s/gen%05d.txt", c->dir, task + 1);
+    FILE *f = label ? fopen(path, "wb") : NULL;
+    if (!f) s->failed = 1;
+    else {
+        size_t n = labelText(&g, text, len, label, &space);
+        s->textChars = n;
+        if (fwrite(label, 1, n, f) != n || fputc('\n', f) == EOF) s->failed = 1;
+        if (fclose(f) != 0) s->failed = 1;
+    }
+    free(label);
+    free(text);
+}
+
+static int makeDir(const char *dir) {
+#ifdef _WIN32
+    return _mkdir(dir) == 0 || errno == EEXIST ? 0 : -1;
+#else
+    return mkdir(dir, 0777) == 0 || errno == EEXIST ? 0 : -1;
+#endif
+}
+
+// Slices of about `chars` characters, cut at whitespace. Returns the count.
+static int sliceText(const char *text, size_t len, int chars, int max, Session *sessions) {
+    size_t pos = 0;
+    int n = 0;
+    while (pos < len && n < max) {
+        while (pos < len && isspace((unsigned char)text[pos])) pos++;
+        if (pos >= len) break;
+        size_t end = pos + (size_t)chars < len ? pos + (size_t)chars : len;
+        while (end < len && !isspace((unsigned char)text[end])) end++;
+        sessions[n].text = text + pos;
+        sessions[n].textLen = end - pos;
+        n++;
+        pos = end;
+    }
+    return n;
+}
+
+static int writeCorpus(const char *dir, const char *textPath, const Operator *op, int count,
+                       int chars, int archive, int workers) {
+    if (makeDir(dir) != 0) { printf("[!] Cannot create %s\n", dir); return 1; }
+    char *text = NULL;
+    size_t textLen = 0;
+    if (textPath) {
+        FILE *f = strcmp(textPath, "-") == 0 ? stdin : fopen(textPath, "rb");
+        if (!f) { perror("Error opening text"); return 1; }
+        size_t cap = 0, n;
+        char block[TEXT_BLOCK];
+        while ((n = fread(block, 1, sizeof(block), f)) > 0) {
+            if (textLen + n > cap) {
+                cap = (textLen + n) * 2;
+                char *grown = (char *)realloc(text, cap);
+                if (!grown) { printf("[!] Out of memory\n"); free(text); return 1; }
+                text = grown;
+            }
+            memcpy(text + textLen, block, n);
+            textLen += n;
+        }
+        if (f != stdin) fclose(f);
+        if (count <= 0) count = (int)(textLen / (size_t)chars) + 1;
+    }
+    if (count <= 0) { printf("[!] --corpus needs --sessions or a text file\n"); return 1; }
+
+    Corpus c;
+    c.sessions = (Session *)calloc((size_t)count, sizeof(Session));
+    c.dir = dir;
+    c.ext = archive ? ".cwarc" : ".cwcap";
+    c.chars = chars;
+    if (!c.sessions) { printf("[!] Out of memory\n"); free(text); return 1; }
+    if (text) count = sliceText(text, textLen, chars, count, c.sessions);
+    for (int i = 0; i < count; i++) pickOperator(op, op->seed + (uint64_t)i, &c.sessions[i].params);
+
+    if (workers <= 0) workers = cwpool_cpu_count();
+    uint64_t startUs = cwcap_now_us();
+    if (cwpool_run(count, workers, NULL, genSession, &c) != 0) {
+        printf("[!] Out of memory\n");
+        return 1;
+    }
+    double seconds = (cwcap_now_us() - startUs) / 1e6;
+
+    // Manifest: who sent what, for slicing results by operator
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/corpus.csv", dir);
+    FILE *csv = fopen(path, "w");
+    if (!csv) { perror("Error writing corpus.csv"); return 1; }
+    fprintf(csv, "session,wpm,farnsworth,word_spacing,weight,jitter,drift,glitch,seed,text_chars,keyed_chars,elements,seconds\n");
+    unsigned long long textChars = 0, totalChars = 0, elements = 0, failed = 0;
+    double audio = 0;
+    for (int i = 0; i < count; i++) {
+        const Session *s = &c.sessions[i];
+        const CwGenParams *p = &s->params;
+        fprintf(csv, "gen%05d,%.2f,%.2f,%.2f,%.1f,%.3f,%.3f,%.3f,%llu,%llu,%llu,%llu,%.1f\n", i + 1, p->wpm,
+                p->farnsworth, p->wordSpacing, p->weight, p->jitter, p->drift, p->glitchRate,
+                (unsigned long long)p->seed, s->textChars, s->chars, s->elements, s->lastMs / 1000.0);
+        textChars += s->textChars;
+        totalChars += s->chars;
+        elements += s->elements;
+        audio += s->lastMs / 1000.0;
+        if (s->failed) { printf("[!] gen%05d: write failed\n", i + 1); failed++; }
+    }
+    if (fclose(csv) != 0) { perror("Error writing corpus.csv"); failed++; }
+    printf("[OK] %d sessions (%llu chars of text, %llu keyed, %llu elements, %.1f h of sending) in %.2f s on %d threads -> %s\n",
+           count, textChars, totalChars, elements, audio / 3600, seconds, workers, dir);
+    free(c.sessions);
+    free(text);
+    return failed ? 1 : 0;
+}
+
+// ============================================================
+// PSEUDO-TERMINAL
+// ============================================================
+
+#ifndef _WIN32
+// A pty whose other end looks like the device's serial port. Returns the
+// master, or NULL.
+static FILE *openPty(char *name, size_t nameLen) {
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0) {
+        if (fd >= 0) close(fd);
+        return NULL;
+    }
+    snprintf(name, nameLen, "%s", ptsname(fd));
+    struct termios t;
+    if (tcgetattr(fd, &t) == 0) {
+        cfmakeraw(&t);
+        tcsetattr(fd, TCSANOW, &t);
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fdopen(fd, "wb");
+}
+
+// Until a reader opens the pty, its master reports a hangup
+static void waitForReader(FILE *pty) {
+    struct pollfd pfd = { fileno(pty), POLLOUT, 0 };
+    while (poll(&pfd, 1, 100) >= 0 && (pfd.revents & POLLHUP)) usleep(100000);
+}
+#endif
+
+// ============================================================
+// MAIN
+// ============================================================
+
+static void printUsage(const char *progname) {
+    printf("CW Hotline element stream generator\n\n");
+    printf("Usage: %s [text|-] [options]\n\n", progname);
+    printf("Output (one of):\n");
+    printf("  -o <file>             .cwarc archive, .cwcap capture, or device lines (default: - = stdout)\n");
+    printf("  --pty                 Key into a new pseudo-terminal in real time (serial_keyboard -p <it>)\n");
+    printf("  --corpus <dir>        Labelled sessions gen00001.cwarc + .txt and corpus.csv, on all cores\n\n");
+    printf("Text:\n");
+    printf("  text|-                Text file to send (- = stdin)\n");
+    printf("  --random <chars>      Random QSO words instead (default for --corpus)\n");
+    printf("  --chars <N>           Characters per corpus session (default: %d)\n", DEFAULT_CORPUS_CHARS);
+    printf("  --sessions <N>        Corpus sessions (default: all of the text)\n");
+    printf("  --label <file>        Also write the transcript of what was sent\n\n");
+    printf("Operator (a value, or lo-hi for a corpus to draw from):\n");
+    printf("  --wpm <x>             Character speed (default: 20)\n");
+    printf("  --farnsworth <x>      Character and word gaps stretched by x (default: 1)\n");
+    printf("  --word-spacing <x>    Word gaps stretched by x on top (default: 1)\n");
+    printf("  --weight <x>          Element weighting, 50 = standard\n");
+    printf("  --jitter <x>          Timing std dev as a fraction of each element (default: 0)\n");
+    printf("  --drift <x>           Speed random walk per character, fraction (default: 0)\n");
+    printf("  --glitch <x>          Chance of a noise pulse per element (default: 0)\n");
+    printf("  --seed <N>            Base seed (default: 1)\n\n");
+    printf("Other:\n");
+    printf("  --format <cwarc|cwcap> Corpus session format (default: cwarc)\n");
+    printf("  --speed <x>           --pty pacing (1 = real time, 0 = as fast as it is read)\n");
+    printf("  --loop                --pty: send the text again and again\n");
+    printf("  -j <N>                Worker threads for --corpus (default: one per CPU)\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *textPath = NULL, *outPath = "-", *corpusDir = NULL, *labelPath = NULL;
+    unsigned long long randomChars = 0;
+    int chars = DEFAULT_CORPUS_CHARS, sessions = 0, archive = 1, workers = 0, pty = 0, loop = 0;
+    double speed = 1.0;
+    Operator op;
+    op.wpm.lo = op.wpm.hi = 20;
+    op.farnsworth.lo = op.farnsworth.hi = 1;
+    op.wordSpacing.lo = op.wordSpacing.hi = 1;
+    op.weight.lo = op.weight.hi = 50;
+    op.jitter.lo = op.jitter.hi = 0;
+    op.drift.lo = op.drift.hi = 0;
+    op.glitch.lo = op.glitch.hi = 0;
+    op.seed = 1;
+
+    static const struct { const char *flag; size_t offset; } ranges[] = {
+        { "--wpm", offsetof(Operator, wpm) },
+        { "--farnsworth", offsetof(Operator, farnsworth) },
+        { "--word-spacing", offsetof(Operator, wordSpacing) },
+        { "--weight", offsetof(Operator, weight) },
+        { "--jitter", offsetof(Operator, jitter) },
+        { "--drift", offsetof(Operator, drift) },
+        { "--glitch", offsetof(Operator, glitch) },
+    };
+
+    for (int i = 1; i < argc; i++) {
+        int matched = 0;
+        for (size_t r = 0; r < sizeof(ranges) / sizeof(ranges[0]); r++) {
+            if (strcmp(argv[i], ranges[r].flag) != 0 || i + 1 >= argc) continue;
+            Range *range = (Range *)((char *)&op + ranges[r].offset);
+            if (parseRange(argv[++i], range) != 0) {
+                printf("Invalid %s '%s' (expected <x> or <lo>-<hi>)\n", ranges[r].flag, argv[i]);
+                return 1;
+            }
+            matched = 1;
+        }
+        if (matched) continue;
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) outPath = argv[++i];
+        else if (strcmp(argv[i], "--pty") == 0) pty = 1;
+        else if (strcmp(argv[i], "--corpus") == 0 && i + 1 < argc) corpusDir = argv[++i];
+        else if (strcmp(argv[i], "--random") == 0 && i + 1 < argc) randomChars = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--chars") == 0 && i + 1 < argc) chars = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--sessions") == 0 && i + 1 < argc) sessions = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--label") == 0 && i + 1 < argc) labelPath = argv[++i];
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) op.seed = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            const char *fmt = argv[++i];
+            if (strcmp(fmt, "cwarc") != 0 && strcmp(fmt, "cwcap") != 0) {
+                printf("Invalid --format '%s' (must be cwarc or cwcap)\n", fmt);
+                return 1;
+            }
+            archive = strcmp(fmt, "cwarc") == 0;
+        }
+        else if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc) speed = atof(argv[++i]);
+        else if (strcmp(argv[i], "--loop") == 0) loop = 1;
+        else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) workers = atoi(argv[++i]);
+        else if (argv[i][0] != '-' || strcmp(argv[i], "-") == 0) textPath = argv[i];
+        else { printUsage(argv[0]); return strcmp(argv[i], "-h") != 0 && strcmp(argv[i], "--help") != 0; }
+    }
+    if (op.wpm.lo < 1) { printf("Invalid --wpm (must be at least 1)\n"); return 1; }
+    if (chars < 1) chars = DEFAULT_CORPUS_CHARS;
+
+    if (corpusDir) return writeCorpus(corpusDir, textPath, &op, sessions, chars, archive, workers);
+
+    if (!textPath && !randomChars) {
+        if (argc > 1) textPath = "-";
+        else { printUsage(argv[0]); return 1; }
+    }
+    FILE *text = NULL;
+    if (textPath) {
+        text = strcmp(textPath, "-") == 0 ? stdin : fopen(textPath, "rb");
+        if (!text) { perror("Error opening text"); return 1; }
+    }
+
+    // One operator; a range means one draw from it
+    CwGenParams params;
+    pickOperator(&op, op.seed, &params);
+    Sink sink;
+    if (pty) {
+#ifdef _WIN32
+        printf("[!] --pty needs a POSIX system\n");
+        return 1;
+#else
+        char name[256];
+        memset(&sink, 0, sizeof(sink));
+        sink.format = FMT_LINES;
+        sink.f = openPty(name, sizeof(name));
+        sink.buf = (char *)malloc(LINE_BUF);
+        if (!sink.f || !sink.buf) { printf("[!] Cannot create a pseudo-terminal\n"); return 1; }
+        sink.pty = 1;
+        sink.speed = speed;
+        CwClock real = CWCLOCK_REAL;
+        sink.clock = real;
+        printf("[*] Keying into %s at %.0f WPM. Run: ./serial_keyboard -p %s\n", name, params.wpm, name);
+        printf("[*] Waiting for the port to be opened... (Ctrl+C to stop)\n");
+        fflush(stdout);
+        waitForReader(sink.f);
+        sink.startMs = cwclock_now(&sink.clock);
+#endif
+    } else if (sinkOpen(&sink, outPath) != 0) {
+        printf("[!] Cannot write %s\n", outPath);
+        return 1;
+    }
+    FILE *label = labelPath ? fopen(labelPath, "wb") : NULL;
+    if (labelPath && !label) { perror("Error writing label"); return 1; }
+
+    CwGen g;
+    cwgen_init(&g, &params, sinkElement, &sink);
+    uint64_t startUs = cwcap_now_us();
+    unsigned long long sent = 0;
+    do {
+        sent += sendText(&g, text, randomChars, label);
+        if (text && loop) rewind(text);
+    } while (loop && pty && !sink.error);
+    double seconds = (cwcap_now_us() - startUs) / 1e6;
+    unsigned long long elements = sink.elements;
+    uint64_t lastMs = sink.lastMs;
+    int rc = sinkClose(&sink);
+    if (text && text != stdin) fclose(text);
+    if (label && (fputc('\n', label) == EOF || fclose(label) != 0)) rc = -1;
+
+    // stdout may be carrying the stream: report on stderr
+    FILE *report = strcmp(outPath, "-") == 0 && !pty ? stderr : stdout;
+    if (rc != 0) {
+        fprintf(report, pty ? "[!] The port was closed\n" : "[!] Cannot write %s\n", outPath);
+        return 1;
+    }
+    fprintf(report, "[OK] %llu chars keyed, %llu elements (%.1f min of sending at %.0f WPM) in %.2f s\n", sent,
+            elements, lastMs / 60000.0, params.wpm, seconds);
+    return 0;
+}
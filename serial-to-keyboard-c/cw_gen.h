@@ -0,0 +1,196 @@
+/*
+ * cw_gen.h
+ * Synthetic CW: turns text into the element stream a CW Hotline would send
+ * for it (pause before each element, key-down length, arrival time), with
+ * an operator model for speed, Farnsworth and word spacing, weighting,
+ * timing jitter, speed drift and noise glitches. Deterministic for a given
+ * seed, so generated sessions can serve as ground truth.
+ *
+ * Characters are encoded from the decoder's own morseTree (inverted once per
+ * generator into a per-character table), so everything the generator can
+ * send is something the decoder knows.
+ */
+
+#ifndef CW_GEN_H
+#define CW_GEN_H
+
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+
+#include "cw_archive.h"
+#include "morse_decoder.h"
+
+typedef struct {
+    double wpm;          // Character speed (PARIS standard: dit = 1200 / wpm ms)
+    double farnsworth;   // Character and word gaps stretched by this (1 = none)
+    double wordSpacing;  // Word gaps stretched by this on top (1 = none)
+    double dahRatio;     // Dah length in dits (3)
+    double weight;       // 50 = standard; more lengthens elements and shortens spaces alike
+    double jitter;       // Std dev of every element and gap, as a fraction of it
+    double drift;        // Std dev of the speed's random walk per character (fraction)
+    double glitchRate;   // Chance of a noise pulse in front of each element
+    uint64_t seed;
+} CwGenParams;
+
+static inline void cwgen_default_params(CwGenParams *p) {
+    p->wpm = 20;
+    p->farnsworth = 1.0;
+    p->wordSpacing = 1.0;
+    p->dahRatio = 3.0;
+    p->weight = 50;
+    p->jitter = 0.0;
+    p->drift = 0.0;
+    p->glitchRate = 0.0;
+    p->seed = 1;
+}
+
+typedef void (*CwGenEmitFn)(void *ctx, const CwArcElement *e);
+
+typedef struct {
+    CwGenParams p;
+    uint64_t rng;
+    double pause;        // Silence accumulated before the next element, ms
+    uint64_t clockMs;    // Arrival time of the last element
+    int started;
+    double speed;        // Current speed as a fraction of p.wpm (drift)
+    char codes[128][8];  // Dits and dahs per ASCII character, "" = none
+    CwGenEmitFn emit;
+    void *ctx;
+} CwGen;
+
+// Tree path for c (dits and dahs, at most 6), or 0 if c can't be sent
+static inline int cwgen_code(char c, char code[8]) {
+    c = (char)toupper((unsigned char)c);
+    for (int i = 1; i < 128; i++) {
+        if (morseTree[i] != c) continue;
+        int len = 0;
+        for (int n = i; n > 0; n = (n - 1) / 2) code[len++] = (n % 2) ? '.' : '-';
+        for (int k = 0; k < len / 2; k++) { char t = code[k]; code[k] = code[len - 1 - k]; code[len - 1 - k] = t; }
+        code[len] = '\0';
+        return len;
+    }
+    return 0;
+}
+
+static inline void cwgen_init(CwGen *g, const CwGenParams *p, CwGenEmitFn emit, void *ctx) {
+    memset(g, 0, sizeof(*g));
+    g->p = *p;
+    g->rng = p->seed * 0x9E3779B97F4A7C15ull + 1;
+    g->speed = 1.0;
+    for (int c = 1; c < 128; c++) {
+        if (!isspace(c)) cwgen_code((char)c, g->codes[c]);
+    }
+    g->emit = emit;
+    g->ctx = ctx;
+}
+
+// xorshift64*, uniform in [0, 1)
+static inline double cwgen_uniform(CwGen *g) {
+    g->rng ^= g->rng >> 12;
+    g->rng ^= g->rng << 25;
+    g->rng ^= g->rng >> 27;
+    return (double)((g->rng * 0x2545F4914F6CDD1Dull) >> 11) / 9007199254740992.0;
+}
+
+static inline double cwgen_gauss(CwGen *g) {
+    double u = cwgen_uniform(g), v = cwgen_uniform(g);
+    if (u < 1e-12) u = 1e-12;
+    return sqrt(-2.0 * log(u)) * cos(6.283185307179586 * v);
+}
+
+// ms with jitter applied, never below 1
+static inline double cwgen_jitter(CwGen *g, double ms) {
+    if (g->p.jitter == 0) {
+        // Same draws as cwgen_gauss(), so a seed gives the same session
+        // with or without jitter, minus the transcendental math
+        cwgen_uniform(g);
+        cwgen_uniform(g);
+        return ms < 1.0 ? 1.0 : ms;
+    }
+    double v = ms * (1.0 + g->p.jitter * cwgen_gauss(g));
+    return v < 1.0 ? 1.0 : v;
+}
+
+static inline void cwgen_send(CwGen *g, uint32_t pause, uint32_t length) {
+    CwArcElement e;
+    e.pause = pause;
+    e.length = length;
+    g->clockMs += pause + length;
+    e.arrivalMs = g->clockMs;
+    g->emit(g->ctx, &e);
+}
+
+static inline double cwgen_dit(const CwGen *g) {
+    return 1200.0 / (g->p.wpm * g->speed);
+}
+
+static inline void cwgen_element(CwGen *g, int isDash) {
+    double dit = cwgen_dit(g);
+    double weight = dit * (g->p.weight - 50) / 50;
+    if (g->p.glitchRate > 0 && cwgen_uniform(g) < g->p.glitchRate) {
+        // A contact bounce somewhere in the gap: splits the pause in two
+        uint32_t before = (uint32_t)(g->pause * cwgen_uniform(g));
+        uint32_t glitch = 3 + (uint32_t)(cwgen_uniform(g) * 20);
+        cwgen_send(g, before, glitch);
+        g->pause = g->pause > before + glitch ? g->pause - before - glitch : 1;
+    }
+    cwgen_send(g, (uint32_t)(g->pause + 0.5), (uint32_t)(cwgen_jitter(g, (isDash ? dit * g->p.dahRatio : dit) + weight) + 0.5));
+    g->pause = cwgen_jitter(g, dit - weight);
+    g->started = 1;
+}
+
+// Send text. Whitespace is a word gap; characters with no code are skipped.
+// Returns the number of characters sent.
+static inline size_t cwgen_text(CwGen *g, const char *text) {
+    size_t sent = 0;
+    int wordGap = 1;
+    for (const char *s = text; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (isspace(c)) { wordGap = 1; continue; }
+        const char *code = c < 128 ? g->codes[c] : "";
+        if (!*code) continue;
+        if (g->p.drift > 0) {
+            // Random walk in log speed, pulled back toward p.wpm
+            g->speed *= exp(g->p.drift * cwgen_gauss(g) - 0.05 * log(g->speed));
+        }
+        double dit = cwgen_dit(g);
+        double gap = (wordGap ? 7 * g->p.wordSpacing : 3) * dit * g->p.farnsworth;
+        if (g->started) {
+            // pause already holds one jittered dit of inter-element space
+            g->pause += cwgen_jitter(g, gap - dit);
+        } else {
+            g->pause = cwgen_jitter(g, 7 * dit * g->p.farnsworth);
+        }
+        for (const char *e = code; *e; e++) cwgen_element(g, *e == '-');
+        wordGap = 0;
+        sent++;
+    }
+    return sent;
+}
+
+// Random plain-language and QSO words from the generator's own stream,
+// space separated, until text holds at least chars characters. text needs
+// room for chars + 32. Returns the length.
+static inline size_t cwgen_words(CwGen *g, char *text, size_t chars) {
+    // Every character has a code in morseTree
+    static const char *words[] = {
+        "THE", "QUICK", "BROWN", "FOX", "JUMPS", "OVER", "LAZY", "DOG", "PARIS",
+        "CQ", "DE", "K", "TU", "73", "RST", "599", "QTH", "NAME", "OP", "RIG",
+        "ANT", "WX", "HR", "ES", "FB", "AGN", "PSE", "QSL", "QRZ?", "W1AW",
+        "K5ZD/P", "DX", "5NN", "TEST", "1.5", "UP,", "GM", "BK", "SK", "2024",
+    };
+    size_t len = 0;
+    while (len < chars) {
+        const char *w = words[(int)(cwgen_uniform(g) * (sizeof(words) / sizeof(words[0])))];
+        size_t n = strlen(w);
+        if (len) text[len++] = ' ';
+        memcpy(text + len, w, n);
+        len += n;
+    }
+    text[len] = '\0';
+    return len;
+}
+
+#endif // CW_GEN_H
@@ -0,0 +1,220 @@
+/*
+ * cw_keyer.h
+ * An iambic keyer in software: paddle contacts in, timed elements out, in
+ * the same pause/length form a CW Hotline sends, so a bare paddle on a USB
+ * adapter can drive the decoder and key injection without the device.
+ *
+ *   cwkeyer_paddles()  a paddle contact changed at time now
+ *   cwkeyer_run()      key elements whose time has come (call at
+ *                      cwkeyer_next(), or on any wakeup)
+ *
+ * Modes: straight key (the dit contact passes through), iambic A and
+ * iambic B (a squeeze released during an element earns one more opposite
+ * element). Dit/dah memory remembers a paddle tapped while the keyer is
+ * busy. Weighting lengthens every element and shortens every space by the
+ * same amount, so the speed is unchanged.
+ *
+ * The keyer is a pure state machine on caller-supplied milliseconds: each
+ * element starts exactly when the previous space ends, however late the
+ * caller wakes up, and it runs the same on a real or a virtual clock.
+ * Also here: a parser for MIDI paddle adapters, which report the paddles as
+ * note on/off messages.
+ */
+
+#ifndef CW_KEYER_H
+#define CW_KEYER_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "cw_archive.h"
+
+#define CWKEYER_DIT 1
+#define CWKEYER_DAH 2
+
+enum { CWKEYER_STRAIGHT, CWKEYER_IAMBIC_A, CWKEYER_IAMBIC_B };
+
+typedef struct {
+    int mode;            // CWKEYER_STRAIGHT/IAMBIC_A/IAMBIC_B
+    double wpm;          // PARIS: dit = 1200 / wpm ms
+    int weight;          // 50 = standard; 25-75
+    int memory;          // Dit/dah memory on
+} CwKeyerParams;
+
+static inline void cwkeyer_default_params(CwKeyerParams *p) {
+    p->mode = CWKEYER_IAMBIC_B;
+    p->wpm = 20;
+    p->weight = 50;
+    p->memory = 1;
+}
+
+typedef void (*CwKeyerEmitFn)(void *ctx, const CwArcElement *e);
+// An iambic element is starting: its length is known up front (sidetone)
+typedef void (*CwKeyerStartFn)(void *ctx, unsigned long pause, unsigned long length);
+
+enum { CWKEYER_IDLE, CWKEYER_ON, CWKEYER_SPACE };
+
+typedef struct {
+    CwKeyerParams p;
+    unsigned long ditMs, dahMs, spaceMs;  // Weighted timing
+
+    int paddles;                 // CWKEYER_DIT/DAH bits held now
+    int state;
+    unsigned long until;         // End of the current element or space
+    int element;                 // Current/last element: 0 dit, 1 dah
+    int memory;                  // CWKEYER_DIT/DAH bits remembered
+    int squeeze;                 // Both paddles held during this element
+
+    unsigned long downAt;        // Key-down time of the current element
+    unsigned long upAt;          // Last key-up
+    int keyed;                   // upAt is valid
+    unsigned long elements;
+
+    CwKeyerEmitFn emit;
+    CwKeyerStartFn onStart;      // Optional
+    void *ctx;
+} CwKeyer;
+
+static inline void cwkeyer_init(CwKeyer *k, const CwKeyerParams *p, CwKeyerEmitFn emit, void *ctx) {
+    memset(k, 0, sizeof(*k));
+    k->p = *p;
+    if (k->p.wpm < 5) k->p.wpm = 5;
+    if (k->p.wpm > 60) k->p.wpm = 60;
+    if (k->p.weight < 25) k->p.weight = 25;
+    if (k->p.weight > 75) k->p.weight = 75;
+    double dit = 1200.0 / k->p.wpm;
+    double extra = dit * (k->p.weight - 50) / 50.0;
+    k->ditMs = (unsigned long)(dit + extra + 0.5);
+    k->dahMs = (unsigned long)(3 * dit + extra + 0.5);
+    k->spaceMs = (unsigned long)(dit - extra + 0.5);
+    k->state = CWKEYER_IDLE;
+    k->emit = emit;
+    k->ctx = ctx;
+}
+
+// Key up at time t: hand the finished element on
+static inline void cwkeyer_key_up(CwKeyer *k, unsigned long t) {
+    CwArcElement e;
+    e.pause = k->keyed ? (uint32_t)(k->downAt - k->upAt) : 0;
+    e.length = (uint32_t)(t - k->downAt);
+    e.arrivalMs = t;
+    k->upAt = t;
+    k->keyed = 1;
+    k->elements++;
+    if (k->emit) k->emit(k->ctx, &e);
+}
+
+static inline void cwkeyer_start(CwKeyer *k, unsigned long t, int dah) {
+    k->state = CWKEYER_ON;
+    k->element = dah;
+    k->downAt = t;
+    k->until = t + (dah ? k->dahMs : k->ditMs);
+    k->memory &= dah ? ~CWKEYER_DAH : ~CWKEYER_DIT;
+    k->squeeze = k->paddles == (CWKEYER_DIT | CWKEYER_DAH);
+    if (k->onStart) k->onStart(k->ctx, k->keyed ? t - k->upAt : 0, k->until - t);
+}
+
+// What the paddles (held or remembered) ask for next: 0 dit, 1 dah, -1 none.
+// A squeeze alternates.
+static inline int cwkeyer_choose(const CwKeyer *k) {
+    int want = k->paddles | k->memory;
+    if (want == (CWKEYER_DIT | CWKEYER_DAH)) return !k->element;
+    if (want & CWKEYER_DIT) return 0;
+    if (want & CWKEYER_DAH) return 1;
+    return -1;
+}
+
+// Advance through every element and space that has ended by now
+static inline void cwkeyer_run(CwKeyer *k, unsigned long now) {
+    if (k->p.mode == CWKEYER_STRAIGHT) return;
+    while (k->state != CWKEYER_IDLE && (long)(now - k->until) >= 0) {
+        unsigned long t = k->until;
+        if (k->state == CWKEYER_ON) {
+            // Mode B: a squeeze during the element earns the opposite one
+            if (k->p.mode == CWKEYER_IAMBIC_B && k->squeeze)
+                k->memory |= k->element ? CWKEYER_DIT : CWKEYER_DAH;
+            cwkeyer_key_up(k, t);
+            k->state = CWKEYER_SPACE;
+            k->until = t + k->spaceMs;
+        } else {
+            int next = cwkeyer_choose(k);
+            if (next < 0) k->state = CWKEYER_IDLE;
+            else cwkeyer_start(k, t, next);
+        }
+    }
+}
+
+// Time of the keyer's next transition, or 0 when idle
+static inline unsigned long cwkeyer_next(const CwKeyer *k) {
+    return k->state == CWKEYER_IDLE ? 0 : k->until;
+}
+
+// The paddle contacts are now `paddles` (CWKEYER_DIT/DAH bits)
+static inline void cwkeyer_paddles(CwKeyer *k, unsigned long now, int paddles) {
+    int pressed = paddles & ~k->paddles;
+    if (k->p.mode == CWKEYER_STRAIGHT) {
+        int was = k->paddles & CWKEYER_DIT, is = paddles & CWKEYER_DIT;
+        k->paddles = paddles;
+        if (is && !was) k->downAt = now;
+        else if (was && !is) cwkeyer_key_up(k, now);
+        return;
+    }
+    cwkeyer_run(k, now);
+    k->paddles = paddles;
+    if (k->state == CWKEYER_IDLE) {
+        int next = cwkeyer_choose(k);
+        if (next >= 0) cwkeyer_start(k, now, next);
+        return;
+    }
+    if (paddles == (CWKEYER_DIT | CWKEYER_DAH) && k->state == CWKEYER_ON) k->squeeze = 1;
+    if (k->p.memory) {
+        // During an element only the other paddle is remembered
+        if (k->state == CWKEYER_ON) pressed &= k->element ? CWKEYER_DIT : CWKEYER_DAH;
+        k->memory |= pressed;
+    }
+}
+
+// ============================================================
+// MIDI PADDLE ADAPTERS
+// ============================================================
+
+// Raw MIDI byte stream -> paddle bits. Note ditNote/dahNote on/off (any
+// channel) press/release the paddles; everything else is skipped.
+typedef struct {
+    uint8_t status;              // Running status
+    uint8_t data[2];
+    int have;
+    int ditNote, dahNote;
+    int paddles;
+} CwMidiPaddle;
+
+static inline void cwmidi_init(CwMidiPaddle *m, int ditNote, int dahNote) {
+    memset(m, 0, sizeof(*m));
+    m->ditNote = ditNote;
+    m->dahNote = dahNote;
+}
+
+// Feed one byte. Returns 1 if the paddle bits changed.
+static inline int cwmidi_byte(CwMidiPaddle *m, uint8_t b) {
+    if (b >= 0xF8) return 0;                       // Real-time, may interleave anything
+    if (b & 0x80) {
+        m->status = b < 0xF0 ? b : 0;              // System messages cancel running status
+        m->have = 0;
+        return 0;
+    }
+    uint8_t type = m->status & 0xF0;
+    if (!m->status) return 0;
+    int need = (type == 0xC0 || type == 0xD0) ? 1 : 2;
+    m->data[m->have++] = b;
+    if (m->have < need) return 0;
+    m->have = 0;
+    if (type != 0x80 && type != 0x90) return 0;
+    int bit = m->data[0] == m->ditNote ? CWKEYER_DIT : m->data[0] == m->dahNote ? CWKEYER_DAH : 0;
+    if (!bit) return 0;
+    int old = m->paddles;
+    if (type == 0x90 && m->data[1] > 0) m->paddles |= bit;
+    else m->paddles &= ~bit;
+    return m->paddles != old;
+}
+
+#endif // CW_KEYER_H
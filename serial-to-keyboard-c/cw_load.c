@@ -0,0 +1,611 @@
+/*
+ * cw_load.c - Scaling test: many emulated CW Hotlines on one host
+ * Opens a pseudo-terminal per device, starts a decoder on each (by default
+ * ./serial_keyboard --no-keys -p <pty>, one process per device) and keys
+ * independent generated traffic into all of them in real time, each device
+ * with its own speed and seed (cw_gen.h). Every word a decoder prints is
+ * matched to the word that was sent and timed from the moment the decoder
+ * had all it needed to print it: when the line revealing the word gap was
+ * written, or when the character timeout ran out. The report gives latency
+ * percentiles overall and per device, and the CPU time each decoder used.
+ *
+ * --ramp doubles the device count from -n until the p99 latency passes
+ * --bound (or words are lost), to find how many devices one host decodes
+ * within it.
+ *
+ * POSIX only (pseudo-terminals, fork/exec).
+ *
+ * Compile: clang -O2 -o cw_load cw_load.c -lm
+ * Run: ./cw_load -n 64 --seconds 30
+ *      ./cw_load -n 16 --ramp 1024 --bound 50 --csv load.csv
+ */
+
+#ifdef __linux__
+    #define _GNU_SOURCE    // glibc hides posix_openpt() and friends otherwise
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <poll.h>
+    #include <signal.h>
+    #include <termios.h>
+    #include <unistd.h>
+    #include <errno.h>
+    #include <sys/resource.h>
+    #include <sys/time.h>
+    #include <sys/wait.h>
+#endif
+
+#include "cw_capture.h"
+#include "cw_gen.h"
+
+#define DEFAULT_COMMAND "./serial_keyboard --no-keys -p {}"
+#define DEFAULT_DEVICES 16
+#define DEFAULT_SECONDS 30
+#define DEFAULT_BOUND_MS 100.0
+#define READY_MARKER "Listening"   // serial_keyboard's last line before decoded text
+#define STARTUP_MS 10000           // For every decoder to open its port
+#define STAGGER_MS 1000            // Devices start spread over this
+#define DRAIN_MS (CHARACTER_TIMEOUT_MS + 1000)
+#define EXIT_WAIT_MS 2000
+#define QUEUE 64                   // Elements generated ahead, per device
+#define PENDING 64                 // Words sent and not yet printed, per device
+
+#ifndef _WIN32
+
+// ============================================================
+// DEVICES
+// ============================================================
+
+typedef struct {
+    char text[40];
+    uint64_t readyUs;           // Word gap written (0 = not yet)
+    uint64_t lastUs;            // Last element written
+} SentWord;
+
+typedef struct {
+    CwArcElement el;
+    int revealsWord;            // First element of a word: the previous one is complete
+} Queued;
+
+typedef struct {
+    char pty[64];
+    int master, out;            // Pty master, decoder's stdout
+    pid_t pid;
+    int state;                  // DEV_*
+    double wpm;
+
+    CwGen gen;
+    Queued queue[QUEUE];
+    int qHead, qCount, nextReveals;
+    uint64_t startUs;
+    char line[32];              // Element line being written
+    int lineLen, lineOff;
+
+    SentWord words[PENDING];
+    int wHead, wCount;
+    char got[64];               // Decoder output: banner line, then the word being printed
+    int gotLen;
+    uint64_t lastOutputUs;
+
+    float *lat;                 // ms, one per word
+    size_t latCount, latCap;
+    unsigned long sent, wrong, lost;
+    double cpuSeconds;
+} Device;
+
+enum { DEV_STARTING, DEV_LISTENING, DEV_DONE, DEV_FAILED };
+
+typedef struct {
+    int devices, seconds;
+    double wpmLo, wpmHi, jitter, bound;
+    uint64_t seed;
+    const char *command;
+    int verbose;
+} LoadParams;
+
+typedef struct {
+    int devices, failed;
+    unsigned long words, wrong, lost;
+    double p50, p90, p99, max;
+    double cpuPerDevice, cpuTotal;   // % of one core
+    double genLagMs;                 // Worst lateness of a write against its due time
+} RoundResult;
+
+static void queueElement(void *ctx, const CwArcElement *e) {
+    Device *d = (Device *)ctx;
+    if (d->qCount == QUEUE) return;  // Longer than any word
+    Queued *q = &d->queue[(d->qHead + d->qCount++) % QUEUE];
+    q->el = *e;
+    q->revealsWord = d->nextReveals;
+    d->nextReveals = 0;
+}
+
+// Key the device's next word into its queue
+static void nextWord(Device *d) {
+    char text[64];
+    cwgen_words(&d->gen, text, 1);
+    if (d->wCount == PENDING) {
+        // The decoder is this far behind: give up on the oldest
+        d->wHead = (d->wHead + 1) % PENDING;
+        d->wCount--;
+        d->lost++;
+    }
+    SentWord *w = &d->words[(d->wHead + d->wCount++) % PENDING];
+    snprintf(w->text, sizeof(w->text), "%.39s", text);
+    w->readyUs = w->lastUs = 0;
+    d->nextReveals = 1;
+    cwgen_text(&d->gen, text);
+    d->sent++;
+}
+
+static void addLatency(Device *d, double ms) {
+    if (d->latCount == d->latCap) {
+        size_t cap = d->latCap ? d->latCap * 2 : 256;
+        float *lat = (float *)realloc(d->lat, cap * sizeof(float));
+        if (!lat) return;
+        d->lat = lat;
+        d->latCap = cap;
+    }
+    d->lat[d->latCount++] = (float)(ms < 0 ? 0 : ms);
+}
+
+// A word came out of the decoder: match it to the oldest one sent
+static void wordDecoded(Device *d, uint64_t nowUs) {
+    d->got[d->gotLen] = '\0';
+    if (!d->wCount) { d->wrong++; d->gotLen = 0; return; }
+    SentWord *w = &d->words[d->wHead];
+    uint64_t ready = w->readyUs ? w->readyUs : w->lastUs + CHARACTER_TIMEOUT_MS * 1000ull;
+    if (w->lastUs) addLatency(d, ((double)nowUs - (double)ready) / 1000.0);
+    if (strcmp(w->text, d->got) != 0) d->wrong++;
+    d->wHead = (d->wHead + 1) % PENDING;
+    d->wCount--;
+    d->gotLen = 0;
+}
+
+static void readOutput(Device *d, uint64_t nowUs) {
+    char buf[4096];
+    ssize_t n = read(d->out, buf, sizeof(buf));
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+        if (d->state != DEV_DONE) d->state = DEV_FAILED;
+        close(d->out);
+        d->out = -1;
+        return;
+    }
+    for (ssize_t i = 0; i < n; i++) {
+        char c = buf[i];
+        if (d->state == DEV_STARTING) {
+            // Banner: wait for the line that comes right before the text
+            if (c == '\n') {
+                d->got[d->gotLen] = '\0';
+                if (strncmp(d->got, READY_MARKER, strlen(READY_MARKER)) == 0) d->state = DEV_LISTENING;
+                d->gotLen = 0;
+            } else if (d->gotLen < (int)sizeof(d->got) - 1) {
+                d->got[d->gotLen++] = c;
+            }
+            continue;
+        }
+        if (d->state != DEV_LISTENING || c == '\r' || c == '\n') continue;
+        d->lastOutputUs = nowUs;
+        if (c == ' ') {
+            if (d->gotLen) wordDecoded(d, nowUs);
+        } else if (d->gotLen < (int)sizeof(d->got) - 1) {
+            d->got[d->gotLen++] = c;
+        }
+    }
+}
+
+// Write the device's due elements. Returns the next due time.
+static uint64_t writeDue(Device *d, uint64_t nowUs, int sending, double *lagMs) {
+    while (1) {
+        if (!d->lineLen) {
+            if (!d->qCount) {
+                if (!sending) return UINT64_MAX;
+                nextWord(d);
+            }
+            Queued *q = &d->queue[d->qHead];
+            uint64_t due = d->startUs + q->el.arrivalMs * 1000ull;
+            if (due > nowUs) return due;
+            double lag = ((double)nowUs - (double)due) / 1000.0;
+            if (lag > *lagMs) *lagMs = lag;
+            d->lineLen = snprintf(d->line, sizeof(d->line), "S,%u,%u\r\n", (unsigned)q->el.pause, (unsigned)q->el.length);
+            d->lineOff = 0;
+        }
+        ssize_t n = write(d->master, d->line + d->lineOff, d->lineLen - d->lineOff);
+        if (n < 0) return nowUs + 1000;  // Decoder not reading: try again shortly
+        d->lineOff += (int)n;
+        if (d->lineOff < d->lineLen) return nowUs + 1000;
+        d->lineLen = 0;
+
+        // Written: this word's latest element, and maybe the previous word's end
+        Queued *q = &d->queue[d->qHead];
+        d->qHead = (d->qHead + 1) % QUEUE;
+        d->qCount--;
+        if (d->wCount) d->words[(d->wHead + d->wCount - 1) % PENDING].lastUs = nowUs;
+        if (q->revealsWord && d->wCount >= 2) {
+            SentWord *prev = &d->words[(d->wHead + d->wCount - 2) % PENDING];
+            if (!prev->readyUs) prev->readyUs = nowUs;
+        }
+    }
+}
+
+// ============================================================
+// PROCESSES
+// ============================================================
+
+static int openPty(Device *d) {
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0) {
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    snprintf(d->pty, sizeof(d->pty), "%s", ptsname(fd));
+    struct termios t;
+    if (tcgetattr(fd, &t) == 0) {
+        cfmakeraw(&t);
+        tcsetattr(fd, TCSANOW, &t);
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    d->master = fd;
+    return 0;
+}
+
+// "{}" in the command becomes the device's pty
+static int startDecoder(Device *d, const char *command) {
+    char cmd[1024];
+    size_t len = snprintf(cmd, sizeof(cmd), "exec ");
+    for (const char *s = command; *s && len < sizeof(cmd) - 1; s++) {
+        if (s[0] == '{' && s[1] == '}') {
+            len += snprintf(cmd + len, sizeof(cmd) - len, "%s", d->pty);
+            s++;
+        } else {
+            cmd[len++] = *s;
+        }
+    }
+    cmd[len < sizeof(cmd) ? len : sizeof(cmd) - 1] = '\0';
+
+    int pipefd[2];
+    if (pipe(pipefd) != 0) return -1;
+    d->pid = fork();
+    if (d->pid < 0) {
+        close(pipefd[0]);
+        close(pipefd[1]);
+        return -1;
+    }
+    if (d->pid == 0) {
+        dup2(pipefd[1], STDOUT_FILENO);
+        dup2(pipefd[1], STDERR_FILENO);
+        close(pipefd[0]);
+        close(pipefd[1]);
+        execl("/bin/sh", "sh", "-c", cmd, (char *)NULL);
+        _exit(127);
+    }
+    close(pipefd[1]);
+    fcntl(pipefd[0], F_SETFL, fcntl(pipefd[0], F_GETFL) | O_NONBLOCK);
+    fcntl(pipefd[0], F_SETFD, FD_CLOEXEC);
+    d->out = pipefd[0];
+    return 0;
+}
+
+// Hang up every port (the decoders see the device go away), then collect
+// each one's CPU time
+static void stopDecoders(Device *devs, int n) {
+    for (int i = 0; i < n; i++) {
+        if (devs[i].master >= 0) close(devs[i].master);
+        devs[i].master = -1;
+    }
+    uint64_t until = cwcap_now_us() + EXIT_WAIT_MS * 1000ull;
+    for (int i = 0; i < n; i++) {
+        Device *d = &devs[i];
+        if (d->pid <= 0) continue;
+        int status;
+        struct rusage ru;
+        pid_t r;
+        while ((r = wait4(d->pid, &status, WNOHANG, &ru)) == 0 && cwcap_now_us() < until) usleep(10000);
+        if (r == 0) {
+            kill(d->pid, SIGTERM);
+            r = wait4(d->pid, &status, 0, &ru);
+        }
+        if (r == d->pid) {
+            d->cpuSeconds = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 + ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+        }
+        d->pid = 0;
+        if (d->out >= 0) close(d->out);
+        d->out = -1;
+    }
+}
+
+// ============================================================
+// ROUND
+// ============================================================
+
+static int byValue(const void *a, const void *b) {
+    float x = *(const float *)a, y = *(const float *)b;
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+static double percentile(const float *sorted, size_t n, double p) {
+    return n ? sorted[(size_t)(p * (n - 1) + 0.5)] : 0;
+}
+
+static void printDeviceHeader(FILE *f, int csv) {
+    if (csv) fprintf(f, "round_devices,device,pty,wpm,words,wrong,lost,p50_ms,p90_ms,p99_ms,max_ms,cpu_pct\n");
+    else printf("%6s %-14s %5s %6s %5s %5s %8s %8s %8s %8s %6s\n", "DEVICE", "PTY", "WPM", "WORDS", "WRONG", "LOST",
+                "P50ms", "P90ms", "P99ms", "MAXms", "CPU%");
+}
+
+static int runRound(const LoadParams *p, RoundResult *res, FILE *csv) {
+    int n = p->devices;
+    memset(res, 0, sizeof(*res));
+    res->devices = n;
+    Device *devs = (Device *)calloc(n, sizeof(Device));
+    struct pollfd *pfd = (struct pollfd *)malloc(sizeof(struct pollfd) * n);
+    int *pfdDev = (int *)malloc(sizeof(int) * n);
+    if (!devs || !pfd || !pfdDev) { printf("[!] Out of memory\n"); return -1; }
+
+    CwGen pick;
+    CwGenParams gp;
+    cwgen_default_params(&gp);
+    gp.seed = p->seed ^ 0x5DEECE66Dull;
+    cwgen_init(&pick, &gp, NULL, NULL);
+    for (int i = 0; i < n; i++) {
+        Device *d = &devs[i];
+        d->master = d->out = -1;
+        d->wpm = p->wpmLo + (p->wpmHi - p->wpmLo) * cwgen_uniform(&pick);
+        cwgen_default_params(&gp);
+        gp.wpm = d->wpm;
+        gp.jitter = p->jitter;
+        gp.seed = p->seed + i;
+        cwgen_init(&d->gen, &gp, queueElement, d);
+        if (openPty(d) != 0 || startDecoder(d, p->command) != 0) {
+            printf("[!] Cannot start device %d (%s)\n", i + 1, errno ? strerror(errno) : "no pseudo-terminal");
+            d->state = DEV_FAILED;
+        }
+    }
+
+    // Every decoder has its port open and is listening
+    uint64_t t0 = cwcap_now_us();
+    while (cwcap_now_us() - t0 < STARTUP_MS * 1000ull) {
+        int k = 0, starting = 0;
+        for (int i = 0; i < n; i++) {
+            if (devs[i].state == DEV_STARTING) starting++;
+            if (devs[i].out < 0) continue;
+            pfd[k].fd = devs[i].out;
+            pfd[k].events = POLLIN;
+            pfdDev[k++] = i;
+        }
+        if (!starting) break;
+        poll(pfd, k, 100);
+        for (int j = 0; j < k; j++) {
+            if (pfd[j].revents) readOutput(&devs[pfdDev[j]], cwcap_now_us());
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        if (devs[i].state == DEV_STARTING) devs[i].state = DEV_FAILED;
+        if (devs[i].state == DEV_FAILED) {
+            res->failed++;
+            if (p->verbose) printf("[!] Device %d (%s): decoder did not start\n", i + 1, devs[i].pty);
+        }
+    }
+    if (p->verbose) printf("[*] %d decoders listening after %.2f s\n", n - res->failed, (cwcap_now_us() - t0) / 1e6);
+
+    // Send until the end of the round, finish the words under way, then
+    // give the last ones time out
+    struct rusage selfBefore, selfAfter;
+    getrusage(RUSAGE_SELF, &selfBefore);
+    uint64_t start = cwcap_now_us(), stop = start + (uint64_t)p->seconds * 1000000u, end = UINT64_MAX;
+    for (int i = 0; i < n; i++) devs[i].startUs = start + (uint64_t)(cwgen_uniform(&pick) * STAGGER_MS * 1000);
+    while (1) {
+        uint64_t now = cwcap_now_us(), next = now + 50000;
+        if (now >= end) break;
+        int sending = now < stop, k = 0, busy = 0;
+        for (int i = 0; i < n; i++) {
+            Device *d = &devs[i];
+            if (d->state != DEV_LISTENING) continue;
+            uint64_t due = writeDue(d, now, sending, &res->genLagMs);
+            if (due < next) next = due;
+            if (due != UINT64_MAX) busy = 1;
+            if (d->out < 0) continue;
+            pfd[k].fd = d->out;
+            pfd[k].events = POLLIN;
+            pfdDev[k++] = i;
+        }
+        if (!sending && !busy && end == UINT64_MAX) end = now + DRAIN_MS * 1000ull;
+        now = cwcap_now_us();
+        int wait = next > now ? (int)((next - now + 999) / 1000) : 0;
+        if (poll(pfd, k, wait) > 0) {
+            now = cwcap_now_us();
+            for (int j = 0; j < k; j++) {
+                if (pfd[j].revents) readOutput(&devs[pfdDev[j]], now);
+            }
+        }
+    }
+    uint64_t finished = cwcap_now_us();
+    getrusage(RUSAGE_SELF, &selfAfter);
+    for (int i = 0; i < n; i++) {
+        // The last word came out on the timeout, without a space after it
+        Device *d = &devs[i];
+        if (d->state == DEV_LISTENING && d->gotLen) wordDecoded(d, d->lastOutputUs);
+        if (d->state == DEV_LISTENING) d->state = DEV_DONE;
+    }
+    stopDecoders(devs, n);
+
+    // Results
+    double seconds = (finished - start) / 1e6;
+    size_t total = 0;
+    for (int i = 0; i < n; i++) total += devs[i].latCount;
+    float *all = (float *)malloc(sizeof(float) * (total ? total : 1));
+    size_t at = 0;
+    if (p->verbose) printDeviceHeader(stdout, 0);
+    for (int i = 0; i < n; i++) {
+        Device *d = &devs[i];
+        if (d->state == DEV_FAILED) continue;
+        d->lost += d->wCount;
+        res->words += d->sent;
+        res->wrong += d->wrong;
+        res->lost += d->lost;
+        res->cpuTotal += 100 * d->cpuSeconds / seconds;
+        qsort(d->lat, d->latCount, sizeof(float), byValue);
+        if (all && d->latCount) memcpy(all + at, d->lat, d->latCount * sizeof(float));
+        at += d->latCount;
+        double dp50 = percentile(d->lat, d->latCount, 0.5), dp90 = percentile(d->lat, d->latCount, 0.9);
+        double dp99 = percentile(d->lat, d->latCount, 0.99), dmax = percentile(d->lat, d->latCount, 1.0);
+        double cpu = 100 * d->cpuSeconds / seconds;
+        if (p->verbose) {
+            printf("%6d %-14.14s %5.1f %6lu %5lu %5lu %8.2f %8.2f %8.2f %8.2f %6.2f\n", i + 1, d->pty, d->wpm, d->sent,
+                   d->wrong, d->lost, dp50, dp90, dp99, dmax, cpu);
+        }
+        if (csv) {
+            fprintf(csv, "%d,%d,%s,%.1f,%lu,%lu,%lu,%.3f,%.3f,%.3f,%.3f,%.3f\n", n, i + 1, d->pty, d->wpm, d->sent,
+                    d->wrong, d->lost, dp50, dp90, dp99, dmax, cpu);
+        }
+    }
+    if (all) {
+        qsort(all, at, sizeof(float), byValue);
+        res->p50 = percentile(all, at, 0.5);
+        res->p90 = percentile(all, at, 0.9);
+        res->p99 = percentile(all, at, 0.99);
+        res->max = percentile(all, at, 1.0);
+    }
+    int running = n - res->failed;
+    res->cpuPerDevice = running ? res->cpuTotal / running : 0;
+    double genCpu = selfAfter.ru_utime.tv_sec - selfBefore.ru_utime.tv_sec + selfAfter.ru_stime.tv_sec -
+                    selfBefore.ru_stime.tv_sec + (selfAfter.ru_utime.tv_usec - selfBefore.ru_utime.tv_usec +
+                    selfAfter.ru_stime.tv_usec - selfBefore.ru_stime.tv_usec) / 1e6;
+    if (p->verbose) printf("[*] Generator: %.1f%% CPU\n", 100 * genCpu / seconds);
+
+    for (int i = 0; i < n; i++) free(devs[i].lat);
+    free(all);
+    free(devs);
+    free(pfd);
+    free(pfdDev);
+    return 0;
+}
+
+static void printRoundHeader(void) {
+    printf("%7s %6s %7s %6s %6s %8s %8s %8s %8s %9s %8s %7s\n", "DEVICES", "FAILED", "WORDS", "WRONG", "LOST",
+           "P50ms", "P90ms", "P99ms", "MAXms", "CPU%/dev", "CPU%all", "LAGms");
+}
+
+static void printRound(const RoundResult *r) {
+    printf("%7d %6d %7lu %6lu %6lu %8.2f %8.2f %8.2f %8.2f %9.3f %8.2f %7.2f\n", r->devices, r->failed, r->words,
+           r->wrong, r->lost, r->p50, r->p90, r->p99, r->max, r->cpuPerDevice, r->cpuTotal, r->genLagMs);
+}
+
+// Two pseudo-terminal fds and a pipe per device
+static void raiseFileLimit(void) {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+}
+
+#endif // !_WIN32
+
+// ============================================================
+// MAIN
+// ============================================================
+
+static void printUsage(const char *progname) {
+    printf("CW Hotline multi-device load generator\n\n");
+    printf("Usage: %s [options]\n\n", progname);
+    printf("Emulates CW Hotlines on pseudo-terminals, runs a decoder on each and measures\n");
+    printf("how long each decoded word takes to come out and the CPU each decoder uses.\n\n");
+    printf("Options:\n");
+    printf("  -n <N>                Devices (default: %d)\n", DEFAULT_DEVICES);
+    printf("  --seconds <N>         Sending time per round (default: %d)\n", DEFAULT_SECONDS);
+    printf("  --cmd <command>       Decoder per device, {} = its port (default: \"%s\")\n", DEFAULT_COMMAND);
+    printf("  --wpm <x> | <lo>-<hi> Device speeds, drawn per device (default: 15-30)\n");
+    printf("  --jitter <x>          Timing std dev as a fraction of each element (default: 0)\n");
+    printf("  --seed <N>            Base seed (default: 1)\n");
+    printf("  --ramp <max>          Double -n each round up to max, until p99 passes --bound\n");
+    printf("  --bound <ms>          p99 latency bound (default: %.0f); exit status 1 past it\n", DEFAULT_BOUND_MS);
+    printf("  --csv <file>          Per-device results of every round\n");
+    printf("  -v                    Per-device table after each round\n");
+}
+
+int main(int argc, char *argv[]) {
+    LoadParams p;
+    p.devices = DEFAULT_DEVICES;
+    p.seconds = DEFAULT_SECONDS;
+    p.wpmLo = 15;
+    p.wpmHi = 30;
+    p.jitter = 0;
+    p.bound = DEFAULT_BOUND_MS;
+    p.seed = 1;
+    p.command = DEFAULT_COMMAND;
+    p.verbose = 0;
+    int ramp = 0;
+    const char *csvPath = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) p.devices = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) p.seconds = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--cmd") == 0 && i + 1 < argc) p.command = argv[++i];
+        else if (strcmp(argv[i], "--wpm") == 0 && i + 1 < argc) {
+            char *end;
+            p.wpmLo = p.wpmHi = strtod(argv[++i], &end);
+            if (*end == '-') p.wpmHi = strtod(end + 1, NULL);
+            if (p.wpmLo < 1 || p.wpmHi < p.wpmLo) {
+                printf("Invalid --wpm '%s' (expected <x> or <lo>-<hi>)\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--jitter") == 0 && i + 1 < argc) p.jitter = atof(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) p.seed = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--ramp") == 0 && i + 1 < argc) ramp = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--bound") == 0 && i + 1 < argc) p.bound = atof(argv[++i]);
+        else if (strcmp(argv[i], "--csv") == 0 && i + 1 < argc) csvPath = argv[++i];
+        else if (strcmp(argv[i], "-v") == 0) p.verbose = 1;
+        else { printUsage(argv[0]); return strcmp(argv[i], "-h") != 0 && strcmp(argv[i], "--help") != 0; }
+    }
+    if (p.devices < 1 || p.seconds < 1) { printUsage(argv[0]); return 1; }
+
+#ifdef _WIN32
+    (void)ramp;
+    (void)csvPath;
+    printf("[!] cw_load needs a POSIX system (pseudo-terminals)\n");
+    return 1;
+#else
+    signal(SIGPIPE, SIG_IGN);
+    raiseFileLimit();
+    FILE *csv = NULL;
+    if (csvPath) {
+        csv = fopen(csvPath, "w");
+        if (!csv) { perror("Error writing CSV"); return 1; }
+        printDeviceHeader(csv, 1);
+    }
+
+    printf("[*] %d s per round at %.0f-%.0f WPM, one decoder per device: %s\n", p.seconds, p.wpmLo, p.wpmHi, p.command);
+    if (!p.verbose) printRoundHeader();
+    int best = 0, rc = 0;
+    for (int n = p.devices; ; n *= 2) {
+        RoundResult r;
+        LoadParams round = p;
+        round.devices = n;
+        if (runRound(&round, &r, csv) != 0) { rc = 1; break; }
+        if (p.verbose) printRoundHeader();
+        printRound(&r);
+        fflush(stdout);
+        int ok = r.failed == 0 && r.lost == 0 && r.p99 <= p.bound;
+        if (!ok) {
+            if (r.failed) printf("[!] %d of %d decoders did not start\n", r.failed, n);
+            else if (r.lost) printf("[!] %lu words never came out of the decoders\n", r.lost);
+            else printf("[!] p99 latency %.2f ms is past the %.0f ms bound\n", r.p99, p.bound);
+            rc = ramp && best ? 0 : 1;  // A ramp ends here by design
+            break;
+        }
+        best = n;
+        if (!ramp || n * 2 > ramp) break;
+    }
+    if (csv && fclose(csv) != 0) { perror("Error writing CSV"); rc = 1; }
+    if (best) printf("[OK] %d devices decoded with p99 latency within %.0f ms\n", best, p.bound);
+    return rc;
+#endif
+}
@@ -0,0 +1,498 @@
+/*
+ * cw_merge.c - One transcript for several CW Hotlines
+ * Decodes several devices at once (both ends of a practice QSO, a class
+ * keying together) and prints a single transcript in the order things were
+ * sent, each line tagged with the device it came from:
+ *
+ *        0.4s  alice  CQ CQ DE K1ABC K1ABC K
+ *        6.9s  bob    K1ABC DE W1AW GM OM
+ *
+ * Every device has its own decoder. A word is stamped with the arrival of
+ * its first element and merged with the others' (cw_merge.h), so words
+ * keyed at the same time interleave by the moment they began, not by when
+ * each decoder got round to finishing them. --delay bounds how long a word
+ * waits for a device that is still in the middle of one.
+ *
+ * Sources are live ports (POSIX) or recorded sessions (captures or
+ * archives), not both, and recordings are merged as fast as they decode.
+ * Captures taken on one host (debug_serial -o) share its monotonic clock
+ * and line up as they were sent; archives only know their own start, so
+ * they are merged as if they had all started together.
+ *
+ * Compile: clang -O2 -o cw_merge cw_merge.c -lpthread -lm
+ * Run: ./cw_merge /dev/ttyUSB0 /dev/ttyUSB1 --names alice,bob -o class.txt
+ *      ./cw_merge alice.cwarc bob.cwarc
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <signal.h>
+
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <poll.h>
+    #include <termios.h>
+    #include <unistd.h>
+    #include <errno.h>
+    #include <sys/stat.h>
+#endif
+
+#include "cw_capture.h"
+#include "cw_batch.h"
+#include "cw_merge.h"
+#include "morse_decoder.h"
+
+#define DEFAULT_BAUD 115200
+#define MAX_DEVICES 64
+#define TICK_MS 20                   // Timeout checks and merging, this often
+#define LINE_WIDTH 64                // Wrap a device's turn after this much text...
+#define TURN_GAP_MS 5000             // ...or start a new line after this long a pause
+
+// ============================================================
+// DEVICES
+// ============================================================
+
+typedef struct {
+    const char *path;
+    char name[16];
+    int index;
+    int fd;                          // Live port, -1 for a recording (or when gone)
+    CwElementList rec;               // Recording
+    size_t next;
+    int done;
+    int gone;                        // The port hung up during the session
+    char line[256];
+    int linePos;
+
+    MorseDecoder decoder;
+    int charDone;                    // The decoder finished a character just now
+    unsigned long charMs;            // Arrival of the first element of the character being keyed
+    char word[CWMERGE_MAX_WORD + 1];
+    int wordLen;
+    unsigned long wordMs;            // ...and of the word
+    unsigned long words;
+} Device;
+
+static CwMerge merge;
+
+static void endWord(Device *d) {
+    if (d->wordLen == 0) return;
+    if (cwmerge_word(&merge, d->index, d->wordMs, d->word, (size_t)d->wordLen) != 0) {
+        printf("[!] Out of memory\n");
+        exit(1);
+    }
+    d->wordLen = 0;
+    d->words++;
+}
+
+static void deviceChar(void *ctx, char c) {
+    Device *d = (Device *)ctx;
+    if (c == ' ' || c == '\n') {
+        endWord(d);
+        return;
+    }
+    d->charDone = 1;
+    if (d->wordLen == CWMERGE_MAX_WORD) endWord(d);   // Not a word: pass it on in pieces
+    if (d->wordLen == 0) d->wordMs = d->charMs;
+    d->word[d->wordLen++] = c;
+}
+
+// One element, arrived at `now` (ms since the start, never 0)
+static void deviceElement(Device *d, int pause, int length, unsigned long now) {
+    MorseDecoder *m = &d->decoder;
+    morseCheckTimeout(m, now);
+    int before = m->elementCount;
+    d->charDone = 0;
+    m->lastActivityTime = now;
+    morseProcessElement(m, pause, length);
+    if (m->elementCount == 1 && (before == 0 || d->charDone)) d->charMs = now;
+}
+
+// Nothing this device finishes from now on can have started before this
+static unsigned long deviceFloor(const Device *d, unsigned long now) {
+    if (d->done) return CWMERGE_DONE;
+    if (d->wordLen > 0) return d->wordMs;
+    if (d->decoder.elementCount > 0) return d->charMs;
+    return now;
+}
+
+// The decoder only ends a word when the next one starts, so a device that
+// has gone quiet (the end of its turn) would hold its last word, and with
+// its floor everyone else's, until it keys again. Once it has been idle
+// longer than the decoder's own word gap, the word is over.
+static void deviceIdle(Device *d, unsigned long now) {
+    const MorseDecoder *m = &d->decoder;
+    if (d->wordLen == 0 || m->elementCount > 0 || m->lastActivityTime == 0) return;
+    unsigned long idle = now - m->lastActivityTime;
+    if (m->lockDeadline) {
+        if (idle < (unsigned long)m->lockWordGap) return;
+    } else if (idle <= (m->dotTiming > 0 ? (unsigned long)(m->dotTiming * m->params.wordGap) : WORD_GAP_TIMEOUT_MS)) {
+        return;
+    }
+    endWord(d);
+}
+
+// The device has nothing more to send: what is pending is complete
+static void deviceFinish(Device *d) {
+    morseCompleteCharacter(&d->decoder);
+    endWord(d);
+    d->done = 1;
+}
+
+// ============================================================
+// TRANSCRIPT
+// ============================================================
+
+typedef struct {
+    Device *devs;
+    int nameWidth;
+    FILE *file;                      // -o, or NULL
+    int device;                      // Device of the line being written, -1 = none
+    unsigned long lastMs;
+    int col;
+} Transcript;
+
+static void out(Transcript *t, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    vprintf(fmt, ap);
+    va_end(ap);
+    if (t->file) {
+        va_start(ap, fmt);
+        vfprintf(t->file, fmt, ap);
+        va_end(ap);
+    }
+}
+
+static void printWord(void *ctx, int device, const CwMergeWord *w) {
+    Transcript *t = (Transcript *)ctx;
+    int len = (int)strlen(w->text);
+    if (device != t->device || w->timeMs - t->lastMs >= TURN_GAP_MS || t->col + 1 + len > LINE_WIDTH) {
+        if (t->device >= 0) out(t, "\n");
+        out(t, "%8.1fs  %-*s  %s", w->timeMs / 1000.0, t->nameWidth, t->devs[device].name, w->text);
+        t->device = device;
+        t->col = len;
+    } else {
+        out(t, " %s", w->text);
+        t->col += 1 + len;
+    }
+    t->lastMs = w->timeMs;
+    fflush(stdout);
+    if (t->file) fflush(t->file);
+}
+
+// ============================================================
+// SOURCES
+// ============================================================
+
+static void mergeTick(Device *devs, int n, unsigned long now) {
+    for (int i = 0; i < n; i++) {
+        if (!devs[i].done) {
+            morseCheckTimeout(&devs[i].decoder, now);
+            deviceIdle(&devs[i], now);
+        }
+        cwmerge_floor(&merge, i, deviceFloor(&devs[i], now));
+    }
+    cwmerge_run(&merge, now, 0);
+}
+
+// Monotonic time of a capture's first chunk; -1 if it isn't a capture
+static int captureStart(const char *path, uint64_t *us) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return -1;
+    static char chunk[CWCAP_MAX_CHUNK];
+    int rc = cwcap_read_header(f, NULL) == 0 && cwcap_read_chunk(f, us, chunk) >= 0 ? 0 : -1;
+    fclose(f);
+    return rc;
+}
+
+// Recordings, on a clock that jumps from one element to the next
+static void runRecordings(Device *devs, int n) {
+    unsigned long now = 1;
+    for (;;) {
+        int active = 0;
+        unsigned long nextMs = CWMERGE_DONE;
+        for (int i = 0; i < n; i++) {
+            Device *d = &devs[i];
+            if (d->done) continue;
+            while (d->next < d->rec.count && d->rec.el[d->next].arrivalMs + 1 <= now) {
+                const CwArcElement *e = &d->rec.el[d->next++];
+                deviceElement(d, (int)e->pause, (int)e->length, (unsigned long)e->arrivalMs + 1);
+            }
+            if (d->next == d->rec.count) {
+                deviceFinish(d);
+                continue;
+            }
+            active = 1;
+            if (d->rec.el[d->next].arrivalMs + 1 < nextMs) nextMs = (unsigned long)d->rec.el[d->next].arrivalMs + 1;
+        }
+        mergeTick(devs, n, now);
+        if (!active) break;
+
+        // Tick through the timeouts while anyone has something pending, else skip ahead
+        int pending = merge.heapLen > 0;
+        for (int i = 0; i < n && !pending; i++) {
+            pending = !devs[i].done && (devs[i].decoder.elementCount > 0 || devs[i].decoder.pendingWordGap || devs[i].wordLen > 0);
+        }
+        now = pending && now + TICK_MS < nextMs ? now + TICK_MS : nextMs;
+    }
+    cwmerge_run(&merge, now, 1);
+}
+
+#ifndef _WIN32
+static volatile sig_atomic_t stopRequested = 0;
+
+static void onSignal(int sig) {
+    (void)sig;
+    stopRequested = 1;
+}
+
+static speed_t baudToSpeed(int baud) {
+    static const struct { int baud; speed_t speed; } table[] = {
+        { 1200, B1200 }, { 2400, B2400 }, { 4800, B4800 }, { 9600, B9600 },
+        { 19200, B19200 }, { 38400, B38400 }, { 57600, B57600 },
+        { 115200, B115200 }, { 230400, B230400 },
+    };
+    for (size_t i = 0; i < sizeof(table) / sizeof(table[0]); i++) {
+        if (table[i].baud == baud) return table[i].speed;
+    }
+    return 0;
+}
+
+static int isPort(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISCHR(st.st_mode);
+}
+
+static int openPort(const char *port, speed_t speed) {
+    int fd = open(port, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd == -1) return -1;
+    struct termios options;
+    if (tcgetattr(fd, &options) != 0) {
+        close(fd);
+        return -1;
+    }
+    cfsetispeed(&options, speed);
+    cfsetospeed(&options, speed);
+    options.c_cflag |= (CLOCAL | CREAD);
+    options.c_cflag &= ~(PARENB | CSTOPB | CSIZE);
+    options.c_cflag |= CS8;
+    options.c_lflag &= ~(ICANON | ECHO | ECHOE | ISIG);
+    options.c_iflag &= ~(IXON | IXOFF | IXANY | INLCR | ICRNL);
+    options.c_oflag &= ~OPOST;
+    options.c_cc[VMIN] = 0;
+    options.c_cc[VTIME] = 0;
+    if (tcsetattr(fd, TCSANOW, &options) != 0) {
+        close(fd);
+        return -1;
+    }
+    tcflush(fd, TCIOFLUSH);
+    return fd;
+}
+
+// Live ports, until Ctrl+C or every device is gone
+static void runPorts(Device *devs, int n) {
+    struct pollfd fds[MAX_DEVICES];
+    uint64_t startUs = cwcap_now_us();
+    int live = n;
+    while (!stopRequested && live > 0) {
+        for (int i = 0; i < n; i++) {
+            fds[i].fd = devs[i].fd;   // Negative: ignored
+            fds[i].events = POLLIN;
+            fds[i].revents = 0;
+        }
+        poll(fds, (nfds_t)n, TICK_MS);
+        unsigned long now = (unsigned long)((cwcap_now_us() - startUs) / 1000) + 1;
+        for (int i = 0; i < n; i++) {
+            Device *d = &devs[i];
+            if (d->fd < 0 || !fds[i].revents) continue;
+            char buf[1024];
+            ssize_t got = read(d->fd, buf, sizeof(buf));
+            if (got < 0 && (errno == EAGAIN || errno == EINTR)) continue;
+            if (got == 0 && !(fds[i].revents & (POLLHUP | POLLERR))) continue;   // VMIN 0: nothing yet
+            if (got <= 0) {
+                d->gone = 1;
+                close(d->fd);
+                d->fd = -1;
+                deviceFinish(d);
+                live--;
+                continue;
+            }
+            for (ssize_t k = 0; k < got; k++) {
+                if (buf[k] != '\r' && buf[k] != '\n') {
+                    if (d->linePos < (int)sizeof(d->line) - 1) d->line[d->linePos++] = buf[k];
+                    continue;
+                }
+                d->line[d->linePos] = '\0';
+                d->linePos = 0;
+                int pauses[16], lengths[16];
+                int count = cwcap_parse_line(d->line, pauses, lengths, 16);
+                for (int e = 0; e < count; e++) deviceElement(d, pauses[e], lengths[e], now);
+            }
+        }
+        mergeTick(devs, n, now);
+    }
+    for (int i = 0; i < n; i++) {
+        if (devs[i].done) continue;
+        deviceFinish(&devs[i]);
+        close(devs[i].fd);
+    }
+    cwmerge_run(&merge, 0, 1);
+}
+#endif
+
+// ============================================================
+// MAIN
+// ============================================================
+
+static void printUsage(const char *progname) {
+    printf("CW Hotline merged transcript\n\n");
+    printf("Usage: %s <port|recording>... [options]\n\n", progname);
+    printf("Options:\n");
+    printf("  -b <baud>           Baud rate of the ports (default: %d)\n", DEFAULT_BAUD);
+    printf("  --names <a,b,...>   Names for the devices, in order (default: from the paths)\n");
+    printf("  --delay <ms>        Longest a word waits for a device still keying one (default: %d)\n",
+           CWMERGE_DEFAULT_DELAY_MS);
+    printf("  --profile <file>    Decoder timing rules for every device (e.g. from cw_tune)\n");
+    printf("  -o <file>           Also write the transcript to <file>\n");
+}
+
+int main(int argc, char *argv[]) {
+    static Device devs[MAX_DEVICES];
+    int n = 0, baud = DEFAULT_BAUD;
+    unsigned long delayMs = CWMERGE_DEFAULT_DELAY_MS;
+    const char *names = NULL, *outPath = NULL;
+    MorseParams params;
+    morseDefaultParams(&params);
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) baud = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--names") == 0 && i + 1 < argc) names = argv[++i];
+        else if (strcmp(argv[i], "--delay") == 0 && i + 1 < argc) delayMs = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) outPath = argv[++i];
+        else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            if (morseLoadProfile(&params, argv[++i]) != 0) {
+                printf("Cannot load profile '%s'\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (argv[i][0] != '-') {
+            if (n == MAX_DEVICES) {
+                printf("[!] At most %d devices\n", MAX_DEVICES);
+                return 1;
+            }
+            devs[n++].path = argv[i];
+        }
+        else { printUsage(argv[0]); return strcmp(argv[i], "-h") != 0 && strcmp(argv[i], "--help") != 0; }
+    }
+    if (n == 0) { printUsage(argv[0]); return 1; }
+
+    // Names: given, or the file name without its directory and extension
+    int nameWidth = 0;
+    for (int i = 0; i < n; i++) {
+        Device *d = &devs[i];
+        const char *name = d->path, *slash = strrchr(name, '/');
+        size_t len;
+        if (names && *names) {
+            name = names;
+            len = strcspn(names, ",");
+            names += len + (names[len] == ',');
+        } else {
+            if (slash) name = slash + 1;
+            const char *dot = strrchr(name, '.');
+            len = dot && dot != name ? (size_t)(dot - name) : strlen(name);
+        }
+        if (len >= sizeof(d->name)) len = sizeof(d->name) - 1;
+        memcpy(d->name, name, len);
+        d->name[len] = '\0';
+        if ((int)len > nameWidth) nameWidth = (int)len;
+
+        d->index = i;
+        d->fd = -1;
+        morseInit(&d->decoder, deviceChar, NULL, d);
+        d->decoder.params = params;
+    }
+
+    Transcript t = { devs, nameWidth, NULL, -1, 0, 0 };
+    if (cwmerge_init(&merge, n, delayMs, printWord, &t) != 0) {
+        printf("[!] Out of memory\n");
+        return 1;
+    }
+
+    int ports = 0;
+#ifndef _WIN32
+    for (int i = 0; i < n; i++) ports += isPort(devs[i].path);
+#endif
+    if (ports > 0 && ports < n) {
+        printf("[!] Give either ports or recorded sessions, not both\n");
+        return 1;
+    }
+    if (ports) {
+#ifndef _WIN32
+        speed_t speed = baudToSpeed(baud);
+        if (!speed) {
+            printf("[!] Unsupported baud rate: %d\n", baud);
+            return 1;
+        }
+        for (int i = 0; i < n; i++) {
+            if ((devs[i].fd = openPort(devs[i].path, speed)) < 0) {
+                printf("[!] Cannot open %s: %s\n", devs[i].path, strerror(errno));
+                return 1;
+            }
+        }
+#else
+        (void)baud;
+#endif
+    } else {
+        uint64_t start[MAX_DEVICES], first = 0;
+        int captures = 0;
+        for (int i = 0; i < n; i++) {
+            if (cwbatch_load(devs[i].path, &devs[i].rec) != 0) {
+                printf("[!] Cannot read %s (expected a port, a capture or an archive)\n", devs[i].path);
+                return 1;
+            }
+            if (captureStart(devs[i].path, &start[i]) == 0) {
+                if (captures++ == 0 || start[i] < first) first = start[i];
+            }
+        }
+        // Captures all: put each where it started on the shared clock
+        for (int i = 0; i < n && captures == n; i++) {
+            uint64_t shift = (start[i] - first) / 1000;
+            for (size_t e = 0; e < devs[i].rec.count; e++) devs[i].rec.el[e].arrivalMs += shift;
+        }
+    }
+    if (outPath && !(t.file = fopen(outPath, "w"))) {
+        perror("Error writing transcript");
+        return 1;
+    }
+
+    fprintf(stderr, "[*] Merging %d %s, words released within %lu ms\n", n, ports ? "ports" : "recordings", delayMs);
+    if (ports) {
+#ifndef _WIN32
+        signal(SIGINT, onSignal);
+        signal(SIGTERM, onSignal);
+        runPorts(devs, n);
+#endif
+    } else {
+        runRecordings(devs, n);
+    }
+    if (t.device >= 0) out(&t, "\n");
+    fflush(stdout);
+
+    int rc = 0;
+    if (t.file && fclose(t.file) != 0) {
+        perror("Error writing transcript");
+        rc = 1;
+    }
+    fprintf(stderr, "[*] %lu words from %d devices", merge.released, n);
+    if (merge.late) fprintf(stderr, ", %lu out of order (held past --delay)", merge.late);
+    fprintf(stderr, "\n");
+    for (int i = 0; i < n; i++) {
+        if (devs[i].gone) fprintf(stderr, "[!] %s hung up during the session\n", devs[i].path);
+        cwbatch_free_list(&devs[i].rec);
+    }
+    cwmerge_free(&merge);
+    return rc;
+}
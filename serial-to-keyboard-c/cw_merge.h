@@ -0,0 +1,168 @@
+/*
+ * cw_merge.h
+ * One transcript from several decoders: the words of every device, merged
+ * in the order they were keyed.
+ *
+ *   cwmerge_word()   a device's finished word, stamped with the arrival of
+ *                    its first element (a device's words come in order)
+ *   cwmerge_floor()  what a device promises: no word it finishes later
+ *                    started before this
+ *   cwmerge_run()    release every word that can no longer be overtaken
+ *
+ * Each device has its own queue; the queue heads sit in a binary min-heap
+ * by time, so releasing a word costs O(log devices). The earliest head is
+ * released once no device can still come up with an earlier word: devices
+ * with words queued are covered by the heap, idle ones by their floors.
+ *
+ * A device stuck in a word (a key held down, a pause mid-word) would hold
+ * everybody up with its floor, so a word that has waited delayMs goes out
+ * regardless. That bounds the latency, and is the only way words can come
+ * out of order (they are counted in `late`).
+ */
+
+#ifndef CW_MERGE_H
+#define CW_MERGE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CWMERGE_MAX_WORD 32
+#define CWMERGE_DEFAULT_DELAY_MS 10000  // A long word at 10 WPM, and its word gap
+#define CWMERGE_DONE ((unsigned long)-1) // Floor of a device that has finished
+
+typedef struct {
+    unsigned long timeMs;
+    char text[CWMERGE_MAX_WORD + 1];
+} CwMergeWord;
+
+typedef struct {
+    CwMergeWord *q;                     // Ring buffer
+    size_t head, count, cap;
+    unsigned long floorMs;
+} CwMergeQueue;
+
+typedef void (*CwMergeFn)(void *ctx, int device, const CwMergeWord *w);
+
+typedef struct {
+    CwMergeQueue *dev;
+    int devices;
+    int *heap;                          // Devices with words queued, by head time
+    int heapLen;
+    unsigned long delayMs;
+    unsigned long lastMs;               // Latest word released so far
+    unsigned long released, late;
+    CwMergeFn onWord;
+    void *ctx;
+} CwMerge;
+
+static inline int cwmerge_init(CwMerge *m, int devices, unsigned long delayMs, CwMergeFn onWord, void *ctx) {
+    memset(m, 0, sizeof(*m));
+    m->dev = (CwMergeQueue *)calloc((size_t)devices, sizeof(CwMergeQueue));
+    m->heap = (int *)malloc((size_t)devices * sizeof(int));
+    if (!m->dev || !m->heap) return -1;
+    m->devices = devices;
+    m->delayMs = delayMs;
+    m->onWord = onWord;
+    m->ctx = ctx;
+    return 0;
+}
+
+static inline void cwmerge_free(CwMerge *m) {
+    for (int i = 0; i < m->devices; i++) free(m->dev[i].q);
+    free(m->dev);
+    free(m->heap);
+    memset(m, 0, sizeof(*m));
+}
+
+static inline const CwMergeWord *cwmerge_head(const CwMerge *m, int d) {
+    return &m->dev[d].q[m->dev[d].head];
+}
+
+// Heap order: head time, then device number (ties stay put)
+static inline int cwmerge_before(const CwMerge *m, int a, int b) {
+    unsigned long ta = cwmerge_head(m, a)->timeMs, tb = cwmerge_head(m, b)->timeMs;
+    return ta < tb || (ta == tb && a < b);
+}
+
+static inline void cwmerge_sift_up(CwMerge *m, int i) {
+    while (i > 0 && cwmerge_before(m, m->heap[i], m->heap[(i - 1) / 2])) {
+        int p = (i - 1) / 2, t = m->heap[i];
+        m->heap[i] = m->heap[p];
+        m->heap[p] = t;
+        i = p;
+    }
+}
+
+static inline void cwmerge_sift_down(CwMerge *m, int i) {
+    for (;;) {
+        int l = 2 * i + 1, r = l + 1, best = i;
+        if (l < m->heapLen && cwmerge_before(m, m->heap[l], m->heap[best])) best = l;
+        if (r < m->heapLen && cwmerge_before(m, m->heap[r], m->heap[best])) best = r;
+        if (best == i) return;
+        int t = m->heap[i];
+        m->heap[i] = m->heap[best];
+        m->heap[best] = t;
+        i = best;
+    }
+}
+
+// Queue a finished word of device d. Returns 0, or -1 if out of memory.
+static inline int cwmerge_word(CwMerge *m, int d, unsigned long timeMs, const char *text, size_t len) {
+    CwMergeQueue *q = &m->dev[d];
+    if (q->count == q->cap) {
+        size_t cap = q->cap ? q->cap * 2 : 64;
+        CwMergeWord *w = (CwMergeWord *)malloc(cap * sizeof(CwMergeWord));
+        if (!w) return -1;
+        for (size_t i = 0; i < q->count; i++) w[i] = q->q[(q->head + i) % q->cap];
+        free(q->q);
+        q->q = w;
+        q->head = 0;
+        q->cap = cap;
+    }
+    CwMergeWord *w = &q->q[(q->head + q->count) % q->cap];
+    if (len > CWMERGE_MAX_WORD) len = CWMERGE_MAX_WORD;
+    w->timeMs = timeMs;
+    memcpy(w->text, text, len);
+    w->text[len] = '\0';
+    if (q->count++ == 0) {
+        m->heap[m->heapLen++] = d;
+        cwmerge_sift_up(m, m->heapLen - 1);
+    }
+    return 0;
+}
+
+static inline void cwmerge_floor(CwMerge *m, int d, unsigned long floorMs) {
+    m->dev[d].floorMs = floorMs;
+}
+
+/*
+ * Release words in time order: every word no device can still overtake,
+ * and any that has waited delayMs by `now`. With `all`, release everything
+ * (the end of the session).
+ */
+static inline void cwmerge_run(CwMerge *m, unsigned long now, int all) {
+    while (m->heapLen > 0) {
+        int d = m->heap[0];
+        const CwMergeWord *w = cwmerge_head(m, d);
+        if (!all && now - w->timeMs < m->delayMs) {
+            int safe = 1;
+            for (int i = 0; i < m->devices && safe; i++) {
+                if (m->dev[i].count == 0 && m->dev[i].floorMs < w->timeMs) safe = 0;
+            }
+            if (!safe) break;
+        }
+
+        if (w->timeMs < m->lastMs) m->late++;
+        else m->lastMs = w->timeMs;
+        m->released++;
+        if (m->onWord) m->onWord(m->ctx, d, w);
+
+        CwMergeQueue *q = &m->dev[d];
+        q->head = (q->head + 1) % q->cap;
+        if (--q->count == 0) m->heap[0] = m->heap[--m->heapLen];
+        cwmerge_sift_down(m, 0);
+    }
+}
+
+#endif // CW_MERGE_H
@@ -0,0 +1,165 @@
+/*
+ * cw_pool.h
+ * Minimal threads + work-stealing task pool for the offline tools.
+ *
+ * cwpool_run() hands tasks 0..count-1 out to N workers. Every worker owns a
+ * deque pre-filled round-robin from the caller's order (pass the biggest
+ * tasks first); it takes work from the front of its own deque and, once that
+ * is empty, steals from the back of the other workers' deques. Tasks are
+ * coarse (a whole session or segment) so a mutex per deque is plenty.
+ *
+ * POSIX threads or Win32 threads.
+ */
+
+#ifndef CW_POOL_H
+#define CW_POOL_H
+
+#include <stdlib.h>
+
+#ifdef _WIN32
+    #include <windows.h>
+    typedef HANDLE cw_thread_t;
+    typedef CRITICAL_SECTION cw_mutex_t;
+    #define cw_mutex_init(m) InitializeCriticalSection(m)
+    #define cw_mutex_destroy(m) DeleteCriticalSection(m)
+    #define cw_mutex_lock(m) EnterCriticalSection(m)
+    #define cw_mutex_unlock(m) LeaveCriticalSection(m)
+    #define CW_THREAD_FN DWORD WINAPI
+    #define CW_THREAD_RETURN return 0
+    typedef DWORD (WINAPI *cw_thread_fn)(void *);
+#else
+    #include <pthread.h>
+    #include <unistd.h>
+    typedef pthread_t cw_thread_t;
+    typedef pthread_mutex_t cw_mutex_t;
+    #define cw_mutex_init(m) pthread_mutex_init(m, NULL)
+    #define cw_mutex_destroy(m) pthread_mutex_destroy(m)
+    #define cw_mutex_lock(m) pthread_mutex_lock(m)
+    #define cw_mutex_unlock(m) pthread_mutex_unlock(m)
+    #define CW_THREAD_FN void *
+    #define CW_THREAD_RETURN return NULL
+    typedef void *(*cw_thread_fn)(void *);
+#endif
+
+// Start fn(arg) on a new thread. Returns 0 on success.
+static inline int cw_thread_start(cw_thread_t *t, cw_thread_fn fn, void *arg) {
+#ifdef _WIN32
+    *t = CreateThread(NULL, 0, fn, arg, 0, NULL);
+    return *t ? 0 : -1;
+#else
+    return pthread_create(t, NULL, fn, arg);
+#endif
+}
+
+static inline void cw_thread_join(cw_thread_t t) {
+#ifdef _WIN32
+    WaitForSingleObject(t, INFINITE);
+    CloseHandle(t);
+#else
+    pthread_join(t, NULL);
+#endif
+}
+
+static inline int cwpool_cpu_count(void) {
+#ifdef _WIN32
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    return si.dwNumberOfProcessors > 0 ? (int)si.dwNumberOfProcessors : 1;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+#endif
+}
+
+// fn runs each task exactly once; worker is 0..workers-1 so callers can keep
+// per-worker state (decoder contexts, scratch buffers) without locking
+typedef void (*CwPoolTaskFn)(void *ctx, int task, int worker);
+
+typedef struct {
+    cw_mutex_t lock;
+    int *tasks;
+    int head, tail;   // Pending tasks are tasks[head..tail)
+} CwPoolDeque;
+
+typedef struct {
+    CwPoolDeque *deques;
+    int workers;
+    CwPoolTaskFn fn;
+    void *ctx;
+} CwPool;
+
+typedef struct {
+    CwPool *pool;
+    int id;
+} CwPoolWorker;
+
+static inline int cwpool_take(CwPoolDeque *q, int fromBack) {
+    int task = -1;
+    cw_mutex_lock(&q->lock);
+    if (q->head < q->tail) task = fromBack ? q->tasks[--q->tail] : q->tasks[q->head++];
+    cw_mutex_unlock(&q->lock);
+    return task;
+}
+
+static inline CW_THREAD_FN cwpool_worker_main(void *arg) {
+    CwPoolWorker *w = (CwPoolWorker *)arg;
+    CwPool *pool = w->pool;
+    for (;;) {
+        int task = cwpool_take(&pool->deques[w->id], 0);
+        // Own deque empty: steal, starting with the next worker over
+        for (int k = 1; task < 0 && k < pool->workers; k++) {
+            task = cwpool_take(&pool->deques[(w->id + k) % pool->workers], 1);
+        }
+        if (task < 0) break;  // Nothing left anywhere (tasks never spawn tasks)
+        pool->fn(pool->ctx, task, w->id);
+    }
+    CW_THREAD_RETURN;
+}
+
+// Run count tasks on `workers` threads (<= 0: one per CPU). order lists task
+// ids in the order to hand them out, or NULL for 0..count-1.
+// Returns 0 once every task has run, or -1 if memory could not be allocated.
+static inline int cwpool_run(int count, int workers, const int *order, CwPoolTaskFn fn, void *ctx) {
+    if (workers <= 0) workers = cwpool_cpu_count();
+    if (workers > count) workers = count > 0 ? count : 1;
+
+    CwPool pool = { NULL, workers, fn, ctx };
+    pool.deques = (CwPoolDeque *)calloc(workers, sizeof(CwPoolDeque));
+    int *taskMem = (int *)malloc(sizeof(int) * (count > 0 ? count : 1));
+    CwPoolWorker *ws = (CwPoolWorker *)calloc(workers, sizeof(CwPoolWorker));
+    cw_thread_t *threads = (cw_thread_t *)calloc(workers, sizeof(cw_thread_t));
+    if (!pool.deques || !taskMem || !ws || !threads) {
+        free(pool.deques); free(taskMem); free(ws); free(threads);
+        return -1;
+    }
+
+    // Deque w gets every workers-th task, laid out contiguously in taskMem
+    int offset = 0;
+    for (int w = 0; w < workers; w++) {
+        CwPoolDeque *q = &pool.deques[w];
+        cw_mutex_init(&q->lock);
+        q->tasks = taskMem + offset;
+        for (int i = w; i < count; i += workers) q->tasks[q->tail++] = order ? order[i] : i;
+        offset += q->tail;
+    }
+
+    // The calling thread is worker 0. If a thread fails to start, the deques
+    // of the missing workers are simply drained by stealing.
+    int started = 0;
+    for (int w = 0; w < workers; w++) {
+        ws[w].pool = &pool;
+        ws[w].id = w;
+    }
+    for (int w = 1; w < workers; w++) {
+        if (cw_thread_start(&threads[w], cwpool_worker_main, &ws[w]) != 0) break;
+        started = w;
+    }
+    cwpool_worker_main(&ws[0]);
+    for (int w = 1; w <= started; w++) cw_thread_join(threads[w]);
+
+    for (int w = 0; w < workers; w++) cw_mutex_destroy(&pool.deques[w].lock);
+    free(pool.deques); free(taskMem); free(ws); free(threads);
+    return 0;
+}
+
+#endif // CW_POOL_H
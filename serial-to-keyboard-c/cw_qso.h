@@ -0,0 +1,733 @@
+/*
+ * cw_qso.h
+ * QSO logging from the decoded stream: callsigns, RST reports, serial
+ * numbers, names and QTHs are picked out as they are decoded, and each
+ * finished QSO is appended to an ADIF or CSV log.
+ *
+ *   cwqso_open()    the log (.adi/.adif: ADIF, anything else: CSV)
+ *   cwqso_char()    every decoded character
+ *   cwqso_tick()    now and then: writes out a batch that has waited long enough
+ *   cwqso_close()   logs the QSO in progress and syncs
+ *
+ * Words are classified by one DFA, compiled at start-up from the patterns
+ * in cwqso_patterns (a small regex subset, through a Thompson NFA and the
+ * subset construction). Each state carries the set of patterns a word
+ * ending there matches ("599" is an RST and a number; context decides),
+ * so a word costs one table lookup per character.
+ *
+ * Which station is which follows the text: a call after DE or CQ is the
+ * one sending, any other is the one addressed. When logging what we send
+ * (the key), the addressed station is the QSO partner and our report,
+ * serial, name and QTH are the sent ones; when logging what we hear
+ * (--audio), it is the other way round.
+ *
+ * Entries are batched and written with one write and an fsync, so a crash
+ * loses at most the last batch. A write cut short leaves a partial entry at
+ * the end of the file; cwqso_open() trims it before appending, but only
+ * from a log it created itself.
+ */
+
+#ifndef CW_QSO_H
+#define CW_QSO_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+    #include <io.h>
+#else
+    #include <unistd.h>
+#endif
+
+#define CWQSO_MAX_WORD 16
+#define CWQSO_MAX_FIELD 48
+#define CWQSO_MAX_NFA 512
+#define CWQSO_BATCH 8                // Entries per write...
+#define CWQSO_BATCH_MS 5000          // ...or as old as this, whichever comes first
+#define CWQSO_QTH_WORDS 3
+#define CWQSO_CSV_FIELDS 13
+
+// What cwqso_open() writes at the top of a new log, and looks for to tell
+// a log of ours from someone else's
+#define CWQSO_ADIF_HEADER "CW Hotline QSO log\n<ADIF_VER:5>3.1.4 <PROGRAMID:15>serial_keyboard <EOH>\n"
+#define CWQSO_CSV_HEADER "qso_date,time_on,time_off,call,station_callsign,rst_sent,rst_rcvd,stx,srx,name,qth,my_name,my_city\n"
+
+// ============================================================
+// WORD CLASSES
+// ============================================================
+
+enum {
+    CWQSO_CALL, CWQSO_RST, CWQSO_NUM, CWQSO_WORD,
+    CWQSO_KW_DE, CWQSO_KW_CQ, CWQSO_KW_NAME, CWQSO_KW_QTH, CWQSO_KW_RST, CWQSO_KW_NR,
+    CWQSO_KW_FILLER, CWQSO_KW_TU, CWQSO_KW_SK, CWQSO_KW_BREAK,
+    CWQSO_CLASSES
+};
+#define CWQSO_KEYWORDS (~((1u << CWQSO_KW_DE) - 1))
+
+/*
+ * Literals, [classes] with ranges, ( | ) and the ? * + operators.
+ * Numbers may be cut (T or O for 0, N for 9), as in "5NN TT7".
+ */
+static const struct { int cls; const char *re; } cwqso_patterns[] = {
+    { CWQSO_CALL, "([A-Z0-9]+/)?([A-Z][A-Z]?|[0-9][A-Z])[0-9]+[A-Z]+(/[A-Z0-9]+)?" },
+    { CWQSO_RST, "[1-5][1-9N][1-9N]" },
+    { CWQSO_NUM, "[0-9TON]*[0-9][0-9TON]*" },
+    { CWQSO_WORD, "[A-Z]+" },
+    { CWQSO_KW_DE, "DE" },
+    { CWQSO_KW_CQ, "CQ|TEST|DX" },
+    { CWQSO_KW_NAME, "NAME|OP" },
+    { CWQSO_KW_QTH, "QTH" },
+    { CWQSO_KW_RST, "RST|UR" },
+    { CWQSO_KW_NR, "NR" },
+    { CWQSO_KW_FILLER, "IS|HR|ES" },
+    { CWQSO_KW_TU, "TU" },
+    { CWQSO_KW_SK, "SK" },
+    { CWQSO_KW_BREAK, "=|\\+|\\(" },    // BT, AR, KN
+};
+
+typedef struct {
+    uint64_t set;       // Symbols leading to next
+    int16_t next;       // -1 = none
+    int16_t eps[2];     // Empty moves, -1 = none
+    int8_t cls;         // Accepting: the class, -1 = not
+} CwQsoNfa;
+
+// ============================================================
+// LOG ENTRY
+// ============================================================
+
+typedef struct {
+    char call[CWQSO_MAX_WORD + 1];      // The station worked
+    char rst[4];
+    char serial[CWQSO_MAX_WORD + 1];
+    char name[CWQSO_MAX_WORD + 1];
+    char qth[CWQSO_MAX_FIELD + 1];
+    time_t timeOn;
+} CwQsoEntry;
+
+enum { CWQSO_EXPECT_NONE, CWQSO_EXPECT_SENDER, CWQSO_EXPECT_NAME, CWQSO_EXPECT_QTH,
+       CWQSO_EXPECT_RST, CWQSO_EXPECT_SERIAL, CWQSO_EXPECT_AFTER_RST };
+
+typedef struct {
+    // Classifier
+    unsigned char sym[128];
+    int symbols;
+    uint16_t *next;      // state x symbol; state 0 is dead, 1 the start
+    uint32_t *classes;   // Per state: 1 << class for every pattern a word ending here matches
+    int states;
+
+    // Stream
+    int state;
+    char word[CWQSO_MAX_WORD + 1];
+    int len;
+    int expect;
+    int qthWords;
+    char lastRst[CWQSO_MAX_WORD + 1];   // As sent, to tell "599 599" from "599 001"
+
+    // What we decode is what we send (1) or what we hear (0)
+    int sent;
+    CwQsoEntry qso;
+    char station[CWQSO_MAX_WORD + 1];   // Our call, once seen
+    char last[CWQSO_MAX_FIELD * 2];     // The entry just logged, for the console
+
+    // Log
+    FILE *f;
+    int adif;
+    char *pending;
+    size_t pendingLen, pendingCap;
+    int pendingCount;
+    unsigned long pendingSince;
+    unsigned logged;
+    long trimmed;        // Bytes of a partial entry cut off the end by cwqso_open()
+    int failed;
+} CwQso;
+
+// ============================================================
+// PATTERN COMPILER
+// ============================================================
+
+typedef struct {
+    CwQso *q;
+    CwQsoNfa *nfa;
+    int count;
+    const char *p;
+    int bad;
+} CwQsoParse;
+
+typedef struct { int start, end; } CwQsoFrag;
+
+static inline int cwqso_node(CwQsoParse *ps) {
+    if (ps->count == CWQSO_MAX_NFA) {
+        ps->bad = 1;
+        return 0;
+    }
+    CwQsoNfa *n = &ps->nfa[ps->count];
+    n->set = 0;
+    n->next = n->eps[0] = n->eps[1] = -1;
+    n->cls = -1;
+    return ps->count++;
+}
+
+static inline void cwqso_eps(CwQsoParse *ps, int from, int to) {
+    CwQsoNfa *n = &ps->nfa[from];
+    if (n->eps[0] < 0) n->eps[0] = (int16_t)to;
+    else n->eps[1] = (int16_t)to;
+}
+
+static inline uint64_t cwqso_symbol(CwQsoParse *ps, char c) {
+    CwQso *q = ps->q;
+    if (!q->sym[(unsigned char)c]) {
+        if (q->symbols == 64) {
+            ps->bad = 1;
+            return 0;
+        }
+        q->sym[(unsigned char)c] = (unsigned char)q->symbols++;
+    }
+    return 1ull << q->sym[(unsigned char)c];
+}
+
+static inline CwQsoFrag cwqso_alt(CwQsoParse *ps);
+
+static inline CwQsoFrag cwqso_atom(CwQsoParse *ps) {
+    CwQsoFrag f;
+    if (*ps->p == '(') {
+        ps->p++;
+        f = cwqso_alt(ps);
+        if (*ps->p == ')') ps->p++;
+        else ps->bad = 1;
+        return f;
+    }
+    f.start = cwqso_node(ps);
+    f.end = cwqso_node(ps);
+    uint64_t set = 0;
+    if (*ps->p == '[') {
+        ps->p++;
+        while (*ps->p && *ps->p != ']') {
+            char lo = *ps->p++, hi = lo;
+            if (ps->p[0] == '-' && ps->p[1] && ps->p[1] != ']') {
+                hi = ps->p[1];
+                ps->p += 2;
+            }
+            for (int c = lo; c <= hi; c++) set |= cwqso_symbol(ps, (char)c);
+        }
+        if (*ps->p == ']') ps->p++;
+        else ps->bad = 1;
+    } else {
+        if (*ps->p == '\\' && ps->p[1]) ps->p++;
+        if (*ps->p) set = cwqso_symbol(ps, *ps->p++);
+        else ps->bad = 1;
+    }
+    ps->nfa[f.start].set = set;
+    ps->nfa[f.start].next = (int16_t)f.end;
+    return f;
+}
+
+static inline CwQsoFrag cwqso_repeat(CwQsoParse *ps) {
+    CwQsoFrag f = cwqso_atom(ps);
+    char op = *ps->p;
+    if (op != '?' && op != '*' && op != '+') return f;
+    ps->p++;
+    CwQsoFrag r = { cwqso_node(ps), cwqso_node(ps) };
+    if (ps->bad) return f;
+    cwqso_eps(ps, r.start, f.start);
+    cwqso_eps(ps, f.end, r.end);
+    if (op != '+') cwqso_eps(ps, r.start, r.end);   // May be skipped
+    if (op != '?') cwqso_eps(ps, f.end, f.start);   // May repeat
+    return r;
+}
+
+static inline CwQsoFrag cwqso_concat(CwQsoParse *ps) {
+    CwQsoFrag f = { -1, -1 };
+    while (*ps->p && *ps->p != '|' && *ps->p != ')' && !ps->bad) {
+        CwQsoFrag g = cwqso_repeat(ps);
+        if (f.start < 0) f = g;
+        else {
+            cwqso_eps(ps, f.end, g.start);
+            f.end = g.end;
+        }
+    }
+    if (f.start < 0) f.start = f.end = cwqso_node(ps);
+    return f;
+}
+
+static inline CwQsoFrag cwqso_alt(CwQsoParse *ps) {
+    CwQsoFrag f = cwqso_concat(ps);
+    while (*ps->p == '|' && !ps->bad) {
+        ps->p++;
+        CwQsoFrag g = cwqso_concat(ps);
+        CwQsoFrag a = { cwqso_node(ps), cwqso_node(ps) };
+        if (ps->bad) break;
+        cwqso_eps(ps, a.start, f.start);
+        cwqso_eps(ps, a.start, g.start);
+        cwqso_eps(ps, f.end, a.end);
+        cwqso_eps(ps, g.end, a.end);
+        f = a;
+    }
+    return f;
+}
+
+#define CWQSO_SET_WORDS (CWQSO_MAX_NFA / 64)
+
+// Add a state and everything reachable from it by empty moves
+static inline void cwqso_closure(const CwQsoNfa *nfa, uint64_t *set, int s) {
+    int stack[CWQSO_MAX_NFA], top = 0;
+    if (set[s / 64] >> (s % 64) & 1) return;
+    set[s / 64] |= 1ull << (s % 64);
+    stack[top++] = s;
+    while (top > 0) {
+        const CwQsoNfa *n = &nfa[stack[--top]];
+        for (int k = 0; k < 2; k++) {
+            int t = n->eps[k];
+            if (t >= 0 && !(set[t / 64] >> (t % 64) & 1)) {
+                set[t / 64] |= 1ull << (t % 64);
+                stack[top++] = t;
+            }
+        }
+    }
+}
+
+// Compile cwqso_patterns into the word DFA. Returns 0, or -1 if out of memory.
+static inline int cwqso_compile(CwQso *q) {
+    CwQsoNfa *nfa = (CwQsoNfa *)malloc(CWQSO_MAX_NFA * sizeof(CwQsoNfa));
+    if (!nfa) return -1;
+    memset(q->sym, 0, sizeof(q->sym));
+    q->symbols = 1;   // Symbol 0: any other character, always dead
+
+    // One NFA: from the start (state 0), a chain of empty moves into every pattern
+    CwQsoParse ps = { q, nfa, 0, NULL, 0 };
+    size_t patterns = sizeof(cwqso_patterns) / sizeof(cwqso_patterns[0]);
+    int at = cwqso_node(&ps);
+    for (size_t i = 0; i < patterns && !ps.bad; i++) {
+        ps.p = cwqso_patterns[i].re;
+        CwQsoFrag f = cwqso_alt(&ps);
+        if (*ps.p) ps.bad = 1;
+        if (ps.bad) break;
+        nfa[f.end].cls = (int8_t)cwqso_patterns[i].cls;
+        cwqso_eps(&ps, at, f.start);
+        if (i + 1 < patterns) {
+            int more = cwqso_node(&ps);
+            cwqso_eps(&ps, at, more);
+            at = more;
+        }
+    }
+    if (ps.bad) {
+        free(nfa);
+        return -1;
+    }
+
+    // Subset construction. DFA state 0 is the empty set (dead), 1 the start.
+    int cap = 64, S = q->symbols;
+    uint64_t *sets = (uint64_t *)calloc((size_t)cap * CWQSO_SET_WORDS, sizeof(uint64_t));
+    q->next = (uint16_t *)calloc((size_t)cap * S, sizeof(uint16_t));
+    q->classes = (uint32_t *)calloc((size_t)cap, sizeof(uint32_t));
+    if (!sets || !q->next || !q->classes) goto fail;
+    cwqso_closure(nfa, sets + CWQSO_SET_WORDS, 0);
+    q->states = 2;
+
+    for (int d = 1; d < q->states; d++) {
+        for (int s = 0; s < ps.count; s++) {
+            if (sets[d * CWQSO_SET_WORDS + s / 64] >> (s % 64) & 1 && nfa[s].cls >= 0)
+                q->classes[d] |= 1u << nfa[s].cls;
+        }
+        for (int a = 1; a < S; a++) {
+            uint64_t to[CWQSO_SET_WORDS] = { 0 };
+            int any = 0;
+            for (int s = 0; s < ps.count; s++) {
+                if (sets[d * CWQSO_SET_WORDS + s / 64] >> (s % 64) & 1 && nfa[s].set >> a & 1) {
+                    cwqso_closure(nfa, to, nfa[s].next);
+                    any = 1;
+                }
+            }
+            if (!any) continue;   // Dead
+            int t = 1;
+            while (t < q->states && memcmp(sets + t * CWQSO_SET_WORDS, to, sizeof(to)) != 0) t++;
+            if (t == q->states) {
+                if (t == 65535) goto fail;
+                if (t == cap) {
+                    cap *= 2;
+                    uint64_t *ns = (uint64_t *)realloc(sets, (size_t)cap * CWQSO_SET_WORDS * sizeof(uint64_t));
+                    if (ns) sets = ns;
+                    uint16_t *nn = (uint16_t *)realloc(q->next, (size_t)cap * S * sizeof(uint16_t));
+                    if (nn) q->next = nn;
+                    uint32_t *nc = (uint32_t *)realloc(q->classes, (size_t)cap * sizeof(uint32_t));
+                    if (nc) q->classes = nc;
+                    if (!ns || !nn || !nc) goto fail;
+                    memset(q->next + (size_t)t * S, 0, (size_t)(cap - t) * S * sizeof(uint16_t));
+                    memset(q->classes + t, 0, (size_t)(cap - t) * sizeof(uint32_t));
+                }
+                memcpy(sets + t * CWQSO_SET_WORDS, to, sizeof(to));
+                q->states++;
+            }
+            q->next[d * S + a] = (uint16_t)t;
+        }
+    }
+    free(sets);
+    free(nfa);
+    q->state = 1;
+    return 0;
+
+fail:
+    free(sets);
+    free(nfa);
+    free(q->next);
+    free(q->classes);
+    q->next = NULL;
+    q->classes = NULL;
+    return -1;
+}
+
+// The classes of a whole word (tests, and callers outside the stream)
+static inline uint32_t cwqso_classify(const CwQso *q, const char *w) {
+    int s = 1;
+    for (; *w && s; w++) {
+        unsigned char c = (unsigned char)*w;
+        s = q->next[s * q->symbols + (c < 128 ? q->sym[c] : 0)];
+    }
+    return q->classes[s];
+}
+
+// ============================================================
+// LOG FILE
+// ============================================================
+
+static inline void cwqso_sync_file(FILE *f) {
+    fflush(f);
+#ifdef _WIN32
+    _commit(_fileno(f));
+#else
+    fsync(fileno(f));
+#endif
+}
+
+// Case-insensitive match of an ADIF tag at s (WSJT-X and others write <eor>)
+static inline int cwqso_tag_at(const char *s, const char *tag) {
+    for (; *tag; s++, tag++) {
+        char c = *s >= 'a' && *s <= 'z' ? (char)(*s - 'a' + 'A') : *s;
+        if (c != *tag) return 0;
+    }
+    return 1;
+}
+
+/*
+ * Open (or create) the log. A new log gets its header. An existing one is
+ * only ever appended to, with one exception: a log that starts with our own
+ * header and ends in a cut-short entry of ours (an ADIF record from
+ * <QSO_DATE: without its <EOR>, a CSV line short of its fields) has that
+ * entry trimmed. A CSV line missing only its newline is kept and the
+ * newline added. Returns 0, -1 if the file can't be used, or -2 if it is
+ * not ours and ends mid-record (it is left as it was).
+ */
+static inline int cwqso_open(CwQso *q, const char *path, int sent) {
+    const char *ext = strrchr(path, '.');
+    char lower[6] = "";
+    for (size_t i = 0; ext && ext[i] && i < sizeof(lower) - 1; i++) {
+        lower[i] = ext[i] >= 'A' && ext[i] <= 'Z' ? (char)(ext[i] - 'A' + 'a') : ext[i];
+        lower[i + 1] = '\0';
+    }
+    q->adif = strcmp(lower, ".adi") == 0 || strcmp(lower, ".adif") == 0;
+    q->sent = sent;
+    q->f = fopen(path, "r+b");
+    if (!q->f) q->f = fopen(path, "w+b");
+    if (!q->f) return -1;
+    const char *header = q->adif ? CWQSO_ADIF_HEADER : CWQSO_CSV_HEADER;
+    long headerLen = (long)strlen(header);
+
+    fseek(q->f, 0, SEEK_END);
+    long size = ftell(q->f), keep = size;
+    char tail[4097];
+    size_t got = 0;
+    if (size > 0) {
+        fseek(q->f, 0, SEEK_SET);
+        got = fread(tail, 1, (size_t)(size < headerLen ? size : headerLen), q->f);
+    }
+    int ours = size > 0 && memcmp(tail, header, got) == 0;
+
+    if (ours && size < headerLen) {
+        keep = 0;   // Even the header was cut short
+    } else if (size > 0) {
+        long from = size > 4096 ? size - 4096 : 0, end = -1;
+        fseek(q->f, from, SEEK_SET);
+        got = fread(tail, 1, (size_t)(size - from), q->f);
+        tail[got] = '\0';
+        for (long i = (long)got - 1; i >= 0 && end < 0; i--) {
+            if (q->adif) {
+                if (i + 5 <= (long)got && (cwqso_tag_at(tail + i, "<EOR>") || cwqso_tag_at(tail + i, "<EOH>")))
+                    end = i + 5;
+            } else if (tail[i] == '\n') {
+                end = i + 1;
+            }
+        }
+        while (end >= 0 && end < (long)got && (tail[end] == '\r' || tail[end] == '\n')) end++;
+        long rest = end < 0 ? 0 : end;
+        while (rest < (long)got && (tail[rest] == ' ' || tail[rest] == '\t' || tail[rest] == '\r' || tail[rest] == '\n')) rest++;
+        if (rest < (long)got) {
+            // Something after the last whole entry
+            int cut = 0;
+            if (ours && end >= 0 && q->adif) {
+                cut = cwqso_tag_at(tail + rest, "<QSO_DATE:");
+            } else if (ours && end >= 0) {
+                int commas = 0;
+                for (long i = rest; i < (long)got; i++) commas += tail[i] == ',';
+                cut = commas < CWQSO_CSV_FIELDS - 1;
+            }
+            if (cut) {
+                keep = from + end;
+            } else if (q->adif) {
+                fclose(q->f);
+                q->f = NULL;
+                return -2;
+            } else {
+                fseek(q->f, 0, SEEK_END);
+                fputc('\n', q->f);   // A whole line without its newline
+            }
+        }
+    }
+    if (keep < size) {
+        fflush(q->f);
+#ifdef _WIN32
+        if (_chsize(_fileno(q->f), keep) != 0) return -1;
+#else
+        if (ftruncate(fileno(q->f), keep) != 0) return -1;
+#endif
+        q->trimmed = size - keep;
+    }
+    fseek(q->f, 0, SEEK_END);
+    if (keep == 0) fputs(header, q->f);
+    cwqso_sync_file(q->f);
+    return ferror(q->f) ? -1 : 0;
+}
+
+// Write out the pending entries. Returns 0, or -1 on a write error.
+static inline int cwqso_sync(CwQso *q) {
+    if (!q->f || q->pendingLen == 0) return q->failed ? -1 : 0;
+    fseek(q->f, 0, SEEK_END);
+    if (fwrite(q->pending, 1, q->pendingLen, q->f) != q->pendingLen) q->failed = 1;
+    cwqso_sync_file(q->f);
+    q->pendingLen = 0;
+    q->pendingCount = 0;
+    return q->failed ? -1 : 0;
+}
+
+static inline void cwqso_put(CwQso *q, const char *s) {
+    size_t n = strlen(s);
+    if (q->pendingLen + n > q->pendingCap) {
+        size_t cap = q->pendingCap ? q->pendingCap * 2 : 4096;
+        while (cap < q->pendingLen + n) cap *= 2;
+        char *p = (char *)realloc(q->pending, cap);
+        if (!p) {
+            q->failed = 1;
+            return;
+        }
+        q->pending = p;
+        q->pendingCap = cap;
+    }
+    memcpy(q->pending + q->pendingLen, s, n);
+    q->pendingLen += n;
+}
+
+static inline void cwqso_field(CwQso *q, const char *tag, const char *value) {
+    if (!*value) return;
+    char buf[CWQSO_MAX_FIELD + 32];
+    snprintf(buf, sizeof(buf), "<%s:%u>%s ", tag, (unsigned)strlen(value), value);
+    cwqso_put(q, buf);
+}
+
+// Queue the QSO in progress, if it has a call, and start the next one
+static inline int cwqso_log(CwQso *q, unsigned long now) {
+    CwQsoEntry *e = &q->qso;
+    int logged = e->call[0] != 0;
+    if (logged && q->f) {
+        char date[9], on[7], off[7];
+        time_t t = time(NULL);
+        strftime(date, sizeof(date), "%Y%m%d", gmtime(&e->timeOn));
+        strftime(on, sizeof(on), "%H%M%S", gmtime(&e->timeOn));
+        strftime(off, sizeof(off), "%H%M%S", gmtime(&t));
+        const char *rs = q->sent ? e->rst : "", *rr = q->sent ? "" : e->rst;
+        const char *stx = q->sent ? e->serial : "", *srx = q->sent ? "" : e->serial;
+        const char *name = q->sent ? "" : e->name, *qth = q->sent ? "" : e->qth;
+        const char *myName = q->sent ? e->name : "", *myQth = q->sent ? e->qth : "";
+        if (q->adif) {
+            cwqso_field(q, "QSO_DATE", date);
+            cwqso_field(q, "TIME_ON", on);
+            cwqso_field(q, "TIME_OFF", off);
+            cwqso_field(q, "CALL", e->call);
+            cwqso_field(q, "MODE", "CW");
+            cwqso_field(q, "STATION_CALLSIGN", q->station);
+            cwqso_field(q, "RST_SENT", rs);
+            cwqso_field(q, "RST_RCVD", rr);
+            cwqso_field(q, "STX", stx);
+            cwqso_field(q, "SRX", srx);
+            cwqso_field(q, "NAME", name);
+            cwqso_field(q, "QTH", qth);
+            cwqso_field(q, "MY_NAME", myName);
+            cwqso_field(q, "MY_CITY", myQth);
+            cwqso_put(q, "<EOR>\n");
+        } else {
+            char line[CWQSO_MAX_FIELD * 6];
+            snprintf(line, sizeof(line), "%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s\n", date, on, off, e->call,
+                     q->station, rs, rr, stx, srx, name, qth, myName, myQth);
+            cwqso_put(q, line);
+        }
+        if (q->pendingCount++ == 0) q->pendingSince = now;
+        q->logged++;
+        if (q->pendingCount >= CWQSO_BATCH) cwqso_sync(q);
+    }
+    if (logged) {
+        snprintf(q->last, sizeof(q->last), "%s%s%s%s%s%s%s%s%s", e->call, *e->rst ? " " : "", e->rst,
+                 *e->serial ? " #" : "", e->serial, *e->name ? " " : "", e->name, *e->qth ? " " : "", e->qth);
+    }
+    memset(e, 0, sizeof(*e));
+    q->expect = CWQSO_EXPECT_NONE;
+    return logged;
+}
+
+// Write out a batch that has waited CWQSO_BATCH_MS
+static inline void cwqso_tick(CwQso *q, unsigned long now) {
+    if (q->pendingCount > 0 && now - q->pendingSince >= CWQSO_BATCH_MS) cwqso_sync(q);
+}
+
+// ============================================================
+// EXTRACTION
+// ============================================================
+
+static inline int cwqso_has_exchange(const CwQsoEntry *e) {
+    return e->rst[0] || e->serial[0] || e->name[0] || e->qth[0];
+}
+
+// Cut numbers to digits: T and O are 0, N is 9
+static inline void cwqso_digits(char *to, const char *from, size_t max) {
+    size_t i = 0;
+    for (; from[i] && i < max; i++) to[i] = from[i] == 'T' || from[i] == 'O' ? '0' : from[i] == 'N' ? '9' : from[i];
+    to[i] = '\0';
+}
+
+// A word of the other station's call. Returns 1 if it ended a logged QSO.
+static inline int cwqso_partner(CwQso *q, const char *w, unsigned long now) {
+    CwQsoEntry *e = &q->qso;
+    int logged = 0;
+    if (strcmp(e->call, w) == 0) return 0;
+    if (e->call[0] && cwqso_has_exchange(e)) logged = cwqso_log(q, now);   // On to the next QSO
+    if (!e->timeOn) e->timeOn = time(NULL);
+    strcpy(e->call, w);   // A first call, or a correction before any exchange
+    return logged;
+}
+
+static inline int cwqso_word(CwQso *q, const char *w, uint32_t cls, unsigned long now) {
+    CwQsoEntry *e = &q->qso;
+    int logged = 0, expect = q->expect;
+    q->expect = CWQSO_EXPECT_NONE;
+
+    if (expect == CWQSO_EXPECT_QTH) {
+        // The QTH runs on until something else comes up, or it repeats
+        const char *first = e->qth;
+        size_t firstLen = strcspn(first, " ");
+        int repeat = q->qthWords > 0 && strlen(w) == firstLen && strncmp(first, w, firstLen) == 0;
+        if ((cls & 1u << CWQSO_WORD) && !(cls & CWQSO_KEYWORDS) && !repeat && q->qthWords < CWQSO_QTH_WORDS &&
+            strlen(e->qth) + strlen(w) + 1 <= CWQSO_MAX_FIELD) {
+            if (q->qthWords++ > 0) strcat(e->qth, " ");
+            strcat(e->qth, w);
+            q->expect = CWQSO_EXPECT_QTH;
+            return 0;
+        }
+        if (repeat) return 0;
+        if (q->qthWords == 0 && (cls & 1u << CWQSO_KW_FILLER)) {
+            q->expect = CWQSO_EXPECT_QTH;   // QTH IS ...
+            return 0;
+        }
+    }
+
+    if (cls & 1u << CWQSO_KW_DE) q->expect = CWQSO_EXPECT_SENDER;
+    else if (cls & 1u << CWQSO_KW_CQ) q->expect = CWQSO_EXPECT_SENDER;
+    else if (cls & 1u << CWQSO_KW_NAME) q->expect = CWQSO_EXPECT_NAME;
+    else if (cls & 1u << CWQSO_KW_QTH) {
+        q->expect = CWQSO_EXPECT_QTH;
+        q->qthWords = 0;
+        e->qth[0] = '\0';
+    }
+    else if (cls & 1u << CWQSO_KW_RST) q->expect = CWQSO_EXPECT_RST;
+    else if (cls & 1u << CWQSO_KW_NR) q->expect = CWQSO_EXPECT_SERIAL;
+    else if (cls & 1u << CWQSO_KW_FILLER) q->expect = expect == CWQSO_EXPECT_AFTER_RST ? CWQSO_EXPECT_NONE : expect;
+    else if (cls & 1u << CWQSO_KW_SK) logged = cwqso_log(q, now);
+    else if (cls & 1u << CWQSO_KW_TU) {
+        if (e->call[0] && e->rst[0]) logged = cwqso_log(q, now);   // Contest: the exchange is done
+    }
+    else if (cls & 1u << CWQSO_KW_BREAK) {
+        // Nothing carries across a BT, AR or KN
+    }
+    else if (cls & 1u << CWQSO_CALL) {
+        // Once seen, our own call is ours wherever it turns up (CQ DE W1AW W1AW)
+        int sender = expect == CWQSO_EXPECT_SENDER;
+        if (sender == q->sent || strcmp(w, q->station) == 0) snprintf(q->station, sizeof(q->station), "%s", w);
+        else logged = cwqso_partner(q, w, now);
+    }
+    else if (expect == CWQSO_EXPECT_NAME && (cls & 1u << CWQSO_WORD)) {
+        if (!e->name[0]) snprintf(e->name, sizeof(e->name), "%s", w);
+    }
+    else if ((cls & 1u << CWQSO_RST) && (expect == CWQSO_EXPECT_RST || (e->call[0] && !e->rst[0]))) {
+        cwqso_digits(e->rst, w, 3);
+        snprintf(q->lastRst, sizeof(q->lastRst), "%s", w);
+        q->expect = CWQSO_EXPECT_AFTER_RST;
+    }
+    else if ((cls & 1u << CWQSO_NUM) &&
+             (expect == CWQSO_EXPECT_SERIAL || (expect == CWQSO_EXPECT_AFTER_RST && strcmp(w, q->lastRst) != 0))) {
+        if (!e->serial[0]) cwqso_digits(e->serial, w, CWQSO_MAX_WORD);
+    }
+    else if (expect == CWQSO_EXPECT_AFTER_RST && strcmp(w, q->lastRst) == 0) {
+        q->expect = CWQSO_EXPECT_AFTER_RST;   // 599 599 001
+    }
+    return logged;
+}
+
+/*
+ * One decoded character. Returns 1 if a QSO was logged (its summary is in
+ * q->last).
+ */
+static inline int cwqso_char(CwQso *q, char c, unsigned long now) {
+    if (c >= 'a' && c <= 'z') c = (char)(c - 'a' + 'A');
+    int brk = c == '=' || c == '+' || c == '(';
+    int logged = 0;
+    if (c == ' ' || c == '\n' || brk) {
+        if (q->len > 0) {
+            q->word[q->len] = '\0';
+            logged |= cwqso_word(q, q->word, q->classes[q->state], now);
+        }
+        q->len = 0;
+        q->state = 1;
+        if (!brk) return logged;
+    }
+    if (q->len < CWQSO_MAX_WORD) {
+        q->word[q->len++] = c;
+        q->state = q->next[q->state * q->symbols + ((unsigned char)c < 128 ? q->sym[(unsigned char)c] : 0)];
+    } else {
+        q->state = 0;   // Too long to be anything
+    }
+    if (brk) {
+        // Prosigns are words of their own
+        q->word[q->len] = '\0';
+        logged |= cwqso_word(q, q->word, q->classes[q->state], now);
+        q->len = 0;
+        q->state = 1;
+    }
+    return logged;
+}
+
+// Log the QSO in progress, write everything out and close. Returns 0 or -1.
+static inline int cwqso_close(CwQso *q, unsigned long now) {
+    cwqso_char(q, ' ', now);
+    cwqso_log(q, now);
+    int rc = cwqso_sync(q);
+    if (q->f && fclose(q->f) != 0) rc = -1;
+    q->f = NULL;
+    free(q->pending);
+    free(q->next);
+    free(q->classes);
+    q->pending = NULL;
+    q->next = NULL;
+    q->classes = NULL;
+    return rc;
+}
+
+#endif // CW_QSO_H
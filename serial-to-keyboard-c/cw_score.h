@@ -0,0 +1,190 @@
+/*
+ * cw_score.h
+ * Decode-and-score against a known transcript: character error rate (edit
+ * distance over the normalized text) and latency (ms from a character's
+ * last element to the decoder emitting it). Shared by cw_tune and cw_bench.
+ *
+ * Decoding runs on a simulated clock that steps from arrival to arrival,
+ * and to the character timeout in between when that fires first, so a
+ * session of any length scores in well under real time.
+ */
+
+#ifndef CW_SCORE_H
+#define CW_SCORE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "cw_archive.h"
+#include "morse_decoder.h"
+
+// Uppercase, newlines as spaces, runs of spaces collapsed, no leading or
+// trailing space: the decoder's output and a transcript compare as equal
+// when they differ only in layout. s must have room for n + 1 chars.
+static inline size_t cwscore_normalize(char *s, size_t n) {
+    size_t out = 0;
+    int space = 1;
+    for (size_t i = 0; i < n; i++) {
+        char c = s[i];
+        if (c == '\n' || c == '\r' || c == '\t') c = ' ';
+        if (c == ' ') {
+            if (!space) s[out++] = ' ';
+            space = 1;
+            continue;
+        }
+        s[out++] = (char)toupper((unsigned char)c);
+        space = 0;
+    }
+    if (out > 0 && s[out - 1] == ' ') out--;
+    s[out] = '\0';
+    return out;
+}
+
+// The transcript next to a session (lesson.cwarc -> lesson.txt), normalized.
+// Returns NULL if there is none; the caller frees it.
+static inline char *cwscore_read_label(const char *sessionPath, size_t *len) {
+    char path[1024];
+    snprintf(path, sizeof(path), "%s", sessionPath);
+    char *dot = strrchr(path, '.');
+    if (dot) *dot = '\0';
+    strncat(path, ".txt", sizeof(path) - strlen(path) - 1);
+
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    rewind(f);
+    char *text = (char *)malloc(size + 1);
+    if (!text || fread(text, 1, size, f) != (size_t)size) {
+        free(text);
+        fclose(f);
+        return NULL;
+    }
+    fclose(f);
+    *len = cwscore_normalize(text, size);
+    return text;
+}
+
+// One per thread: decoder, output text and scratch space
+typedef struct {
+    char *text;
+    size_t len, cap;
+    unsigned long clock;        // Simulated time of the decoder's current step
+    unsigned long lastElement;  // Arrival of the last element processed
+    double latencySum;          // Over characters decoded, in ms
+    unsigned long latencyCount;
+    int *rows;                  // Edit distance band, 2 rows
+    size_t rowsCap;
+    MorseDecoder decoder;
+} CwScorer;
+
+// Returns 0, or -1 if memory could not be allocated
+static inline int cwscore_init(CwScorer *s) {
+    memset(s, 0, sizeof(*s));
+    s->cap = 8192;
+    s->text = (char *)malloc(s->cap);
+    return s->text ? 0 : -1;
+}
+
+static inline void cwscore_free(CwScorer *s) {
+    free(s->text);
+    free(s->rows);
+    memset(s, 0, sizeof(*s));
+}
+
+static inline void cwscore_on_char(void *ctx, char c) {
+    CwScorer *s = (CwScorer *)ctx;
+    if (s->len + 1 >= s->cap) {
+        char *text = (char *)realloc(s->text, s->cap * 2);
+        if (!text) return;
+        s->text = text;
+        s->cap *= 2;
+    }
+    s->text[s->len++] = c;
+    if (c != ' ') {
+        s->latencySum += s->clock - s->lastElement;
+        s->latencyCount++;
+    }
+}
+
+// Decode n elements into s->text (normalized). Latency accumulates across
+// calls; reset latencySum/latencyCount to start a new measurement.
+static inline void cwscore_decode(CwScorer *s, const CwArcElement *el, size_t n, const MorseParams *params) {
+    MorseDecoder *d = &s->decoder;
+    morseInit(d, cwscore_on_char, NULL, s);
+    if (params) d->params = *params;
+    s->len = 0;
+    s->lastElement = 0;
+    for (size_t i = 0; i < n; i++) {
+        // +1 keeps arrival 0 distinct from "no activity yet"
+        unsigned long now = (unsigned long)el[i].arrivalMs + 1;
+        long due = morseUntilTimeout(d, d->lastActivityTime);
+        if (due >= 0 && now - d->lastActivityTime >= (unsigned long)due) {
+            s->clock = d->lastActivityTime + due;
+            morseCheckTimeout(d, s->clock);
+        }
+        s->clock = now;
+        d->lastActivityTime = now;
+        morseProcessElement(d, (int)el[i].pause, (int)el[i].length);
+        if (el[i].length >= (uint32_t)d->params.minPulse) s->lastElement = now;
+    }
+    s->clock = s->lastElement + (d->lockDeadline ? d->lockDeadline : CHARACTER_TIMEOUT_MS + 1);
+    morseCompleteCharacter(d);
+    s->len = cwscore_normalize(s->text, s->len);
+}
+
+// Edit distance between a and b, or max + 1 if it is larger than max.
+// Only a diagonal band of width 2*max+1 is computed.
+static inline long cwscore_distance(CwScorer *s, const char *a, long n, const char *b, long m, long max) {
+    if (labs(n - m) > max) return max + 1;
+    long width = 2 * max + 1;
+    if ((size_t)(2 * width + 2) > s->rowsCap) {
+        int *rows = (int *)realloc(s->rows, sizeof(int) * (2 * width + 2));
+        if (!rows) return max + 1;
+        s->rows = rows;
+        s->rowsCap = 2 * width + 2;
+    }
+    // Row i, column j lives at index j - i + max; out-of-band cells are max + 1
+    int *prev = s->rows, *cur = s->rows + width + 1;
+    int inf = (int)max + 1;
+    for (long k = 0; k < width; k++) {
+        long j = k - max;
+        prev[k] = (j >= 0 && j <= m) ? (int)j : inf;
+    }
+    for (long i = 1; i <= n; i++) {
+        int best = inf;
+        for (long k = 0; k < width; k++) {
+            long j = i + k - max;
+            if (j < 0 || j > m) { cur[k] = inf; continue; }
+            int v;
+            if (j == 0) {
+                v = (int)i;
+            } else {
+                v = prev[k] + (a[i - 1] != b[j - 1]);                 // (i-1, j-1)
+                if (k + 1 < width && prev[k + 1] + 1 < v) v = prev[k + 1] + 1;  // (i-1, j)
+                if (k > 0 && cur[k - 1] + 1 < v) v = cur[k - 1] + 1;         // (i, j-1)
+            }
+            cur[k] = v > inf ? inf : v;
+            if (cur[k] < best) best = cur[k];
+        }
+        if (best >= inf) return max + 1;
+        int *t = prev; prev = cur; cur = t;
+    }
+    int d = prev[m - n + max];
+    return d > max ? max + 1 : d;
+}
+
+// Errors in the last decode against label, widening the band only as far as
+// needed. Returns cap + 1 if there are more than cap.
+static inline long cwscore_errors(CwScorer *s, const char *label, size_t labelLen, long cap) {
+    long max = cap < 16 ? cap : 16, dist;
+    for (;;) {
+        dist = cwscore_distance(s, s->text, (long)s->len, label, (long)labelLen, max);
+        if (dist <= max || max >= cap) return dist;
+        max = max * 4 < cap ? max * 4 : cap;
+    }
+}
+
+#endif // CW_SCORE_H
@@ -0,0 +1,227 @@
+/*
+ * cw_sidetone.h
+ * Local sidetone: every element the decoder sees is played back as a
+ * keyed tone, for operators who have turned the device speaker off
+ * (--speaker-off) but still want to hear their sending.
+ *
+ *   cwside_open()     16-bit mono PCM to stdout ("-"), a pipe into an audio
+ *                     player ("|cmd"), a WAV file (*.wav) or a raw file
+ *   cwside_element()  one pause/length element -> silence + shaped tone
+ *   cwside_advance()  keep the stream fed with silence between elements
+ *
+ * The oscillator is a phase accumulator into a precomputed sine table, and
+ * the key-down/key-up edges follow a precomputed raised-cosine table, so
+ * rendering is a table lookup per sample (a multiply on the edges only).
+ *
+ * The stream runs latencyMs ahead of the clock it is given: that much
+ * silence is always queued in the player, so it never underruns between
+ * polls, and a tone starts at most latencyMs after the device reports it.
+ */
+
+#ifndef CW_SIDETONE_H
+#define CW_SIDETONE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef _WIN32
+    #include <io.h>
+    #include <fcntl.h>
+    #define popen _popen
+    #define pclose _pclose
+#else
+    #include <signal.h>
+#endif
+
+#define CWSIDE_DEFAULT_RATE 48000
+#define CWSIDE_DEFAULT_FREQ 600
+#define CWSIDE_DEFAULT_LATENCY_MS 150
+#define CWSIDE_RISE_MS 5            // Raised-cosine edge: no key clicks
+#define CWSIDE_AMPLITUDE 0.5        // -6 dBFS
+#define CWSIDE_TABLE_BITS 11
+#define CWSIDE_TABLE (1 << CWSIDE_TABLE_BITS)
+#define CWSIDE_MAX_RISE 1024        // Edge samples (CWSIDE_RISE_MS at up to ~200 kHz)
+#define CWSIDE_BUF_SAMPLES 2048
+
+enum { CWSIDE_RAW, CWSIDE_WAV, CWSIDE_PIPE };
+
+typedef struct {
+    FILE *f;
+    int kind;                       // CWSIDE_RAW/WAV/PIPE
+    int ownsFile;
+    int error;                      // A write failed (e.g. the player quit)
+    int sampleRate;
+    double freq;
+    unsigned long latencyMs;
+
+    int16_t sine[CWSIDE_TABLE];     // One period at CWSIDE_AMPLITUDE
+    int16_t rise[CWSIDE_MAX_RISE];  // Edge envelope, Q15
+    int riseLen;
+    uint32_t phase, step;           // Oscillator: table index in the top bits
+
+    unsigned long startMs;          // Clock time of sample 0
+    int started;
+    uint64_t written;               // Samples rendered so far
+    uint64_t toneEnd;               // Sample after the last tone (0 = none yet)
+    unsigned long tones;
+
+    uint8_t buf[CWSIDE_BUF_SAMPLES * 2];
+    size_t bufLen;
+} CwSidetone;
+
+static inline void cwside_put32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); p[2] = (uint8_t)(v >> 16); p[3] = (uint8_t)(v >> 24);
+}
+
+// 44-byte PCM header. Streams can't be patched afterwards, so the sizes
+// start at the maximum, which players read as "until end of file".
+static inline void cwside_wav_header(uint8_t h[44], int sampleRate, uint32_t dataBytes) {
+    memcpy(h, "RIFF", 4);
+    cwside_put32(h + 4, dataBytes > 0xFFFFFFFFu - 36 ? 0xFFFFFFFFu : dataBytes + 36);
+    memcpy(h + 8, "WAVEfmt ", 8);
+    cwside_put32(h + 16, 16);
+    cwside_put32(h + 20, 1 | 1u << 16);                  // PCM, mono
+    cwside_put32(h + 24, (uint32_t)sampleRate);
+    cwside_put32(h + 28, (uint32_t)sampleRate * 2);
+    cwside_put32(h + 32, 2 | 16u << 16);                 // Block align, bits
+    memcpy(h + 36, "data", 4);
+    cwside_put32(h + 40, dataBytes);
+}
+
+// Open the output and build the tables. Returns 0, or -1 if the output
+// can't be opened (or the rate is out of range).
+static inline int cwside_open(CwSidetone *s, const char *path, int sampleRate, double freq,
+                              unsigned long latencyMs) {
+    memset(s, 0, sizeof(*s));
+    if (sampleRate < 8000 || sampleRate > 192000 || freq <= 0 || freq >= sampleRate / 2) return -1;
+    s->sampleRate = sampleRate;
+    s->freq = freq;
+    s->latencyMs = latencyMs;
+
+    size_t len = strlen(path);
+    if (strcmp(path, "-") == 0) {
+        s->f = stdout;
+#ifdef _WIN32
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    } else if (path[0] == '|') {
+#ifdef _WIN32
+        s->f = popen(path + 1, "wb");
+#else
+        signal(SIGPIPE, SIG_IGN);   // Player quitting is a write error, not death
+        s->f = popen(path + 1, "w");
+#endif
+        s->kind = CWSIDE_PIPE;
+    } else {
+        s->f = fopen(path, "wb");
+        if (len > 4 && (strcmp(path + len - 4, ".wav") == 0 || strcmp(path + len - 4, ".WAV") == 0))
+            s->kind = CWSIDE_WAV;
+    }
+    if (!s->f) return -1;
+    s->ownsFile = s->f != stdout;
+
+    for (int i = 0; i < CWSIDE_TABLE; i++)
+        s->sine[i] = (int16_t)lrint(32767.0 * CWSIDE_AMPLITUDE * sin(6.283185307179586 * i / CWSIDE_TABLE));
+    s->riseLen = sampleRate * CWSIDE_RISE_MS / 1000;
+    if (s->riseLen > CWSIDE_MAX_RISE) s->riseLen = CWSIDE_MAX_RISE;
+    for (int i = 0; i < s->riseLen; i++)
+        s->rise[i] = (int16_t)lrint(32767.0 * (0.5 - 0.5 * cos(3.141592653589793 * (i + 0.5) / s->riseLen)));
+    s->step = (uint32_t)(freq / sampleRate * 4294967296.0);
+
+    if (s->kind == CWSIDE_WAV) {
+        uint8_t h[44];
+        cwside_wav_header(h, sampleRate, 0xFFFFFFFFu);
+        if (fwrite(h, 1, sizeof(h), s->f) != sizeof(h)) s->error = 1;
+    }
+    return 0;
+}
+
+static inline void cwside_flush(CwSidetone *s) {
+    if (s->bufLen && !s->error && fwrite(s->buf, 1, s->bufLen, s->f) != s->bufLen) s->error = 1;
+    s->bufLen = 0;
+    if (!s->error && s->kind != CWSIDE_WAV && fflush(s->f) != 0) s->error = 1;
+}
+
+static inline void cwside_sample(CwSidetone *s, int16_t v) {
+    s->buf[s->bufLen++] = (uint8_t)v;
+    s->buf[s->bufLen++] = (uint8_t)((uint16_t)v >> 8);
+    if (s->bufLen == sizeof(s->buf)) {
+        if (!s->error && fwrite(s->buf, 1, s->bufLen, s->f) != s->bufLen) s->error = 1;
+        s->bufLen = 0;
+    }
+    s->written++;
+}
+
+static inline void cwside_silence(CwSidetone *s, uint64_t n) {
+    while (n--) cwside_sample(s, 0);
+}
+
+// n samples of tone, phase starting at zero, edges shaped by the rise table
+// (shortened for elements under two rise times)
+static inline void cwside_tone(CwSidetone *s, uint64_t n) {
+    uint64_t edge = (uint64_t)s->riseLen;
+    if (edge > n / 2) edge = n / 2;
+    s->phase = 0;
+    for (uint64_t i = 0; i < n; i++) {
+        int32_t v = s->sine[s->phase >> (32 - CWSIDE_TABLE_BITS)];
+        s->phase += s->step;
+        if (i < edge) v = v * s->rise[i * s->riseLen / edge] >> 15;
+        else if (i >= n - edge) v = v * s->rise[(n - 1 - i) * s->riseLen / edge] >> 15;
+        cwside_sample(s, (int16_t)v);
+    }
+}
+
+static inline uint64_t cwside_samples(const CwSidetone *s, unsigned long ms) {
+    return (uint64_t)ms * (uint64_t)s->sampleRate / 1000;
+}
+
+// Fill with silence up to latencyMs past nowMs. Call at least every
+// latencyMs while the stream is live.
+static inline void cwside_advance(CwSidetone *s, unsigned long nowMs) {
+    if (!s->started) {
+        s->started = 1;
+        s->startMs = nowMs;
+    }
+    uint64_t target = cwside_samples(s, nowMs - s->startMs + s->latencyMs);
+    if (s->written < target) cwside_silence(s, target - s->written);
+    cwside_flush(s);
+}
+
+// An element reported at nowMs: pause ms of silence, then length ms of key
+// down. It starts as soon as the queued silence allows, but never closer to
+// the previous tone than its pause, so elements that arrive in a burst
+// (a fast replay, decoded audio) keep their rhythm.
+static inline void cwside_element(CwSidetone *s, unsigned long nowMs, unsigned long pause, unsigned long length) {
+    cwside_advance(s, nowMs);
+    uint64_t start = s->toneEnd ? s->toneEnd + cwside_samples(s, pause) : s->written;
+    if (start > s->written) cwside_silence(s, start - s->written);
+    cwside_tone(s, cwside_samples(s, length));
+    s->toneEnd = s->written;
+    s->tones++;
+    cwside_flush(s);
+}
+
+// Flush, fix up the WAV sizes where the output can seek, and close.
+// Returns 0, or -1 if anything failed to write.
+static inline int cwside_close(CwSidetone *s) {
+    if (!s->f) return -1;
+    cwside_flush(s);
+    if (s->kind == CWSIDE_WAV && !s->error && fflush(s->f) == 0 && fseek(s->f, 0, SEEK_SET) == 0) {
+        uint64_t bytes = s->written * 2;
+        uint8_t h[44];
+        cwside_wav_header(h, s->sampleRate, bytes > 0xFFFFFFFFu ? 0xFFFFFFFFu : (uint32_t)bytes);
+        if (fwrite(h, 1, sizeof(h), s->f) != sizeof(h)) s->error = 1;
+    }
+    if (s->ownsFile) {
+        int rc = s->kind == CWSIDE_PIPE ? pclose(s->f) : fclose(s->f);
+        if (rc != 0) s->error = 1;
+    } else if (fflush(s->f) != 0) {
+        s->error = 1;
+    }
+    s->f = NULL;
+    return s->error ? -1 : 0;
+}
+
+#endif // CW_SIDETONE_H
@@ -0,0 +1,497 @@
+/*
+ * cw_skimmer.c - Multi-signal CW skimmer
+ * Finds every CW signal in a receiver passband (3 kHz of audio, or a wider
+ * I/Q stream), follows each carrier with its own keying detector and
+ * decoder, and prints frequency-tagged text as it is decoded.
+ *
+ * The audio is cut into batches of about a second. For each batch:
+ *   1. short-time FFT rows (Hann window, one row per 4 ms) on all cores
+ *   2. carrier detection on the long-term spectrum (sequential, cheap)
+ *   3. every carrier's keying + decoder over the batch, one task per carrier
+ *   4. finished lines printed in frequency order
+ * Each carrier is only ever touched by one task at a time, and the output
+ * is the same for any number of threads.
+ *
+ * Compile: clang -O2 -o cw_skimmer cw_skimmer.c -lm
+ * Run: ./cw_skimmer band.wav
+ *      rtl_fm -M usb -f 7.025M -s 8k - | ./cw_skimmer - --dial 7025000
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cw_audio.h"
+#include "cw_capture.h"
+#include "cw_pool.h"
+#include "morse_decoder.h"
+
+#define SKIM_HOP_MS CWTONE_BLOCK_MS   // One FFT row per keying block
+#define SKIM_BIN_HZ 50                // FFT bins at most this wide
+#define SKIM_BATCH_ROWS 256           // Rows per batch (~1 s)
+#define SKIM_MAX_CHANNELS 128
+#define SKIM_DETECT_DB 10.0           // Carrier: long-term bin power this far above the median
+#define SKIM_SPACING_HZ 80            // Closer peaks are one signal
+#define SKIM_AVG_MS 1000              // Long-term spectrum time constant
+#define SKIM_LINE 64                  // Print a channel's text in lines this long...
+#define SKIM_FLUSH_MS 3000            // ...or once it has been idle this long
+#define SKIM_EXPIRE_MS 30000          // Drop a silent carrier after this
+
+// ============================================================
+// FFT
+// ============================================================
+
+typedef struct {
+    int n, bits;
+    float *cosT, *sinT;               // Twiddles, n/2 each
+    int *rev;                         // Bit reversal
+    float *window;                    // Hann, n
+} Fft;
+
+static int fftInit(Fft *f, int n) {
+    memset(f, 0, sizeof(*f));
+    f->n = n;
+    while ((1 << f->bits) < n) f->bits++;
+    f->cosT = (float *)malloc(sizeof(float) * n / 2);
+    f->sinT = (float *)malloc(sizeof(float) * n / 2);
+    f->rev = (int *)malloc(sizeof(int) * n);
+    f->window = (float *)malloc(sizeof(float) * n);
+    if (!f->cosT || !f->sinT || !f->rev || !f->window) return -1;
+    for (int i = 0; i < n / 2; i++) {
+        f->cosT[i] = (float)cos(6.283185307179586 * i / n);
+        f->sinT[i] = (float)-sin(6.283185307179586 * i / n);
+    }
+    for (int i = 0; i < n; i++) {
+        int r = 0;
+        for (int b = 0; b < f->bits; b++) if (i & (1 << b)) r |= 1 << (f->bits - 1 - b);
+        f->rev[i] = r;
+        f->window[i] = (float)(0.5 - 0.5 * cos(6.283185307179586 * i / n));
+    }
+    return 0;
+}
+
+static void fftFree(Fft *f) {
+    free(f->cosT); free(f->sinT); free(f->rev); free(f->window);
+}
+
+// In-place radix-2 complex FFT of re/im (already bit-reversed)
+static void fftRun(const Fft *f, float *re, float *im) {
+    for (int len = 2; len <= f->n; len <<= 1) {
+        int half = len / 2, step = f->n / len;
+        for (int i = 0; i < f->n; i += len) {
+            for (int k = 0; k < half; k++) {
+                float wr = f->cosT[k * step], wi = f->sinT[k * step];
+                float *ar = re + i + k, *ai = im + i + k;
+                float br = ar[half] * wr - ai[half] * wi;
+                float bi = ar[half] * wi + ai[half] * wr;
+                ar[half] = *ar - br;
+                ai[half] = *ai - bi;
+                *ar += br;
+                *ai += bi;
+            }
+        }
+    }
+}
+
+// ============================================================
+// CHANNELS
+// ============================================================
+
+typedef struct {
+    int bin;                          // FFT bin being keyed
+    double freq;                      // Hz (interpolated)
+    CwKeying key;
+    MorseDecoder decoder;
+    unsigned long lastElementMs;      // Stream time of the last element (or of detection)
+    char *text;                       // Decoded, not yet printed
+    size_t len, cap;
+    unsigned long lineMs;             // Stream time the pending text started
+    unsigned long chars;              // Characters decoded in total
+    int active;
+    int backfill;                     // New: key the previous batch first
+} Channel;
+
+typedef struct {
+    CwAudioSource audio;
+    int iq;
+    int sampleRate, hop;
+    Fft fft;
+    int lo, hi;                       // Bin range searched (IQ: may be negative)
+    int bins;                         // hi - lo + 1
+    float *samples, *qsamples;        // n - hop of history + one batch
+    int rows;                         // Rows in the current batch
+    uint64_t row0;                    // Stream row index of the batch's first row
+    float *spectrum;                  // rows x bins, power
+    float *previous;                  // The batch before, prevRows x bins
+    int prevRows;
+    float *avg;                       // bins, long-term power
+    float **scratch;                  // Per worker: re + im, 2n
+    Channel channels[SKIM_MAX_CHANNELS];
+    int channelCount;
+    MorseParams params;
+    double dial;
+    unsigned long carriers;           // Channels ever opened
+} Skimmer;
+
+static double binHz(const Skimmer *s, double bin) {
+    return bin * s->sampleRate / s->fft.n;
+}
+
+// Stream time of FFT row `row`, in ms (the same clock as the keying)
+static unsigned long rowMs(const Skimmer *s, uint64_t row) {
+    return (unsigned long)(row * (uint64_t)s->hop * 1000 / (uint64_t)s->sampleRate);
+}
+
+static void channelChar(void *ctx, char c) {
+    Channel *ch = (Channel *)ctx;
+    if (c == ' ' && (ch->len == 0 || ch->text[ch->len - 1] == ' ')) return;
+    if (ch->len + 1 >= ch->cap) {
+        size_t cap = ch->cap ? ch->cap * 2 : 256;
+        char *text = (char *)realloc(ch->text, cap);
+        if (!text) return;
+        ch->text = text;
+        ch->cap = cap;
+    }
+    if (ch->len == 0) ch->lineMs = ch->lastElementMs;
+    ch->text[ch->len++] = c;
+    if (c != ' ') ch->chars++;
+}
+
+static void channelElement(void *ctx, const CwArcElement *e) {
+    Channel *ch = (Channel *)ctx;
+    MorseDecoder *d = &ch->decoder;
+    // +1 keeps stream time 0 distinct from "no activity yet"
+    unsigned long now = (unsigned long)e->arrivalMs + 1;
+    morseCheckTimeout(d, now);
+    d->lastActivityTime = now;
+    ch->lastElementMs = (unsigned long)e->arrivalMs;
+    morseProcessElement(d, (int)e->pause, (int)e->length);
+}
+
+static void channelOpen(Skimmer *s, int bin) {
+    Channel *ch = &s->channels[s->channelCount++];
+    memset(ch, 0, sizeof(*ch));
+    ch->bin = bin;
+    ch->freq = binHz(s, bin);
+    ch->active = 1;
+    cwkey_init(&ch->key, s->sampleRate, s->hop, channelElement, ch);
+    // A carrier is only seen once it has built up in the long-term spectrum:
+    // start from the batch before so its first characters are not lost
+    cwkey_start(&ch->key, s->row0 - s->prevRows);
+    ch->backfill = s->prevRows > 0;
+    morseInit(&ch->decoder, channelChar, NULL, ch);
+    ch->decoder.params = s->params;
+    ch->lastElementMs = cwkey_now(&ch->key);
+    s->carriers++;
+}
+
+// Print pending text: whole lines always; the rest too if `all`
+static void channelPrint(Skimmer *s, Channel *ch, int all) {
+    while (ch->len > 0 && (all || ch->len >= SKIM_LINE)) {
+        size_t n = ch->len;
+        if (n > SKIM_LINE) {
+            n = SKIM_LINE;
+            while (n > SKIM_LINE / 2 && ch->text[n] != ' ') n--;   // Break at a word
+        }
+        size_t shown = n;
+        while (shown > 0 && ch->text[shown - 1] == ' ') shown--;
+        if (shown > 0) {
+            printf("%8.1fs %10.1f Hz  %.*s\n", ch->lineMs / 1000.0, s->dial + ch->freq, (int)shown, ch->text);
+        }
+        while (n < ch->len && ch->text[n] == ' ') n++;
+        memmove(ch->text, ch->text + n, ch->len - n);
+        ch->len -= n;
+        ch->lineMs = ch->lastElementMs;
+    }
+}
+
+// ============================================================
+// PIPELINE
+// ============================================================
+
+// Pool task: FFT rows task, task + workers, ...
+typedef struct {
+    Skimmer *s;
+    int workers;
+} RowJob;
+
+static void fftRows(void *ctx, int task, int worker) {
+    RowJob *job = (RowJob *)ctx;
+    Skimmer *s = job->s;
+    const Fft *f = &s->fft;
+    float *re = s->scratch[worker], *im = re + f->n;
+    for (int r = task; r < s->rows; r += job->workers) {
+        const float *x = s->samples + (size_t)r * s->hop;
+        const float *q = s->iq ? s->qsamples + (size_t)r * s->hop : NULL;
+        for (int i = 0; i < f->n; i++) {
+            re[f->rev[i]] = x[i] * f->window[i];
+            im[f->rev[i]] = q ? q[i] * f->window[i] : 0.0f;
+        }
+        fftRun(f, re, im);
+        float *out = s->spectrum + (size_t)r * s->bins;
+        for (int b = 0; b < s->bins; b++) {
+            int k = (s->lo + b + f->n) % f->n;
+            out[b] = re[k] * re[k] + im[k] * im[k];
+        }
+    }
+}
+
+static void keyRows(Channel *ch, int b, const float *spectrum, int rows, int bins) {
+    for (int r = 0; r < rows; r++) {
+        const float *row = spectrum + (size_t)r * bins;
+        // A tone between two bins splits across them: add the stronger side
+        float side = 0;
+        if (b > 0) side = row[b - 1];
+        if (b + 1 < bins && row[b + 1] > side) side = row[b + 1];
+        cwkey_block(&ch->key, row[b] + side);
+        morseCheckTimeout(&ch->decoder, cwkey_now(&ch->key) + 1);
+    }
+}
+
+// Pool task: one carrier over the whole batch
+static void decodeChannel(void *ctx, int task, int worker) {
+    Skimmer *s = (Skimmer *)ctx;
+    Channel *ch = &s->channels[task];
+    (void)worker;
+    int b = ch->bin - s->lo;
+    if (ch->backfill) keyRows(ch, b, s->previous, s->prevRows, s->bins);
+    ch->backfill = 0;
+    keyRows(ch, b, s->spectrum, s->rows, s->bins);
+}
+
+static int cmpFloat(const void *a, const void *b) {
+    float x = *(const float *)a, y = *(const float *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Long-term spectrum -> open channels on new carriers, re-center or drop old ones
+static void detectCarriers(Skimmer *s, double minSnrDb, float *sorted) {
+    float alpha = (float)SKIM_HOP_MS / SKIM_AVG_MS;
+    for (int r = 0; r < s->rows; r++) {
+        const float *row = s->spectrum + (size_t)r * s->bins;
+        for (int b = 0; b < s->bins; b++) s->avg[b] += (row[b] - s->avg[b]) * alpha;
+    }
+    memcpy(sorted, s->avg, sizeof(float) * s->bins);
+    qsort(sorted, s->bins, sizeof(float), cmpFloat);
+    float floor = sorted[s->bins / 2];
+    float threshold = floor * (float)pow(10.0, minSnrDb / 10.0);
+    int spacing = (int)(SKIM_SPACING_HZ * s->fft.n / s->sampleRate) + 1;
+    unsigned long nowMs = rowMs(s, s->row0);
+
+    // Existing carriers: follow a drift of one bin while key-up; drop if gone
+    for (int c = 0; c < s->channelCount; c++) {
+        Channel *ch = &s->channels[c];
+        int b = ch->bin - s->lo;
+        if (!ch->key.keyDown) {
+            if (b > 0 && s->avg[b - 1] > s->avg[b] * CWTONE_TRACK_HYST) ch->bin--;
+            else if (b + 1 < s->bins && s->avg[b + 1] > s->avg[b] * CWTONE_TRACK_HYST) ch->bin++;
+        }
+        b = ch->bin - s->lo;
+        if (b > 0 && b + 1 < s->bins) {
+            // Parabolic peak interpolation for the displayed frequency
+            double l = s->avg[b - 1], m = s->avg[b], r = s->avg[b + 1];
+            double den = l - 2 * m + r;
+            double delta = (den < 0) ? 0.5 * (l - r) / den : 0.0;
+            ch->freq = binHz(s, ch->bin + delta);
+        }
+        if (s->avg[b] < threshold && nowMs - ch->lastElementMs > SKIM_EXPIRE_MS) ch->active = 0;
+    }
+
+    // New carriers: local maxima above threshold, strongest first
+    for (;;) {
+        int best = -1;
+        for (int b = 1; b + 1 < s->bins; b++) {
+            if (s->avg[b] < threshold || s->avg[b] < s->avg[b - 1] || s->avg[b] < s->avg[b + 1]) continue;
+            if (best >= 0 && s->avg[b] <= s->avg[best]) continue;
+            int taken = 0;
+            for (int c = 0; c < s->channelCount && !taken; c++) {
+                taken = abs(s->channels[c].bin - s->lo - b) <= spacing;
+            }
+            if (!taken) best = b;
+        }
+        if (best < 0 || s->channelCount >= SKIM_MAX_CHANNELS) break;
+        channelOpen(s, best + s->lo);
+    }
+}
+
+static int cmpChannel(const void *a, const void *b) {
+    const Channel *x = (const Channel *)a, *y = (const Channel *)b;
+    return x->bin - y->bin;
+}
+
+// Print what is ready, close expired channels, keep frequency order
+static void printBatch(Skimmer *s) {
+    unsigned long nowMs = rowMs(s, s->row0);
+    int kept = 0;
+    for (int c = 0; c < s->channelCount; c++) {
+        Channel *ch = &s->channels[c];
+        int idle = nowMs - ch->lastElementMs > SKIM_FLUSH_MS;
+        if (!ch->active) morseCompleteCharacter(&ch->decoder);
+        channelPrint(s, ch, idle || !ch->active);
+        if (!ch->active) {
+            free(ch->text);
+            continue;
+        }
+        if (kept != c) s->channels[kept] = *ch;
+        kept++;
+    }
+    s->channelCount = kept;
+    qsort(s->channels, s->channelCount, sizeof(Channel), cmpChannel);
+    // Channels moved: the keying and decoder callbacks point back at them
+    for (int c = 0; c < s->channelCount; c++) {
+        s->channels[c].key.ctx = &s->channels[c];
+        s->channels[c].decoder.ctx = &s->channels[c];
+    }
+    fflush(stdout);
+}
+
+// ============================================================
+// MAIN
+// ============================================================
+
+static void printUsage(const char *progname) {
+    printf("CW Hotline multi-signal skimmer\n\n");
+    printf("Usage: %s <audio.wav|-> [options]\n\n", progname);
+    printf("Options:\n");
+    printf("  --audio-rate <Hz>   Sample rate of raw s16le PCM (default: %d)\n", CWAUDIO_DEFAULT_RATE);
+    printf("  --iq                Input is I/Q: stereo WAV, or interleaved raw I,Q\n");
+    printf("  --band <lo>-<hi>    Audio Hz to search (default: 200-3200; I/Q: whole passband)\n");
+    printf("  --dial <Hz>         Add the receiver's dial frequency to printed frequencies\n");
+    printf("  --min-snr <dB>      Carrier detection threshold (default: %.0f)\n", SKIM_DETECT_DB);
+    printf("  --profile <file>    Decoder timing rules (e.g. from cw_tune)\n");
+    printf("  -j <N>              Worker threads (default: one per CPU)\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *path = NULL;
+    int rawRate = 0, workers = 0, haveBand = 0;
+    double bandLo = 200, bandHi = 3200, minSnr = SKIM_DETECT_DB;
+    static Skimmer s;
+    morseDefaultParams(&s.params);
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--audio-rate") == 0 && i + 1 < argc) rawRate = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--iq") == 0) s.iq = 1;
+        else if (strcmp(argv[i], "--band") == 0 && i + 1 < argc) {
+            const char *band = argv[++i];
+            if (sscanf(band, "%lf-%lf", &bandLo, &bandHi) != 2 || bandHi <= bandLo) {
+                printf("Invalid --band '%s' (expected <lo>-<hi> in Hz)\n", band);
+                return 1;
+            }
+            haveBand = 1;
+        }
+        else if (strcmp(argv[i], "--dial") == 0 && i + 1 < argc) s.dial = atof(argv[++i]);
+        else if (strcmp(argv[i], "--min-snr") == 0 && i + 1 < argc) minSnr = atof(argv[++i]);
+        else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            if (morseLoadProfile(&s.params, argv[++i]) != 0) {
+                printf("Cannot load profile '%s'\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) workers = atoi(argv[++i]);
+        else if (argv[i][0] != '-' || strcmp(argv[i], "-") == 0) path = argv[i];
+        else { printUsage(argv[0]); return strcmp(argv[i], "-h") != 0 && strcmp(argv[i], "--help") != 0; }
+    }
+    if (!path) { printUsage(argv[0]); return 1; }
+    if (workers <= 0) workers = cwpool_cpu_count();
+
+    if (cwaudio_open(&s.audio, path, rawRate) != 0) {
+        printf("[!] Cannot read audio from %s (WAV: PCM or float only)\n", path);
+        return 1;
+    }
+    if (s.iq && s.audio.raw) s.audio.channels = 2;
+    if (s.iq && s.audio.channels != 2) {
+        printf("[!] --iq needs 2 channels (I and Q), %s has %d\n", path, s.audio.channels);
+        return 1;
+    }
+
+    s.sampleRate = s.audio.sampleRate;
+    s.hop = s.sampleRate * SKIM_HOP_MS / 1000;
+    int n = 64;
+    while (n < s.sampleRate / SKIM_BIN_HZ) n <<= 1;
+    if (fftInit(&s.fft, n) != 0) { printf("[!] Out of memory\n"); return 1; }
+
+    double nyquist = s.sampleRate / 2.0;
+    if (!haveBand) {
+        bandLo = s.iq ? -nyquist : 200;
+        bandHi = s.iq ? nyquist : 3200;
+    }
+    if (bandHi > nyquist) bandHi = nyquist;
+    if (bandLo < (s.iq ? -nyquist : 0)) bandLo = s.iq ? -nyquist : 0;
+    s.lo = (int)(bandLo * n / s.sampleRate);
+    s.hi = (int)(bandHi * n / s.sampleRate);
+    if (s.hi >= (s.iq ? n / 2 : n / 2 + 1)) s.hi = s.iq ? n / 2 - 1 : n / 2;
+    if (s.lo > s.hi - 2) { printf("[!] Band %.0f-%.0f Hz is empty\n", bandLo, bandHi); return 1; }
+    s.bins = s.hi - s.lo + 1;
+
+    size_t span = (size_t)(n - s.hop) + (size_t)SKIM_BATCH_ROWS * s.hop;
+    s.samples = (float *)calloc(span, sizeof(float));
+    s.qsamples = (float *)calloc(span, sizeof(float));
+    s.spectrum = (float *)malloc(sizeof(float) * SKIM_BATCH_ROWS * s.bins);
+    s.previous = (float *)malloc(sizeof(float) * SKIM_BATCH_ROWS * s.bins);
+    s.avg = (float *)calloc(s.bins, sizeof(float));
+    float *sorted = (float *)malloc(sizeof(float) * s.bins);
+    s.scratch = (float **)calloc(workers, sizeof(float *));
+    if (!s.samples || !s.qsamples || !s.spectrum || !s.previous || !s.avg || !sorted || !s.scratch) { printf("[!] Out of memory\n"); return 1; }
+    for (int w = 0; w < workers; w++) {
+        s.scratch[w] = (float *)malloc(sizeof(float) * 2 * n);
+        if (!s.scratch[w]) { printf("[!] Out of memory\n"); return 1; }
+    }
+
+    fprintf(stderr, "[*] %s: %d Hz%s, searching %.0f to %.0f Hz in %.1f Hz bins, %d threads\n",
+            strcmp(path, "-") == 0 ? "stdin" : path, s.sampleRate, s.iq ? " I/Q" : "",
+            binHz(&s, s.lo), binHz(&s, s.hi), binHz(&s, 1), workers);
+
+    unsigned long startMs = (unsigned long)(cwcap_now_us() / 1000);
+    size_t history = (size_t)(n - s.hop);
+    RowJob job = { &s, workers };
+    for (;;) {
+        // Read one batch after the history, then transform it
+        size_t want = (size_t)SKIM_BATCH_ROWS * s.hop, got = 0, step;
+        while (got < want) {
+            if (s.iq) step = cwaudio_read_iq(&s.audio, s.samples + history + got, s.qsamples + history + got, want - got);
+            else step = cwaudio_read(&s.audio, s.samples + history + got, want - got);
+            if (step == 0) break;
+            got += step;
+        }
+        s.rows = (int)(got / s.hop);
+        if (s.rows == 0) break;
+
+        int rowTasks = workers < s.rows ? workers : s.rows;
+        job.workers = rowTasks;
+        if (cwpool_run(rowTasks, workers, NULL, fftRows, &job) != 0) { printf("[!] Out of memory\n"); return 1; }
+        detectCarriers(&s, minSnr, sorted);
+        if (s.channelCount > 0 && cwpool_run(s.channelCount, workers, NULL, decodeChannel, &s) != 0) {
+            printf("[!] Out of memory\n");
+            return 1;
+        }
+        s.row0 += s.rows;
+        printBatch(&s);
+        float *t = s.previous; s.previous = s.spectrum; s.spectrum = t;
+        s.prevRows = s.rows;
+
+        size_t used = (size_t)s.rows * s.hop;
+        memmove(s.samples, s.samples + used, sizeof(float) * history);
+        memmove(s.qsamples, s.qsamples + used, sizeof(float) * history);
+        if (got < want) break;
+    }
+
+    // End of the audio: everything pending is complete
+    for (int c = 0; c < s.channelCount; c++) {
+        cwkey_finish(&s.channels[c].key);
+        morseCompleteCharacter(&s.channels[c].decoder);
+        s.channels[c].active = 0;
+    }
+    printBatch(&s);
+
+    unsigned long elapsedMs = (unsigned long)(cwcap_now_us() / 1000) - startMs;
+    double audioSec = (double)s.row0 * s.hop / s.sampleRate;
+    fprintf(stderr, "[*] %lu carriers in %.1f s of audio, decoded in %.2f s (%.0fx real time)\n",
+            s.carriers, audioSec, elapsedMs / 1000.0, elapsedMs ? audioSec * 1000.0 / elapsedMs : 0.0);
+
+    cwaudio_close(&s.audio);
+    fftFree(&s.fft);
+    for (int w = 0; w < workers; w++) free(s.scratch[w]);
+    free(s.scratch); free(s.samples); free(s.qsamples); free(s.spectrum); free(s.previous); free(s.avg); free(sorted);
+    return 0;
+}
@@ -0,0 +1,374 @@
+/*
+ * cw_timeline.h
+ * Live timeline of what the decoder saw and decided, for coaching: each
+ * element is drawn to scale (one column = a fixed number of ms) and colored
+ * by how it was classified, each gap is marked with the decision it caused,
+ * and the decoded characters sit under the elements they came from.
+ *
+ *   cwtl_keying()    an element as the device reported it (before decoding)
+ *   cwtl_element()   ...and how the decoder classified it
+ *   cwtl_char()      a decoded character
+ *   cwtl_render()    bring the screen up to date (rate-limited)
+ *
+ * The screen is a grid of cells kept twice: what it should show and what
+ * it shows. A frame rewrites only the cells that differ, with ANSI cursor
+ * addressing, so a new element costs a few dozen bytes of output. When the
+ * last band fills, the history scrolls up by one band.
+ */
+
+#ifndef CW_TIMELINE_H
+#define CW_TIMELINE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "morse_decoder.h"
+
+#define CWTL_MAX_ROWS 96
+#define CWTL_MAX_COLS 320
+#define CWTL_TOP 4                  // Title, thresholds, legend, blank
+#define CWTL_BAND 4                 // Pulses, gap decisions, text, blank
+#define CWTL_DEFAULT_SCALE 20       // ms per column: a 20 WPM dit is 3 columns
+#define CWTL_FRAME_MS 50            // Redraw at most 20x per second
+#define CWTL_MAX_GAP_DITS 10        // Longer pauses are cut short ("~")
+#define CWTL_NEAR 0.15              // Gaps this close to a threshold are flagged
+
+// Pens (SGR sequences)
+enum {
+    CWTL_PEN_PLAIN, CWTL_PEN_DIT, CWTL_PEN_DAH, CWTL_PEN_UNSURE, CWTL_PEN_NOISE,
+    CWTL_PEN_GAP, CWTL_PEN_WORD, CWTL_PEN_DIM, CWTL_PEN_BOLD, CWTL_PEN_BAD
+};
+static const char *const cwtl_pens[] = {
+    "\x1b[0m", "\x1b[0;32m", "\x1b[0;36m", "\x1b[0;33m", "\x1b[0;31m",
+    "\x1b[0;37m", "\x1b[0;35m", "\x1b[0;2m", "\x1b[0;1m", "\x1b[0;1;31m"
+};
+
+// Glyphs: ASCII as is, these above it (UTF-8)
+enum { CWTL_G_FULL = 128, CWTL_G_SHADE, CWTL_G_LOW, CWTL_G_BAR, CWTL_G_DBAR, CWTL_G_LINE, CWTL_G_DOT };
+static const char *const cwtl_glyphs[] = {
+    "\xe2\x96\x88", "\xe2\x96\x93", "\xe2\x96\x81", "\xe2\x94\x82", "\xe2\x95\x91", "\xe2\x94\x80", "\xc2\xb7"
+};
+
+enum { CWTL_GAP_START, CWTL_GAP_INTRA, CWTL_GAP_CHAR, CWTL_GAP_WORD };
+
+typedef struct {
+    uint8_t glyph;
+    uint8_t pen;
+} CwTlCell;
+
+typedef struct {
+    FILE *out;
+    int rows, cols;                 // Screen area in use
+    int bands;                      // Bands that fit under the header
+    double scale;                   // ms per column
+
+    CwTlCell want[CWTL_MAX_ROWS][CWTL_MAX_COLS];
+    CwTlCell shown[CWTL_MAX_ROWS][CWTL_MAX_COLS];
+    int started;                    // Screen cleared and cursor hidden
+    int dirty;
+    unsigned long lastFrameMs;
+
+    int band, col;                  // Where the next element goes
+    int charBand, charCol;          // First element of the current character (-1 = scrolled off)
+    int charElements;               // Elements in it so far
+    int charText;                   // A character was placed for it
+
+    // Element reported but not yet classified, with the timings it met
+    int pending;
+    int pause, length, gap;
+    int dit, dah, tolerance;
+
+    unsigned long elements, noise, unsure, chars, unknown;
+
+    char buf[8192];
+    size_t len;
+} CwTimeline;
+
+static inline void cwtl_clear_rows(CwTimeline *t, int from, int count) {
+    for (int r = from; r < from + count && r < t->rows; r++) {
+        for (int c = 0; c < t->cols; c++) {
+            t->want[r][c].glyph = ' ';
+            t->want[r][c].pen = CWTL_PEN_PLAIN;
+        }
+    }
+}
+
+// rows/cols: terminal size. scale: ms per column (<= 0 = default).
+static inline void cwtl_init(CwTimeline *t, FILE *out, int rows, int cols, double scale) {
+    memset(t, 0, sizeof(*t));
+    t->out = out;
+    t->rows = rows > CWTL_MAX_ROWS ? CWTL_MAX_ROWS : rows;
+    t->cols = cols > CWTL_MAX_COLS ? CWTL_MAX_COLS : cols;
+    if (t->cols < 20) t->cols = 20;
+    // The last terminal row is left free for the cursor
+    t->bands = (t->rows - 1 - CWTL_TOP) / CWTL_BAND;
+    if (t->bands < 1) t->bands = 1;
+    if (t->rows < CWTL_TOP + t->bands * CWTL_BAND + 1) t->rows = CWTL_TOP + t->bands * CWTL_BAND + 1;
+    if (t->rows > CWTL_MAX_ROWS) {
+        t->rows = CWTL_MAX_ROWS;
+        t->bands = (t->rows - 1 - CWTL_TOP) / CWTL_BAND;
+    }
+    t->scale = scale > 0 ? scale : CWTL_DEFAULT_SCALE;
+    cwtl_clear_rows(t, 0, t->rows);
+    memcpy(t->shown, t->want, sizeof(t->shown));
+    t->charBand = -1;
+}
+
+static inline void cwtl_put(CwTimeline *t, int row, int col, int glyph, int pen) {
+    if (row < 0 || row >= t->rows || col < 0 || col >= t->cols) return;
+    t->want[row][col].glyph = (uint8_t)glyph;
+    t->want[row][col].pen = (uint8_t)pen;
+    t->dirty = 1;
+}
+
+// Write text at row/col; returns the column after it
+static inline int cwtl_text(CwTimeline *t, int row, int col, int pen, const char *s) {
+    for (; *s && col < t->cols; s++) cwtl_put(t, row, col++, (unsigned char)*s < 128 ? *s : '?', pen);
+    return col;
+}
+
+// Blank the rest of a row from col
+static inline void cwtl_erase(CwTimeline *t, int row, int col) {
+    while (col < t->cols) cwtl_put(t, row, col++, ' ', CWTL_PEN_PLAIN);
+}
+
+static inline int cwtl_row(int band, int line) {
+    return CWTL_TOP + band * CWTL_BAND + line;
+}
+
+// Move to the start of the next band, scrolling the history up if full
+static inline void cwtl_next_band(CwTimeline *t) {
+    t->col = 0;
+    if (t->band + 1 < t->bands) {
+        t->band++;
+        return;
+    }
+    int first = cwtl_row(0, 0), rest = (t->bands - 1) * CWTL_BAND;
+    memmove(&t->want[first], &t->want[first + CWTL_BAND], (size_t)rest * sizeof(t->want[0]));
+    cwtl_clear_rows(t, first + rest, CWTL_BAND);
+    if (t->charBand >= 0) t->charBand--;
+    t->dirty = 1;
+}
+
+static inline int cwtl_cols(const CwTimeline *t, int ms) {
+    int n = (int)(ms / t->scale + 0.5);
+    return n < 0 ? 0 : n;
+}
+
+// Gap classification from the decoder's thresholds as they stand before the
+// element; morseProcessElement decides for itself and has the last word
+static inline int cwtl_gap_kind(const MorseDecoder *d, int pause) {
+    if (d->lockDeadline) {
+        // Contest mode: fixed thresholds, reached at >=
+        if (d->stats.elements == 0) return CWTL_GAP_START;
+        if (pause < d->lockCharGap) return CWTL_GAP_INTRA;
+        return pause >= d->lockWordGap ? CWTL_GAP_WORD : CWTL_GAP_CHAR;
+    }
+    if (d->dotTiming == -1) return CWTL_GAP_START;
+    if (d->dotTiming > 0 && pause > d->dotTiming * d->params.charGap)
+        return pause > d->dotTiming * d->params.wordGap ? CWTL_GAP_WORD : CWTL_GAP_CHAR;
+    return CWTL_GAP_INTRA;
+}
+
+// 1 if pause is within CWTL_NEAR of a gap threshold (a coin-flip decision)
+static inline int cwtl_gap_near(const MorseDecoder *d, int dit, int pause) {
+    double c = d->lockCharGap, w = d->lockWordGap;
+    if (!d->lockDeadline) {
+        if (dit <= 0) return 0;
+        c = dit * d->params.charGap;
+        w = dit * d->params.wordGap;
+    }
+    return (pause > c * (1 - CWTL_NEAR) && pause < c * (1 + CWTL_NEAR)) ||
+           (pause > w * (1 - CWTL_NEAR) && pause < w * (1 + CWTL_NEAR));
+}
+
+// Draw the pause in front of an element and the element itself, and move
+// past them. Returns the element's column.
+static inline int cwtl_draw(CwTimeline *t, int pause, int length, int gap, int near, int glyph, int pen) {
+    int gapCols = gap == CWTL_GAP_START ? (t->col ? 2 : 0) : cwtl_cols(t, pause);
+    int cap = t->dit > 0 ? cwtl_cols(t, t->dit * CWTL_MAX_GAP_DITS) : t->cols / 4;
+    if (cap > t->cols / 3) cap = t->cols / 3;
+    int cut = gapCols > cap;
+    if (cut) gapCols = cap;
+    int width = cwtl_cols(t, length);
+    if (width < 1) width = 1;
+    if (width > t->cols - 1) width = t->cols - 1;
+    if (t->col + gapCols + width > t->cols) cwtl_next_band(t);
+
+    int pulseRow = cwtl_row(t->band, 0), gapRow = pulseRow + 1;
+    for (int i = 0; i < gapCols; i++) cwtl_put(t, pulseRow, t->col + i, CWTL_G_LINE, CWTL_PEN_DIM);
+    if (cut) cwtl_put(t, pulseRow, t->col + gapCols / 2, '~', CWTL_PEN_DIM);
+    if (gapCols > 0) {
+        int mid = t->col + (gapCols - 1) / 2;
+        if (gap == CWTL_GAP_CHAR) cwtl_put(t, gapRow, mid, CWTL_G_BAR, near ? CWTL_PEN_UNSURE : CWTL_PEN_GAP);
+        else if (gap == CWTL_GAP_WORD) cwtl_put(t, gapRow, mid, CWTL_G_DBAR, near ? CWTL_PEN_UNSURE : CWTL_PEN_WORD);
+        else if (gap == CWTL_GAP_INTRA && near) cwtl_put(t, gapRow, mid, CWTL_G_DOT, CWTL_PEN_UNSURE);
+    }
+    t->col += gapCols;
+    for (int i = 0; i < width; i++) cwtl_put(t, pulseRow, t->col + i, glyph, pen);
+    t->col += width;
+    return t->col - width;
+}
+
+// An element as reported, before the decoder sees it (MorseKeyingFn order).
+// Noise is drawn at once; anything else waits for its classification.
+static inline void cwtl_keying(CwTimeline *t, const MorseDecoder *d, int pauseTime, int charLength) {
+    t->dit = d->dotTiming;
+    t->dah = d->dashTiming;
+    t->tolerance = d->params.tolerance;
+    if (charLength < (d->lockDeadline ? d->lockMinPulse : d->params.minPulse)) {
+        t->noise++;
+        t->pending = 0;
+        cwtl_draw(t, pauseTime, charLength, CWTL_GAP_INTRA, 0, CWTL_G_LOW, CWTL_PEN_NOISE);
+        return;
+    }
+    t->pending = 1;
+    t->pause = pauseTime;
+    t->length = charLength;
+    t->gap = cwtl_gap_kind(d, pauseTime);
+}
+
+// Mark a character that decoded to nothing
+static inline void cwtl_unknown(CwTimeline *t) {
+    if (t->charElements && !t->charText) {
+        t->unknown++;
+        if (t->charBand >= 0) cwtl_put(t, cwtl_row(t->charBand, 2), t->charCol, '?', CWTL_PEN_BAD);
+    }
+}
+
+// The pending element was classified (MorseElementFn)
+static inline void cwtl_element(CwTimeline *t, const MorseDecoder *d, int isDash) {
+    if (!t->pending) return;
+    t->pending = 0;
+    t->elements++;
+    // Unsure: outside the tolerance of what it was called, so it was decided
+    // by nearest distance or by a self-correction
+    int target = isDash ? t->dah : t->dit;
+    int sure = target <= 0 || abs(t->length - target) <= t->tolerance;
+    if (!sure) t->unsure++;
+    int near = cwtl_gap_near(d, t->dit, t->pause);
+    int newChar = t->gap != CWTL_GAP_INTRA;
+    if (newChar) cwtl_unknown(t);
+
+    int pen = !sure ? CWTL_PEN_UNSURE : isDash ? CWTL_PEN_DAH : CWTL_PEN_DIT;
+    int col = cwtl_draw(t, t->pause, t->length, t->gap, near, sure ? CWTL_G_FULL : CWTL_G_SHADE, pen);
+    if (newChar || t->charBand < 0) {
+        t->charBand = t->band;
+        t->charCol = col;
+        t->charElements = 0;
+        t->charText = 0;
+    }
+    t->charElements++;
+}
+
+// A decoded character (MorseCharFn): under the first element it came from
+static inline void cwtl_char(CwTimeline *t, char c) {
+    if (c == ' ') return;  // Shown by the word gap marker
+    t->chars++;
+    t->charText = 1;
+    if (t->charBand < 0) return;
+    cwtl_put(t, cwtl_row(t->charBand, 2), t->charCol, (unsigned char)c >= 32 && (unsigned char)c < 127 ? c : '#',
+             CWTL_PEN_BOLD);
+}
+
+// Header: title, the decoder's current thresholds, legend
+static inline void cwtl_header(CwTimeline *t, const MorseDecoder *d) {
+    char s[256];
+    int col = cwtl_text(t, 0, 0, CWTL_PEN_BOLD, "CW timeline");
+    snprintf(s, sizeof(s), "   1 column = %g ms   %lu elements, %lu unsure, %lu noise, %lu chars (%lu unknown)",
+             t->scale, t->elements, t->unsure, t->noise, t->chars, t->unknown);
+    cwtl_erase(t, 0, cwtl_text(t, 0, col, CWTL_PEN_PLAIN, s));
+
+    if (d->lockDeadline) {
+        snprintf(s, sizeof(s), "locked %g WPM: dit %d ms  dah >= %d ms  |  char gap >= %d ms  word gap >= %d ms  |  noise < %d ms",
+                 d->params.lockedWpm, d->dotTiming, d->lockDah, d->lockCharGap, d->lockWordGap, d->lockMinPulse);
+        col = cwtl_text(t, 1, 0, CWTL_PEN_PLAIN, s);
+    } else if (d->dotTiming <= 0) {
+        col = cwtl_text(t, 1, 0, CWTL_PEN_DIM, "Learning the speed: send a few characters");
+    } else {
+        int dah = d->dashTiming > 0 ? d->dashTiming : 3 * d->dotTiming;
+        snprintf(s, sizeof(s), "dit %d ms (%.1f WPM)  dah %d ms%s  match +/-%d  |  char gap > %.0f ms  word gap > %.0f ms  |  noise < %d ms",
+                 d->dotTiming, 1200.0 / d->dotTiming, dah, d->dashTiming > 0 ? "" : "?", d->params.tolerance,
+                 d->dotTiming * d->params.charGap, d->dotTiming * d->params.wordGap, d->params.minPulse);
+        col = cwtl_text(t, 1, 0, CWTL_PEN_PLAIN, s);
+    }
+    cwtl_erase(t, 1, col);
+
+    static const struct { int glyph, pen; const char *label; } legend[] = {
+        { CWTL_G_FULL, CWTL_PEN_DIT, " dit  " }, { CWTL_G_FULL, CWTL_PEN_DAH, " dah  " },
+        { CWTL_G_SHADE, CWTL_PEN_UNSURE, " unsure  " }, { CWTL_G_LOW, CWTL_PEN_NOISE, " noise  " },
+        { CWTL_G_BAR, CWTL_PEN_GAP, " char gap  " }, { CWTL_G_DBAR, CWTL_PEN_WORD, " word gap  " },
+        { CWTL_G_DOT, CWTL_PEN_UNSURE, " near a threshold  " }, { '~', CWTL_PEN_DIM, " pause cut" },
+    };
+    col = 0;
+    for (size_t i = 0; i < sizeof(legend) / sizeof(legend[0]) && col < t->cols; i++) {
+        cwtl_put(t, 2, col++, legend[i].glyph, legend[i].pen);
+        col = cwtl_text(t, 2, col, CWTL_PEN_DIM, legend[i].label);
+    }
+}
+
+static inline void cwtl_emit(CwTimeline *t, const char *s, size_t n) {
+    if (t->len + n > sizeof(t->buf)) {
+        fwrite(t->buf, 1, t->len, t->out);
+        t->len = 0;
+    }
+    memcpy(t->buf + t->len, s, n);
+    t->len += n;
+}
+
+static inline void cwtl_emitf(CwTimeline *t, const char *fmt, int a, int b) {
+    char s[32];
+    int n = snprintf(s, sizeof(s), fmt, a, b);
+    cwtl_emit(t, s, (size_t)n);
+}
+
+// Redraw whatever changed. Frames are at least CWTL_FRAME_MS apart unless
+// forced; the cursor is parked on the free row under the last band.
+static inline void cwtl_render(CwTimeline *t, const MorseDecoder *d, unsigned long nowMs, int force) {
+    if (!force && (!t->dirty || (t->started && nowMs - t->lastFrameMs < CWTL_FRAME_MS))) return;
+    t->lastFrameMs = nowMs;
+    cwtl_header(t, d);
+    if (!t->started) {
+        t->started = 1;
+        cwtl_emit(t, "\x1b[2J\x1b[?25l", 10);
+    }
+    int pen = -1;
+    for (int r = 0; r < t->rows; r++) {
+        int next = -1;  // Column the terminal cursor is at, if on this row
+        for (int c = 0; c < t->cols; c++) {
+            CwTlCell w = t->want[r][c];
+            if (w.glyph == t->shown[r][c].glyph && w.pen == t->shown[r][c].pen) continue;
+            if (c != next) cwtl_emitf(t, "\x1b[%d;%dH", r + 1, c + 1);
+            if (w.pen != pen) {
+                pen = w.pen;
+                cwtl_emit(t, cwtl_pens[pen], strlen(cwtl_pens[pen]));
+            }
+            if (w.glyph < 128) {
+                char ch = (char)w.glyph;
+                cwtl_emit(t, &ch, 1);
+            } else {
+                const char *g = cwtl_glyphs[w.glyph - 128];
+                cwtl_emit(t, g, strlen(g));
+            }
+            t->shown[r][c] = w;
+            next = c + 1;
+        }
+    }
+    if (pen != CWTL_PEN_PLAIN) cwtl_emit(t, cwtl_pens[CWTL_PEN_PLAIN], strlen(cwtl_pens[CWTL_PEN_PLAIN]));
+    cwtl_emitf(t, "\x1b[%d;%dH", CWTL_TOP + t->bands * CWTL_BAND + 1, 1);
+    fwrite(t->buf, 1, t->len, t->out);
+    t->len = 0;
+    fflush(t->out);
+    t->dirty = 0;
+}
+
+// Last frame; leaves the cursor visible under the timeline
+static inline void cwtl_finish(CwTimeline *t, const MorseDecoder *d, unsigned long nowMs) {
+    cwtl_render(t, d, nowMs, 1);
+    fputs("\x1b[?25h", t->out);
+    fflush(t->out);
+}
+
+#endif // CW_TIMELINE_H
@@ -0,0 +1,298 @@
+/*
+ * cw_tune.c - Decoder parameter tuner
+ * Grid-searches the decoder's timing rules (tolerance, noise floor, gap and
+ * correction multipliers) over a labelled corpus on every core, scores each
+ * candidate by character error rate and decode latency, and writes the best
+ * as a profile for serial_keyboard --profile.
+ *
+ * A corpus is a directory of captures/archives, each with its transcript
+ * next to it: lesson.cwarc + lesson.txt. Every session is loaded once into
+ * one element array that all workers share read-only; each worker has its
+ * own decoder and scratch buffers. The arrays are decoded copies, not a
+ * mapping of the files: captures are device text and archives are
+ * compressed, so neither holds elements that could be used in place.
+ *
+ * Compile: clang -O2 -o cw_tune cw_tune.c
+ * Run: ./cw_tune corpus/ -o tuned.profile
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "cw_batch.h"
+#include "cw_score.h"
+
+#define TOP_RESULTS 10
+
+// ============================================================
+// SEARCH SPACE
+// ============================================================
+
+static const double gridTolerance[] = { 30, 40, 50, 60, 70 };
+static const double gridMinPulse[] = { 15, 20, 25, 30, 35 };
+static const double gridCharGap[] = { 2.0, 2.25, 2.5, 2.75, 3.0 };
+static const double gridWordGap[] = { 4.5, 5.0, 5.5, 6.0, 6.5 };
+static const double gridDitCorrection[] = { 0.5, 0.6, 0.7 };
+static const double gridDahCorrection[] = { 1.75, 2.0, 2.25 };
+
+typedef struct {
+    const double *values;
+    int count;
+} Axis;
+
+#define AXIS(a) { a, (int)(sizeof(a) / sizeof(a[0])) }
+static const Axis axes[] = {
+    AXIS(gridTolerance), AXIS(gridMinPulse), AXIS(gridCharGap),
+    AXIS(gridWordGap), AXIS(gridDitCorrection), AXIS(gridDahCorrection),
+};
+#define AXIS_COUNT (int)(sizeof(axes) / sizeof(axes[0]))
+
+// Candidate i -> parameters (mixed-radix over the axes)
+static void candidateParams(int i, MorseParams *p) {
+    int digit[AXIS_COUNT];
+    for (int a = AXIS_COUNT - 1; a >= 0; a--) {
+        digit[a] = i % axes[a].count;
+        i /= axes[a].count;
+    }
+    p->tolerance = (int)axes[0].values[digit[0]];
+    p->minPulse = (int)axes[1].values[digit[1]];
+    p->charGap = axes[2].values[digit[2]];
+    p->wordGap = axes[3].values[digit[3]];
+    p->ditCorrection = axes[4].values[digit[4]];
+    p->dahCorrection = axes[5].values[digit[5]];
+}
+
+static int candidateCount(void) {
+    int n = 1;
+    for (int a = 0; a < AXIS_COUNT; a++) n *= axes[a].count;
+    return n;
+}
+
+// ============================================================
+// CORPUS
+// ============================================================
+
+typedef struct {
+    const char *path;
+    CwElementList elements;
+    char *label;       // Normalized transcript
+    size_t labelLen;
+} Session;
+
+// ============================================================
+// SCORING
+// ============================================================
+
+typedef struct {
+    MorseParams params;
+    unsigned long errors;       // Edit distance summed over sessions
+    unsigned long labelChars;
+    double latencyMs;           // Mean character latency
+    double cer;
+    int saturated;              // Some session hit the distance cap
+    int pruned;                 // Stopped early, hopelessly behind the best
+} Result;
+
+typedef struct {
+    Session *sessions;
+    int sessionCount;
+    CwScorer *workers;
+    Result *results;
+    double latencyWeight;       // Score = CER% + weight * latency in seconds
+    unsigned long labelChars;   // Over all sessions
+    cw_mutex_t lock;
+    unsigned long bestErrors;   // Fewest errors of any finished candidate
+} Tuner;
+
+// Score r->params over the whole corpus. Stops early once the errors exceed
+// budget: the candidate is then marked pruned. Either way a saturated or
+// pruned candidate's CER is only a lower bound.
+static void evaluate(Tuner *t, CwScorer *w, Result *r, unsigned long budget) {
+    w->latencySum = 0;
+    w->latencyCount = 0;
+    r->errors = 0;
+    r->labelChars = t->labelChars;
+    r->saturated = r->pruned = 0;
+    for (int i = 0; i < t->sessionCount && !r->pruned; i++) {
+        const Session *s = &t->sessions[i];
+        cwscore_decode(w, s->elements.el, s->elements.count, &r->params);
+        // Beyond 25% CER (or the budget) the exact figure doesn't matter,
+        // only that it's bad
+        long cap = (long)(s->labelLen / 4) + 16;
+        int capByBudget = 0;
+        if ((unsigned long)cap > budget - r->errors) {
+            cap = (long)(budget - r->errors);
+            capByBudget = 1;
+        }
+        long dist = cwscore_errors(w, s->label, s->labelLen, cap);
+        if (dist > cap) {
+            r->saturated = 1;
+            r->pruned = capByBudget;
+        }
+        r->errors += dist;
+    }
+    r->cer = r->labelChars ? 100.0 * r->errors / r->labelChars : 0.0;
+    r->latencyMs = w->latencyCount ? w->latencySum / w->latencyCount : 0.0;
+}
+
+// Candidates far behind the best so far are cut short: their exact error
+// count can't matter, and the edit distance is most of the cost
+static void scoreCandidate(void *ctx, int task, int worker) {
+    Tuner *t = (Tuner *)ctx;
+    Result *r = &t->results[task];
+    cw_mutex_lock(&t->lock);
+    unsigned long best = t->bestErrors;
+    cw_mutex_unlock(&t->lock);
+    unsigned long budget = best + best / 2 + 16;
+    if (budget < best) budget = ULONG_MAX;
+
+    candidateParams(task, &r->params);
+    evaluate(t, &t->workers[worker], r, budget);
+    if (!r->pruned) {
+        cw_mutex_lock(&t->lock);
+        if (r->errors < t->bestErrors) t->bestErrors = r->errors;
+        cw_mutex_unlock(&t->lock);
+    }
+}
+
+static double score(const Tuner *t, const Result *r) {
+    return r->cer + t->latencyWeight * r->latencyMs / 1000.0;
+}
+
+// Ranking: finished candidates first, then score, then latency
+static int better(const Tuner *t, const Result *a, const Result *b) {
+    if (a->pruned != b->pruned) return b->pruned;
+    if (score(t, a) != score(t, b)) return score(t, a) < score(t, b);
+    return a->latencyMs < b->latencyMs;
+}
+
+static void printResult(const char *label, const Result *r) {
+    printf("%-8s %5d %6d %6.2f %6.2f %6.2f %6.2f  %s%6.2f%% %8.0f\n", label,
+           r->params.tolerance, r->params.minPulse, r->params.charGap, r->params.wordGap,
+           r->params.ditCorrection, r->params.dahCorrection, r->saturated ? ">" : " ",
+           r->cer, r->latencyMs);
+}
+
+// ============================================================
+// MAIN
+// ============================================================
+
+static void printUsage(const char *progname) {
+    printf("CW Hotline decoder tuner\n\n");
+    printf("Usage: %s <corpus-dir> [options]\n\n", progname);
+    printf("The corpus holds .cwcap/.cwarc sessions, each with a .txt transcript\n");
+    printf("of the same name (lesson.cwarc + lesson.txt).\n\n");
+    printf("Options:\n");
+    printf("  -o <file>             Profile to write (default: tuned.profile)\n");
+    printf("  -j <N>                Worker threads (default: one per CPU)\n");
+    printf("  --latency-weight <w>  CER points traded per second of latency (default: 0)\n");
+    printf("\nUse the result with: serial_keyboard --profile tuned.profile\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *corpus = NULL;
+    const char *outPath = "tuned.profile";
+    int workers = 0;
+    Tuner t;
+    memset(&t, 0, sizeof(t));
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) outPath = argv[++i];
+        else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) workers = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--latency-weight") == 0 && i + 1 < argc) t.latencyWeight = atof(argv[++i]);
+        else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) { printUsage(argv[0]); return 0; }
+        else corpus = argv[i];
+    }
+    if (!corpus) { printUsage(argv[0]); return 1; }
+
+    char **paths = NULL;
+    int count = cwbatch_list_dir(corpus, &paths);
+    if (count <= 0) {
+        printf("[!] No .cwcap or .cwarc files in %s\n", corpus);
+        return 1;
+    }
+    t.sessions = (Session *)calloc(count, sizeof(Session));
+    if (!t.sessions) return 1;
+    unsigned long long elements = 0;
+    for (int i = 0; i < count; i++) {
+        Session *s = &t.sessions[t.sessionCount];
+        s->path = paths[i];
+        s->label = cwscore_read_label(paths[i], &s->labelLen);
+        if (!s->label) { printf("[!] %s: no transcript, skipped\n", paths[i]); continue; }
+        if (cwbatch_load(paths[i], &s->elements) != 0) {
+            printf("[!] %s: not a capture or archive, skipped\n", paths[i]);
+            free(s->label);
+            continue;
+        }
+        elements += s->elements.count;
+        t.labelChars += s->labelLen;
+        t.sessionCount++;
+    }
+    if (t.sessionCount == 0) {
+        printf("[!] No labelled sessions in %s\n", corpus);
+        return 1;
+    }
+
+    if (workers <= 0) workers = cwpool_cpu_count();
+    int candidates = candidateCount();
+    t.workers = (CwScorer *)calloc(workers, sizeof(CwScorer));
+    t.results = (Result *)calloc(candidates + 1, sizeof(Result));
+    if (!t.workers || !t.results) { printf("[!] Out of memory\n"); return 1; }
+    for (int i = 0; i < workers; i++) {
+        if (cwscore_init(&t.workers[i]) != 0) { printf("[!] Out of memory\n"); return 1; }
+    }
+
+    printf("[*] %d sessions, %llu elements; %d candidates on %d threads\n",
+           t.sessionCount, elements, candidates, workers);
+
+    // Baseline: the built-in constants (last result slot, scored on worker 0)
+    Result *baseline = &t.results[candidates];
+    morseDefaultParams(&baseline->params);
+    evaluate(&t, &t.workers[0], baseline, ULONG_MAX);
+
+    cw_mutex_init(&t.lock);
+    t.bestErrors = baseline->saturated ? ULONG_MAX : baseline->errors;
+    unsigned long startMs = (unsigned long)(cwcap_now_us() / 1000);
+    if (cwpool_run(candidates, workers, NULL, scoreCandidate, &t) != 0) {
+        printf("[!] Out of memory\n");
+        return 1;
+    }
+    unsigned long elapsedMs = (unsigned long)(cwcap_now_us() / 1000) - startMs;
+
+    // Keep the best TOP_RESULTS (ties: lower latency, then grid order)
+    int top[TOP_RESULTS], topCount = 0;
+    for (int i = 0; i < candidates; i++) {
+        const Result *r = &t.results[i];
+        int pos = topCount;
+        while (pos > 0) {
+            const Result *o = &t.results[top[pos - 1]];
+            if (!better(&t, r, o)) break;
+            pos--;
+        }
+        if (pos >= TOP_RESULTS) continue;
+        if (topCount < TOP_RESULTS) topCount++;
+        memmove(&top[pos + 1], &top[pos], sizeof(int) * (topCount - 1 - pos));
+        top[pos] = i;
+    }
+
+    printf("[*] Searched in %.1f s\n\n", elapsedMs / 1000.0);
+    printf("%-8s %5s %6s %6s %6s %6s %6s  %7s %8s\n", "", "TOL", "MINP", "CHAR", "WORD", "DITC", "DAHC", "CER", "LAT(ms)");
+    printResult("default", baseline);
+    for (int i = 0; i < topCount; i++) {
+        char label[16];
+        snprintf(label, sizeof(label), "#%d", i + 1);
+        printResult(label, &t.results[top[i]]);
+    }
+
+    const Result *best = &t.results[top[0]];
+    FILE *f = fopen(outPath, "w");
+    if (!f) { perror("Error writing profile"); return 1; }
+    fprintf(f, "# cw_tune: CER %.2f%% (defaults %.2f%%), latency %.0f ms, %d sessions\n",
+            best->cer, baseline->cer, best->latencyMs, t.sessionCount);
+    morseWriteProfile(f, &best->params);
+    if (fclose(f) != 0) { perror("Error writing profile"); return 1; }
+    printf("\n[OK] Wrote %s\n", outPath);
+    return 0;
+}
@@ -1,9 +1,10 @@
 /*
- * debug_serial.c - Raw serial debug tool
- * Shows every byte received in hex and ASCII
- * 
- * Compile: clang -o debug_serial debug_serial.c
- * Run: ./debug_serial
+ * debug_serial.c - Raw serial debug / capture tool
+ * Shows every byte received in hex and ASCII, with a monotonic timestamp
+ * per read, and can save a binary capture for `serial_keyboard --replay`.
+ *
+ * Compile: clang -O2 -o debug_serial debug_serial.c -lm
+ * Run: ./debug_serial [-p port] [-b baud] [-o capture.cwcap] [-q] [-A] [-r capture.cwcap]
  */
 
 #include <stdio.h>
@@ -13,15 +14,407 @@
 #include <unistd.h>
 #include <termios.h>
 #include <errno.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <math.h>
+
+#include "cw_capture.h"
 
 #define SERIAL_PORT "/dev/tty.usbserial-11240"
+#define DEFAULT_BAUD 115200
+#define BYTES_PER_ROW 16
+#define OUT_BUF_SIZE (256 * 1024)
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void onSignal(int sig) {
+    (void)sig;
+    stopRequested = 1;
+}
+
+static speed_t baudToSpeed(int baud) {
+    static const struct { int baud; speed_t speed; } table[] = {
+        { 1200, B1200 }, { 2400, B2400 }, { 4800, B4800 }, { 9600, B9600 },
+        { 19200, B19200 }, { 38400, B38400 }, { 57600, B57600 },
+        { 115200, B115200 }, { 230400, B230400 },
+    };
+    for (size_t i = 0; i < sizeof(table) / sizeof(table[0]); i++) {
+        if (table[i].baud == baud) return table[i].speed;
+    }
+    return 0;
+}
+
+// ============================================================
+// HEX DUMP FORMATTER
+// ============================================================
+
+/*
+ * Output is built in one large buffer and written with a single fwrite() when
+ * it fills up or the line goes idle, so a slow terminal costs one syscall per
+ * burst instead of one printf per byte. Each row is:
+ *
+ *   "  0010  53 2c 31 32 30 2c 36 30 0d 0a .. ..  |S,120,60..|\n"
+ */
+
+static char hexPair[256][3];   // "53 "
+static char asciiOf[256];      // printable or '.'
+
+static char outBuf[OUT_BUF_SIZE];
+static size_t outLen = 0;
+
+static void initFormatter(void) {
+    static const char digits[] = "0123456789abcdef";
+    for (int i = 0; i < 256; i++) {
+        hexPair[i][0] = digits[i >> 4];
+        hexPair[i][1] = digits[i & 15];
+        hexPair[i][2] = ' ';
+        asciiOf[i] = (i >= 32 && i < 127) ? (char)i : '.';
+    }
+}
+
+static void outFlush(void) {
+    if (outLen) {
+        fwrite(outBuf, 1, outLen, stdout);
+        fflush(stdout);
+        outLen = 0;
+    }
+}
+
+static char *outReserve(size_t n) {
+    if (outLen + n > sizeof(outBuf)) outFlush();
+    return outBuf + outLen;
+}
+
+// "[   12.345678] +N bytes\n"
+static void formatChunkHeader(uint64_t relUs, int n) {
+    char *p = outReserve(64);
+    outLen += snprintf(p, 64, "[%6lu.%06lu] +%d bytes\n",
+                       (unsigned long)(relUs / 1000000u), (unsigned long)(relUs % 1000000u), n);
+}
+
+static void formatRow(const unsigned char *data, int n, unsigned offset) {
+    // 2 + 4 + 2 + 48 + 1 + 16 + 2 = 75
+    char *p = outReserve(80);
+    char *start = p;
+    static const char digits[] = "0123456789abcdef";
+    *p++ = ' '; *p++ = ' ';
+    *p++ = digits[(offset >> 12) & 15]; *p++ = digits[(offset >> 8) & 15];
+    *p++ = digits[(offset >> 4) & 15];  *p++ = digits[offset & 15];
+    *p++ = ' '; *p++ = ' ';
+    for (int i = 0; i < BYTES_PER_ROW; i++) {
+        if (i < n) memcpy(p, hexPair[data[i]], 3);
+        else memcpy(p, "   ", 3);
+        p += 3;
+    }
+    *p++ = ' '; *p++ = '|';
+    for (int i = 0; i < n; i++) *p++ = asciiOf[data[i]];
+    *p++ = '|'; *p++ = '\n';
+    outLen += p - start;
+}
+
+static void formatChunk(const unsigned char *data, int n, uint64_t relUs) {
+    formatChunkHeader(relUs, n);
+    for (int off = 0; off < n; off += BYTES_PER_ROW) {
+        int rowLen = n - off < BYTES_PER_ROW ? n - off : BYTES_PER_ROW;
+        formatRow(data + off, rowLen, (unsigned)off);
+    }
+}
+
+// ============================================================
+// PROTOCOL ANALYZER (-A)
+// ============================================================
+
+/*
+ * Parses the device's "S,<pause>,<length>" lines and keeps rolling statistics
+ * over the last ANALYZER_WINDOW elements. Histogram bins are updated as
+ * elements enter and leave the window, and the screen is redrawn with cursor
+ * addressing: only rows whose bar or count changed since the last frame are
+ * rewritten, so a steady stream costs a few dozen bytes per frame.
+ */
+
+#define ANALYZER_WINDOW 256
+#define MIN_PULSE_LENGTH 30        // Same noise floor as serial_keyboard
+#define HIST_BINS 20
+#define PULSE_BIN_MS 20            // 0-400ms
+#define PAUSE_BIN_MS 60            // 0-1200ms
+#define BAR_WIDTH 28
+#define FRAME_INTERVAL_US 100000   // Redraw at most 10x per second
+
+typedef struct {
+    int pause;
+    int length;
+    int64_t jitterUs;   // Arrival delta minus (pause + length) reported
+    int timed;          // jitterUs is valid (there was an arrival to measure from)
+} Element;
+
+static Element window[ANALYZER_WINDOW];
+static int windowHead = 0, windowCount = 0;
+static int pulseHist[HIST_BINS], pauseHist[HIST_BINS];
+static unsigned long totalElements = 0, totalNoise = 0;
+static uint64_t lastArrivalUs = 0;
+static int haveArrival = 0;
+static char anLine[256];
+static int anLinePos = 0;
+
+// What is currently on screen, per histogram row
+static int shownPulse[HIST_BINS], shownPause[HIST_BINS];
+static int shownScale = -1;
+static uint64_t lastFrameUs = 0;
+static int analyzerDirty = 0;
+
+static int binOf(int ms, int binMs) {
+    int b = ms / binMs;
+    return b >= HIST_BINS ? HIST_BINS - 1 : b;
+}
+
+// An element that shares its line's arrival with the one before it is not
+// `timed`: its arrival says nothing about its own length
+static void analyzerAdd(int pause, int length, uint64_t arrivalUs, int timed) {
+    Element *e = &window[windowHead];
+    if (windowCount == ANALYZER_WINDOW) {
+        // Evict the oldest element (the slot we are about to overwrite)
+        pulseHist[binOf(e->length, PULSE_BIN_MS)]--;
+        pauseHist[binOf(e->pause, PAUSE_BIN_MS)]--;
+    } else {
+        windowCount++;
+    }
+    e->pause = pause;
+    e->length = length;
+    e->timed = timed && haveArrival;
+    e->jitterUs = e->timed ? (int64_t)(arrivalUs - lastArrivalUs) - (int64_t)(pause + length) * 1000 : 0;
+    lastArrivalUs = arrivalUs;
+    haveArrival = 1;
+    pulseHist[binOf(length, PULSE_BIN_MS)]++;
+    pauseHist[binOf(pause, PAUSE_BIN_MS)]++;
+    windowHead = (windowHead + 1) % ANALYZER_WINDOW;
+    totalElements++;
+    if (length < MIN_PULSE_LENGTH) totalNoise++;
+    analyzerDirty = 1;
+}
+
+static void analyzerLine(const char *line, uint64_t arrivalUs) {
+    int pauses[16], lengths[16];
+    int n = cwcap_parse_line(line, pauses, lengths, 16);
+    for (int i = 0; i < n; i++) analyzerAdd(pauses[i], lengths[i], arrivalUs, i == 0);
+}
+
+static void analyzerFeed(const unsigned char *data, int n, uint64_t arrivalUs) {
+    for (int i = 0; i < n; i++) {
+        char c = (char)data[i];
+        if (c == '\r' || c == '\n') {
+            anLine[anLinePos] = '\0';
+            if (anLinePos) analyzerLine(anLine, arrivalUs);
+            anLinePos = 0;
+        } else if (anLinePos < (int)sizeof(anLine) - 1) {
+            anLine[anLinePos++] = c;
+        } else {
+            anLinePos = 0;  // Runaway line: drop it
+        }
+    }
+}
+
+typedef struct {
+    double dit, dah;
+    int dits, dahs, noise;
+    int intraGaps, charGaps, wordGaps;
+    double jitterMeanMs, jitterSdMs;
+} AnalyzerStats;
+
+// Two-means split of the window's pulses into dits and dahs, then gap classes
+// against the dit estimate (2.5x / 6x, as in the decoder)
+static void analyzerStats(AnalyzerStats *st) {
+    memset(st, 0, sizeof(*st));
+    int lo = 1 << 30, hi = 0;
+    for (int i = 0; i < windowCount; i++) {
+        int len = window[i].length;
+        if (len < MIN_PULSE_LENGTH) { st->noise++; continue; }
+        if (len < lo) lo = len;
+        if (len > hi) hi = len;
+    }
+    if (hi == 0) return;
+    double split = (lo + hi) / 2.0;
+    if (hi < lo * 2) split = hi + 1;  // One cluster only: call it all dits
+    for (int iter = 0; iter < 4; iter++) {
+        double sumDit = 0, sumDah = 0;
+        st->dits = st->dahs = 0;
+        for (int i = 0; i < windowCount; i++) {
+            int len = window[i].length;
+            if (len < MIN_PULSE_LENGTH) continue;
+            if (len < split) { sumDit += len; st->dits++; }
+            else { sumDah += len; st->dahs++; }
+        }
+        st->dit = st->dits ? sumDit / st->dits : lo;
+        st->dah = st->dahs ? sumDah / st->dahs : st->dit * 3;
+        if (!st->dahs) break;
+        split = (st->dit + st->dah) / 2.0;
+    }
+
+    double sum = 0, sumSq = 0;
+    int jitterCount = 0;
+    for (int i = 0; i < windowCount; i++) {
+        int pause = window[i].pause;
+        if (pause > st->dit * 6) st->wordGaps++;
+        else if (pause > st->dit * 2.5) st->charGaps++;
+        else st->intraGaps++;
+        if (window[i].timed) {
+            double ms = window[i].jitterUs / 1000.0;
+            sum += ms; sumSq += ms * ms; jitterCount++;
+        }
+    }
+    if (jitterCount) {
+        st->jitterMeanMs = sum / jitterCount;
+        double var = sumSq / jitterCount - st->jitterMeanMs * st->jitterMeanMs;
+        st->jitterSdMs = var > 0 ? sqrt(var) : 0;
+    }
+}
+
+static void outText(const char *fmt, ...) {
+    char *p = outReserve(256);
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(p, 256, fmt, ap);
+    va_end(ap);
+    if (n > 0) outLen += n < 256 ? n : 255;
+}
+
+#define HIST_TOP_ROW 8
+#define PAUSE_COL 46
+
+static void drawBar(int row, int col, int lowMs, int binMs, int count, int scale, int last) {
+    char bar[BAR_WIDTH + 1];
+    int w = scale ? (count * BAR_WIDTH + scale - 1) / scale : 0;
+    memset(bar, '#', w);
+    memset(bar + w, ' ', BAR_WIDTH - w);
+    bar[BAR_WIDTH] = '\0';
+    if (last) outText("\x1b[%d;%dH%4d+    |%s|%5d", row, col, lowMs, bar, count);
+    else outText("\x1b[%d;%dH%4d-%-4d|%s|%5d", row, col, lowMs, lowMs + binMs, bar, count);
+}
+
+static void analyzerRender(int force) {
+    uint64_t now = cwcap_now_us();
+    if (!force && (!analyzerDirty || now - lastFrameUs < FRAME_INTERVAL_US)) return;
+    lastFrameUs = now;
+    analyzerDirty = 0;
+
+    if (shownScale < 0) {
+        outText("\x1b[2J\x1b[?25l\x1b[1;1H🎛  CW Hotline protocol analyzer  (last %d elements, Ctrl+C to stop)", ANALYZER_WINDOW);
+        outText("\x1b[%d;1HPULSE LENGTH (ms)", HIST_TOP_ROW - 1);
+        outText("\x1b[%d;%dHPAUSE BEFORE (ms)", HIST_TOP_ROW - 1, PAUSE_COL);
+        for (int b = 0; b < HIST_BINS; b++) shownPulse[b] = shownPause[b] = -1;
+    }
+
+    AnalyzerStats st;
+    analyzerStats(&st);
+    int ratioX100 = st.dit > 0 ? (int)(st.dah / st.dit * 100 + 0.5) : 0;
+    outText("\x1b[3;1H\x1b[KSpeed: %5.1f WPM   dit %5.1fms   dah %5.1fms   dah:dit %d.%02d",
+            st.dit > 0 ? 1200.0 / st.dit : 0.0, st.dit, st.dah, ratioX100 / 100, ratioX100 % 100);
+    outText("\x1b[4;1H\x1b[KElements: %lu total   %d dits  %d dahs   noise %d (%.1f%% window, %.1f%% all)",
+            totalElements, st.dits, st.dahs, st.noise,
+            windowCount ? 100.0 * st.noise / windowCount : 0.0,
+            totalElements ? 100.0 * totalNoise / totalElements : 0.0);
+    outText("\x1b[5;1H\x1b[KGaps: %d intra  %d char  %d word   arrival jitter %+.1fms mean, %.1fms sd",
+            st.intraGaps, st.charGaps, st.wordGaps, st.jitterMeanMs, st.jitterSdMs);
+
+    // Power-of-two scale so bars only all move when the tallest bin doubles
+    int maxCount = 1;
+    for (int b = 0; b < HIST_BINS; b++) {
+        if (pulseHist[b] > maxCount) maxCount = pulseHist[b];
+        if (pauseHist[b] > maxCount) maxCount = pauseHist[b];
+    }
+    int scale = 8;
+    while (scale < maxCount) scale *= 2;
+    int rescaled = scale != shownScale;
+    shownScale = scale;
+
+    for (int b = 0; b < HIST_BINS; b++) {
+        int row = HIST_TOP_ROW + b;
+        if (rescaled || pulseHist[b] != shownPulse[b]) {
+            drawBar(row, 1, b * PULSE_BIN_MS, PULSE_BIN_MS, pulseHist[b], scale, b == HIST_BINS - 1);
+            shownPulse[b] = pulseHist[b];
+        }
+        if (rescaled || pauseHist[b] != shownPause[b]) {
+            drawBar(row, PAUSE_COL, b * PAUSE_BIN_MS, PAUSE_BIN_MS, pauseHist[b], scale, b == HIST_BINS - 1);
+            shownPause[b] = pauseHist[b];
+        }
+    }
+    outText("\x1b[%d;1H", HIST_TOP_ROW + HIST_BINS + 1);
+    outFlush();
+}
+
+static void analyzerFinish(void) {
+    analyzerRender(1);
+    outText("\x1b[?25h\n");
+    outFlush();
+}
+
+// ============================================================
+// MAIN
+// ============================================================
+
+static void printUsage(const char *progname) {
+    printf("Usage: %s [options] [port]\n\n", progname);
+    printf("  -p <port>   Serial port (default: %s)\n", SERIAL_PORT);
+    printf("  -b <baud>   Baud rate (default: %d)\n", DEFAULT_BAUD);
+    printf("  -o <file>   Write a binary capture (replay with serial_keyboard --replay)\n");
+    printf("  -q          No hex dump, capture only\n");
+    printf("  -A          Live protocol analyzer (timing histograms, WPM, jitter)\n");
+    printf("  -r <file>   Read a capture instead of the port (with -A: analyze it)\n");
+    printf("  -h          Show this help\n");
+}
+
+// Dump or analyze a capture written with -o
+static int readCapture(const char *path, int analyze) {
+    FILE *f = fopen(path, "rb");
+    uint32_t baud = 0;
+    if (!f || cwcap_read_header(f, &baud) != 0) {
+        printf("❌ %s is not a capture file\n", path);
+        if (f) fclose(f);
+        return 1;
+    }
+    static unsigned char chunk[CWCAP_MAX_CHUNK];
+    uint64_t timeUs;
+    int n;
+    while ((n = cwcap_read_chunk(f, &timeUs, chunk)) >= 0) {
+        if (analyze) analyzerFeed(chunk, n, timeUs);
+        else formatChunk(chunk, n, timeUs);
+    }
+    fclose(f);
+    if (analyze) analyzerFinish();
+    outFlush();
+    return 0;
+}
 
 int main(int argc, char *argv[]) {
-    const char *port = (argc > 1) ? argv[1] : SERIAL_PORT;
-    
+    const char *port = SERIAL_PORT;
+    const char *capturePath = NULL;
+    int baud = DEFAULT_BAUD;
+    const char *replayPath = NULL;
+    int dump = 1;
+    int analyze = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) port = argv[++i];
+        else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) baud = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) capturePath = argv[++i];
+        else if (strcmp(argv[i], "-q") == 0) dump = 0;
+        else if (strcmp(argv[i], "-A") == 0) analyze = 1;
+        else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) replayPath = argv[++i];
+        else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) { printUsage(argv[0]); return 0; }
+        else if (argv[i][0] != '-') port = argv[i];  // Old style: debug_serial <port>
+    }
+
+    initFormatter();
+    if (replayPath) return readCapture(replayPath, analyze);
+
+    speed_t speed = baudToSpeed(baud);
+    if (!speed) {
+        printf("❌ Unsupported baud rate: %d\n", baud);
+        return 1;
+    }
+
     printf("🔌 Debug Serial Reader\n");
-    printf("   Port: %s\n\n", port);
-    
+    printf("   Port: %s @ %d baud\n\n", port, baud);
+
     // Try opening with different flags
     printf("Attempting to open port...\n");
     int fd = open(port, O_RDWR | O_NOCTTY);
@@ -30,7 +423,7 @@ int main(int argc, char *argv[]) {
         return 1;
     }
     printf("✅ Port opened (fd=%d)\n", fd);
-    
+
     // Get current settings
     struct termios options;
     if (tcgetattr(fd, &options) != 0) {
@@ -39,84 +432,94 @@ int main(int argc, char *argv[]) {
         return 1;
     }
     printf("✅ Got terminal attributes\n");
-    
-    // Configure: 9600 8N1
-    cfsetispeed(&options, B9600);
-    cfsetospeed(&options, B9600);
-    
+
+    cfsetispeed(&options, speed);
+    cfsetospeed(&options, speed);
+
     options.c_cflag |= (CLOCAL | CREAD);  // Enable receiver, ignore modem control
     options.c_cflag &= ~PARENB;           // No parity
     options.c_cflag &= ~CSTOPB;           // 1 stop bit
     options.c_cflag &= ~CSIZE;
     options.c_cflag |= CS8;               // 8 data bits
-    
+
     // Raw input mode (no line processing)
     options.c_lflag &= ~(ICANON | ECHO | ECHOE | ISIG);
     options.c_iflag &= ~(IXON | IXOFF | IXANY);  // No software flow control
     options.c_iflag &= ~(INLCR | ICRNL);         // Don't translate CR/LF
     options.c_oflag &= ~OPOST;                    // Raw output
-    
-    // Read returns after 1 byte or 1 second timeout
+
+    // Read returns as soon as data arrives, or after 0.1s with nothing
     options.c_cc[VMIN] = 0;
-    options.c_cc[VTIME] = 10;  // 1 second timeout (in tenths of seconds)
-    
+    options.c_cc[VTIME] = 1;
+
     if (tcsetattr(fd, TCSANOW, &options) != 0) {
         printf("❌ tcsetattr failed: %s\n", strerror(errno));
         close(fd);
         return 1;
     }
-    printf("✅ Configured: 9600 8N1, raw mode\n");
-    
+    printf("✅ Configured: %d 8N1, raw mode\n", baud);
+
     // Flush any pending data
     tcflush(fd, TCIOFLUSH);
-    printf("✅ Flushed buffers\n\n");
-    
-    printf("🎧 Listening for data... (Ctrl+C to quit)\n");
-    printf("   Each byte shown as [HEX] 'CHAR'\n\n");
-    
-    unsigned char buffer[256];
-    int totalBytes = 0;
-    int lineBytes = 0;
-    
-    while (1) {
+    printf("✅ Flushed buffers\n");
+
+    FILE *capture = NULL;
+    if (capturePath) {
+        capture = fopen(capturePath, "wb");
+        if (!capture || cwcap_write_header(capture, (uint32_t)baud) != 0) {
+            printf("❌ Cannot write capture %s: %s\n", capturePath, strerror(errno));
+            close(fd);
+            return 1;
+        }
+        printf("✅ Capturing to %s\n", capturePath);
+    }
+
+    printf("\n🎧 Listening for data... (Ctrl+C to stop)\n\n");
+    fflush(stdout);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = onSignal;  // No SA_RESTART: read() returns EINTR
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    if (analyze) dump = 0;
+    static unsigned char buffer[4096];
+    unsigned long long totalBytes = 0;
+    unsigned long chunks = 0;
+    uint64_t startUs = cwcap_now_us();
+
+    while (!stopRequested) {
         ssize_t n = read(fd, buffer, sizeof(buffer));
-        
+        uint64_t relUs = cwcap_now_us() - startUs;
+
         if (n > 0) {
-            for (int i = 0; i < n; i++) {
-                unsigned char c = buffer[i];
-                totalBytes++;
-                lineBytes++;
-                
-                // Print hex value
-                printf("[%02X]", c);
-                
-                // Print ASCII if printable
-                if (c >= 32 && c < 127) {
-                    printf("'%c' ", c);
-                } else if (c == '\n') {
-                    printf("\\n ");
-                } else if (c == '\r') {
-                    printf("\\r ");
-                } else {
-                    printf("    ");
-                }
-                
-                // Newline every 8 bytes or on actual newline
-                if (c == '\n' || c == '\r' || lineBytes >= 8) {
-                    printf("\n");
-                    lineBytes = 0;
-                }
+            totalBytes += n;
+            chunks++;
+            if (capture && cwcap_write_chunk(capture, relUs, buffer, (uint32_t)n) != 0) {
+                outFlush();
+                printf("\n❌ Capture write failed: %s\n", strerror(errno));
+                break;
             }
-            fflush(stdout);
+            if (dump) formatChunk(buffer, (int)n, relUs);
+            if (analyze) { analyzerFeed(buffer, (int)n, relUs); analyzerRender(0); }
         } else if (n == 0) {
-            // Timeout - just print a dot every second to show we're alive
-            printf(".");
-            fflush(stdout);
-        } else {
+            // Line idle: show what we have
+            if (analyze) analyzerRender(0);
+            outFlush();
+        } else if (errno != EINTR) {
+            outFlush();
             printf("\n❌ Read error: %s\n", strerror(errno));
+            break;
         }
     }
-    
+
+    if (analyze) analyzerFinish();
+    outFlush();
+    if (capture) fclose(capture);
+    printf("\n📊 %llu bytes in %lu chunks over %.1fs\n", totalBytes, chunks,
+           (cwcap_now_us() - startUs) / 1e6);
+
     close(fd);
     return 0;
 }
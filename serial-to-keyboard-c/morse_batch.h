@@ -0,0 +1,213 @@
+/*
+ * morse_batch.h
+ * Batch classification of element arrays against a fixed timing model.
+ *
+ * The live decoder (morse_decoder.h) adapts its timing after every element,
+ * which makes it inherently one-at-a-time. Analytics and parameter searches
+ * mostly want the opposite: one timing model, millions of elements. Here the
+ * model's decisions are reduced to integer thresholds, so classification is
+ * a handful of compares per element and runs 4/8 elements per instruction:
+ *
+ *   morseClassifyBatch()  pauses[] + lengths[] -> one class byte per element
+ *   morseWalkBatch()      class bytes -> text (scalar tree walk)
+ *
+ * Kernels: AVX2 when compiled with -mavx2 (or -march=native), SSE2 on any
+ * other x86-64 build, NEON on Apple Silicon / ARM64, scalar elsewhere. All
+ * of them produce identical bytes.
+ */
+
+#ifndef MORSE_BATCH_H
+#define MORSE_BATCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "morse_decoder.h"
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+    #define MORSE_BATCH_KERNEL "avx2"
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define MORSE_BATCH_SSE2 1
+    #define MORSE_BATCH_KERNEL "sse2"
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #include <arm_neon.h>
+    #define MORSE_BATCH_KERNEL "neon"
+#else
+    #define MORSE_BATCH_KERNEL "scalar"
+#endif
+
+// Class byte: element in bits 0-1, gap before the element in bits 2-3
+#define MORSE_EL_NOISE 0
+#define MORSE_EL_DIT 1
+#define MORSE_EL_DAH 2
+#define MORSE_GAP_INTRA 0
+#define MORSE_GAP_CHAR 1
+#define MORSE_GAP_WORD 2
+#define MORSE_CLASS_ELEMENT(c) ((c) & 3)
+#define MORSE_CLASS_GAP(c) ((c) >> 2)
+
+typedef struct {
+    // Inputs, in ms (defaults match the live decoder)
+    int dot;
+    int dash;
+    int tolerance;       // TIMING_TOLERANCE
+    int minPulse;        // MIN_PULSE_LENGTH
+    double charGap;      // Pause > dot * charGap ends a character (2.5)
+    double wordGap;      // Pause > dot * wordGap is a word gap (6)
+
+    // Derived by morseModelPrepare()
+    int ditMax;          // Longest pulse classified as a dit
+    int charGapMin;      // Shortest pause that ends a character
+    int wordGapMin;      // Shortest pause that is a word gap
+} MorseTimingModel;
+
+// Derive the integer thresholds. They reproduce the live decoder's rules for
+// a fixed dot/dash: a pulse within tolerance of the dit is a dit, otherwise
+// within tolerance of the dah is a dah, otherwise whichever is nearer.
+static inline void morseModelPrepare(MorseTimingModel *m) {
+    int dash = m->dash > m->dot ? m->dash : m->dot;
+    int nearest = (m->dot + dash - 1) / 2;       // 2l < dot + dash
+    int beforeDah = dash - m->tolerance - 1;     // Not yet within tolerance of the dah
+    int ditMax = nearest < beforeDah ? nearest : beforeDah;
+    if (ditMax < m->dot + m->tolerance) ditMax = m->dot + m->tolerance;
+    m->ditMax = ditMax;
+    m->charGapMin = (int)(m->dot * m->charGap) + 1;
+    m->wordGapMin = (int)(m->dot * m->wordGap) + 1;
+}
+
+// Model for a given dit/dah under a decoder's rules (params NULL: defaults)
+static inline MorseTimingModel morseModel(int dot, int dash, const MorseParams *params) {
+    MorseParams defaults;
+    if (!params) {
+        morseDefaultParams(&defaults);
+        params = &defaults;
+    }
+    MorseTimingModel m = { dot, dash, params->tolerance, params->minPulse, params->charGap, params->wordGap, 0, 0, 0 };
+    morseModelPrepare(&m);
+    return m;
+}
+
+static inline uint8_t morseClassifyOne(const MorseTimingModel *m, int32_t pause, int32_t length) {
+    int el = length < m->minPulse ? MORSE_EL_NOISE : length > m->ditMax ? MORSE_EL_DAH : MORSE_EL_DIT;
+    int gap = (pause >= m->charGapMin) + (pause >= m->wordGapMin);
+    return (uint8_t)(el | gap << 2);
+}
+
+// Classify n elements into classes[n]. Pauses and lengths must be >= 0.
+static inline void morseClassifyBatch(const MorseTimingModel *m, const int32_t *pauses,
+                                      const int32_t *lengths, uint8_t *classes, size_t n) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i minPulse = _mm256_set1_epi32(m->minPulse);
+    const __m256i ditMax = _mm256_set1_epi32(m->ditMax);
+    const __m256i charGap = _mm256_set1_epi32(m->charGapMin - 1);
+    const __m256i wordGap = _mm256_set1_epi32(m->wordGapMin - 1);
+    for (; i + 16 <= n; i += 16) {
+        __m256i codes[2];
+        for (int h = 0; h < 2; h++) {
+            __m256i len = _mm256_loadu_si256((const __m256i *)(lengths + i + h * 8));
+            __m256i pause = _mm256_loadu_si256((const __m256i *)(pauses + i + h * 8));
+            __m256i noise = _mm256_cmpgt_epi32(minPulse, len);
+            __m256i dah = _mm256_cmpgt_epi32(len, ditMax);
+            __m256i el = _mm256_andnot_si256(noise, _mm256_sub_epi32(one, dah));   // 1 or 2
+            __m256i gap = _mm256_add_epi32(_mm256_cmpgt_epi32(pause, charGap),
+                                           _mm256_cmpgt_epi32(pause, wordGap));  // 0, -1, -2
+            codes[h] = _mm256_or_si256(el, _mm256_slli_epi32(_mm256_sub_epi32(_mm256_setzero_si256(), gap), 2));
+        }
+        // Packs work per 128-bit lane: reorder so the 16 bytes come out in order
+        __m256i w = _mm256_permute4x64_epi64(_mm256_packs_epi32(codes[0], codes[1]), 0xD8);
+        __m256i b = _mm256_permute4x64_epi64(_mm256_packus_epi16(w, w), 0xD8);
+        _mm_storeu_si128((__m128i *)(classes + i), _mm256_castsi256_si128(b));
+    }
+#elif defined(MORSE_BATCH_SSE2)
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i minPulse = _mm_set1_epi32(m->minPulse);
+    const __m128i ditMax = _mm_set1_epi32(m->ditMax);
+    const __m128i charGap = _mm_set1_epi32(m->charGapMin - 1);
+    const __m128i wordGap = _mm_set1_epi32(m->wordGapMin - 1);
+    for (; i + 16 <= n; i += 16) {
+        __m128i codes[4];
+        for (int q = 0; q < 4; q++) {
+            __m128i len = _mm_loadu_si128((const __m128i *)(lengths + i + q * 4));
+            __m128i pause = _mm_loadu_si128((const __m128i *)(pauses + i + q * 4));
+            __m128i noise = _mm_cmplt_epi32(len, minPulse);
+            __m128i dah = _mm_cmpgt_epi32(len, ditMax);
+            __m128i el = _mm_andnot_si128(noise, _mm_sub_epi32(one, dah));   // 1 or 2
+            __m128i gap = _mm_add_epi32(_mm_cmpgt_epi32(pause, charGap),
+                                        _mm_cmpgt_epi32(pause, wordGap));  // 0, -1, -2
+            codes[q] = _mm_or_si128(el, _mm_slli_epi32(_mm_sub_epi32(_mm_setzero_si128(), gap), 2));
+        }
+        __m128i lo = _mm_packs_epi32(codes[0], codes[1]);
+        __m128i hi = _mm_packs_epi32(codes[2], codes[3]);
+        _mm_storeu_si128((__m128i *)(classes + i), _mm_packus_epi16(lo, hi));
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    const uint32x4_t one = vdupq_n_u32(1);
+    const int32x4_t minPulse = vdupq_n_s32(m->minPulse);
+    const int32x4_t ditMax = vdupq_n_s32(m->ditMax);
+    const int32x4_t charGap = vdupq_n_s32(m->charGapMin);
+    const int32x4_t wordGap = vdupq_n_s32(m->wordGapMin);
+    for (; i + 8 <= n; i += 8) {
+        uint16x4_t codes[2];
+        for (int h = 0; h < 2; h++) {
+            int32x4_t len = vld1q_s32(lengths + i + h * 4);
+            int32x4_t pause = vld1q_s32(pauses + i + h * 4);
+            uint32x4_t noise = vcltq_s32(len, minPulse);
+            uint32x4_t dah = vcgtq_s32(len, ditMax);
+            uint32x4_t el = vbicq_u32(vaddq_u32(one, vandq_u32(dah, one)), noise);
+            uint32x4_t gap = vaddq_u32(vandq_u32(vcgeq_s32(pause, charGap), one),
+                                       vandq_u32(vcgeq_s32(pause, wordGap), one));
+            codes[h] = vmovn_u32(vorrq_u32(el, vshlq_n_u32(gap, 2)));
+        }
+        vst1_u8(classes + i, vmovn_u16(vcombine_u16(codes[0], codes[1])));
+    }
+#endif
+    for (; i < n; i++) classes[i] = morseClassifyOne(m, pauses[i], lengths[i]);
+}
+
+// Tree position carried between morseWalkBatch() calls
+typedef struct {
+    int treePos;
+    int elementCount;
+    unsigned long unknown;   // Element sequences with no character
+} MorseWalk;
+
+static inline size_t morseWalkEmit(MorseWalk *w, char *out, size_t pos, size_t cap) {
+    if (w->elementCount > 0) {
+        char c = morseTree[w->treePos];
+        if (c == '\0') w->unknown++;
+        else if (pos < cap) out[pos++] = c;
+    }
+    w->treePos = 0;
+    w->elementCount = 0;
+    return pos;
+}
+
+// Turn class bytes into text, the way the decoder's tree walk does: a char or
+// word gap completes the pending character, a word gap then adds ' ', and
+// noise is skipped. Writes at most cap chars (no terminator) and returns the
+// count. The last character stays pending in w; pass classes = NULL, n = 0 to
+// complete it.
+static inline size_t morseWalkBatch(MorseWalk *w, const uint8_t *classes, size_t n, char *out, size_t cap) {
+    size_t pos = 0;
+    if (!classes) return morseWalkEmit(w, out, 0, cap);
+    for (size_t i = 0; i < n; i++) {
+        int el = MORSE_CLASS_ELEMENT(classes[i]);
+        if (el == MORSE_EL_NOISE) continue;
+        int gap = MORSE_CLASS_GAP(classes[i]);
+        if (gap != MORSE_GAP_INTRA) {
+            pos = morseWalkEmit(w, out, pos, cap);
+            if (gap == MORSE_GAP_WORD && pos < cap) out[pos++] = ' ';
+        }
+        if (w->treePos < 63) {
+            w->treePos = w->treePos * 2 + el;  // Dit = left child (+1), dah = right (+2)
+            w->elementCount++;
+        }
+    }
+    return pos;
+}
+
+#endif // MORSE_BATCH_H
@@ -0,0 +1,748 @@
+/*
+ * morse_decoder.h
+ * Morse decoder shared by serial_keyboard and the offline tools.
+ *
+ * All decoder state lives in a MorseDecoder, so any number of independent
+ * decoders can run side by side (one per worker thread, device, or signal).
+ * Decoded characters and classified elements are delivered through
+ * callbacks; the decoder itself never types or buffers output.
+ */
+
+#ifndef MORSE_DECODER_H
+#define MORSE_DECODER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+
+#define TIMING_TOLERANCE 50
+#define MIN_PULSE_LENGTH 30      // Filter out noise < 30ms
+#define CHARACTER_TIMEOUT_MS 1500 // Flush pending char after 1.5s of inactivity
+#define WORD_GAP_TIMEOUT_MS 500   // Add space after 0.5s of silence (if char pending)
+#define MORSE_CLF_FEATURES 4      // Length/dit, length/dah, pause/dit, previous element a dah
+#define MORSE_CLF_MAX_WEIGHT 16.0
+#define MORSE_LOCK_MAX_ELEMENT 4  // Contest mode: longest element (units) a character waits for
+
+// ============================================================
+// MORSE CODE DECODER - Binary Tree Implementation
+// ============================================================
+
+/*
+ * Binary tree structure for Morse decoding:
+ * - Start at root (index 0)
+ * - Dit (.) = go to left child = index * 2 + 1
+ * - Dah (-) = go to right child = index * 2 + 2
+ * - When pause detected, output character at current index
+ * 
+ * Tree layout (first 63 nodes, depth 5):
+ *                        [0] ROOT
+ *                       /        \
+ *                    [1]E        [2]T
+ *                   /    \      /    \
+ *                [3]I   [4]A  [5]N  [6]M
+ *               / \    / \   / \   / \
+ *             [7]S...  and so on
+ */
+
+// Morse tree - character at each node position (0=root, 1=E, 2=T, etc.)
+// '\0' means invalid/unused position
+static const char morseTree[128] = {
+    '\0',  // [0] ROOT
+    'E',   // [1] .
+    'T',   // [2] -
+    'I',   // [3] ..
+    'A',   // [4] .-
+    'N',   // [5] -.
+    'M',   // [6] --
+    'S',   // [7] ...
+    'U',   // [8] ..-
+    'R',   // [9] .-.
+    'W',   // [10] .--
+    'D',   // [11] -..
+    'K',   // [12] -.-
+    'G',   // [13] --.
+    'O',   // [14] ---
+    'H',   // [15] ....
+    'V',   // [16] ...-
+    'F',   // [17] ..-.
+    '\0',  // [18] ..--
+    'L',   // [19] .-..
+    '\n',  // [20] .-.- (AA) - Newline/Enter
+    'P',   // [21] .--.
+    'J',   // [22] .---
+    'B',   // [23] -...
+    'X',   // [24] -..-
+    'C',   // [25] -.-.
+    'Y',   // [26] -.--
+    'Z',   // [27] --..
+    'Q',   // [28] --.-
+    '\0',  // [29] ---.
+    '\0',  // [30] ----
+    '5',   // [31] .....
+    '4',   // [32] ....-
+    '\0',  // [33] ...-.
+    '3',   // [34] ...--
+    '\0',  // [35] ..-..
+    '\0',  // [36] ..-.-
+    '\0',  // [37] ..--. 
+    '2',   // [38] ..---
+    '\0',  // [39] .-...
+    '\0',  // [40] .-..-
+    '+',   // [41] .-.-.
+    '\0',  // [42] .-.-. (dup?)
+    '\0',  // [43] .-.--
+    '\0',  // [44] .--..
+    '\0',  // [45] .--.-
+    '1',   // [46] .----
+    '6',   // [47] -....
+    '=',   // [48] -...-
+    '/',   // [49] -..-.
+    '\0',  // [50] -..--
+    '\0',  // [51] -.-..
+    '\0',  // [52] -.-.-
+    '(',   // [53] -.--.
+    '\0',  // [54] -.---
+    '7',   // [55] --...
+    '\0',  // [56] --..-
+    '\0',  // [57] --.-.
+    '\0',  // [58] --.--
+    '8',   // [59] ---..
+    '\0',  // [60] ---.-
+    '9',   // [61] ----.
+    '0',   // [62] -----
+    
+    // Level 6 (Indices 63-126)
+    // Common Punctuation
+    '.',   // [84] .-.-.-  (AAA) - Period
+    ',',   // [114] --..-- (MIM) - Comma
+    '?',   // [75] ..--..  (IMI) - Question Mark
+    '\'',  // [92] .----.  (1, then dit?) Wait .---- is 1(46). 46->L(93)? No 1 is .----
+           // J(22) .--- -> R(46: 1 .----) -> L(93: .----.) - Apostrophe
+    '!',   // [106] -.-.-- (KW)  - Exclamation
+    ':',   // [71] ---...  (OS)  - Colon (O->29->59(8)->L(119)? No O=14. 14->29->...)
+           // O(14) --- -> 29(---.) -> 59(---..) -> (8)
+           // 29(---.) -> R(60: ---.-) -> ?
+           // 14(---) -> L(29) -> L(59 : 8)
+           // Wait. 8 is ---..
+           // : is ---...
+           // 59(8) -> L(119)? No. 59*2+1 = 119.
+           // So : is at 119? 
+           // Let's verify.
+           // 0->2(T)->6(M)->14(O)->29(---.)->59(8: ---..)->119(---...) 
+           // Yes. : is at 119. ???
+           // Standard : is ---...  (3 dahs, 3 dits)
+           // O (3 dahs). S (3 dits). 
+           // 14 (O). Left is 29 (---.). Left is 59 (---..). Left is 119 (---...).
+           // Yes. 119.
+    
+    // Fill specific slots
+    [75] = '?',
+    [84] = '.',
+    [93] = '\'',
+    [106] = '!', // KW digraph
+    [114] = ',',
+    [119] = ':',
+    [70] = ';', // -.-.-. (C -> R(52) -> L(105)??)
+                // C(25) -.-. -> R(52: -.-.-) -> L(105: -.-.-.)
+    [105] = ';',
+    // [20] = '\n', // Moved to line 111
+    [97] = '-',   // -....- (6 -> R(95)? No 6 is 47.)
+                  // 6(47) -.... -> R(96) is -....-
+                  // Let's verify index for -....-
+                  // T(2)->M(6)->O(14)->CH(30: ----)->0(62: -----)->Was L(125: ----.) or R(126)?
+                  // Wait. - is -....-
+                  // T(2)->M(6)->G(13: --.)->Z(27: --..)->7(55: --...)->L(111: --...-)?
+                  // No 7 is --...
+                  // - is -....-
+                  // T(2)->N(5: -.)->D(11: -..)->B(23: -...)->6(47: -....)->R(96: -....-)
+                  // So 96 is Hyphen
+    [96] = '-'
+};
+
+typedef struct MorseDecoder MorseDecoder;
+
+// Decoded character (letters are uppercase; ' ' for word gaps, '\n' for AA)
+typedef void (*MorseCharFn)(void *ctx, char c);
+// Every accepted element, as it is classified (0 = dit, 1 = dah)
+typedef void (*MorseElementFn)(void *ctx, int isDash);
+// Every element as received (ms), before the glitch filter (e.g. sidetone)
+typedef void (*MorseKeyingFn)(void *ctx, int pauseTime, int charLength);
+
+// Timing rules. The defaults are the constants above; cw_tune fits them to
+// a labelled corpus and writes a profile that morseLoadProfile() reads.
+typedef struct {
+    int tolerance;         // Pulse within this many ms of the dit/dah matches it
+    int minPulse;          // Shorter pulses are noise
+    double charGap;        // Pause > charGap x dit ends a character
+    double wordGap;        // Pause > wordGap x dit is a word gap
+    double ditCorrection;  // Pulse < ditCorrection x dit re-learns the dit
+    double dahCorrection;  // Pulse > dahCorrection x dit (but < dah) re-learns the dah
+    int dit, dah;          // Warm start (ms) instead of learning from the first elements; 0 = learn
+    int classifier;        // 1 = dit or dah from the learned model below instead of the tolerance
+    double clfWeights[MORSE_CLF_FEATURES + 1];  // Per feature, then the bias: a dah when the sum > 0
+    double clfRate;        // Online learning rate from decoded characters (0 = frozen)
+    double lockedWpm;      // Contest mode: fixed speed, nothing learned or corrected; 0 = adapt
+} MorseParams;
+
+// Profile keys for clfWeights
+static const char *const morseClfKeys[MORSE_CLF_FEATURES + 1] = {
+    "clf_dit_ratio", "clf_dah_ratio", "clf_pause", "clf_after_dah", "clf_bias"
+};
+
+static inline void morseDefaultParams(MorseParams *p) {
+    p->tolerance = TIMING_TOLERANCE;
+    p->minPulse = MIN_PULSE_LENGTH;
+    p->charGap = 2.5;
+    p->wordGap = 6.0;
+    p->ditCorrection = 0.6;
+    p->dahCorrection = 2.0;
+    p->dit = 0;
+    p->dah = 0;
+    p->classifier = 0;
+    // The model starts out as the midpoint between dit and dah
+    p->clfWeights[0] = 3.0;
+    p->clfWeights[1] = 3.0;
+    p->clfWeights[2] = 0.0;
+    p->clfWeights[3] = 0.0;
+    p->clfWeights[4] = -8.0;
+    p->clfRate = 0.005;
+    p->lockedWpm = 0;
+}
+
+typedef struct {
+    unsigned long elements;   // Accepted elements
+    unsigned long noise;      // Pulses dropped by the glitch filter
+    unsigned long dits;
+    unsigned long dahs;
+    unsigned long chars;      // Characters decoded (not counting word spaces)
+    unsigned long words;      // Word gaps seen
+    unsigned long unknown;    // Element sequences with no character
+    unsigned long timeouts;   // Characters completed by CHARACTER_TIMEOUT_MS (not the contest deadline)
+} MorseStats;
+
+struct MorseDecoder {
+    // Learned timing (-1 = not learned yet)
+    int dotTiming;
+    int dashTiming;
+
+    // Decoder state
+    int morseTreePos;                // Current position in tree (0 = root)
+    int elementCount;                // Number of elements in current character
+    unsigned long lastActivityTime;  // Last time we received data
+    int pendingWordGap;              // Flag: we've added a char but not yet a word gap
+    int lastDash;                    // Previous element of this character was a dah
+
+    // Learned classifier (params.classifier): Q12 weights, and the features
+    // (Q8) of this character's elements, trained on once it decodes
+    int32_t clfW[MORSE_CLF_FEATURES + 1];
+    int32_t clfX[8][MORSE_CLF_FEATURES];
+    unsigned char clfDash[8];   // Labels from the tolerance rules
+    int clfCount;
+    int clfLoaded;
+
+    // Contest mode (params.lockedWpm), in ms; 0 until the first element
+    int lockDah;                     // Elements this long or longer are dahs
+    int lockCharGap;                 // A pause this long ends the character
+    int lockWordGap;                 // ...and this long, the word
+    int lockDeadline;                // No element this long after the last one: the character is complete
+    int lockMinPulse;                // Glitch filter, lowered for high speeds
+
+    // Diagnostics, printed to stdout
+    int verbose;                     // Timing info per element
+    int debug;                       // Show filtered noise
+
+    MorseParams params;
+    MorseStats stats;
+
+    MorseCharFn onChar;
+    MorseElementFn onElement;
+    MorseKeyingFn onKeying;          // Optional, set after morseInit()
+    void *ctx;
+};
+
+static inline void morseInit(MorseDecoder *d, MorseCharFn onChar, MorseElementFn onElement, void *ctx) {
+    memset(d, 0, sizeof(*d));
+    d->dotTiming = -1;
+    d->dashTiming = -1;
+    morseDefaultParams(&d->params);
+    d->onChar = onChar;
+    d->onElement = onElement;
+    d->ctx = ctx;
+}
+
+static inline void morseEmitChar(MorseDecoder *d, char c) {
+    if (d->onChar) d->onChar(d->ctx, c);
+}
+
+// Add a dit (0) or dah (1) to the current sequence
+static inline void morseAddElement(MorseDecoder *d, int isDash) {
+    if (d->morseTreePos < 63) {  // Allow moving to children of nodes < 63 (up to index 126)
+        d->morseTreePos = d->morseTreePos * 2 + 1 + isDash;  // Left child for a dit, right for a dah
+        d->elementCount++;
+    }
+    d->lastDash = isDash;
+    d->stats.dits += !isDash;
+    d->stats.dahs += isDash;
+    if (d->onElement) d->onElement(d->ctx, isDash);
+}
+
+static inline void morseAddDit(MorseDecoder *d) {
+    morseAddElement(d, 0);
+}
+
+static inline void morseAddDah(MorseDecoder *d) {
+    morseAddElement(d, 1);
+}
+
+// ============================================================
+// LEARNED CLASSIFIER
+// ============================================================
+
+/*
+ * Logistic regression over four features of each element, as ratios to the
+ * decoder's running dit and dah: its length in dits, its length in dahs, the
+ * pause before it in dits, and whether the element before it in the
+ * character was a dah. Inference is a fixed-point dot product (Q8 features,
+ * Q12 weights) with no branches or floating point.
+ *
+ * Training labels come from the tolerance rules, not from the model: an
+ * element within tolerance of the running dit and not of the dah is a dit,
+ * the reverse a dah, and anything else is left out. Once a character
+ * decodes to something in the tree, each labelled element moves the weights
+ * one gradient step toward its label, so the model follows the operator
+ * without reinforcing its own misreads. morseClfSave() hands the weights
+ * back for a profile.
+ */
+
+static inline void morseClfLoad(MorseDecoder *d) {
+    for (int i = 0; i <= MORSE_CLF_FEATURES; i++) {
+        double w = d->params.clfWeights[i] * 4096.0;
+        d->clfW[i] = (int32_t)(w < 0 ? w - 0.5 : w + 0.5);
+    }
+    d->clfLoaded = 1;
+}
+
+// The trained weights (unchanged unless the classifier has run)
+static inline void morseClfSave(const MorseDecoder *d, MorseParams *p) {
+    if (!d->clfLoaded) return;
+    for (int i = 0; i <= MORSE_CLF_FEATURES; i++) p->clfWeights[i] = d->clfW[i] / 4096.0;
+}
+
+static inline void morseClfFeatures(const MorseDecoder *d, int pauseTime, int charLength, int32_t x[MORSE_CLF_FEATURES]) {
+    int32_t dit = d->dotTiming > 0 ? d->dotTiming : 1, dah = d->dashTiming > 0 ? d->dashTiming : 1;
+    x[0] = (int32_t)charLength * 256 / dit;
+    x[1] = (int32_t)charLength * 256 / dah;
+    x[2] = d->elementCount > 0 ? (int32_t)pauseTime * 256 / dit : 256;  // A character gap says nothing
+    x[3] = d->elementCount > 0 && d->lastDash ? 256 : 0;
+    for (int i = 0; i < MORSE_CLF_FEATURES; i++) x[i] = x[i] > 4095 ? 4095 : x[i];
+}
+
+// Q12 log-odds of a dah
+static inline int32_t morseClfScore(const int32_t w[MORSE_CLF_FEATURES + 1], const int32_t x[MORSE_CLF_FEATURES]) {
+    int32_t z = w[MORSE_CLF_FEATURES];
+    for (int i = 0; i < MORSE_CLF_FEATURES; i++) z += (w[i] * x[i]) >> 8;
+    return z;
+}
+
+// One gradient step per element of the character just decoded. The
+// sigmoid is approximated as 0.5 + 0.5 * t / (1 + |t|), t = z / 2.
+static inline void morseClfTrain(MorseDecoder *d) {
+    const int32_t limit = (int32_t)(MORSE_CLF_MAX_WEIGHT * 4096);
+    float rate = (float)d->params.clfRate;
+    for (int k = 0; k < d->clfCount; k++) {
+        float t = morseClfScore(d->clfW, d->clfX[k]) / 8192.0f;
+        float p = 0.5f + 0.5f * t / (1.0f + (t < 0 ? -t : t));
+        float g = rate * ((d->clfDash[k] ? 1.0f : 0.0f) - p);
+        for (int i = 0; i <= MORSE_CLF_FEATURES; i++) {
+            int32_t x = i < MORSE_CLF_FEATURES ? d->clfX[k][i] : 256;
+            int32_t w = d->clfW[i] + (int32_t)(g * x * 16.0f);
+            d->clfW[i] = w > limit ? limit : w < -limit ? -limit : w;
+        }
+    }
+}
+
+// Replaces the tolerance test; the running dit and dah follow as before
+static inline void morseClfClassify(MorseDecoder *d, int pauseTime, int charLength) {
+    int32_t x[MORSE_CLF_FEATURES];
+    morseClfFeatures(d, pauseTime, charLength, x);
+    int dash = morseClfScore(d->clfW, x) > 0;
+    int nearDit = abs(charLength - d->dotTiming) <= d->params.tolerance;
+    int nearDah = abs(charLength - d->dashTiming) <= d->params.tolerance;
+    if (nearDit != nearDah && d->clfCount < 8) {
+        memcpy(d->clfX[d->clfCount], x, sizeof(x));
+        d->clfDash[d->clfCount++] = (unsigned char)nearDah;
+    }
+    if (dash) {
+        morseAddDah(d);
+        if (nearDah) d->dashTiming = (d->dashTiming * 3 + charLength) / 4;
+    } else {
+        morseAddDit(d);
+        if (nearDit) d->dotTiming = (d->dotTiming * 3 + charLength) / 4;
+    }
+}
+
+// Complete current character and output it
+static inline void morseCompleteCharacter(MorseDecoder *d) {
+    if (d->clfCount && d->elementCount > 0 && d->morseTreePos < 128 && morseTree[d->morseTreePos] != '\0' &&
+        d->params.clfRate > 0) {
+        morseClfTrain(d);
+    }
+    d->clfCount = 0;
+    if (d->elementCount > 0 && d->morseTreePos < 128) {
+        char c = morseTree[d->morseTreePos];
+        if (c != '\0') {
+            morseEmitChar(d, c);
+            d->stats.chars++;
+            d->pendingWordGap = 1;  // We output a char, might need word gap later
+            if (d->verbose) {
+                // Visualize special chars
+                if (c == '\n') printf(" [=ENTER] ");
+                else printf(" [=%c] ", c);
+            }
+        } else {
+            d->stats.unknown++;
+            if (d->verbose) printf(" [?] ");  // Unknown sequence
+        }
+    }
+    // Reset for next character
+    d->morseTreePos = 0;
+    d->elementCount = 0;
+    d->lastDash = 0;
+}
+
+// Check for timeout at time `now` (ms, same clock as lastActivityTime).
+// Returns 1 if a pending character was completed.
+static inline int morseCheckTimeout(MorseDecoder *d, unsigned long now) {
+    if (d->lastActivityTime == 0) return 0;  // No activity yet
+    
+    unsigned long elapsed = now - d->lastActivityTime;
+    int completed = 0;
+    
+    // Contest mode: complete at the deadline rather than the timeout
+    if (d->lockDeadline && d->elementCount > 0 && elapsed >= (unsigned long)d->lockDeadline) {
+        morseCompleteCharacter(d);
+        completed = 1;
+    }
+
+    // If we have a pending character and enough time has passed, complete it
+    if (d->elementCount > 0 && elapsed > CHARACTER_TIMEOUT_MS) {
+        if (d->verbose) printf(" [timeout] ");
+        d->stats.timeouts++;
+        morseCompleteCharacter(d);
+        completed = 1;
+    }
+    
+    // If we completed a char but haven't added word gap yet, add space after shorter timeout
+    if (d->pendingWordGap && elapsed > WORD_GAP_TIMEOUT_MS && d->elementCount == 0) {
+        // Don't add space - word gaps come naturally from pause detection
+        // Just reset the flag
+        d->pendingWordGap = 0;
+    }
+    return completed;
+}
+
+// Milliseconds from `now` until morseCheckTimeout() completes the pending
+// character (0 if it is due), or -1 if nothing is pending
+static inline long morseUntilTimeout(const MorseDecoder *d, unsigned long now) {
+    if (d->lastActivityTime == 0 || d->elementCount == 0) return -1;
+    long limit = d->lockDeadline ? d->lockDeadline : CHARACTER_TIMEOUT_MS + 1;
+    long left = limit - (long)(now - d->lastActivityTime);
+    return left > 0 ? left : 0;
+}
+
+static inline int morseIsClose(const MorseDecoder *d, int val, int target) {
+    return abs(val - target) <= d->params.tolerance;
+}
+
+// ============================================================
+// CONTEST MODE
+// ============================================================
+
+/*
+ * For nets and contests keyed at one agreed speed. params.lockedWpm fixes
+ * the unit at 1200 / WPM ms (PARIS) and the decoder stops adapting: no
+ * auto-learn, no CORRECTION, no running averages. An element of 2 units or
+ * more is a dah; a pause of 2 units or more ends the character (halfway to
+ * the nominal 3) and one of 5 or more the word (halfway to 7).
+ *
+ * The device reports an element at key-up, so silence after the last one
+ * can't be told from a key held down. If no element has arrived within
+ * 2 + MORSE_LOCK_MAX_ELEMENT units (a character gap, then the longest
+ * element keyed in it), none of this character is coming: morseCheckTimeout()
+ * completes it at that deadline instead of waiting for the next character
+ * or CHARACTER_TIMEOUT_MS.
+ */
+
+static inline void morseLock(MorseDecoder *d) {
+    double unit = 1200.0 / d->params.lockedWpm;
+    d->dotTiming = (int)(unit + 0.5);
+    d->dashTiming = (int)(3 * unit + 0.5);
+    d->lockDah = (int)(2 * unit + 0.5);
+    d->lockCharGap = (int)(2 * unit + 0.5);
+    d->lockWordGap = (int)(5 * unit + 0.5);
+    d->lockDeadline = (int)((2 + MORSE_LOCK_MAX_ELEMENT) * unit + 0.5);
+    d->lockMinPulse = d->params.minPulse < unit / 2 ? d->params.minPulse : (int)(unit / 2);
+}
+
+static inline void morseLockedElement(MorseDecoder *d, int pauseTime, int charLength) {
+    if (d->stats.elements == 1) {
+        // The first pause is from before the session, so it ends nothing
+    } else if (pauseTime >= d->lockCharGap) {
+        morseCompleteCharacter(d);  // Usually already done by the deadline
+        if (pauseTime >= d->lockWordGap) {
+            morseEmitChar(d, ' ');
+            d->stats.words++;
+            if (d->verbose) printf(" ");
+        }
+    }
+    morseAddElement(d, charLength >= d->lockDah);
+}
+
+// Classify one element: pauseTime ms of silence followed by charLength ms of key down
+static inline void morseProcessElement(MorseDecoder *d, int pauseTime, int charLength) {
+    if (d->params.lockedWpm > 0 && !d->lockDeadline) morseLock(d);
+    if (d->onKeying) d->onKeying(d->ctx, pauseTime, charLength);
+
+    // Glitch Filter
+    if (charLength < (d->lockDeadline ? d->lockMinPulse : d->params.minPulse)) {
+        d->stats.noise++;
+        if (d->debug) printf("[noise:%d] ", charLength);
+        return;
+    }
+    d->stats.elements++;
+    
+    if (d->verbose) printf("[p=%d l=%d] ", pauseTime, charLength);
+
+    if (d->params.lockedWpm > 0) {
+        morseLockedElement(d, pauseTime, charLength);
+        return;
+    }
+
+    // Warm start from a calibrated profile. The first pause is from before
+    // the session, so it ends nothing.
+    int first = d->dotTiming == -1;
+    if (first && d->params.dit > 0) {
+        d->dotTiming = d->params.dit;
+        if (d->params.dah > d->params.dit) d->dashTiming = d->params.dah;
+    }
+    if (d->params.classifier && !d->clfLoaded) morseClfLoad(d);
+
+    // Auto-learn mode
+    if (d->dotTiming == -1) {
+        d->dotTiming = charLength;
+        if (d->verbose) printf("[learned dit=%d] ", d->dotTiming);
+        morseAddDit(d);
+        return;
+    }
+    
+    // Check for character/word boundary based on pause time
+    // Character gap = 3 dit units, Word gap = 7 dit units
+    // We use 2.5x and 6x as thresholds by default (with some tolerance)
+    if (!first && d->dotTiming > 0 && pauseTime > d->dotTiming * d->params.charGap) {
+        // End of character detected - decode what we have
+        morseCompleteCharacter(d);
+        
+        // Check for word gap (7 dit units, use 6x threshold)
+        if (pauseTime > d->dotTiming * d->params.wordGap) {
+            morseEmitChar(d, ' ');
+            d->stats.words++;
+            if (d->verbose) printf(" ");
+        }
+    }
+    
+    if (d->dashTiming == -1) {
+        if (morseIsClose(d, charLength, d->dotTiming)) {
+            morseAddDit(d);
+        } else {
+            if (charLength > d->dotTiming) {
+                d->dashTiming = charLength;
+            } else {
+                d->dashTiming = d->dotTiming;
+                d->dotTiming = charLength;
+            }
+            if (d->verbose) printf("[learned dit=%d dah=%d] ", d->dotTiming, d->dashTiming);
+            if (charLength == d->dotTiming) {
+                morseAddDit(d);
+            } else {
+                morseAddDah(d);
+            }
+        }
+        return;
+    }
+    
+    // Self-Correction
+    if (charLength < d->dotTiming * d->params.ditCorrection && charLength > d->params.minPulse) {
+        if (d->verbose) printf("[CORRECTION: dit=%d] ", charLength);
+        d->dashTiming = d->dotTiming;
+        d->dotTiming = charLength;
+        morseAddDit(d);
+        return;
+    }
+    
+    if (d->dashTiming > d->dotTiming * 6 && charLength > d->dotTiming * d->params.dahCorrection && charLength < d->dashTiming) {
+        if (d->verbose) printf("[CORRECTION: dah=%d] ", charLength);
+        d->dashTiming = charLength;
+        morseAddDah(d);
+        return;
+    }
+
+    // Classify
+    if (d->params.classifier) {
+        morseClfClassify(d, pauseTime, charLength);
+        return;
+    }
+    if (morseIsClose(d, charLength, d->dotTiming)) {
+        morseAddDit(d);
+        d->dotTiming = (d->dotTiming * 3 + charLength) / 4;
+    } else if (morseIsClose(d, charLength, d->dashTiming)) {
+        morseAddDah(d);
+        d->dashTiming = (d->dashTiming * 3 + charLength) / 4;
+    } else {
+        int dotDiff = abs(charLength - d->dotTiming);
+        int dashDiff = abs(charLength - d->dashTiming);
+        if (dotDiff < dashDiff) {
+            morseAddDit(d);
+        } else {
+            morseAddDah(d);
+        }
+    }
+}
+
+// Process a command starting at the first comma (e.g. ",100,200")
+// Returns pointer to end of command (digits), or NULL if invalid
+static inline char *morseProcessCommandWithComma(MorseDecoder *d, char *firstComma) {
+    // Parse pause time (between first and second comma)
+    char pauseStr[32] = {0};
+    char *p = firstComma + 1;
+    char *dst = pauseStr;
+    while (*p && isdigit((unsigned char)*p) && dst - pauseStr < 31) {
+        *dst++ = *p++;
+    }
+    int pauseTime = atoi(pauseStr);
+    
+    char *secondComma = strchr(firstComma + 1, ',');
+    if (!secondComma) return NULL;
+    
+    // Parse length cleanly
+    char lengthStr[32] = {0};
+    char *src = secondComma + 1;
+    dst = lengthStr;
+    char *endOfDigits = src;
+    
+    while (*src && isdigit((unsigned char)*src) && dst - lengthStr < 31) {
+        *dst++ = *src;
+        endOfDigits = src; // Keep track of last digit
+        src++;
+    }
+    
+    int charLength = atoi(lengthStr);
+    if (charLength == 0) return NULL;
+    
+    morseProcessElement(d, pauseTime, charLength);
+    return endOfDigits;
+}
+
+static inline void morseHandleLine(MorseDecoder *d, char *line) {
+    if (strlen(line) == 0) return;
+    
+    if (d->verbose) printf("\n>> %s -> ", line);
+    
+    char *cursor = line;
+    // Scan for 'S' or 's', then find the next comma pattern
+    while ((cursor = strpbrk(cursor, "Ss"))) {
+        // We found an 'S'. Now look for the next comma
+        char *comma = strchr(cursor, ',');
+        
+        // If no comma, or comma is too far (sanity check: >20 chars away?), break
+        if (!comma) break;
+        if (comma - cursor > 20) {
+            cursor++; // Too far, this 'S' isn't a prefix
+            continue;
+        }
+
+        // Check pattern from comma: ,digits,digits
+        if (isdigit((unsigned char)*(comma+1))) {
+            char *secondComma = strchr(comma + 1, ',');
+            if (secondComma && isdigit((unsigned char)*(secondComma+1))) {
+                // Found valid pattern associated with this 'S'
+                char *end = morseProcessCommandWithComma(d, comma);
+                if (end) {
+                    cursor = end;
+                    continue;
+                }
+            }
+        }
+        cursor++;
+    }
+    
+    if (d->verbose) { printf("\n"); fflush(stdout); }
+}
+
+// ============================================================
+// PROFILES
+// ============================================================
+
+/*
+ * A profile is a text file of "key = value" lines ('#' starts a comment):
+ *   tolerance, min_pulse (ms), char_gap, word_gap, dit_correction,
+ *   dah_correction (multiples of the dit), dit, dah (warm start, ms),
+ *   classifier (1 = learned dit/dah model), clf_rate and its weights
+ *   clf_dit_ratio, clf_dah_ratio, clf_pause, clf_after_dah, clf_bias,
+ *   locked_wpm (contest mode).
+ * Missing keys keep their value.
+ */
+
+// Returns 0 on success, -1 if the file can't be read or has an unknown key
+static inline int morseLoadProfile(MorseParams *p, const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    char line[256];
+    int rc = 0;
+    while (fgets(line, sizeof(line), f)) {
+        char *hash = strchr(line, '#');
+        if (hash) *hash = '\0';
+        char key[64];
+        double value;
+        if (sscanf(line, " %63[a-z_] = %lf", key, &value) != 2) continue;
+        if (strcmp(key, "tolerance") == 0) p->tolerance = (int)value;
+        else if (strcmp(key, "min_pulse") == 0) p->minPulse = (int)value;
+        else if (strcmp(key, "char_gap") == 0) p->charGap = value;
+        else if (strcmp(key, "word_gap") == 0) p->wordGap = value;
+        else if (strcmp(key, "dit_correction") == 0) p->ditCorrection = value;
+        else if (strcmp(key, "dah_correction") == 0) p->dahCorrection = value;
+        else if (strcmp(key, "dit") == 0) p->dit = (int)value;
+        else if (strcmp(key, "dah") == 0) p->dah = (int)value;
+        else if (strcmp(key, "classifier") == 0) p->classifier = (int)value;
+        else if (strcmp(key, "clf_rate") == 0) p->clfRate = value;
+        else if (strcmp(key, "locked_wpm") == 0) p->lockedWpm = value;
+        else {
+            int k = 0;
+            while (k <= MORSE_CLF_FEATURES && strcmp(key, morseClfKeys[k]) != 0) k++;
+            if (k <= MORSE_CLF_FEATURES) p->clfWeights[k] = value;
+            else rc = -1;
+        }
+    }
+    fclose(f);
+    return rc;
+}
+
+static inline void morseWriteProfile(FILE *f, const MorseParams *p) {
+    fprintf(f, "tolerance = %d\n", p->tolerance);
+    fprintf(f, "min_pulse = %d\n", p->minPulse);
+    fprintf(f, "char_gap = %g\n", p->charGap);
+    fprintf(f, "word_gap = %g\n", p->wordGap);
+    fprintf(f, "dit_correction = %g\n", p->ditCorrection);
+    fprintf(f, "dah_correction = %g\n", p->dahCorrection);
+    if (p->dit > 0) fprintf(f, "dit = %d\n", p->dit);
+    if (p->dah > 0) fprintf(f, "dah = %d\n", p->dah);
+    if (p->classifier) {
+        fprintf(f, "classifier = %d\n", p->classifier);
+        fprintf(f, "clf_rate = %g\n", p->clfRate);
+        for (int k = 0; k <= MORSE_CLF_FEATURES; k++) fprintf(f, "%s = %.4f\n", morseClfKeys[k], p->clfWeights[k]);
+    }
+    if (p->lockedWpm > 0) fprintf(f, "locked_wpm = %g\n", p->lockedWpm);
+}
+
+#endif // MORSE_DECODER_H
@@ -1,17 +1,18 @@
 /*
  * serial_keyboard.c
  * Cross-Platform CW Hotline to Keyboard converter
- * Works on macOS (Native CoreGraphics) and Windows (Native API)
+ * Works on macOS (Native CoreGraphics), Windows (Native API) and Linux
+ * (a uinput virtual keyboard)
  * 
- * Compile macOS: make
+ * Compile macOS/Linux: make
  * Compile Windows: gcc -o serial_keyboard.exe serial_keyboard.c -luser32
  */
 
 #ifdef _WIN32
     #include <windows.h>
     #include <conio.h>
-    #define sleep_ms(x) Sleep(x)
     #define strncasecmp _strnicmp
+    #define strcasecmp _stricmp
     typedef HANDLE SERIAL_HANDLE;
     #define INVALID_SERIAL_HANDLE INVALID_HANDLE_VALUE
 #else
@@ -21,8 +22,15 @@
     #include <errno.h>  // Added for error checking
     #include <sys/select.h>
     #include <sys/time.h>
-    #include <ApplicationServices/ApplicationServices.h>
-    #define sleep_ms(x) usleep((x)*1000)
+    #include <dirent.h>
+    #include <poll.h>
+    #include <sys/ioctl.h>
+    #ifdef __APPLE__
+        #include <ApplicationServices/ApplicationServices.h>
+    #elif defined(__linux__)
+        #include <linux/input.h>
+        #include <linux/uinput.h>
+    #endif
     typedef int SERIAL_HANDLE;
     #define INVALID_SERIAL_HANDLE -1
 #endif
@@ -31,6 +39,22 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <signal.h>
+
+#include "cw_capture.h"
+#include "cw_archive.h"
+#include "morse_decoder.h"
+#include "cw_batch.h"
+#include "cw_clock.h"
+#include "cw_audio.h"
+#include "cw_sidetone.h"
+#include "cw_keyer.h"
+#include "cw_timeline.h"
+#include "cw_calibrate.h"
+#include "cw_score.h"
+#include "cw_complete.h"
+#include "cw_expand.h"
+#include "cw_qso.h"
 
 // ============================================================
 // CONFIGURATION
@@ -38,189 +62,54 @@
 
 #ifdef _WIN32
   #define DEFAULT_PORT "COM3"
-#else
+#elif defined(__APPLE__)
   #define DEFAULT_PORT "/dev/tty.usbserial-11240"
+#else
+  #define DEFAULT_PORT "/dev/ttyUSB0"
 #endif
 
 #define DEFAULT_BAUD 115200
-#define TIMING_TOLERANCE 50
-#define MIN_PULSE_LENGTH 30      // Filter out noise < 30ms
-#define CHARACTER_TIMEOUT_MS 1500 // Flush pending char after 1.5s of inactivity
-#define WORD_GAP_TIMEOUT_MS 500   // Add space after 0.5s of silence (if char pending)
 
 // Global Config
 static char dotChar = 'z';
 static char dashChar = 'x';
-static int dotTiming = -1;
-static int dashTiming = -1;
 static int debugMode = 0;
 static int quietMode = 0;
 static int verboseMode = 0;  // Show raw serial data and timing info
 static int keyboardMode = 0; // Full keyboard mode - type decoded characters
 static int lowercaseMode = 0; // Output lowercase instead of uppercase (default)
+static int noKeysMode = 0;    // Decode to the console only, never touch the keyboard
+static MorseParams decoderParams; // Timing rules (defaults, or --profile)
 
 // Platform Specific Key Codes
 #ifdef __APPLE__
     static CGEventRef dotDown = NULL, dotUp = NULL;
     static CGEventRef dashDown = NULL, dashUp = NULL;
+#elif defined(__linux__)
+    static int uinputFd = -1;     // Virtual keyboard, -1 = none
+    static int dotKey = KEY_Z, dashKey = KEY_X;
 #endif
 
 // ============================================================
-// MORSE CODE DECODER - Binary Tree Implementation
+// DECODED OUTPUT
 // ============================================================
 
-/*
- * Binary tree structure for Morse decoding:
- * - Start at root (index 0)
- * - Dit (.) = go to left child = index * 2 + 1
- * - Dah (-) = go to right child = index * 2 + 2
- * - When pause detected, output character at current index
- * 
- * Tree layout (first 63 nodes, depth 5):
- *                        [0] ROOT
- *                       /        \
- *                    [1]E        [2]T
- *                   /    \      /    \
- *                [3]I   [4]A  [5]N  [6]M
- *               / \    / \   / \   / \
- *             [7]S...  and so on
- */
-
-// Morse tree - character at each node position (0=root, 1=E, 2=T, etc.)
-// '\0' means invalid/unused position
-static const char morseTree[128] = {
-    '\0',  // [0] ROOT
-    'E',   // [1] .
-    'T',   // [2] -
-    'I',   // [3] ..
-    'A',   // [4] .-
-    'N',   // [5] -.
-    'M',   // [6] --
-    'S',   // [7] ...
-    'U',   // [8] ..-
-    'R',   // [9] .-.
-    'W',   // [10] .--
-    'D',   // [11] -..
-    'K',   // [12] -.-
-    'G',   // [13] --.
-    'O',   // [14] ---
-    'H',   // [15] ....
-    'V',   // [16] ...-
-    'F',   // [17] ..-.
-    '\0',  // [18] ..--
-    'L',   // [19] .-..
-    '\n',  // [20] .-.- (AA) - Newline/Enter
-    'P',   // [21] .--.
-    'J',   // [22] .---
-    'B',   // [23] -...
-    'X',   // [24] -..-
-    'C',   // [25] -.-.
-    'Y',   // [26] -.--
-    'Z',   // [27] --..
-    'Q',   // [28] --.-
-    '\0',  // [29] ---.
-    '\0',  // [30] ----
-    '5',   // [31] .....
-    '4',   // [32] ....-
-    '\0',  // [33] ...-.
-    '3',   // [34] ...--
-    '\0',  // [35] ..-..
-    '\0',  // [36] ..-.-
-    '\0',  // [37] ..--. 
-    '2',   // [38] ..---
-    '\0',  // [39] .-...
-    '\0',  // [40] .-..-
-    '+',   // [41] .-.-.
-    '\0',  // [42] .-.-. (dup?)
-    '\0',  // [43] .-.--
-    '\0',  // [44] .--..
-    '\0',  // [45] .--.-
-    '1',   // [46] .----
-    '6',   // [47] -....
-    '=',   // [48] -...-
-    '/',   // [49] -..-.
-    '\0',  // [50] -..--
-    '\0',  // [51] -.-..
-    '\0',  // [52] -.-.-
-    '(',   // [53] -.--.
-    '\0',  // [54] -.---
-    '7',   // [55] --...
-    '\0',  // [56] --..-
-    '\0',  // [57] --.-.
-    '\0',  // [58] --.--
-    '8',   // [59] ---..
-    '\0',  // [60] ---.-
-    '9',   // [61] ----.
-    '0',   // [62] -----
-    
-    // Level 6 (Indices 63-126)
-    // Common Punctuation
-    '.',   // [84] .-.-.-  (AAA) - Period
-    ',',   // [114] --..-- (MIM) - Comma
-    '?',   // [75] ..--..  (IMI) - Question Mark
-    '\'',  // [92] .----.  (1, then dit?) Wait .---- is 1(46). 46->L(93)? No 1 is .----
-           // J(22) .--- -> R(46: 1 .----) -> L(93: .----.) - Apostrophe
-    '!',   // [106] -.-.-- (KW)  - Exclamation
-    ':',   // [71] ---...  (OS)  - Colon (O->29->59(8)->L(119)? No O=14. 14->29->...)
-           // O(14) --- -> 29(---.) -> 59(---..) -> (8)
-           // 29(---.) -> R(60: ---.-) -> ?
-           // 14(---) -> L(29) -> L(59 : 8)
-           // Wait. 8 is ---..
-           // : is ---...
-           // 59(8) -> L(119)? No. 59*2+1 = 119.
-           // So : is at 119? 
-           // Let's verify.
-           // 0->2(T)->6(M)->14(O)->29(---.)->59(8: ---..)->119(---...) 
-           // Yes. : is at 119. ???
-           // Standard : is ---...  (3 dahs, 3 dits)
-           // O (3 dahs). S (3 dits). 
-           // 14 (O). Left is 29 (---.). Left is 59 (---..). Left is 119 (---...).
-           // Yes. 119.
-    
-    // Fill specific slots
-    [75] = '?',
-    [84] = '.',
-    [93] = '\'',
-    [106] = '!', // KW digraph
-    [114] = ',',
-    [119] = ':',
-    [70] = ';', // -.-.-. (C -> R(52) -> L(105)??)
-                // C(25) -.-. -> R(52: -.-.-) -> L(105: -.-.-.)
-    [105] = ';',
-    // [20] = '\n', // Moved to line 111
-    [97] = '-',   // -....- (6 -> R(95)? No 6 is 47.)
-                  // 6(47) -.... -> R(96) is -....-
-                  // Let's verify index for -....-
-                  // T(2)->M(6)->O(14)->CH(30: ----)->0(62: -----)->Was L(125: ----.) or R(126)?
-                  // Wait. - is -....-
-                  // T(2)->M(6)->G(13: --.)->Z(27: --..)->7(55: --...)->L(111: --...-)?
-                  // No 7 is --...
-                  // - is -....-
-                  // T(2)->N(5: -.)->D(11: -..)->B(23: -...)->6(47: -....)->R(96: -....-)
-                  // So 96 is Hyphen
-    [96] = '-'
-};
-
 // Forward declaration for type_character (defined later in platform layer)
 void type_character(char c);
+void type_text(const char *s);
 
-// Decoder state
-static int morseTreePos = 0;      // Current position in tree (0 = root)
-static int elementCount = 0;      // Number of elements in current character
+// The decoder (see morse_decoder.h) and what it has produced so far
+static MorseDecoder decoder;
 static char decodedBuffer[256];   // Buffer for decoded text
 static int decodedPos = 0;        // Position in decoded buffer
-static unsigned long lastActivityTime = 0;  // Last time we received data
-static int pendingWordGap = 0;    // Flag: we've added a char but not yet a word gap
 
-// Cross-platform millisecond timer
+// Every timeout and sleep in decoding and key injection goes through this
+// clock (virtual with --virtual-clock, see cw_clock.h)
+static CwClock appClock = CWCLOCK_REAL;
+#define sleep_ms(x) cwclock_sleep(&appClock, (x))
+
 static unsigned long getCurrentTimeMs(void) {
-#ifdef _WIN32
-    return GetTickCount();
-#else
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    return (unsigned long)(tv.tv_sec * 1000 + tv.tv_usec / 1000);
-#endif
+    return cwclock_now(&appClock);
 }
 
 // Flush decoded buffer to output
@@ -235,85 +124,217 @@ static void flushDecoded(void) {
     }
 }
 
-// Add character to decoded buffer (and optionally type it)
-static void addDecodedChar(char c) {
-    // Apply case conversion (default: uppercase, Morse standard)
-    if (c >= 'A' && c <= 'Z' && lowercaseMode) {
-        c = c - 'A' + 'a';  // Convert to lowercase
-    }
-    // Note: Morse tree already stores uppercase, so no conversion needed for uppercase mode
-    
-    // In keyboard mode, actually type the character
-    if (keyboardMode) {
-        type_character(c);
-    }
-    
-    if (decodedPos < sizeof(decodedBuffer) - 1) {
-        decodedBuffer[decodedPos++] = c;
+// Abbreviation and macro expansion (--expand), NULL when off
+static CwExpand expander;
+static CwExpand *expanding = NULL;
+
+// QSO log (--log), NULL when off
+static CwQso qsoLog;
+static CwQso *logging = NULL;
+
+// Word completion (--complete), NULL when off
+static CwComplete completer;
+static CwComplete *completing = NULL;
+static char completeKey = '=';        // Prosign that accepts the offer (BT)
+static FILE *completeSink = NULL;     // Every offer as "<prefix>\t<word>" lines
+static int completeHints = 0;         // Show the offer on the console
+static int justCompleted = 0;         // Swallow the word gap after an accepted word
+
+static char outputCase(char c) {
+    return c >= 'A' && c <= 'Z' && lowercaseMode ? c - 'A' + 'a' : c;
+}
+
+// Text on its way out: typed in keyboard mode (more than one character as
+// one injection) and buffered for the console
+static void outputText(const char *s, size_t n) {
+    char text[CWEXP_MAX_TEXT + 2 * CWEXP_MAX_KEY + 8];
+    while (n > 0) {
+        size_t len = n < sizeof(text) - 1 ? n : sizeof(text) - 1;
+        for (size_t i = 0; i < len; i++) text[i] = outputCase(s[i]);
+        text[len] = '\0';
+        s += len;
+        n -= len;
+
+        if (keyboardMode && !noKeysMode) {
+            if (len == 1) type_character(text[0]);
+            else type_text(text);
+        }
+        for (size_t i = 0; i < len; i++) {
+            if (decodedPos < sizeof(decodedBuffer) - 1) {
+                decodedBuffer[decodedPos++] = text[i];
+            }
+            // Auto-flush every 64 chars or on space/newline
+            if (decodedPos >= 64 || text[i] == ' ' || text[i] == '\n') {
+                flushDecoded();
+            }
+        }
+        if (completeHints) flushDecoded();
     }
-    // Auto-flush every 64 chars or on space/newline
-    if (decodedPos >= 64 || c == ' ' || c == '\n') {
-        flushDecoded();
+}
+
+// Decoded text passes the expander, if any, on its way out
+static void emitText(const char *s, size_t n) {
+    if (!expanding) {
+        outputText(s, n);
+        return;
     }
+    for (size_t i = 0; i < n; i++) cwexp_char(expanding, s[i]);
+    outputText(expanding->outText, expanding->outLen);
+    expanding->outLen = 0;
 }
 
-// Complete current character and output it
-static void completeCharacter(void) {
-    if (elementCount > 0 && morseTreePos < 128) {
-        char c = morseTree[morseTreePos];
-        if (c != '\0') {
-            addDecodedChar(c);
-            pendingWordGap = 1;  // We output a char, might need word gap later
-            if (verboseMode) {
-                // Visualize special chars
-                if (c == '\n') printf(" [=ENTER] ");
-                else printf(" [=%c] ", c);
-            }
-        } else if (verboseMode) {
-            printf(" [?] ");  // Unknown sequence
+// Decoded text (before expansion) goes to the QSO log
+static void logText(const char *s, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (cwqso_char(logging, s[i], getCurrentTimeMs()) && !quietMode) {
+            flushDecoded();
+            printf("\n[*] Logged %s\n", logging->last);
+            fflush(stdout);
         }
     }
-    // Reset for next character
-    morseTreePos = 0;
-    elementCount = 0;
 }
 
-// Check for timeout and flush pending character
-static void checkTimeout(void) {
-    if (lastActivityTime == 0) return;  // No activity yet
-    
-    unsigned long now = getCurrentTimeMs();
-    unsigned long elapsed = now - lastActivityTime;
-    
-    // If we have a pending character and enough time has passed, complete it
-    if (elementCount > 0 && elapsed > CHARACTER_TIMEOUT_MS) {
-        if (verboseMode) printf(" [timeout] ");
-        completeCharacter();
-        flushDecoded();
+// The word is over (end of input, or a long silence): out with anything
+// the expander is holding back
+static void releaseExpanded(void) {
+    if (!expanding || !expanding->heldLen) return;
+    cwexp_flush(expanding);
+    outputText(expanding->outText, expanding->outLen);
+    expanding->outLen = 0;
+}
+
+// Show the current offer: dimmed after the cursor, and to the sink
+static void showCompletion(void) {
+    const char *word = completing->offer ? cwcomp_word(completing, completing->offer) : "";
+    if (completeSink) {
+        fprintf(completeSink, "%s\t%s\n", completing->word, word);
+        fflush(completeSink);
     }
-    
-    // If we completed a char but haven't added word gap yet, add space after shorter timeout
-    if (pendingWordGap && elapsed > WORD_GAP_TIMEOUT_MS && elementCount == 0) {
-        // Don't add space - word gaps come naturally from pause detection
-        // Just reset the flag
-        pendingWordGap = 0;
+    if (completeHints) {
+        // Not while the expander holds the word back: it isn't on screen
+        const char *rest = *word && !(expanding && expanding->heldLen) ? word + completing->len : "";
+        printf("\x1b[K");
+        if (*rest) {
+            printf("\x1b[2m");
+            for (const char *r = rest; *r; r++) putchar(outputCase(*r));
+            printf("\x1b[0m\x1b[%dD", (int)strlen(rest));
+        }
+        fflush(stdout);
     }
 }
 
-// Add a dit to the current sequence
-static void addDit(void) {
-    if (morseTreePos < 63) {  // Allow moving to children of nodes < 63 (up to index 126)
-        morseTreePos = morseTreePos * 2 + 1;  // Left child
-        elementCount++;
+// The accept prosign: inject the rest of the offered word and a space in one go
+static void acceptCompletion(void) {
+    const char *rest = cwcomp_accept(completing);
+    if (!rest) return;  // Nothing offered: the prosign is dropped
+    char text[CWCOMP_MAX_WORD + 2];
+    size_t n = strlen(rest);
+    memcpy(text, rest, n);
+    text[n++] = ' ';
+    if (completeHints) printf("\x1b[K");
+    if (logging) logText(text, n);
+    emitText(text, n);
+    flushDecoded();
+    cwcomp_char(completing, ' ');  // The whole word goes into the history
+    showCompletion();
+    justCompleted = 1;
+}
+
+// Add character to decoded buffer (and optionally type it)
+static void addDecodedChar(char c) {
+    if (completing) {
+        if (c == completeKey) {
+            acceptCompletion();
+            return;
+        }
+        int skip = c == ' ' && justCompleted;  // Already typed with the word
+        justCompleted = 0;
+        if (skip) return;
+    }
+
+    if (logging) logText(&c, 1);
+
+    // Case conversion (default: uppercase, Morse standard) and, in keyboard
+    // mode, typing happen on the way out
+    emitText(&c, 1);
+    if (completing && cwcomp_char(completing, c)) showCompletion();
+}
+
+// End of input: whatever is pending is a complete character and word
+static void finishDecoded(void) {
+    morseCompleteCharacter(&decoder);
+    releaseExpanded();
+    flushDecoded();
+}
+
+// Live timeline view (--timeline), NULL when off
+static CwTimeline timelineView;
+static CwTimeline *timeline = NULL;
+
+// Decoder callback: decoded character
+static void onDecodedChar(void *ctx, char c) {
+    (void)ctx;
+    if (timeline) cwtl_char(timeline, c);
+    addDecodedChar(c);
+}
+
+// Decoder callback: classified element
+void press_key(int isDash);
+static void onDecodedElement(void *ctx, int isDash) {
+    (void)ctx;
+    if (timeline) {
+        cwtl_element(timeline, &decoder, isDash);
+        cwtl_render(timeline, &decoder, getCurrentTimeMs(), 0);
     }
+    press_key(isDash);
+}
+
+// Local sidetone (--sidetone), NULL when off
+static CwSidetone sidetoneOut;
+static CwSidetone *sidetone = NULL;
+static int sidetoneFromKeyer = 0;  // The iambic keyer sounds elements as they start
+
+// Calibration session (--calibrate), NULL when off
+static const char *calibrationText = CWCAL_DEFAULT_TEXT;
+#define CALIBRATE_DONE_MS 1500     // Pause after the whole text that ends the session
+#define CALIBRATE_GIVEUP_MS 5000   // ...or after at least half of it
+static CwCalibration calibration;
+static CwCalibration *calibrating = NULL;
+
+static int calibrationDone(void) {
+    if (!calibrating || !calibrating->nGot) return 0;
+    unsigned long idle = getCurrentTimeMs() - (unsigned long)calibrating->got[calibrating->nGot - 1].arrivalMs;
+    if (calibrating->accepted >= calibrating->nExpected) return idle > CALIBRATE_DONE_MS;
+    return calibrating->accepted >= calibrating->nExpected / 2 && idle > CALIBRATE_GIVEUP_MS;
 }
 
-// Add a dah to the current sequence
-static void addDah(void) {
-    if (morseTreePos < 63) {  // Allow moving to children of nodes < 63 (up to index 126)
-        morseTreePos = morseTreePos * 2 + 2;  // Right child
-        elementCount++;
+// Set by Ctrl+C when the session has something to save on the way out (--learn)
+static volatile sig_atomic_t stopRequested = 0;
+
+static int sessionDone(void) {
+    return stopRequested || calibrationDone();
+}
+
+// Decoder callback: every element as the device reported it
+static void onDecodedKeying(void *ctx, int pauseTime, int charLength) {
+    (void)ctx;
+    if (calibrating)
+        cwcal_add(calibrating, (uint32_t)pauseTime, (uint32_t)charLength, getCurrentTimeMs(), decoder.params.minPulse);
+    if (sidetone && !sidetoneFromKeyer)
+        cwside_element(sidetone, getCurrentTimeMs(), (unsigned long)pauseTime, (unsigned long)charLength);
+    if (timeline) cwtl_keying(timeline, &decoder, pauseTime, charLength);
+}
+
+// Check for timeout and flush pending character
+static void checkTimeout(void) {
+    if (morseCheckTimeout(&decoder, getCurrentTimeMs())) flushDecoded();
+    if (expanding && expanding->heldLen && getCurrentTimeMs() - decoder.lastActivityTime > CHARACTER_TIMEOUT_MS) {
+        releaseExpanded();
+        flushDecoded();
     }
+    if (logging) cwqso_tick(logging, getCurrentTimeMs());
+    if (sidetone) cwside_advance(sidetone, getCurrentTimeMs());
+    if (timeline) cwtl_render(timeline, &decoder, getCurrentTimeMs(), 0);
 }
 
 // ============================================================
@@ -354,6 +375,56 @@ static CGKeyCode charToKeyCode(char c) {
         default: return 0xFF;   // Invalid
     }
 }
+#elif defined(__linux__)
+// Linux key codes (US layout), -1 = none
+static int charToKeyCode(char c) {
+    static const int letters[26] = {
+        KEY_A, KEY_B, KEY_C, KEY_D, KEY_E, KEY_F, KEY_G, KEY_H, KEY_I, KEY_J, KEY_K, KEY_L, KEY_M,
+        KEY_N, KEY_O, KEY_P, KEY_Q, KEY_R, KEY_S, KEY_T, KEY_U, KEY_V, KEY_W, KEY_X, KEY_Y, KEY_Z
+    };
+    if (c >= 'A' && c <= 'Z') c = c - 'A' + 'a';  // Lowercase
+    if (c >= 'a' && c <= 'z') return letters[c - 'a'];
+    if (c == '0') return KEY_0;
+    if (c >= '1' && c <= '9') return KEY_1 + (c - '1');
+    switch (c) {
+        case ' ': return KEY_SPACE;
+        case '.': return KEY_DOT;
+        case ',': return KEY_COMMA;
+        case '/': return KEY_SLASH;
+        case '=': return KEY_EQUAL;
+        case '+': return KEY_EQUAL;       // Needs shift
+        case '(': return KEY_9;           // 9 with shift
+        case '-': return KEY_MINUS;
+        case '?': return KEY_SLASH;       // Slash with shift
+        case '\'': return KEY_APOSTROPHE;
+        case ';': return KEY_SEMICOLON;
+        case '\n': return KEY_ENTER;
+        default: return -1;
+    }
+}
+
+static void uinputKey(int code, int down) {
+    struct input_event ev[2];
+    memset(ev, 0, sizeof(ev));
+    ev[0].type = EV_KEY;
+    ev[0].code = (unsigned short)code;
+    ev[0].value = down;
+    ev[1].type = EV_SYN;
+    ev[1].code = SYN_REPORT;
+    if (write(uinputFd, ev, sizeof(ev)) != (ssize_t)sizeof(ev) && verboseMode) perror("uinput");
+}
+
+// One keystroke, shifted if the character needs it
+static void uinputTap(char c, int hold) {
+    int code = charToKeyCode(c);
+    if (code < 0 || uinputFd < 0) return;
+    int needsShift = (c >= 'A' && c <= 'Z') || c == '?' || c == '+' || c == '(';
+    if (needsShift) uinputKey(KEY_LEFTSHIFT, 1);
+    uinputKey(code, 1);
+    if (hold) sleep_ms(hold);
+    uinputKey(code, 0);
+    if (needsShift) uinputKey(KEY_LEFTSHIFT, 0);
+}
 #endif
 
 // Type a single character (for full keyboard mode)
@@ -394,6 +465,8 @@ void type_character(char c) {
     }
     
     SendInput(inputCount, ip, sizeof(INPUT));
+#elif defined(__linux__)
+    uinputTap(c, 10);  // 10ms hold
 #else
     // macOS: Use CGEvent
     CGKeyCode keyCode = charToKeyCode(c);
@@ -411,7 +484,7 @@ void type_character(char c) {
     CGEventRef keyDown = CGEventCreateKeyboardEvent(NULL, keyCode, true);
     CGEventRef keyUp = CGEventCreateKeyboardEvent(NULL, keyCode, false);
     CGEventPost(kCGHIDEventTap, keyDown);
-    usleep(10000);  // 10ms hold
+    sleep_ms(10);  // 10ms hold
     CGEventPost(kCGHIDEventTap, keyUp);
     CFRelease(keyDown);
     CFRelease(keyUp);
@@ -427,6 +500,53 @@ void type_character(char c) {
     sleep_ms(30);
 }
 
+// Type a whole string as one injection (accepted completions, expansions).
+// Newlines go out as Return through type_character().
+void type_text(const char *s) {
+    while (*s) {
+        if (*s == '\n') {
+            type_character(*s++);
+            continue;
+        }
+        size_t n = strcspn(s, "\n");
+#ifdef _WIN32
+        // Unicode key events need no key codes or shift handling
+        for (size_t at = 0; at < n; at += 32) {
+            INPUT ip[2 * 32];
+            size_t len = n - at < 32 ? n - at : 32;
+            memset(ip, 0, sizeof(ip));
+            for (size_t i = 0; i < len; i++) {
+                ip[2 * i].type = ip[2 * i + 1].type = INPUT_KEYBOARD;
+                ip[2 * i].ki.wScan = ip[2 * i + 1].ki.wScan = (WORD)(unsigned char)s[at + i];
+                ip[2 * i].ki.dwFlags = KEYEVENTF_UNICODE;
+                ip[2 * i + 1].ki.dwFlags = KEYEVENTF_UNICODE | KEYEVENTF_KEYUP;
+            }
+            SendInput((UINT)(2 * len), ip, sizeof(INPUT));
+        }
+#elif defined(__linux__)
+        // uinput only knows keys: type them back to back
+        for (size_t i = 0; i < n; i++) uinputTap(s[i], 0);
+#else
+        // macOS: the text rides on the events, up to 20 characters each
+        for (size_t at = 0; at < n; at += 20) {
+            UniChar text[20];
+            size_t len = n - at < 20 ? n - at : 20;
+            for (size_t i = 0; i < len; i++) text[i] = (UniChar)(unsigned char)s[at + i];
+            CGEventRef keyDown = CGEventCreateKeyboardEvent(NULL, 0, true);
+            CGEventRef keyUp = CGEventCreateKeyboardEvent(NULL, 0, false);
+            CGEventKeyboardSetUnicodeString(keyDown, len, text);
+            CGEventKeyboardSetUnicodeString(keyUp, len, text);
+            CGEventPost(kCGHIDEventTap, keyDown);
+            CGEventPost(kCGHIDEventTap, keyUp);
+            CFRelease(keyDown);
+            CFRelease(keyUp);
+        }
+#endif
+        s += n;
+        sleep_ms(30);
+    }
+}
+
 // 1. KEYBOARD HANDLING
 
 void init_keyboard(void) {
@@ -466,6 +586,32 @@ void init_keyboard(void) {
     dotUp = CGEventCreateKeyboardEvent(NULL, dotCode, false);
     dashDown = CGEventCreateKeyboardEvent(NULL, dashCode, true);
     dashUp = CGEventCreateKeyboardEvent(NULL, dashCode, false);
+#elif defined(__linux__)
+    // Linux: a virtual keyboard through uinput, seen by X, Wayland and the console alike
+    uinputFd = open("/dev/uinput", O_WRONLY | O_NONBLOCK);
+    if (uinputFd < 0) {
+        printf("[!] Cannot open /dev/uinput (%s): decoding to the console only\n", strerror(errno));
+        noKeysMode = 1;
+        return;
+    }
+    struct uinput_setup setup;
+    memset(&setup, 0, sizeof(setup));
+    setup.id.bustype = BUS_VIRTUAL;
+    snprintf(setup.name, sizeof(setup.name), "CW Hotline keyboard");
+    int ok = ioctl(uinputFd, UI_SET_EVBIT, EV_KEY) == 0;
+    for (int code = KEY_ESC; ok && code <= KEY_MICMUTE; code++) ok = ioctl(uinputFd, UI_SET_KEYBIT, code) == 0;
+    if (!ok || ioctl(uinputFd, UI_DEV_SETUP, &setup) != 0 || ioctl(uinputFd, UI_DEV_CREATE) != 0) {
+        printf("[!] Cannot create a uinput keyboard (%s): decoding to the console only\n", strerror(errno));
+        close(uinputFd);
+        uinputFd = -1;
+        noKeysMode = 1;
+        return;
+    }
+    if (charToKeyCode(dotChar) >= 0) dotKey = charToKeyCode(dotChar);
+    if (charToKeyCode(dashChar) >= 0) dashKey = charToKeyCode(dashChar);
+    // Give the desktop a moment to pick up the new keyboard, or the first
+    // keys are lost (real time: the device appears in the real world)
+    cwclock_real_sleep(NULL, 200);
 #endif
     // Windows: No init needed
 }
@@ -476,12 +622,18 @@ void cleanup_keyboard(void) {
     if (dotUp) CFRelease(dotUp);
     if (dashDown) CFRelease(dashDown);
     if (dashUp) CFRelease(dashUp);
+#elif defined(__linux__)
+    if (uinputFd >= 0) {
+        ioctl(uinputFd, UI_DEV_DESTROY);
+        close(uinputFd);
+        uinputFd = -1;
+    }
 #endif
 }
 
 void press_key(int isDash) {
     // In keyboard mode, we don't send Z/X keys - only decoded characters
-    if (keyboardMode) {
+    if (keyboardMode || noKeysMode) {
         if (verboseMode) printf(isDash ? "-" : ".");
         return;
     }
@@ -494,11 +646,15 @@ void press_key(int isDash) {
         ip[0].type = INPUT_KEYBOARD; ip[0].ki.wVk = LOBYTE(vk);
         ip[1].type = INPUT_KEYBOARD; ip[1].ki.wVk = LOBYTE(vk); ip[1].ki.dwFlags = KEYEVENTF_KEYUP;
         SendInput(1, &ip[0], sizeof(INPUT));
-        Sleep(25); // Hold
+        sleep_ms(25); // Hold
         SendInput(1, &ip[1], sizeof(INPUT));
+#elif defined(__linux__)
+        uinputKey(dashKey, 1);
+        sleep_ms(25); // Hold 25ms
+        uinputKey(dashKey, 0);
 #else
         CGEventPost(kCGHIDEventTap, dashDown);
-        usleep(25000); // Hold 25ms
+        sleep_ms(25); // Hold 25ms
         CGEventPost(kCGHIDEventTap, dashUp);
 #endif
     } else {
@@ -509,11 +665,15 @@ void press_key(int isDash) {
         ip[0].type = INPUT_KEYBOARD; ip[0].ki.wVk = LOBYTE(vk);
         ip[1].type = INPUT_KEYBOARD; ip[1].ki.wVk = LOBYTE(vk); ip[1].ki.dwFlags = KEYEVENTF_KEYUP;
         SendInput(1, &ip[0], sizeof(INPUT));
-        Sleep(25); // Hold
+        sleep_ms(25); // Hold
         SendInput(1, &ip[1], sizeof(INPUT));
+#elif defined(__linux__)
+        uinputKey(dotKey, 1);
+        sleep_ms(25); // Hold 25ms
+        uinputKey(dotKey, 0);
 #else
         CGEventPost(kCGHIDEventTap, dotDown);
-        usleep(25000); // Hold 25ms
+        sleep_ms(25); // Hold 25ms
         CGEventPost(kCGHIDEventTap, dotUp);
 #endif
     }
@@ -575,6 +735,17 @@ void os_close_serial(SERIAL_HANDLE h) {
 #endif
 }
 
+// Wait up to ms for input. Returns 1 if there may be some, 0 on timeout.
+int os_serial_wait(SERIAL_HANDLE h, int ms) {
+#ifdef _WIN32
+    (void)h; (void)ms;
+    return 1;  // Reads return immediately anyway
+#else
+    struct pollfd pfd = { h, POLLIN, 0 };
+    return poll(&pfd, 1, ms) != 0;
+#endif
+}
+
 int os_serial_read(SERIAL_HANDLE h, char *buf, int max) {
 #ifdef _WIN32
     DWORD bytesRead = 0;
@@ -618,174 +789,504 @@ char os_getch(void) {
 #endif
 }
 
+// Raw console: keystrokes arrive immediately and unechoed, Ctrl+C still
+// signals. The original mode is put back by os_console_restore(), at exit,
+// and from SIGINT/SIGTERM/SIGHUP.
+#ifdef _WIN32
+static DWORD savedConsoleMode;
+static int consoleRaw = 0;
+
+void os_console_restore(void) {
+    if (consoleRaw) {
+        SetConsoleMode(GetStdHandle(STD_INPUT_HANDLE), savedConsoleMode);
+        consoleRaw = 0;
+    }
+}
+
+static BOOL WINAPI consoleCtrlHandler(DWORD type) {
+    os_console_restore();
+    return FALSE;  // Let the default handler terminate
+}
+
+int os_console_raw(void) {
+    HANDLE hIn = GetStdHandle(STD_INPUT_HANDLE);
+    if (!GetConsoleMode(hIn, &savedConsoleMode)) return 0;  // Not a console
+    SetConsoleMode(hIn, savedConsoleMode & ~(ENABLE_LINE_INPUT | ENABLE_ECHO_INPUT));
+    consoleRaw = 1;
+    atexit(os_console_restore);
+    SetConsoleCtrlHandler(consoleCtrlHandler, TRUE);
+    return 1;
+}
+#else
+static struct termios savedConsole;
+static int consoleRaw = 0;
+
+void os_console_restore(void) {
+    if (consoleRaw) {
+        tcsetattr(STDIN_FILENO, TCSANOW, &savedConsole);
+        consoleRaw = 0;
+    }
+}
+
+static void consoleSignalHandler(int sig) {
+    os_console_restore();  // tcsetattr is async-signal-safe
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+int os_console_raw(void) {
+    if (!isatty(STDIN_FILENO) || tcgetattr(STDIN_FILENO, &savedConsole) != 0) return 0;
+    struct termios raw = savedConsole;
+    raw.c_lflag &= ~(ICANON | ECHO);
+    raw.c_iflag &= ~(ICRNL | INLCR | IXON);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    if (tcsetattr(STDIN_FILENO, TCSANOW, &raw) != 0) return 0;
+    consoleRaw = 1;
+    atexit(os_console_restore);
+    signal(SIGINT, consoleSignalHandler);
+    signal(SIGTERM, consoleSignalHandler);
+    signal(SIGHUP, consoleSignalHandler);
+    return 1;
+}
+#endif
+
 // ============================================================
 // MORSE PROCESSING LOGIC
 // ============================================================
 
-int isClose(int val, int target) {
-    return abs(val - target) <= TIMING_TOLERANCE;
-}
+// Split raw serial bytes into lines for the decoder
+void feedSerialData(const char *buf, int n) {
+    static char lineBuf[4096];
+    static int linePos = 0;
 
-// Process a command starting at the first comma (e.g. ",100,200")
-// Returns pointer to end of command (digits), or NULL if invalid
-char* processCommandWithComma(char *firstComma) {
-    // Parse pause time (between first and second comma)
-    char pauseStr[32] = {0};
-    char *p = firstComma + 1;
-    char *d = pauseStr;
-    while (*p && isdigit((unsigned char)*p) && d - pauseStr < 31) {
-        *d++ = *p++;
-    }
-    int pauseTime = atoi(pauseStr);
-    
-    char *secondComma = strchr(firstComma + 1, ',');
-    if (!secondComma) return NULL;
-    
-    // Parse length cleanly
-    char lengthStr[32] = {0};
-    char *src = secondComma + 1;
-    char *dst = lengthStr;
-    char *endOfDigits = src;
-    
-    while (*src && isdigit((unsigned char)*src) && dst - lengthStr < 31) {
-        *dst++ = *src;
-        endOfDigits = src; // Keep track of last digit
-        src++;
-    }
-    
-    int charLength = atoi(lengthStr);
-    if (charLength == 0) return NULL;
-    
-    // Glitch Filter
-    if (charLength < MIN_PULSE_LENGTH) {
-        if (debugMode) printf("[noise:%d] ", charLength);
-        return endOfDigits;
+    if (debugMode) {
+        for(int j=0; j<n; j++) printf("[%02X]%c ", (unsigned char)buf[j], (buf[j]>=32 && buf[j]<127)?buf[j]:'.');
+        printf("\n"); fflush(stdout);
+        return;
     }
-    
-    if (verboseMode) printf("[p=%d l=%d] ", pauseTime, charLength);
 
-    // Auto-learn mode
-    if (dotTiming == -1) {
-        dotTiming = charLength;
-        if (verboseMode) printf("[learned dit=%d] ", dotTiming);
-        addDit();
-        press_key(0); // Dot
-        return endOfDigits;
+    // Append to buffer
+    if (linePos + n < (int)sizeof(lineBuf)) {
+        memcpy(lineBuf + linePos, buf, n);
+        linePos += n;
+    } else {
+        // Buffer overflow protection
+        linePos = 0; 
     }
     
-    // Check for character/word boundary based on pause time
-    // Character gap = 3 dit units, Word gap = 7 dit units
-    // We use 2.5x and 6x as thresholds (with some tolerance)
-    if (dotTiming > 0 && pauseTime > dotTiming * 2.5) {
-        // End of character detected - decode what we have
-        completeCharacter();
+    // Scan for lines
+    while(1) {
+        int found = -1;
+        for(int k=0; k<linePos; k++) {
+            if (lineBuf[k] == '\n' || lineBuf[k] == '\r') {
+                found = k;
+                break;
+            }
+        }
+        
+        if (found == -1) break;
+        
+        // Process Line
+        lineBuf[found] = 0;
+        morseHandleLine(&decoder, lineBuf);
         
-        // Check for word gap (7 dit units, use 6x threshold)
-        if (pauseTime > dotTiming * 6) {
-            addDecodedChar(' ');
-            if (verboseMode) printf(" ");
+        // Shift remaining
+        int remaining = linePos - (found + 1);
+        memmove(lineBuf, lineBuf + found + 1, remaining);
+        linePos = remaining;
+        
+        // If next char is also newline (CRLF?), skip it
+        if (linePos > 0 && (lineBuf[0] == '\n' || lineBuf[0] == '\r')) {
+            memmove(lineBuf, lineBuf + 1, linePos - 1);
+            linePos--;
         }
     }
-    
-    if (dashTiming == -1) {
-        if (isClose(charLength, dotTiming)) {
-            addDit();
-            press_key(0); 
-        } else {
-            if (charLength > dotTiming) {
-                dashTiming = charLength;
-            } else {
-                dashTiming = dotTiming;
-                dotTiming = charLength;
-            }
-            if (verboseMode) printf("[learned dit=%d dah=%d] ", dotTiming, dashTiming);
-            if (charLength == dotTiming) {
-                addDit();
-                press_key(0);
-            } else {
-                addDah();
-                press_key(1);
-            }
-        }
-        return endOfDigits;
+}
+
+// ============================================================
+// CAPTURE REPLAY
+// ============================================================
+
+// Sleep until dueMs, running the timeout logic like the live loop does
+static void replayWaitUntil(unsigned long dueMs) {
+    while ((long)(dueMs - getCurrentTimeMs()) > 0) {
+        long left = (long)(dueMs - getCurrentTimeMs());
+        long due = morseUntilTimeout(&decoder, getCurrentTimeMs());
+        if (due >= 0 && due < left) left = due;
+        sleep_ms(left < 100 ? left : 100);
+        checkTimeout();
     }
-    
-    // Self-Correction
-    if (charLength < dotTiming * 0.6 && charLength > MIN_PULSE_LENGTH) {
-        if (verboseMode) printf("[CORRECTION: dit=%d] ", charLength);
-        dashTiming = dotTiming;
-        dotTiming = charLength;
-        addDit();
-        press_key(0);
-        return endOfDigits;
+}
+
+// Archives hold elements rather than bytes: regenerate the device's lines
+static int replayArchive(const char *path, double speed) {
+    CwArchive a;
+    if (cwarc_open(&a, path) != 0) {
+        printf("[!] Cannot read archive %s\n", path);
+        return 1;
     }
-    
-    if (dashTiming > dotTiming * 6 && charLength > dotTiming * 2 && charLength < dashTiming) {
-        if (verboseMode) printf("[CORRECTION: dah=%d] ", charLength);
-        dashTiming = charLength;
-        addDah();
-        press_key(1);
-        return endOfDigits;
-    }
-
-    // Classify
-    if (isClose(charLength, dotTiming)) {
-        addDit();
-        press_key(0);
-        dotTiming = (dotTiming * 3 + charLength) / 4;
-    } else if (isClose(charLength, dashTiming)) {
-        addDah();
-        press_key(1);
-        dashTiming = (dashTiming * 3 + charLength) / 4;
-    } else {
-        int dotDiff = abs(charLength - dotTiming);
-        int dashDiff = abs(charLength - dashTiming);
-        if (dotDiff < dashDiff) {
-            addDit();
-            press_key(0);
-        } else {
-            addDah();
-            press_key(1);
+    static CwArcElement elements[CWARC_CHUNK_ELEMENTS];
+    unsigned long startMs = getCurrentTimeMs();
+    unsigned long long replayed = 0;
+    int rc = 0;
+    for (uint32_t c = 0; c < a.chunkCount; c++) {
+        int n = cwarc_decode_chunk(&a, c, elements);
+        if (n < 0) { printf("\n[!] Archive chunk %u is corrupt\n", c); rc = 1; break; }
+        for (int i = 0; i < n; i++) {
+            if (speed > 0) replayWaitUntil(startMs + (unsigned long)(elements[i].arrivalMs / speed));
+            char line[48];
+            int len = snprintf(line, sizeof(line), "S,%u,%u\r\n", elements[i].pause, elements[i].length);
+            decoder.lastActivityTime = getCurrentTimeMs();
+            feedSerialData(line, len);
         }
+        replayed += n;
     }
-    
-    return endOfDigits;
+    cwarc_close(&a);
+    finishDecoded();
+    if (!quietMode) printf("\n[*] Replayed %llu elements from %s\n", replayed, path);
+    return rc;
 }
 
-void handleLine(char *line) {
-    if (strlen(line) == 0) return;
-    
-    if (verboseMode) printf("\n>> %s -> ", line);
-    
-    char *cursor = line;
-    // Scan for 'S' or 's', then find the next comma pattern
-    while ((cursor = strpbrk(cursor, "Ss"))) {
-        // We found an 'S'. Now look for the next comma
-        char *comma = strchr(cursor, ',');
-        
-        // If no comma, or comma is too far (sanity check: >20 chars away?), break
-        if (!comma) break;
-        if (comma - cursor > 20) {
-            cursor++; // Too far, this 'S' isn't a prefix
-            continue;
+// Feed a debug_serial capture (or a cw_archive archive) through the decoder.
+// speed scales the recorded gaps (2 = twice as fast); 0 replays without
+// waiting. Returns 0 on success.
+int replayCapture(const char *path, double speed) {
+    FILE *f = fopen(path, "rb");
+    if (!f) { perror("Error opening capture"); return 1; }
+    char magic[CWARC_MAGIC_LEN];
+    size_t got = fread(magic, 1, sizeof(magic), f);
+    if (cwarc_is_archive(magic, got)) {
+        fclose(f);
+        return replayArchive(path, speed);
+    }
+    rewind(f);
+    if (cwcap_read_header(f, NULL) != 0) {
+        printf("[!] %s is not a capture file\n", path);
+        fclose(f);
+        return 1;
+    }
+
+    static char chunk[CWCAP_MAX_CHUNK];
+    uint64_t firstUs = 0, timeUs;
+    unsigned long startMs = getCurrentTimeMs();
+    int n, chunks = 0;
+    while ((n = cwcap_read_chunk(f, &timeUs, chunk)) >= 0) {
+        if (chunks++ == 0) firstUs = timeUs;
+        if (speed > 0) replayWaitUntil(startMs + (unsigned long)((timeUs - firstUs) / 1000 / speed));
+        decoder.lastActivityTime = getCurrentTimeMs();
+        feedSerialData(chunk, n);
+    }
+    fclose(f);
+
+    // End of capture: a line cut off mid-way still counts, and whatever is
+    // pending is a complete character
+    if (!debugMode) feedSerialData("\r", 1);
+    finishDecoded();
+    if (!quietMode) printf("\n[*] Replayed %d chunks from %s\n", chunks, path);
+    return 0;
+}
+
+// ============================================================
+// AUDIO INPUT
+// ============================================================
+
+// Keying detected in the audio: hand it to the decoder as a device line
+static void audioElement(void *ctx, const CwArcElement *e) {
+    (void)ctx;
+    char line[48];
+    int len = snprintf(line, sizeof(line), "S,%u,%u\r\n", e->pause, e->length);
+    decoder.lastActivityTime = e->arrivalMs + 1;
+    feedSerialData(line, len);
+}
+
+// Decode CW from a WAV file or raw PCM ("-" for stdin, e.g. from an SDR).
+// The audio is its own clock: timeouts run on sample time, so a recording
+// decodes as fast as it can be read, with the result it would give live.
+// Returns 0 on success.
+int decodeAudio(const char *path, int rawRate, double toneLo, double toneHi) {
+    CwAudioSource a;
+    if (cwaudio_open(&a, path, rawRate) != 0) {
+        printf("[!] Cannot read audio from %s (WAV: PCM or float only)\n", path);
+        return 1;
+    }
+    static CwTone tone;
+    cwtone_init(&tone, a.sampleRate, toneLo, toneHi, audioElement, NULL);
+    if (!quietMode) {
+        printf("[*] Audio: %d Hz, %d channel(s), %d-bit%s, tone search %.0f-%.0f Hz (%s)\n",
+               a.sampleRate, a.channels, a.bits, a.isFloat ? " float" : "",
+               tone.freq[0], tone.freq[CWTONE_BINS - 1], CWTONE_KERNEL);
+    }
+
+    // Read a few detection blocks at a time so timeouts fire promptly
+    static float samples[4096];
+    size_t want = (size_t)tone.blockLen * 4;
+    if (want > 4096) want = 4096;
+    size_t n;
+    while (!stopRequested && (n = cwaudio_read(&a, samples, want)) > 0) {
+        cwtone_feed(&tone, samples, n);
+        if (morseCheckTimeout(&decoder, cwtone_now(&tone) + 1)) flushDecoded();
+    }
+    cwtone_finish(&tone);
+    cwaudio_close(&a);
+
+    finishDecoded();
+    if (!quietMode) {
+        printf("\n[*] %lu elements from %.1f s of audio, tone %.0f Hz\n",
+               tone.key.elements, cwtone_now(&tone) / 1000.0, tone.freq[tone.track]);
+    }
+    return 0;
+}
+
+// ============================================================
+// PADDLE INPUT
+// ============================================================
+
+#define PADDLE_MIDI_DIT 1   // Note numbers sent by MIDI paddle adapters
+#define PADDLE_MIDI_DAH 2
+
+static CwKeyer keyer;
+
+// Keyer element: hand it to the decoder as a device line
+static void paddleElement(void *ctx, const CwArcElement *e) {
+    (void)ctx;
+    char line[48];
+    int len = snprintf(line, sizeof(line), "S,%u,%u\r\n", e->pause, e->length);
+    decoder.lastActivityTime = getCurrentTimeMs();
+    feedSerialData(line, len);
+}
+
+// Iambic elements sound as they start, not when the decoder gets them
+static void paddleSidetone(void *ctx, unsigned long pause, unsigned long length) {
+    (void)ctx;
+    cwside_element(sidetone, getCurrentTimeMs(), pause, length);
+}
+
+#ifndef _WIN32
+// Key a paddle on a Linux input device (USB adapters that show up as a
+// keyboard, /dev/input/event*) or a raw MIDI port (paths containing "midi",
+// e.g. /dev/snd/midiC1D0) through the keyer into the decoder, in place of
+// the CW Hotline. ditKey/dahKey are key codes or notes; -1 = the defaults
+// (Ctrl or [ ] keys; notes 1 and 2). Runs until the device goes away.
+int paddleLoop(const char *path, const CwKeyerParams *kp, int ditKey, int dahKey) {
+    int midi = strstr(path, "midi") != NULL;
+#ifndef __linux__
+    if (!midi) {
+        printf("[!] Keyboard-type paddle adapters need Linux (evdev); use a raw MIDI port\n");
+        return 1;
+    }
+#endif
+    int fd = open(path, O_RDONLY | O_NONBLOCK);
+    if (fd < 0) { perror("Error opening paddle device"); return 1; }
+
+    CwMidiPaddle midiIn;
+    cwmidi_init(&midiIn, ditKey >= 0 ? ditKey : PADDLE_MIDI_DIT, dahKey >= 0 ? dahKey : PADDLE_MIDI_DAH);
+    char name[128] = "MIDI";
+#ifdef __linux__
+    if (!midi) {
+        if (ioctl(fd, EVIOCGNAME(sizeof(name)), name) < 0) snprintf(name, sizeof(name), "input events");
+        // Keep the paddle's keystrokes out of other applications
+        if (ioctl(fd, EVIOCGRAB, 1) != 0) printf("[!] Cannot grab %s: its keys also reach other applications\n", path);
+    }
+#endif
+
+    cwkeyer_init(&keyer, kp, paddleElement, NULL);
+    if (sidetone && kp->mode != CWKEYER_STRAIGHT) {
+        sidetoneFromKeyer = 1;
+        keyer.onStart = paddleSidetone;
+    }
+    static const char *modeNames[] = { "straight key", "iambic A", "iambic B" };
+    if (!quietMode) {
+        printf("[*] %s: %s", name, modeNames[kp->mode]);
+        if (kp->mode != CWKEYER_STRAIGHT) {
+            printf(" %.0f WPM, weight %d, memory %s", keyer.p.wpm, keyer.p.weight, kp->memory ? "on" : "off");
         }
+        printf("\n\nListening... (decoded text will appear below)\n\n");
+    }
+
+    // Wake for the keyer's next edge, and often enough for the character
+    // timeout and the sidetone's queue
+    unsigned long tick = 100;
+    if (sidetone && sidetone->latencyMs / 2 < tick) tick = sidetone->latencyMs / 2 ? sidetone->latencyMs / 2 : 1;
+    int rc = 0;
+#ifdef __linux__
+    int paddles = 0;
+#endif
+    while (!sessionDone()) {
+        unsigned long now = getCurrentTimeMs();
+        cwkeyer_run(&keyer, now);
+        checkTimeout();
+        unsigned long wait = tick, next = cwkeyer_next(&keyer);
+        if (next) wait = (long)(next - now) <= 0 ? 0 : next - now < tick ? next - now : tick;
+        long due = morseUntilTimeout(&decoder, now);
+        if (due >= 0 && (unsigned long)due < wait) wait = due;
+
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        int ready = poll(&pfd, 1, (int)wait);
+        if (ready < 0 && errno != EINTR) { perror("Paddle poll"); rc = 1; break; }
+        if (ready <= 0) continue;
 
-        // Check pattern from comma: ,digits,digits
-        if (isdigit((unsigned char)*(comma+1))) {
-            char *secondComma = strchr(comma + 1, ',');
-            if (secondComma && isdigit((unsigned char)*(secondComma+1))) {
-                // Found valid pattern associated with this 'S'
-                char *end = processCommandWithComma(comma);
-                if (end) {
-                    cursor = end;
-                    continue;
-                }
+        if (midi) {
+            unsigned char buf[256];
+            ssize_t n = read(fd, buf, sizeof(buf));
+            if (n <= 0 && !(n < 0 && (errno == EAGAIN || errno == EINTR))) break;
+            for (ssize_t i = 0; i < n; i++) {
+                if (cwmidi_byte(&midiIn, buf[i])) cwkeyer_paddles(&keyer, getCurrentTimeMs(), midiIn.paddles);
             }
+            continue;
+        }
+#ifdef __linux__
+        struct input_event ev[64];
+        ssize_t n = read(fd, ev, sizeof(ev));
+        if (n <= 0 && !(n < 0 && (errno == EAGAIN || errno == EINTR))) break;
+        for (ssize_t i = 0; i < n / (ssize_t)sizeof(ev[0]); i++) {
+            if (ev[i].type != EV_KEY || ev[i].value == 2) continue;   // 2 = autorepeat
+            int code = ev[i].code, bit = 0;
+            if (ditKey >= 0 ? code == ditKey : (code == KEY_LEFTCTRL || code == KEY_LEFTBRACE)) bit = CWKEYER_DIT;
+            else if (dahKey >= 0 ? code == dahKey : (code == KEY_RIGHTCTRL || code == KEY_RIGHTBRACE)) bit = CWKEYER_DAH;
+            if (!bit) continue;
+            int was = paddles;
+            paddles = ev[i].value ? paddles | bit : paddles & ~bit;
+            if (paddles != was) cwkeyer_paddles(&keyer, getCurrentTimeMs(), paddles);
         }
-        cursor++;
+#endif
     }
-    
-    if (verboseMode) { printf("\n"); fflush(stdout); }
+    if (!rc) printf("\n[!] Paddle device closed.\n");
+    close(fd);
+
+    // Finish whatever is being sent
+    while (cwkeyer_next(&keyer)) {
+        sleep_ms(1);
+        cwkeyer_run(&keyer, getCurrentTimeMs());
+    }
+    finishDecoded();
+    if (!quietMode) printf("[*] %lu elements keyed\n", keyer.elements);
+    return rc;
+}
+#else
+int paddleLoop(const char *path, const CwKeyerParams *kp, int ditKey, int dahKey) {
+    (void)path; (void)kp; (void)ditKey; (void)dahKey;
+    printf("[!] --paddle needs Linux input devices or a raw MIDI port\n");
+    return 1;
+}
+#endif
+
+// ============================================================
+// BATCH DECODE
+// ============================================================
+
+static const char *batchBaseName(const char *path) {
+    const char *slash = strrchr(path, '/');
+#ifdef _WIN32
+    const char *bslash = strrchr(path, '\\');
+    if (bslash && (!slash || bslash > slash)) slash = bslash;
+#endif
+    return slash ? slash + 1 : path;
+}
+
+// Decode a directory of captures/archives (or one big file) on all cores.
+// With outDir, each session's text goes to <outDir>/<name>.txt and per-file
+// statistics to <outDir>/batch_stats.csv; otherwise the text is printed.
+// Returns 0 if every file decoded.
+int batchDecode(const char *input, const char *outDir, int workers) {
+    char **paths = NULL;
+    int count = cwbatch_list_dir(input, &paths);
+    if (count < 0) {
+        // Not a directory: a single session
+        paths = (char **)malloc(sizeof(char *));
+        if (!paths || !(paths[0] = strdup(input))) { free(paths); return 1; }
+        count = 1;
+    }
+    if (count == 0) {
+        printf("[!] No .cwcap or .cwarc files in %s\n", input);
+        free(paths);
+        return 1;
+    }
+
+    CwBatch b;
+    memset(&b, 0, sizeof(b));
+    b.files = (CwBatchFile *)calloc(count, sizeof(CwBatchFile));
+    if (!b.files) { free(paths); return 1; }
+    b.fileCount = count;
+    b.lowercase = lowercaseMode;
+    b.params = &decoderParams;
+    for (int f = 0; f < count; f++) b.files[f].path = paths[f];
+
+    unsigned long startMs = getCurrentTimeMs();
+    if (cwbatch_run(&b, workers) != 0) {
+        printf("[!] Out of memory\n");
+        cwbatch_free(&b);
+        for (int f = 0; f < count; f++) free(paths[f]);
+        free(paths); free(b.files);
+        return 1;
+    }
+    unsigned long elapsedMs = getCurrentTimeMs() - startMs;
+
+    FILE *csv = NULL;
+    if (outDir) {
+        char csvPath[1024];
+        snprintf(csvPath, sizeof(csvPath), "%s/batch_stats.csv", outDir);
+        csv = fopen(csvPath, "w");
+        if (!csv) { perror("Error writing batch_stats.csv"); }
+        else fprintf(csv, "file,elements,noise,dits,dahs,chars,words,unknown,timeouts,duration_s,wpm\n");
+    }
+
+    int failed = 0;
+    unsigned long long totalElements = 0;
+    for (int f = 0; f < count; f++) {
+        CwBatchFile *file = &b.files[f];
+        if (!file->loaded) {
+            printf("[!] %s: not a capture or archive\n", file->path);
+            failed++;
+            continue;
+        }
+        MorseStats sum;
+        memset(&sum, 0, sizeof(sum));
+        int dot = -1;
+        FILE *out = stdout;
+        char txtPath[1024];
+        if (outDir) {
+            snprintf(txtPath, sizeof(txtPath), "%s/%s.txt", outDir, batchBaseName(file->path));
+            out = fopen(txtPath, "w");
+            if (!out) { perror(txtPath); failed++; }
+        } else if (!quietMode) {
+            printf("== %s\n", file->path);
+        }
+        for (int t = 0; t < file->taskCount; t++) {
+            CwBatchTask *task = &file->tasks[t];
+            if (out && task->text.len) fwrite(task->text.data, 1, task->text.len, out);
+            sum.elements += task->stats.elements;
+            sum.noise += task->stats.noise;
+            sum.dits += task->stats.dits;
+            sum.dahs += task->stats.dahs;
+            sum.chars += task->stats.chars;
+            sum.words += task->stats.words;
+            sum.unknown += task->stats.unknown;
+            sum.timeouts += task->stats.timeouts;
+            if (task->dotTiming > 0) dot = task->dotTiming;
+        }
+        if (out && out != stdout) fclose(out);
+        else if (out) printf("\n");
+
+        double duration = file->durationMs / 1000.0;
+        totalElements += file->elementCount;
+        if (csv) fprintf(csv, "%s,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%.1f,%.1f\n", batchBaseName(file->path),
+                         sum.elements, sum.noise, sum.dits, sum.dahs, sum.chars, sum.words,
+                         sum.unknown, sum.timeouts, duration, dot > 0 ? 1200.0 / dot : 0.0);
+    }
+    if (csv) fclose(csv);
+
+    if (!quietMode) {
+        printf("[%s] %d/%d files, %llu elements in %d tasks, %.2f s (%.0f elements/s)\n",
+               failed ? "!" : "OK", count - failed, count, totalElements, b.taskCount,
+               elapsedMs / 1000.0, elapsedMs ? totalElements * 1000.0 / elapsedMs : 0.0);
+    }
+
+    cwbatch_free(&b);
+    for (int f = 0; f < count; f++) free(paths[f]);
+    free(paths);
+    free(b.files);
+    return failed ? 1 : 0;
 }
 
 // Config Automation constants
@@ -856,31 +1357,611 @@ void automatedConfig(SERIAL_HANDLE h, int targetSetting, const char *newValue) {
     printf("\n[OK] Configuration complete! Power cycle device.\n");
 }
 
+#define CONFIG_EXIT_KEY 0x1D  // Ctrl+]
+
+// Translate console input for the device (Enter -> CR) and cut it at the
+// exit key. Returns bytes to forward; sets *quit if the exit key was seen.
+static int relayTranslate(char *buf, int n, int *quit) {
+    for (int i = 0; i < n; i++) {
+        if (buf[i] == CONFIG_EXIT_KEY) { *quit = 1; return i; }
+        if (buf[i] == '\n') buf[i] = '\r';
+    }
+    return n;
+}
+
+// Local echo (the device doesn't echo what it is sent)
+static void relayEcho(const char *buf, int n) {
+    for (int i = 0; i < n; i++) putchar(buf[i] == '\r' ? '\n' : buf[i]);
+    fflush(stdout);
+}
+
 void enterConfigMode(SERIAL_HANDLE h) {
-    printf("[*] Interactive Mode (Press Ctrl+C to quit)\n");
+    printf("[*] Interactive Mode (Ctrl+] to quit)\n");
+    fflush(stdout);
+    os_console_raw();
     os_serial_write(h, "***\r", 4);
-    
-    while(1) {
-        // Serial -> Console
-        char buf[256];
-        int n = os_serial_read(h, buf, sizeof(buf)-1);
-        if (n>0) { buf[n]=0; printf("%s", buf); fflush(stdout); }
-        
-        // Console -> Serial
-        if (os_kbhit()) {
-            char c = os_getch();
-            if (c=='\n') c='\r';
-            os_serial_write(h, &c, 1);
-            printf("%c", c);
+
+    char buf[4096];
+    int quit = 0;
+#ifdef _WIN32
+    HANDLE hIn = GetStdHandle(STD_INPUT_HANDLE);
+    while (!quit) {
+        // Serial -> Console (reads return immediately, see os_open_serial)
+        int n;
+        while ((n = os_serial_read(h, buf, sizeof(buf))) > 0) fwrite(buf, 1, n, stdout);
+        if (n < 0) { printf("\n[!] Serial port error or device disconnected.\n"); break; }
+        fflush(stdout);
+
+        // Console -> Serial: sleep until a key arrives (or 10ms for the serial side),
+        // then forward everything that is waiting in one write
+        if (WaitForSingleObject(hIn, 10) != WAIT_OBJECT_0) continue;
+        n = 0;
+        while (n < (int)sizeof(buf) && os_kbhit()) buf[n++] = os_getch();
+        n = relayTranslate(buf, n, &quit);
+        if (n > 0) { os_serial_write(h, buf, n); relayEcho(buf, n); }
+    }
+#else
+    struct pollfd fds[2] = {
+        { STDIN_FILENO, POLLIN, 0 },
+        { h, POLLIN, 0 }
+    };
+    int stdinOpen = 1;
+    while (!quit) {
+        // Once piped input is exhausted, give the device a moment to answer
+        int ready = poll(fds + !stdinOpen, 2 - !stdinOpen, stdinOpen ? -1 : 500);
+        if (ready < 0 && errno == EINTR) continue;
+        if (ready <= 0) break;
+        if (fds[1].revents & POLLIN) {
+            int n = os_serial_read(h, buf, sizeof(buf));
+            if (n > 0) { fwrite(buf, 1, n, stdout); fflush(stdout); }
+        }
+        if (fds[1].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+            printf("\n[!] Device disconnected.\n");
+            break;
+        }
+        if (stdinOpen && (fds[0].revents & (POLLIN | POLLHUP))) {
+            int n = read(STDIN_FILENO, buf, sizeof(buf));
+            if (n <= 0) { stdinOpen = 0; continue; }
+            n = relayTranslate(buf, n, &quit);
+            if (n > 0) { os_serial_write(h, buf, n); relayEcho(buf, n); }
         }
-        sleep_ms(10);
     }
+#endif
+    os_console_restore();
+    printf("\n[*] Left interactive mode.\n");
+}
+
+// ============================================================
+// FLEET PROVISIONING
+// ============================================================
+
+/*
+ * Applies one settings snapshot to every CW Hotline found on the host at once.
+ * Each device gets its own small state machine that walks the same menu
+ * automatedConfig() does (*** -> "Settings" banner -> 14 ':' prompts), but
+ * instead of sleeping per step all machines are driven from one event loop
+ * (select() on POSIX, a 10ms poll over the handles on Windows).
+ *
+ * After the apply pass the menu is walked a second time, answering Enter to
+ * every prompt, and each changed setting's prompt is checked for the new value.
+ */
+
+#define FLEET_MAX_DEVICES 64
+#define FLEET_PROMPT_TIMEOUT_MS 4000   // Same 4s budget automatedConfig uses
+#define FLEET_SETTLE_MS 200            // Pause after answering a prompt
+
+typedef enum {
+    FLEET_ENTER,          // Send *** to open the settings menu
+    FLEET_WAIT_BANNER,    // Wait for "Settings"
+    FLEET_WAIT_PROMPT,    // Wait for ':' of the current setting
+    FLEET_SETTLE,         // Answered; let the device move on
+    FLEET_DONE,
+    FLEET_FAILED
+} FleetState;
+
+typedef struct {
+    char port[128];
+    SERIAL_HANDLE h;
+    FleetState state;
+    int verifyPass;          // 0 = applying, 1 = reading back
+    int setting;             // Current setting (1-based)
+    unsigned long deadline;  // When the current state times out
+    unsigned long startTime;
+    unsigned long endTime;
+    char text[1024];         // Device output since the last answer
+    int textLen;
+    int promptTimeouts[2];   // Per pass: prompts answered blind
+    int verified;
+    int mismatched;
+    const char *error;
+} FleetDevice;
+
+// Settings snapshot: value per setting index, NULL = keep current
+static const char *fleetSnapshot[CONFIG_TOTAL_SETTINGS + 1];
+
+static int fleetSnapshotSize(void) {
+    int count = 0;
+    for (int i = 1; i <= CONFIG_TOTAL_SETTINGS; i++) if (fleetSnapshot[i]) count++;
+    return count;
+}
+
+// Find candidate CW Hotline ports. Returns number of names written.
+static int fleetDiscoverPorts(char names[][128], int max) {
+    int count = 0;
+#ifdef _WIN32
+    for (int i = 1; i <= 64 && count < max; i++) {
+        char path[32];
+        snprintf(path, sizeof(path), "\\\\.\\COM%d", i);
+        HANDLE h = CreateFile(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+        if (h == INVALID_HANDLE_VALUE) continue;
+        CloseHandle(h);
+        snprintf(names[count++], 128, "%s", path);
+    }
+#else
+    DIR *dir = opendir("/dev");
+    if (!dir) return 0;
+    struct dirent *ent;
+    while ((ent = readdir(dir)) && count < max) {
+  #ifdef __APPLE__
+        int match = strncmp(ent->d_name, "tty.usbserial", 13) == 0;
+  #else
+        int match = strncmp(ent->d_name, "ttyUSB", 6) == 0 || strncmp(ent->d_name, "ttyACM", 6) == 0;
+  #endif
+        if (match) snprintf(names[count++], 128, "/dev/%.120s", ent->d_name);
+    }
+    closedir(dir);
+#endif
+    return count;
+}
+
+// Does the prompt text show `value` as a standalone token?
+static int fleetPromptShows(const char *text, const char *value) {
+    size_t len = strlen(value);
+    for (const char *p = strstr(text, value); p; p = strstr(p + 1, value)) {
+        int before = (p == text) ? 0 : isalnum((unsigned char)p[-1]);
+        int after = isalnum((unsigned char)p[len]);
+        if (!before && !after) return 1;
+    }
+    return 0;
+}
+
+static void fleetFail(FleetDevice *dev, const char *why, unsigned long now) {
+    dev->state = FLEET_FAILED;
+    dev->error = why;
+    dev->endTime = now;
+}
+
+static void fleetAnswerPrompt(FleetDevice *dev, unsigned long now) {
+    const char *value = fleetSnapshot[dev->setting];
+    if (dev->verifyPass) {
+        if (value) {
+            if (fleetPromptShows(dev->text, value)) dev->verified++;
+            else dev->mismatched++;
+        }
+        os_serial_write(dev->h, "\r", 1);
+    } else {
+        if (value) os_serial_write(dev->h, value, strlen(value));
+        os_serial_write(dev->h, "\r", 1);
+    }
+    dev->textLen = 0;
+    dev->text[0] = '\0';
+    dev->state = FLEET_SETTLE;
+    dev->deadline = now + FLEET_SETTLE_MS;
+}
+
+// Advance a device on a timer or after new input
+static void fleetStep(FleetDevice *dev, unsigned long now) {
+    switch (dev->state) {
+    case FLEET_ENTER:
+        os_serial_write(dev->h, "***\r", 4);
+        dev->textLen = 0;
+        dev->text[0] = '\0';
+        dev->state = FLEET_WAIT_BANNER;
+        dev->deadline = now + FLEET_PROMPT_TIMEOUT_MS;
+        break;
+    case FLEET_WAIT_BANNER:
+        if (strstr(dev->text, "Settings")) {
+            // Like automatedConfig, start looking for the first ':' after the banner
+            dev->textLen = 0;
+            dev->text[0] = '\0';
+            dev->setting = 1;
+            dev->state = FLEET_WAIT_PROMPT;
+            dev->deadline = now + FLEET_PROMPT_TIMEOUT_MS;
+        } else if ((long)(now - dev->deadline) >= 0) {
+            fleetFail(dev, dev->verifyPass ? "no banner on verify" : "no response", now);
+        }
+        break;
+    case FLEET_WAIT_PROMPT:
+        if (strchr(dev->text, ':')) {
+            fleetAnswerPrompt(dev, now);
+        } else if ((long)(now - dev->deadline) >= 0) {
+            dev->promptTimeouts[dev->verifyPass]++;   // automatedConfig answers anyway
+            fleetAnswerPrompt(dev, now);
+        }
+        break;
+    case FLEET_SETTLE:
+        if ((long)(now - dev->deadline) < 0) break;
+        if (++dev->setting <= CONFIG_TOTAL_SETTINGS) {
+            dev->state = FLEET_WAIT_PROMPT;
+            dev->deadline = now + FLEET_PROMPT_TIMEOUT_MS;
+            if (strchr(dev->text, ':')) fleetAnswerPrompt(dev, now);
+        } else if (!dev->verifyPass) {
+            dev->verifyPass = 1;
+            dev->state = FLEET_ENTER;
+            fleetStep(dev, now);
+        } else {
+            dev->state = FLEET_DONE;
+            dev->endTime = now;
+        }
+        break;
+    case FLEET_DONE:
+    case FLEET_FAILED:
+        break;
+    }
+}
+
+static void fleetFeed(FleetDevice *dev, const char *data, int n, unsigned long now) {
+    int room = (int)sizeof(dev->text) - 1 - dev->textLen;
+    if (n > room) {
+        // Keep the tail; prompts are at the end of what the device sends
+        int drop = n - room;
+        if (drop > dev->textLen) drop = dev->textLen;
+        memmove(dev->text, dev->text + drop, dev->textLen - drop);
+        dev->textLen -= drop;
+        room = (int)sizeof(dev->text) - 1 - dev->textLen;
+        if (n > room) { data += n - room; n = room; }
+    }
+    memcpy(dev->text + dev->textLen, data, n);
+    dev->textLen += n;
+    dev->text[dev->textLen] = '\0';
+    fleetStep(dev, now);
+}
+
+static int fleetFinished(const FleetDevice *dev) {
+    return dev->state == FLEET_DONE || dev->state == FLEET_FAILED;
+}
+
+// Returns number of devices that failed (or 1 if none were found)
+int fleetConfig(char ports[][128], int portCount, int baud) {
+    static FleetDevice devices[FLEET_MAX_DEVICES];
+    static char discovered[FLEET_MAX_DEVICES][128];
+    int count = 0;
+
+    if (portCount == 0) {
+        portCount = fleetDiscoverPorts(discovered, FLEET_MAX_DEVICES);
+        ports = discovered;
+    }
+
+    printf("[*] Fleet Provisioning: %d setting(s) on %d port(s) @ %d baud\n", fleetSnapshotSize(), portCount, baud);
+    for (int i = 1; i <= CONFIG_TOTAL_SETTINGS; i++) {
+        if (fleetSnapshot[i]) printf("    #%d -> %s\n", i, fleetSnapshot[i]);
+    }
+    printf("\n");
+
+    unsigned long now = getCurrentTimeMs();
+    for (int i = 0; i < portCount && count < FLEET_MAX_DEVICES; i++) {
+        FleetDevice *dev = &devices[count];
+        memset(dev, 0, sizeof(*dev));
+        snprintf(dev->port, sizeof(dev->port), "%.127s", ports[i]);
+        dev->startTime = now;
+        dev->h = os_open_serial(dev->port, baud);
+        if (dev->h == INVALID_SERIAL_HANDLE) {
+            fleetFail(dev, "open failed", now);
+        } else {
+            dev->state = FLEET_ENTER;
+            fleetStep(dev, now);
+        }
+        count++;
+    }
+    if (count == 0) {
+        printf("[!] No CW Hotline ports found.\n");
+        return 1;
+    }
+
+    char buf[256];
+    for (;;) {
+        now = getCurrentTimeMs();
+        int active = 0;
+        long wait = 100;
+        for (int i = 0; i < count; i++) {
+            if (fleetFinished(&devices[i])) continue;
+            fleetStep(&devices[i], now);
+            if (fleetFinished(&devices[i])) continue;
+            active++;
+            long left = (long)(devices[i].deadline - now);
+            if (left < wait) wait = left < 0 ? 0 : left;
+        }
+        if (!active) break;
+
+#ifdef _WIN32
+        // Serial handles can't be waited on together without overlapped I/O;
+        // reads return immediately (MAXDWORD interval timeout), so poll.
+        sleep_ms(wait < 10 ? wait : 10);
+        now = getCurrentTimeMs();
+        for (int i = 0; i < count; i++) {
+            if (fleetFinished(&devices[i])) continue;
+            int n = os_serial_read(devices[i].h, buf, sizeof(buf));
+            if (n > 0) fleetFeed(&devices[i], buf, n, now);
+            else if (n < 0) fleetFail(&devices[i], "read error", now);
+        }
+#else
+        fd_set fds;
+        FD_ZERO(&fds);
+        int maxfd = -1;
+        for (int i = 0; i < count; i++) {
+            if (fleetFinished(&devices[i]) || devices[i].h >= FD_SETSIZE) continue;
+            FD_SET(devices[i].h, &fds);
+            if (devices[i].h > maxfd) maxfd = devices[i].h;
+        }
+        struct timeval tv = { wait / 1000, (wait % 1000) * 1000 };
+        if (select(maxfd + 1, &fds, NULL, NULL, &tv) < 0 && errno != EINTR) {
+            perror("select");
+            break;
+        }
+        now = getCurrentTimeMs();
+        for (int i = 0; i < count; i++) {
+            if (fleetFinished(&devices[i]) || devices[i].h >= FD_SETSIZE) continue;
+            if (!FD_ISSET(devices[i].h, &fds)) continue;
+            int n = os_serial_read(devices[i].h, buf, sizeof(buf));
+            if (n > 0) fleetFeed(&devices[i], buf, n, now);
+            else if (n == 0 || (errno != EAGAIN && errno != EINTR)) fleetFail(&devices[i], "disconnected", now);
+        }
+#endif
+    }
+
+    int failed = 0;
+    printf("%-32s %-8s %8s %8s  %s\n", "PORT", "RESULT", "TIME", "PROMPTS", "VERIFY");
+    for (int i = 0; i < count; i++) {
+        FleetDevice *dev = &devices[i];
+        char verify[64];
+        const char *result = "OK";
+        if (dev->state == FLEET_FAILED) {
+            snprintf(verify, sizeof(verify), "%s", dev->error);
+            result = "FAILED";
+        } else {
+            snprintf(verify, sizeof(verify), "%d/%d confirmed", dev->verified, dev->verified + dev->mismatched);
+            if (dev->mismatched) result = "MISMATCH";
+        }
+        if (dev->state == FLEET_FAILED || dev->mismatched) failed++;
+        // Prompts seen, on the worse of the two passes
+        int blind = dev->promptTimeouts[0] > dev->promptTimeouts[1] ? dev->promptTimeouts[0] : dev->promptTimeouts[1];
+        printf("%-32s %-8s %6lums %5d/%-2d  %s\n", dev->port, result,
+               dev->endTime - dev->startTime,
+               CONFIG_TOTAL_SETTINGS - blind, CONFIG_TOTAL_SETTINGS, verify);
+        if (dev->h != INVALID_SERIAL_HANDLE) os_close_serial(dev->h);
+    }
+    printf("\n[%s] %d/%d devices provisioned. Power cycle devices.\n",
+           failed ? "!" : "OK", count - failed, count);
+    return failed;
 }
 
 // ============================================================
 // MAIN
 // ============================================================
 
+// Returns 1 if the sidetone output failed at any point
+static int closeSidetone(void) {
+    if (!sidetone) return 0;
+    if (sidetone->started) cwside_advance(sidetone, getCurrentTimeMs());  // Let the last tone ring out
+    int failed = cwside_close(sidetone) != 0;
+    if (failed) fprintf(stderr, "[!] Sidetone output failed (player closed?)\n");
+    else if (!quietMode) printf("[*] Sidetone: %lu tones\n", sidetone->tones);
+    sidetone = NULL;
+    return failed;
+}
+
+// Restore the terminal if the timeline is interrupted
+#ifdef _WIN32
+static BOOL WINAPI timelineCtrlHandler(DWORD type) {
+    (void)type;
+    fputs("\x1b[0m\x1b[?25h\n", stdout);
+    fflush(stdout);
+    return FALSE;  // Let the default handler terminate
+}
+#else
+static void timelineSignalHandler(int sig) {
+    static const char restore[] = "\x1b[0m\x1b[?25h\n";
+    write(STDOUT_FILENO, restore, sizeof(restore) - 1);
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+#endif
+
+// Take over the terminal for --timeline. Returns 0, or -1 if stdout isn't one.
+static int openTimeline(double msPerColumn) {
+    int rows = 24, cols = 80;
+#ifdef _WIN32
+    HANDLE hOut = GetStdHandle(STD_OUTPUT_HANDLE);
+    CONSOLE_SCREEN_BUFFER_INFO info;
+    DWORD mode;
+    if (!GetConsoleScreenBufferInfo(hOut, &info) || !GetConsoleMode(hOut, &mode)) return -1;
+    rows = info.srWindow.Bottom - info.srWindow.Top + 1;
+    cols = info.srWindow.Right - info.srWindow.Left + 1;
+    SetConsoleMode(hOut, mode | 0x0004);  // ENABLE_VIRTUAL_TERMINAL_PROCESSING
+    SetConsoleOutputCP(CP_UTF8);
+    SetConsoleCtrlHandler(timelineCtrlHandler, TRUE);
+#else
+    if (!isatty(STDOUT_FILENO)) return -1;
+    struct winsize ws;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_row && ws.ws_col) {
+        rows = ws.ws_row;
+        cols = ws.ws_col;
+    }
+    signal(SIGINT, timelineSignalHandler);
+    signal(SIGTERM, timelineSignalHandler);
+    signal(SIGHUP, timelineSignalHandler);
+#endif
+    cwtl_init(&timelineView, stdout, rows, cols, msPerColumn);
+    timeline = &timelineView;
+    return 0;
+}
+
+static void closeTimeline(void) {
+    if (!timeline) return;
+    cwtl_finish(timeline, &decoder, getCurrentTimeMs());
+    printf("[*] %lu elements (%lu unsure), %lu noise, %lu characters (%lu unknown)\n", timeline->elements,
+           timeline->unsure, timeline->noise, timeline->chars, timeline->unknown);
+    timeline = NULL;
+}
+
+// --learn: Ctrl+C ends the session instead of the process, so the trained
+// classifier gets saved
+#ifdef _WIN32
+static BOOL WINAPI learnCtrlHandler(DWORD type) {
+    if (type != CTRL_C_EVENT && type != CTRL_BREAK_EVENT) return FALSE;
+    stopRequested = 1;
+    return TRUE;
+}
+#else
+static void learnSignalHandler(int sig) {
+    (void)sig;
+    stopRequested = 1;
+}
+#endif
+
+static void catchStop(void) {
+#ifdef _WIN32
+    SetConsoleCtrlHandler(learnCtrlHandler, TRUE);
+#else
+    signal(SIGINT, learnSignalHandler);
+    signal(SIGTERM, learnSignalHandler);
+#endif
+}
+
+// Write the classifier, as trained on this session, back into the
+// operator's profile. Returns 1 if it can't be written.
+static int saveLearned(const char *path) {
+    if (!path || !decoder.clfLoaded) return 0;
+    morseClfSave(&decoder, &decoderParams);
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        perror("Error writing profile");
+        return 1;
+    }
+    fprintf(f, "# Trained by serial_keyboard --learn (%lu elements this session)\n", decoder.stats.elements);
+    morseWriteProfile(f, &decoderParams);
+    if (fclose(f) != 0) {
+        perror("Error writing profile");
+        return 1;
+    }
+    if (!quietMode) {
+        printf("\n[OK] Classifier saved to %s: weights %.2f %.2f %.2f %.2f, bias %.2f\n", path,
+               decoderParams.clfWeights[0], decoderParams.clfWeights[1], decoderParams.clfWeights[2],
+               decoderParams.clfWeights[3], decoderParams.clfWeights[4]);
+    }
+    return 0;
+}
+
+// Does stdout take ANSI sequences (for the --complete hints)?
+static int consoleAnsi(void) {
+#ifdef _WIN32
+    HANDLE hOut = GetStdHandle(STD_OUTPUT_HANDLE);
+    DWORD mode;
+    if (!GetConsoleMode(hOut, &mode)) return 0;
+    return SetConsoleMode(hOut, mode | 0x0004) != 0;  // ENABLE_VIRTUAL_TERMINAL_PROCESSING
+#else
+    return isatty(STDOUT_FILENO);
+#endif
+}
+
+// Save the completion history. Returns 1 if it can't be written.
+static int closeCompletion(const char *path) {
+    if (!completing) return 0;
+    if (completeHints) {
+        printf("\x1b[K");
+        fflush(stdout);
+    }
+    int rc = 0;
+    if (cwcomp_save(completing, path) != 0) {
+        perror("Error writing completion history");
+        rc = 1;
+    } else if (!quietMode) {
+        printf("\n[OK] Completion history saved to %s\n", path);
+    }
+    if (completeSink) fclose(completeSink);
+    cwcomp_free(completing);
+    completing = NULL;
+    return rc;
+}
+
+// Release the expansion tables
+static void closeExpansion(void) {
+    if (!expanding) return;
+    cwexp_free(expanding);
+    expanding = NULL;
+}
+
+// Log the QSO in progress and write out the log
+static int closeLog(const char *path) {
+    if (!logging) return 0;
+    unsigned before = logging->logged;
+    int logged = cwqso_close(logging, getCurrentTimeMs()) == 0;
+    if (logging->logged > before && !quietMode) printf("\n[*] Logged %s\n", logging->last);
+    logging = NULL;
+    if (!logged) {
+        printf("[!] Error writing QSO log %s\n", path);
+        return 1;
+    }
+    if (!quietMode) printf("[OK] %u QSOs logged to %s\n", qsoLog.logged, path);
+    return 0;
+}
+
+// Fit and save the calibration profile, and show what it changes on the
+// session just sent. Returns 1 if calibration failed.
+static int closeCalibration(const char *path) {
+    if (!calibrating) return 0;
+    CwCalibration *c = calibrating;
+    calibrating = NULL;
+    if (cwcal_fit(c, &decoderParams) != 0) {
+        printf("\n[!] Calibration failed: only %zu of %zu elements matched the text. Send it again, as written.\n",
+               c->matched, c->nExpected);
+        cwcal_free(c);
+        return 1;
+    }
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        perror("Error writing profile");
+        cwcal_free(c);
+        return 1;
+    }
+    cwcal_write(f, c);
+    if (fclose(f) != 0) {
+        perror("Error writing profile");
+        cwcal_free(c);
+        return 1;
+    }
+
+    printf("\n[OK] Calibrated: %.1f WPM, weight %.0f, dah %.2f dits, gaps %.2f / %.2f / %.2f dits\n", c->wpm, c->weight,
+           c->dah.mean / c->dit.mean, c->gap[CWCAL_INTRA].mean / c->dit.mean, c->gap[CWCAL_CHAR].mean / c->dit.mean,
+           c->gap[CWCAL_WORD].mean / c->dit.mean);
+    printf("     Jitter: dit %.1f ms, dah %.1f ms, gaps %.1f / %.1f ms\n", c->dit.sd, c->dah.sd,
+           c->gap[CWCAL_INTRA].sd, c->gap[CWCAL_CHAR].sd);
+    printf("     %zu of %zu elements matched (%zu missed, %zu extra)\n", c->matched, c->nExpected, c->missed, c->extra);
+
+    // Re-decode the session both ways against the text
+    CwScorer sc;
+    if (cwscore_init(&sc) == 0) {
+        char *label = strdup(calibrationText);
+        size_t labelLen = label ? cwscore_normalize(label, strlen(label)) : 0;
+        if (label) {
+            long errors[2];
+            char first[2][32];
+            for (int k = 0; k < 2; k++) {
+                cwscore_decode(&sc, c->got, c->nGot, k ? &c->params : &decoderParams);
+                errors[k] = cwscore_errors(&sc, label, labelLen, (long)(sc.len + labelLen));
+                snprintf(first[k], sizeof(first[k]), "%.*s", (int)strcspn(sc.text, " "), sc.text);
+            }
+            printf("     This session decodes with %ld errors before, %ld with the profile (first word %s -> %s)\n",
+                   errors[0], errors[1], first[0], first[1]);
+            free(label);
+        }
+        cwscore_free(&sc);
+    }
+    printf("[*] Profile written to %s (use: --profile %s)\n", path, path);
+    cwcal_free(c);
+    return 0;
+}
+
 void printUsage(const char *progname) {
     printf("CW Hotline to Keyboard (Universal)\n");
     printf("Decodes Morse code from CW Hotline device and simulates keyboard input.\n\n");
@@ -889,6 +1970,7 @@ void printUsage(const char *progname) {
     printf("  (default)       Simulates Z/X keys for web trainers, shows decoded text\n");
     printf("  -k, --keyboard  Full Keyboard Mode - types decoded characters!\n");
     printf("  -q              Quiet mode (no console output)\n");
+    printf("  --no-keys       Console only: decode without pressing or typing keys\n");
     printf("  -v              Verbose mode (show raw data and timing info)\n");
     printf("  -r              Raw debug mode (show hex bytes)\n\n");
     printf("Options:\n");
@@ -897,16 +1979,73 @@ void printUsage(const char *progname) {
     printf("  -d <key>    Key for DOT in default mode (default: z)\n");
     printf("  -a <key>    Key for DASH in default mode (default: x)\n");
     printf("  --lowercase Output lowercase instead of UPPERCASE (default)\n");
+    printf("  --profile <file>      Load decoder timing rules (e.g. from cw_tune)\n");
+    printf("  --replay <file>       Decode a debug_serial capture or cw_archive file instead of the port\n");
+    printf("  --replay-speed <x>    Replay pacing (1 = real time, 0 = as fast as possible)\n");
+    printf("  --virtual-clock       Replay on a simulated clock: real-time behavior, instantly\n");
+    printf("  --audio <file|->      Decode CW from a WAV file or raw PCM (- = stdin)\n");
+    printf("  --audio-rate <Hz>     Sample rate of raw s16le PCM (default: %d)\n", CWAUDIO_DEFAULT_RATE);
+    printf("  --tone <lo>-<hi>      Audio tone search band in Hz (default: 300-1200)\n");
+    printf("  --sidetone <out>      Play a local sidetone: - (stdout), |<player cmd>, file.wav or raw file\n");
+    printf("  --sidetone-freq <Hz>  Sidetone pitch (default: %d)\n", CWSIDE_DEFAULT_FREQ);
+    printf("  --sidetone-latency <ms>  Audio queued ahead of the device (default: %d)\n", CWSIDE_DEFAULT_LATENCY_MS);
+    printf("  --timeline            Live view: elements to scale, gap decisions, thresholds, decoded text\n");
+    printf("  --timeline-ms <ms>    Timeline scale, ms per column (default: %d)\n", CWTL_DEFAULT_SCALE);
+    printf("  --calibrate <file>    Send a known text once; fit your timing and save it as a profile\n");
+    printf("  --calibrate-text <t>  Text for --calibrate (default: \"%s\")\n", CWCAL_DEFAULT_TEXT);
+    printf("  --learn <file>        Classify dits/dahs with a model trained on your sending; saved to <file> at exit\n");
+    printf("  --contest [wpm]       Fixed speed: lock the timing (default: --keyer-wpm, or the profile's speed)\n");
+    printf("  --expand              Expand abbreviations as they are decoded (TNX -> THANKS, 73 -> BEST REGARDS)\n");
+    printf("  --macros <file>       Your own expansions, \"KEY = text\" lines (implies --expand)\n");
+    printf("  --log <file>          Log QSOs (call, RST, serial, name, QTH) as they are decoded; .adi for ADIF, else CSV\n");
+    printf("  --log-side <s|r>      The decoded text is what we send (default) or receive (default with --audio)\n");
+    printf("  --complete <file>     Offer word completions from a base vocabulary and your history in <file>\n");
+    printf("  --complete-key <p>    Prosign that accepts the offer: BT (default), AR, KN or AA\n");
+    printf("  --complete-sink <f>   Also write every offer to <f> (file or FIFO)\n");
+    printf("  --paddle <device>     Key a paddle instead of the CW Hotline (Linux /dev/input/event*, or a MIDI port)\n");
+    printf("  --paddle-keys <d>,<a> Dit and dah key codes or MIDI notes (default: Ctrl or [ ] keys; notes 1,2)\n");
+    printf("  --keyer <a|b|straight>  Keyer mode for --paddle (default: b)\n");
+    printf("  --keyer-wpm <N>       Keyer speed (default: 20)\n");
+    printf("  --keyer-weight <N>    Element weighting, 50 = standard (25-75)\n");
+    printf("  --keyer-no-memory     Turn off dit/dah memory\n");
+    printf("  --batch <dir|file>    Decode recorded sessions offline on all cores\n");
+    printf("  --batch-out <dir>     Write <name>.txt and batch_stats.csv there (default: print)\n");
+    printf("  -j <N>                Worker threads for --batch (default: one per CPU)\n");
     printf("  -h          Show this help\n\n");
     printf("Device Config:\n");
     printf("  --speaker-on/off   Toggle internal speaker\n");
     printf("  --wpm <N>          Set keyer speed (7=straight key, 8-50)\n");
-    printf("  --config           Enter interactive config mode\n\n");
+    printf("  --config           Enter interactive config mode (Ctrl+] to quit)\n");
+    printf("  --set <n>=<value>  Set menu setting #n (1-%d), repeatable\n", CONFIG_TOTAL_SETTINGS);
+    printf("  --fleet            Apply the settings above to every CW Hotline found\n");
+    printf("  --fleet-port <p>   Use port <p> instead of discovery (repeatable)\n\n");
     printf("Examples:\n");
     printf("  %s                    # For web trainers (outputs Z/X keys)\n", progname);
     printf("  %s -k                 # TYPE WITH MORSE! (Full Keyboard Mode)\n", progname);
     printf("  %s -q                 # Silent operation\n", progname);
     printf("  %s -v                 # Debug timing issues\n", progname);
+    printf("  %s --fleet --wpm 18 --speaker-off  # Provision a classroom\n", progname);
+}
+
+// Where a session's results are written when it ends
+static struct {
+    const char *calibrate, *learn, *complete, *log;
+} sessionPaths;
+
+// End of a session, whichever loop ran it: out with anything still held
+// back, release the keyboard and write what the session produced. Returns
+// rc, or 1 if something could not be written.
+static int finishSession(int rc) {
+    releaseExpanded();
+    flushDecoded();
+    closeTimeline();
+    cleanup_keyboard();
+    rc = closeCalibration(sessionPaths.calibrate) || rc;
+    rc = saveLearned(sessionPaths.learn) || rc;
+    rc = closeCompletion(sessionPaths.complete) || rc;
+    closeExpansion();
+    rc = closeLog(sessionPaths.log) || rc;
+    return closeSidetone() || rc;
 }
 
 int main(int argc, char *argv[]) {
@@ -915,6 +2054,39 @@ int main(int argc, char *argv[]) {
     int speakerCmd = 0;
     int wpmCmd = 0;
     int configCmd = 0;
+    int fleetCmd = 0;
+    const char *replayPath = NULL;
+    double replaySpeed = 1.0;
+    const char *batchPath = NULL;
+    const char *batchOut = NULL;
+    int batchWorkers = 0;
+    int virtualClock = 0;
+    const char *audioPath = NULL;
+    int audioRate = 0;
+    double toneLo = 300, toneHi = 1200;
+    const char *sidetonePath = NULL;
+    double sidetoneFreq = CWSIDE_DEFAULT_FREQ;
+    int sidetoneLatency = CWSIDE_DEFAULT_LATENCY_MS;
+    const char *calibratePath = NULL;
+    const char *learnPath = NULL;
+    double contestWpm = -1;      // --contest: 0 until a speed is known
+    const char *completePath = NULL;
+    const char *macrosPath = NULL;
+    const char *logPath = NULL;
+    int logSent = -1;
+    int expandMode = 0;
+    const char *completeSinkPath = NULL;
+    int timelineCmd = 0;
+    double timelineScale = CWTL_DEFAULT_SCALE;
+    const char *paddlePath = NULL;
+    CwKeyerParams keyerParams;
+    int paddleDit = -1, paddleDah = -1;
+    static char fleetPorts[FLEET_MAX_DEVICES][128];
+    int fleetPortCount = 0;
+    char wpmVal[10];
+
+    morseDefaultParams(&decoderParams);
+    cwkeyer_default_params(&keyerParams);
 
     // Manual Arg Parsing
     for (int i=1; i<argc; i++) {
@@ -932,20 +2104,285 @@ int main(int argc, char *argv[]) {
         else if (strcmp(arg, "--wpm")==0 && i+1<argc) wpmCmd = atoi(argv[++i]);
         else if (strcmp(arg, "-k")==0 || strcmp(arg, "--keyboard")==0) keyboardMode = 1;
         else if (strcmp(arg, "--lowercase")==0 || strcmp(arg, "-l")==0) lowercaseMode = 1;
+        else if (strcmp(arg, "--no-keys")==0) noKeysMode = 1;
         else if (strcmp(arg, "--config")==0) configCmd = 1;
+        else if (strcmp(arg, "--fleet")==0) fleetCmd = 1;
+        else if (strcmp(arg, "--replay")==0 && i+1<argc) replayPath = argv[++i];
+        else if (strcmp(arg, "--replay-speed")==0 && i+1<argc) replaySpeed = atof(argv[++i]);
+        else if (strcmp(arg, "--profile")==0 && i+1<argc) {
+            const char *profile = argv[++i];
+            if (morseLoadProfile(&decoderParams, profile) != 0) {
+                printf("Cannot load profile '%s'\n", profile);
+                return 1;
+            }
+        }
+        else if (strcmp(arg, "--virtual-clock")==0) virtualClock = 1;
+        else if (strcmp(arg, "--audio")==0 && i+1<argc) audioPath = argv[++i];
+        else if (strcmp(arg, "--audio-rate")==0 && i+1<argc) audioRate = atoi(argv[++i]);
+        else if (strcmp(arg, "--tone")==0 && i+1<argc) {
+            const char *band = argv[++i];
+            if (sscanf(band, "%lf-%lf", &toneLo, &toneHi) != 2 || toneLo <= 0 || toneHi <= toneLo) {
+                printf("Invalid --tone '%s' (expected <lo>-<hi> in Hz)\n", band);
+                return 1;
+            }
+        }
+        else if (strcmp(arg, "--sidetone")==0 && i+1<argc) sidetonePath = argv[++i];
+        else if (strcmp(arg, "--sidetone-freq")==0 && i+1<argc) sidetoneFreq = atof(argv[++i]);
+        else if (strcmp(arg, "--sidetone-latency")==0 && i+1<argc) sidetoneLatency = atoi(argv[++i]);
+        else if (strcmp(arg, "--calibrate")==0 && i+1<argc) calibratePath = argv[++i];
+        else if (strcmp(arg, "--learn")==0 && i+1<argc) learnPath = argv[++i];
+        else if (strcmp(arg, "--expand")==0) expandMode = 1;
+        else if (strcmp(arg, "--macros")==0 && i+1<argc) { macrosPath = argv[++i]; expandMode = 1; }
+        else if (strcmp(arg, "--log")==0 && i+1<argc) logPath = argv[++i];
+        else if (strcmp(arg, "--log-side")==0 && i+1<argc) {
+            const char *side = argv[++i];
+            if (side[0] == 's' || side[0] == 'S') logSent = 1;
+            else if (side[0] == 'r' || side[0] == 'R') logSent = 0;
+            else {
+                printf("Invalid --log-side '%s' (expected sent or received)\n", side);
+                return 1;
+            }
+        }
+        else if (strcmp(arg, "--complete")==0 && i+1<argc) completePath = argv[++i];
+        else if (strcmp(arg, "--complete-sink")==0 && i+1<argc) completeSinkPath = argv[++i];
+        else if (strcmp(arg, "--complete-key")==0 && i+1<argc) {
+            const char *key = argv[++i];
+            if (strcasecmp(key, "BT")==0) completeKey = '=';
+            else if (strcasecmp(key, "AR")==0) completeKey = '+';
+            else if (strcasecmp(key, "KN")==0) completeKey = '(';
+            else if (strcasecmp(key, "AA")==0) completeKey = '\n';
+            else {
+                printf("Invalid --complete-key '%s' (expected BT, AR, KN or AA)\n", key);
+                return 1;
+            }
+        }
+        else if (strcmp(arg, "--contest")==0) {
+            contestWpm = 0;
+            if (i+1<argc && atof(argv[i+1]) > 0) contestWpm = atof(argv[++i]);
+        }
+        else if (strcmp(arg, "--calibrate-text")==0 && i+1<argc) calibrationText = argv[++i];
+        else if (strcmp(arg, "--timeline")==0) timelineCmd = 1;
+        else if (strcmp(arg, "--timeline-ms")==0 && i+1<argc) timelineScale = atof(argv[++i]);
+        else if (strcmp(arg, "--paddle")==0 && i+1<argc) paddlePath = argv[++i];
+        else if (strcmp(arg, "--paddle-keys")==0 && i+1<argc) {
+            const char *keys = argv[++i];
+            if (sscanf(keys, "%d,%d", &paddleDit, &paddleDah) != 2 || paddleDit < 0 || paddleDah < 0) {
+                printf("Invalid --paddle-keys '%s' (expected <dit>,<dah> key codes or MIDI notes)\n", keys);
+                return 1;
+            }
+        }
+        else if (strcmp(arg, "--keyer")==0 && i+1<argc) {
+            const char *mode = argv[++i];
+            if (strcmp(mode, "a")==0 || strcmp(mode, "A")==0) keyerParams.mode = CWKEYER_IAMBIC_A;
+            else if (strcmp(mode, "b")==0 || strcmp(mode, "B")==0) keyerParams.mode = CWKEYER_IAMBIC_B;
+            else if (strcmp(mode, "straight")==0) keyerParams.mode = CWKEYER_STRAIGHT;
+            else { printf("Invalid --keyer '%s' (expected a, b or straight)\n", mode); return 1; }
+        }
+        else if (strcmp(arg, "--keyer-wpm")==0 && i+1<argc) keyerParams.wpm = atof(argv[++i]);
+        else if (strcmp(arg, "--keyer-weight")==0 && i+1<argc) keyerParams.weight = atoi(argv[++i]);
+        else if (strcmp(arg, "--keyer-no-memory")==0) keyerParams.memory = 0;
+        else if (strcmp(arg, "--batch")==0 && i+1<argc) batchPath = argv[++i];
+        else if (strcmp(arg, "--batch-out")==0 && i+1<argc) batchOut = argv[++i];
+        else if (strcmp(arg, "-j")==0 && i+1<argc) batchWorkers = atoi(argv[++i]);
+        else if (strcmp(arg, "--fleet-port")==0 && i+1<argc) {
+            if (fleetPortCount < FLEET_MAX_DEVICES) snprintf(fleetPorts[fleetPortCount++], 128, "%s", argv[++i]);
+            else i++;
+        }
+        else if (strcmp(arg, "--set")==0 && i+1<argc) {
+            char *spec = argv[++i];
+            char *eq = strchr(spec, '=');
+            int idx = atoi(spec);
+            if (!eq || idx < 1 || idx > CONFIG_TOTAL_SETTINGS) {
+                printf("Invalid --set '%s' (expected <1-%d>=<value>)\n", spec, CONFIG_TOTAL_SETTINGS);
+                return 1;
+            }
+            fleetSnapshot[idx] = eq + 1;
+        }
+    }
+
+    if (fleetCmd) {
+        if (speakerCmd) fleetSnapshot[CONFIG_SPEAKER_INDEX] = speakerCmd == 2 ? "1" : "0";
+        if (wpmCmd) {
+            snprintf(wpmVal, sizeof(wpmVal), "%d", wpmCmd);
+            fleetSnapshot[CONFIG_WPM_INDEX] = wpmVal;
+        }
+        if (fleetSnapshotSize() == 0) {
+            printf("--fleet needs at least one of --wpm, --speaker-on/off or --set\n");
+            return 1;
+        }
+        return fleetConfig(fleetPorts, fleetPortCount, baud) ? 1 : 0;
+    }
+
+    if (virtualClock) {
+        if (!replayPath) {
+            printf("--virtual-clock only works with --replay\n");
+            return 1;
+        }
+        CwClock simulated = CWCLOCK_VIRTUAL;
+        appClock = simulated;
+    }
+
+    if (learnPath) {
+        // The operator's profile, once there is one
+        FILE *f = fopen(learnPath, "r");
+        if (f) {
+            fclose(f);
+            if (morseLoadProfile(&decoderParams, learnPath) != 0) {
+                printf("Cannot load profile '%s'\n", learnPath);
+                return 1;
+            }
+        }
+        decoderParams.classifier = 1;
+    }
+    if (contestWpm >= 0) {
+        // The agreed speed, else the keyer's, else the operator's calibrated one
+        if (contestWpm == 0 && paddlePath) contestWpm = keyerParams.wpm;
+        if (contestWpm == 0 && decoderParams.dit > 0) contestWpm = 1200.0 / decoderParams.dit;
+        if (contestWpm <= 0) {
+            printf("[!] --contest needs a speed: --contest <wpm>, --keyer-wpm, or a --calibrate profile\n");
+            return 1;
+        }
+        decoderParams.lockedWpm = contestWpm;
     }
 
-    init_keyboard();
+    // Offline: no keyboard, no port
+    if (batchPath) return batchDecode(batchPath, batchOut, batchWorkers);
+
+    morseInit(&decoder, onDecodedChar, onDecodedElement, NULL);
+    decoder.params = decoderParams;
+    decoder.verbose = verboseMode;
+    decoder.debug = debugMode;
+
+    if (sidetonePath) {
+        // PCM on stdout leaves no room for the text
+        if (strcmp(sidetonePath, "-") == 0) quietMode = 1;
+        if (sidetoneLatency < 0) sidetoneLatency = 0;
+        if (cwside_open(&sidetoneOut, sidetonePath, CWSIDE_DEFAULT_RATE, sidetoneFreq, (unsigned long)sidetoneLatency) != 0) {
+            printf("[!] Cannot open sidetone output '%s'\n", sidetonePath);
+            return 1;
+        }
+        sidetone = &sidetoneOut;
+        decoder.onKeying = onDecodedKeying;
+    }
+    if (calibratePath) {
+        if (cwcal_init(&calibration, calibrationText) != 0) {
+            printf("[!] Nothing to send in the calibration text '%s'\n", calibrationText);
+            return 1;
+        }
+        calibrating = &calibration;
+        decoder.onKeying = onDecodedKeying;
+    }
+    if (timelineCmd) {
+        if (sidetone && sidetone->f == stdout) {
+            printf("[!] --timeline and --sidetone - both need stdout\n");
+            return 1;
+        }
+        if (openTimeline(timelineScale) != 0) {
+            printf("[!] --timeline needs a terminal\n");
+            return 1;
+        }
+        // The timeline is the console output: no text, banners or timing dumps
+        quietMode = 1;
+        verboseMode = 0;
+        decoder.verbose = decoder.debug = 0;
+        decoder.onKeying = onDecodedKeying;
+    }
+    if (expandMode) {
+        if (cwexp_init(&expander) != 0) {
+            printf("[!] Out of memory\n");
+            return 1;
+        }
+        if (macrosPath && cwexp_load(&expander, macrosPath) != 0) {
+            printf("Cannot load macros '%s'\n", macrosPath);
+            return 1;
+        }
+        if (cwexp_compile(&expander) != 0) {
+            printf("[!] Out of memory\n");
+            return 1;
+        }
+        expanding = &expander;
+    }
+    if (logPath) {
+        if (cwqso_compile(&qsoLog) != 0) {
+            printf("[!] Out of memory\n");
+            return 1;
+        }
+        if (logSent < 0) logSent = !audioPath;
+        int opened = cwqso_open(&qsoLog, logPath, logSent);
+        if (opened == -2) {
+            printf("[!] QSO log '%s' ends in the middle of a record: complete it, or log to another file\n", logPath);
+            return 1;
+        }
+        if (opened != 0) {
+            printf("[!] Cannot open QSO log '%s'\n", logPath);
+            return 1;
+        }
+        if (qsoLog.trimmed > 0)
+            printf("[!] Dropped a partial entry (%ld bytes) from the end of %s\n", qsoLog.trimmed, logPath);
+        logging = &qsoLog;
+    }
+    if (completePath) {
+        if (cwcomp_init(&completer) != 0) {
+            printf("[!] Out of memory\n");
+            return 1;
+        }
+        FILE *f = fopen(completePath, "r");
+        if (f) {
+            fclose(f);
+            if (cwcomp_load(&completer, completePath) != 0) {
+                printf("Cannot load completion history '%s'\n", completePath);
+                return 1;
+            }
+        }
+        if (completeSinkPath && !(completeSink = fopen(completeSinkPath, "w"))) {
+            printf("[!] Cannot open completion sink '%s'\n", completeSinkPath);
+            return 1;
+        }
+        completing = &completer;
+        completeHints = !quietMode && !timeline && consoleAnsi();
+    }
+    if (learnPath || completePath || logPath) catchStop();
+    if (!noKeysMode) init_keyboard();
     
     if (!quietMode) {
         printf("[*] CW Hotline to Keyboard\n");
-        printf("    Port: %s @ %d baud\n", port, baud);
-        if (keyboardMode) printf("    Mode: FULL KEYBOARD (typing decoded chars)\n");
+        if (audioPath) printf("    Audio: %s\n", strcmp(audioPath, "-") == 0 ? "stdin" : audioPath);
+        else if (paddlePath) printf("    Paddle: %s\n", paddlePath);
+        else if (replayPath) printf("    Replay: %s\n", replayPath);
+        else printf("    Port: %s @ %d baud\n", port, baud);
+        if (noKeysMode) printf("    Mode: Console only (no keys)\n");
+        else if (keyboardMode) printf("    Mode: FULL KEYBOARD (typing decoded chars)\n");
         else printf("    Mode: Web Trainer (Z/X keys)\n");
         if (verboseMode) printf("    Verbose: ON (showing timing data)\n");
+        if (expanding) printf("    Expansion: %d macros\n", expanding->count);
+        if (logging) printf("    Log: %s (%s, %s side)\n", logPath, logging->adif ? "ADIF" : "CSV", logging->sent ? "sending" : "receiving");
+        if (completing) {
+            printf("    Completion: %u words, accept with %s\n", (unsigned)completing->words,
+                   completeKey == '=' ? "BT" : completeKey == '+' ? "AR" : completeKey == '(' ? "KN" : "AA");
+        }
+        if (decoderParams.lockedWpm > 0) {
+            printf("    Contest: locked at %.0f WPM (dit %.0f ms), no speed tracking\n", decoderParams.lockedWpm,
+                   1200.0 / decoderParams.lockedWpm);
+        }
+        if (sidetone) {
+            printf("    Sidetone: %.0f Hz, %d Hz s16le mono, %lu ms ahead -> %s\n", sidetone->freq,
+                   sidetone->sampleRate, sidetone->latencyMs, sidetonePath);
+        }
         printf("\n");
+        if (calibrating) {
+            printf("[*] Calibration: send this once, at your usual speed, then stop:\n\n    %s\n\n", calibrationText);
+        }
     }
 
+    sessionPaths.calibrate = calibratePath;
+    sessionPaths.learn = learnPath;
+    sessionPaths.complete = completePath;
+    sessionPaths.log = logPath;
+
+    if (audioPath) return finishSession(decodeAudio(audioPath, audioRate, toneLo, toneHi));
+    if (paddlePath) return finishSession(paddleLoop(paddlePath, &keyerParams, paddleDit, paddleDah));
+    if (replayPath) return finishSession(replayCapture(replayPath, replaySpeed));
+
     SERIAL_HANDLE h = os_open_serial(port, baud);
     if (h == INVALID_SERIAL_HANDLE) return 1;
 
@@ -962,59 +2399,23 @@ int main(int argc, char *argv[]) {
         return 0;
     }
 
-    if (!quietMode) printf("Listening... (decoded text will appear below)\n\n");
+    if (!quietMode) {
+        printf("Listening... (decoded text will appear below)\n\n");
+        fflush(stdout);  // Also when stdout is a pipe
+    }
 
-    // Main Loop with Buffering
-    static char lineBuf[4096];
-    static int linePos = 0;
-    
-    while(1) {
+    while(!sessionDone()) {
         char buf[256];
+        // Contest mode: wake up for the character deadline, not the read timeout
+        long due = decoder.lockDeadline ? morseUntilTimeout(&decoder, getCurrentTimeMs()) : -1;
+        if (due >= 0 && due < 100 && !os_serial_wait(h, (int)due)) {
+            checkTimeout();
+            continue;
+        }
         int n = os_serial_read(h, buf, sizeof(buf)-1);
         if (n > 0) {
-            lastActivityTime = getCurrentTimeMs();  // Update activity timestamp
-            if (debugMode) {
-                for(int j=0; j<n; j++) printf("[%02X]%c ", buf[j], (buf[j]>=32 && buf[j]<127)?buf[j]:'.');
-                printf("\n"); fflush(stdout);
-                continue;
-            }
-            
-            // Append to buffer
-            if (linePos + n < (int)sizeof(lineBuf)) {
-                memcpy(lineBuf + linePos, buf, n);
-                linePos += n;
-            } else {
-                // Buffer overflow protection
-                linePos = 0; 
-            }
-            
-            // Scan for lines
-            while(1) {
-                int found = -1;
-                for(int k=0; k<linePos; k++) {
-                    if (lineBuf[k] == '\n' || lineBuf[k] == '\r') {
-                        found = k;
-                        break;
-                    }
-                }
-                
-                if (found == -1) break;
-                
-                // Process Line
-                lineBuf[found] = 0;
-                handleLine(lineBuf);
-                
-                // Shift remaining
-                int remaining = linePos - (found + 1);
-                memmove(lineBuf, lineBuf + found + 1, remaining);
-                linePos = remaining;
-                
-                // If next char is also newline (CRLF?), skip it
-                if (linePos > 0 && (lineBuf[0] == '\n' || lineBuf[0] == '\r')) {
-                    memmove(lineBuf, lineBuf + 1, linePos - 1);
-                    linePos--;
-                }
-            }
+            decoder.lastActivityTime = getCurrentTimeMs();  // Update activity timestamp
+            feedSerialData(buf, n);
         } else if (n < 0) {
             // Error occurred
             #ifdef _WIN32
@@ -1038,10 +2439,6 @@ int main(int argc, char *argv[]) {
         }
     }
 
-    // Flush any remaining decoded text
-    flushDecoded();
-    
-    cleanup_keyboard();
     os_close_serial(h);
-    return 0;
+    return finishSession(0);
 }
@@ -0,0 +1,34 @@
+/*
+ * check.h
+ * What the checks in tests/ share: CHECK() counts a failed condition and
+ * says where it was, CHECK_ALLOC() gives up when memory runs out, and
+ * check_done() prints the verdict and returns main()'s exit code.
+ */
+
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { printf("[!] %s:%d: ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); failures++; } \
+} while (0)
+
+// Nothing after a failed allocation can be checked
+#define CHECK_ALLOC(ok) do { \
+    if (!(ok)) { printf("[!] Out of memory\n"); exit(1); } \
+} while (0)
+
+static inline int check_done(const char *name) {
+    if (failures) {
+        printf("[!] %s: %d checks failed\n", name, failures);
+        return 1;
+    }
+    printf("[OK] %s\n", name);
+    return 0;
+}
+
+#endif
@@ -0,0 +1,136 @@
+/*
+ * cw_complete_test.c
+ * Checks for cw_complete.h: offers from the base list and the operator's
+ * history, accepting an offer, and the history file. Every prefix of a few
+ * hundred random words is checked against a brute-force search.
+ *
+ * Build and run: make check
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../cw_complete.h"
+#include "check.h"
+
+#define HISTORY "cw_complete_test.tmp.txt"
+
+static void init(CwComplete *c) {
+    CHECK_ALLOC(cwcomp_init(c) == 0);
+}
+
+// Feed text; the word offered at the end, or "" for none
+static const char *offerAfter(CwComplete *c, const char *text) {
+    for (const char *p = text; *p; p++) cwcomp_char(c, *p);
+    return c->offer ? cwcomp_word(c, c->offer) : "";
+}
+
+// Each case on a fresh trie: every word finished, even a fragment, goes
+// into the history
+static void checkOffers(void) {
+    CwComplete c;
+    init(&c);
+    CHECK(strcmp(offerAfter(&c, "T"), "") == 0, "one letter offered '%s'", offerAfter(&c, ""));
+    CHECK(strcmp(offerAfter(&c, "H"), "THE") == 0, "TH offered '%s', expected THE (first in the list)", offerAfter(&c, ""));
+    CHECK(strcmp(offerAfter(&c, "a"), "THAT") == 0, "THa offered '%s'", offerAfter(&c, ""));
+    cwcomp_free(&c);
+
+    init(&c);
+    CHECK(strcmp(offerAfter(&c, "THE"), "") == 0, "a whole word offered '%s'", offerAfter(&c, ""));
+    cwcomp_free(&c);
+
+    init(&c);
+    CHECK(strcmp(offerAfter(&c, "XZ"), "") == 0, "no word offered '%s'", offerAfter(&c, ""));
+    CHECK(strcmp(offerAfter(&c, " TH?"), "") == 0, "punctuation offered '%s'", offerAfter(&c, ""));
+    CHECK(strcmp(offerAfter(&c, "E"), "") == 0, "a broken word offered '%s'", offerAfter(&c, ""));
+    offerAfter(&c, " ");
+    CHECK(strcmp(offerAfter(&c, "XZ"), "") == 0, "XZ offered '%s'", offerAfter(&c, ""));
+    CHECK(cwcomp_lookup(&c, "X", 1) != 0, "finished XZ not in the history");
+    CHECK(c.words == sizeof(cwcomp_base_words) / sizeof(cwcomp_base_words[0]) + 1, "%u words: a broken one was kept", c.words);
+    cwcomp_free(&c);
+
+    // Accepting: the rest of the word, which then counts as sent
+    init(&c);
+    CHECK(strcmp(offerAfter(&c, "an"), "AND") == 0, "an offered '%s'", offerAfter(&c, ""));
+    CHECK(strcmp(offerAfter(&c, "t"), "ANTENNA") == 0, "ant offered '%s'", offerAfter(&c, ""));
+    const char *rest = cwcomp_accept(&c);
+    CHECK(rest && strcmp(rest, "ENNA") == 0, "accepting ANT gave '%s'", rest ? rest : "(null)");
+    CHECK(c.offer == 0 && cwcomp_accept(&c) == NULL, "an offer left after accepting");
+    offerAfter(&c, " ");
+    uint32_t antenna = cwcomp_lookup(&c, "ANTENN", 6);
+    CHECK(antenna && c.nodes[antenna].hist == 1, "accepted ANTENNA not counted as sent");
+    cwcomp_free(&c);
+
+    // One finished word outweighs the base list, and the history survives
+    // a save and a load
+    init(&c);
+    offerAfter(&c, "THURSDAY W1AW W1AW ");
+    CHECK(strcmp(offerAfter(&c, "TH"), "THURSDAY") == 0, "TH after THURSDAY offered '%s'", offerAfter(&c, ""));
+    CHECK(cwcomp_save(&c, HISTORY) == 0, "cannot save %s", HISTORY);
+    cwcomp_free(&c);
+    init(&c);
+    CHECK(cwcomp_load(&c, HISTORY) == 0, "cannot load %s", HISTORY);
+    CHECK(strcmp(offerAfter(&c, "TH"), "THURSDAY") == 0, "TH after loading offered '%s'", offerAfter(&c, ""));
+    uint32_t w1aw = cwcomp_lookup(&c, "W1", 2);
+    CHECK(w1aw && strcmp(cwcomp_word(&c, w1aw), "W1AW") == 0 && c.nodes[w1aw].hist == 2, "W1AW not loaded with its count");
+    cwcomp_free(&c);
+    remove(HISTORY);
+}
+
+// Random words, each with its own count: the offer for every prefix is the
+// highest-scoring longer word with that prefix
+#define RANDOM_WORDS 400
+
+static void checkRandom(void) {
+    static char words[RANDOM_WORDS][9];
+    static uint32_t score[RANDOM_WORDS];
+    CwComplete c;
+    init(&c);
+    uint64_t rng = 42;
+    int n = 0;
+    while (n < RANDOM_WORDS) {
+        char w[9];
+        rng = rng * 6364136223846793005ULL + 1442695040888963407ULL;
+        int len = 2 + (int)((rng >> 33) % 7);
+        for (int i = 0; i < len; i++) {
+            rng = rng * 6364136223846793005ULL + 1442695040888963407ULL;
+            w[i] = "ABCDEST"[(rng >> 33) % 7];    // Few letters: long shared prefixes
+        }
+        w[len] = '\0';
+        int dup = 0;
+        for (int i = 0; i < n && !dup; i++) dup = strcmp(words[i], w) == 0;
+        for (size_t i = 0; i < sizeof(cwcomp_base_words) / sizeof(cwcomp_base_words[0]) && !dup; i++)
+            dup = strcmp(cwcomp_base_words[i], w) == 0;
+        if (dup) continue;
+        strcpy(words[n], w);
+        score[n] = (uint32_t)((n * 7919) % RANDOM_WORDS) + 2;  // All different, all above a base word
+        CHECK_ALLOC(cwcomp_add(&c, w, (size_t)len, score[n], 0));
+        n++;
+    }
+
+    int checked = 0;
+    for (int i = 0; i < n; i++) {
+        size_t len = strlen(words[i]);
+        for (size_t p = 1; p <= len; p++) {
+            // Brute force: only random words can win, they outscore the base list
+            int best = -1;
+            for (int j = 0; j < n; j++) {
+                if (strncmp(words[j], words[i], p) == 0 && (best < 0 || score[j] > score[best])) best = j;
+            }
+            const char *want = strlen(words[best]) > p ? words[best] : "";
+            uint32_t got = cwcomp_lookup(&c, words[i], p);
+            CHECK(strcmp(got ? cwcomp_word(&c, got) : "", want) == 0, "prefix %.*s: offered '%s', expected '%s'",
+                  (int)p, words[i], got ? cwcomp_word(&c, got) : "", want);
+            checked++;
+        }
+    }
+    CHECK(checked > RANDOM_WORDS, "only %d prefixes checked", checked);
+    cwcomp_free(&c);
+}
+
+int main(void) {
+    checkOffers();
+    checkRandom();
+    return check_done("cw_complete");
+}
@@ -0,0 +1,134 @@
+/*
+ * cw_expand_test.c
+ * Checks for cw_expand.h: keys expand only as whole words (one or
+ * several), the longest key wins, text that can't start a key is released
+ * at once, and macro files load.
+ *
+ * Build and run: make check
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../cw_expand.h"
+#include "check.h"
+
+#define MACROS "cw_expand_test.tmp.txt"
+
+static void compile(CwExpand *e) {
+    CHECK_ALLOC(cwexp_compile(e) == 0);
+}
+
+// Everything released so far, drained (static buffer)
+static const char *drain(CwExpand *e) {
+    static char buf[4096];
+    size_t n = e->outLen < sizeof(buf) - 1 ? e->outLen : sizeof(buf) - 1;
+    memcpy(buf, e->outText, n);
+    buf[n] = '\0';
+    e->outLen = 0;
+    return buf;
+}
+
+// The whole stream through a fresh start, flushed at the end
+static const char *expand(CwExpand *e, const char *in) {
+    e->state = 0;
+    e->heldLen = 0;
+    e->pos = 0;
+    for (const char *p = in; *p; p++) cwexp_char(e, *p);
+    cwexp_flush(e);
+    return drain(e);
+}
+
+static void checkWords(void) {
+    CwExpand e;
+    CHECK_ALLOC(cwexp_init(&e) == 0);
+    CHECK_ALLOC(cwexp_add(&e, "CU AGN", "SEE YOU AGAIN") == 0);
+    compile(&e);
+
+    static const struct { const char *in, *out; } cases[] = {
+        { "TNX FER CALL ", "THANKS FER CALL " },
+        { "tnx fer call ", "THANKS fer call " },            // Either case; the rest as sent
+        { "ATNXB ", "ATNXB " },                             // Not a whole word...
+        { "ATNX ", "ATNX " },
+        { "TNXB ", "TNXB " },
+        { "HR TNX\n", "HERE THANKS\n" },                    // ...at a word start, ended by any word gap
+        { "73 73 ", "BEST REGARDS BEST REGARDS " },
+        { "TNX", "THANKS" },                                // The end of the stream ends the word
+        { "TN", "TN" },
+        { "CU AGN ", "SEE YOU AGAIN " },                    // Several words: the longest key wins
+        { "XCU AGN ", "XCU AGAIN " },                       // ...but it too has to start at a word
+        { "CU AGN", "SEE YOU AGAIN" },
+        { "CU LATER ", "CU LATER " },
+        { "GM OM ", "GOOD MORNING OLD MAN " },
+        { "UR RST 599 ", "YOUR RST 599 " },
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        const char *got = expand(&e, cases[i].in);
+        CHECK(strcmp(got, cases[i].out) == 0, "'%s' gave '%s', expected '%s'", cases[i].in, got, cases[i].out);
+    }
+    cwexp_free(&e);
+}
+
+// What can't start a key is typed as it arrives; a possible key waits
+static void checkHolding(void) {
+    CwExpand e;
+    CHECK_ALLOC(cwexp_init(&e) == 0);
+    compile(&e);
+    const char *steps[][2] = {
+        { "HELLO", "HELLO" },
+        { " ", " " },
+        { "Q", "Q" },          // No key starts with Q
+        { "RZ ", "RZ " },
+        { "T", "" },           // TNX, TKS, TU...
+        { "N", "" },
+        { "X", "" },
+        { " ", "THANKS " },
+        { "W", "" },           // WX, WKD
+        { "A", "WA" },         // WA is no key
+        { "TNX", "TNX" },      // Inside a word: nothing to wait for
+    };
+    for (size_t i = 0; i < sizeof(steps) / sizeof(steps[0]); i++) {
+        for (const char *p = steps[i][0]; *p; p++) cwexp_char(&e, *p);
+        const char *got = drain(&e);
+        CHECK(strcmp(got, steps[i][1]) == 0, "after '%s' released '%s', expected '%s'", steps[i][0], got, steps[i][1]);
+    }
+    cwexp_free(&e);
+}
+
+static void checkLoad(void) {
+    FILE *f = fopen(MACROS, "w");
+    if (!f) { perror(MACROS); exit(1); }
+    fputs("# Station macros\n"
+          "QTH = MY QTH IS SPRINGFIELD, OREGON\n"
+          "  SK  =  73 AND GOOD DX\\nSK\n"
+          "TNX = THX\n", f);
+    fclose(f);
+    CwExpand e;
+    CHECK_ALLOC(cwexp_init(&e) == 0);
+    CHECK(cwexp_load(&e, MACROS) == 0, "cannot load %s", MACROS);
+    compile(&e);
+    const char *got = expand(&e, "QTH ");
+    CHECK(strcmp(got, "MY QTH IS SPRINGFIELD, OREGON ") == 0, "QTH gave '%s'", got);
+    got = expand(&e, "SK ");
+    CHECK(strcmp(got, "73 AND GOOD DX\nSK ") == 0, "SK gave '%s'", got);   // Not expanded again
+    got = expand(&e, "TNX ");
+    CHECK(strcmp(got, "THX ") == 0, "a replaced built-in gave '%s'", got);
+    cwexp_free(&e);
+
+    f = fopen(MACROS, "w");
+    if (!f) { perror(MACROS); exit(1); }
+    fputs("NO EQUALS SIGN\n", f);
+    fclose(f);
+    CHECK_ALLOC(cwexp_init(&e) == 0);
+    CHECK(cwexp_load(&e, MACROS) != 0, "a bad line was accepted");
+    cwexp_free(&e);
+    remove(MACROS);
+}
+
+int main(void) {
+    checkWords();
+    checkHolding();
+    checkLoad();
+    return check_done("cw_expand");
+}
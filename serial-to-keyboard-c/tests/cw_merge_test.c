@@ -0,0 +1,201 @@
+/*
+ * cw_merge_test.c
+ * Checks for cw_merge.h (release order, floors, the delay) and for
+ * cw_merge itself: a recorded three-turn QSO between two devices has to
+ * come out turn by turn.
+ *
+ * Build and run: make check (needs ./cw_merge)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../cw_capture.h"
+#include "../cw_gen.h"
+#include "../cw_merge.h"
+#include "check.h"
+
+// ============================================================
+// RELEASE ORDER
+// ============================================================
+
+#define MAX_RELEASED 4096
+
+typedef struct {
+    int device[MAX_RELEASED];
+    unsigned long timeMs[MAX_RELEASED];
+    char text[MAX_RELEASED][CWMERGE_MAX_WORD + 1];
+    int count;
+} Released;
+
+static void onWord(void *ctx, int device, const CwMergeWord *w) {
+    Released *r = (Released *)ctx;
+    if (r->count == MAX_RELEASED) return;
+    r->device[r->count] = device;
+    r->timeMs[r->count] = w->timeMs;
+    strcpy(r->text[r->count], w->text);
+    r->count++;
+}
+
+static void word(CwMerge *m, int d, unsigned long timeMs, const char *text) {
+    CHECK_ALLOC(cwmerge_word(m, d, timeMs, text, strlen(text)) == 0);
+}
+
+static void checkFloors(void) {
+    static Released r;
+    CwMerge m;
+    memset(&r, 0, sizeof(r));
+    CHECK_ALLOC(cwmerge_init(&m, 3, 10000, onWord, &r) == 0);
+    word(&m, 0, 100, "CQ");
+    word(&m, 0, 400, "DE");
+    word(&m, 1, 200, "K1ABC");
+    cwmerge_floor(&m, 2, 50);
+
+    // Device 2 may still finish a word that began at 50
+    cwmerge_run(&m, 500, 0);
+    CHECK(r.count == 0, "released %d words past a floor of 50", r.count);
+
+    // Up to 250 is settled: 100 and 200, but not device 0's 400 while device 1 is idle at 300
+    cwmerge_floor(&m, 1, 300);
+    cwmerge_floor(&m, 2, 250);
+    cwmerge_run(&m, 500, 0);
+    CHECK(r.count == 2 && r.timeMs[0] == 100 && r.timeMs[1] == 200, "released %d words up to a floor of 250", r.count);
+
+    // A word that has waited the delay goes out whatever the floors say
+    cwmerge_run(&m, 400 + 10000, 0);
+    CHECK(r.count == 3 && strcmp(r.text[2], "DE") == 0, "delay did not release 'DE'");
+    CHECK(m.late == 0, "%lu late", m.late);
+
+    // ...and a word finished after it is late
+    word(&m, 2, 260, "W1AW");
+    cwmerge_run(&m, 10500, 1);
+    CHECK(r.count == 4 && m.late == 1, "late word: released %d, %lu late", r.count, m.late);
+    cwmerge_free(&m);
+}
+
+// Ties go by device number, and every queue grows past its first ring
+static void checkOrder(void) {
+    static Released r;
+    CwMerge m;
+    enum { DEVICES = 7, WORDS = 300 };
+    memset(&r, 0, sizeof(r));
+    CHECK_ALLOC(cwmerge_init(&m, DEVICES, 10000, onWord, &r) == 0);
+    uint64_t rng = 12345;
+    for (int d = DEVICES - 1; d >= 0; d--) {
+        unsigned long t = 0;
+        for (int i = 0; i < WORDS; i++) {
+            rng = rng * 6364136223846793005ULL + 1442695040888963407ULL;
+            t += (unsigned long)(rng >> 33) % 50;    // Steps of 0 make ties within a device
+            char text[16];
+            snprintf(text, sizeof(text), "%d.%d", d, i);
+            word(&m, d, t, text);
+        }
+    }
+    for (int d = 0; d < DEVICES; d++) cwmerge_floor(&m, d, CWMERGE_DONE);
+    cwmerge_run(&m, 0, 0);
+
+    CHECK(r.count == DEVICES * WORDS, "released %d of %d words", r.count, DEVICES * WORDS);
+    int next[DEVICES] = { 0 };
+    for (int i = 0; i < r.count; i++) {
+        if (i > 0) {
+            int ordered = r.timeMs[i] > r.timeMs[i - 1] ||
+                          (r.timeMs[i] == r.timeMs[i - 1] && r.device[i] >= r.device[i - 1]);
+            CHECK(ordered, "word %d (%lu ms, device %d) after %lu ms, device %d",
+                  i, r.timeMs[i], r.device[i], r.timeMs[i - 1], r.device[i - 1]);
+        }
+        char want[16];
+        snprintf(want, sizeof(want), "%d.%d", r.device[i], next[r.device[i]]++);
+        CHECK(strcmp(r.text[i], want) == 0, "device %d released '%s' for '%s'", r.device[i], r.text[i], want);
+    }
+    CHECK(m.late == 0, "%lu late", m.late);
+    cwmerge_free(&m);
+}
+
+// ============================================================
+// RECORDED QSO
+// ============================================================
+
+#define ALICE "cw_merge_test.tmp.alice.cwcap"
+#define BOB "cw_merge_test.tmp.bob.cwcap"
+
+typedef struct {
+    FILE *f;
+    uint64_t baseMs;
+} Capture;
+
+static void captureElement(void *ctx, const CwArcElement *e) {
+    Capture *c = (Capture *)ctx;
+    char line[32];
+    int len = snprintf(line, sizeof(line), "S,%u,%u\r\n", (unsigned)e->pause, (unsigned)e->length);
+    cwcap_write_chunk(c->f, (c->baseMs + e->arrivalMs) * 1000, line, (uint32_t)len);
+}
+
+// Key text into the capture from startMs on; returns when the last element ends
+static uint64_t keyTurn(Capture *c, uint64_t startMs, const char *text) {
+    CwGenParams p;
+    cwgen_default_params(&p);
+    CwGen g;
+    cwgen_init(&g, &p, captureElement, c);
+    c->baseMs = startMs;
+    cwgen_text(&g, text);
+    return startMs + g.clockMs;
+}
+
+static void checkTurns(void) {
+    const char *sent[] = {
+        "VVV CQ CQ DE K1ABC K1ABC K",
+        "VVV K1ABC DE W1AW GM OM TNX FER CALL UR RST 599 599 NAME BOB QTH BOSTON HW? K1ABC DE W1AW K",
+        "R R W1AW DE K1ABC TNX BOB UR 579 NAME ALICE 73 SK",
+    };
+    Capture alice = { fopen(ALICE, "wb"), 0 }, bob = { fopen(BOB, "wb"), 0 };
+    if (!alice.f || !bob.f) { perror("cw_merge_test"); exit(1); }
+    cwcap_write_header(alice.f, 115200);
+    cwcap_write_header(bob.f, 115200);
+    // Bob's turn lasts well past the default --delay, which would otherwise
+    // let his words go out ahead of alice's last one
+    uint64_t t = keyTurn(&alice, 1000, sent[0]);
+    t = keyTurn(&bob, t + 1500, sent[1]);
+    keyTurn(&alice, t + 1500, sent[2]);
+    fclose(alice.f);
+    fclose(bob.f);
+
+    FILE *p = popen("./cw_merge " ALICE " " BOB " --names alice,bob 2>&1", "r");
+    if (!p) { perror("./cw_merge"); exit(1); }
+    // A turn may wrap onto several lines; a new device starts the next turn
+    static const char *want[] = { "alice", "bob", "alice" };
+    char line[512], prev[512] = "", device[16] = "";
+    int turns = 0;
+    double last = 0;
+    while (fgets(line, sizeof(line), p)) {
+        double at;
+        char name[16];
+        if (sscanf(line, "%lfs %15s", &at, name) != 2) continue;
+        line[strcspn(line, "\n")] = '\0';
+        CHECK(at >= last, "line starts before the one above it: '%s'", line);
+        last = at;
+        if (strcmp(name, device) == 0) {
+            strcpy(prev, line);
+            continue;
+        }
+        if (turns == 1) {
+            size_t n = strlen(prev);
+            CHECK(n >= 2 && strcmp(prev + n - 2, " K") == 0, "alice's first turn lost its K: '%s'", prev);
+        }
+        CHECK(turns < 3 && strcmp(name, want[turns]) == 0, "turn %d: '%s'", turns + 1, line);
+        strcpy(device, name);
+        strcpy(prev, line);
+        turns++;
+    }
+    CHECK(pclose(p) == 0, "./cw_merge failed");
+    CHECK(turns == 3, "%d turns, expected 3", turns);
+    remove(ALICE);
+    remove(BOB);
+}
+
+int main(void) {
+    checkFloors();
+    checkOrder();
+    checkTurns();
+    return check_done("cw_merge");
+}
@@ -0,0 +1,161 @@
+/*
+ * cw_qso_test.c
+ * Checks for cw_qso.h: the word classes the DFA gives, a QSO logged from
+ * the decoded stream, and what cwqso_open() does to logs it finds.
+ *
+ * Build and run: make check
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../cw_qso.h"
+#include "check.h"
+
+#define LOG_ADI "cw_qso_test.tmp.adi"
+#define LOG_CSV "cw_qso_test.tmp.csv"
+
+static void writeFile(const char *path, const char *text) {
+    FILE *f = fopen(path, "wb");
+    if (!f) { perror(path); exit(1); }
+    fputs(text, f);
+    fclose(f);
+}
+
+// The whole file, or "" if there is none (static buffer)
+static const char *readFile(const char *path) {
+    static char buf[8192];
+    FILE *f = fopen(path, "rb");
+    size_t n = f ? fread(buf, 1, sizeof(buf) - 1, f) : 0;
+    if (f) fclose(f);
+    buf[n] = '\0';
+    return buf;
+}
+
+static int startsWith(const char *s, const char *prefix) {
+    return strncmp(s, prefix, strlen(prefix)) == 0;
+}
+
+// Open path as found, log nothing, close. Returns what cwqso_open() did.
+static int reopen(const char *path, long *trimmed) {
+    CwQso q;
+    memset(&q, 0, sizeof(q));
+    CHECK_ALLOC(cwqso_compile(&q) == 0);
+    int rc = cwqso_open(&q, path, 1);
+    *trimmed = q.trimmed;
+    cwqso_close(&q, 0);
+    return rc;
+}
+
+static void checkClasses(void) {
+    CwQso q;
+    memset(&q, 0, sizeof(q));
+    CHECK_ALLOC(cwqso_compile(&q) == 0);
+    static const struct { const char *word; uint32_t want, not; } cases[] = {
+        { "K1ABC", 1u << CWQSO_CALL, 1u << CWQSO_WORD },
+        { "W1AW/P", 1u << CWQSO_CALL, 0 },
+        { "VE3/K1ABC", 1u << CWQSO_CALL, 0 },
+        { "599", (1u << CWQSO_RST) | (1u << CWQSO_NUM), 1u << CWQSO_CALL },
+        { "5NN", (1u << CWQSO_RST) | (1u << CWQSO_NUM), 1u << CWQSO_CALL },
+        { "TT7", 1u << CWQSO_NUM, 1u << CWQSO_RST },
+        { "DE", (1u << CWQSO_KW_DE) | (1u << CWQSO_WORD), 1u << CWQSO_CALL },
+        { "TEST", 1u << CWQSO_KW_CQ, 0 },
+        { "BOSTON", 1u << CWQSO_WORD, CWQSO_KEYWORDS },
+        { "=", 1u << CWQSO_KW_BREAK, 1u << CWQSO_WORD },
+        { "K1", 0, 1u << CWQSO_CALL },
+        { "", 0, ~0u },
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        uint32_t got = cwqso_classify(&q, cases[i].word);
+        CHECK((got & cases[i].want) == cases[i].want, "'%s': classes %#x lack %#x", cases[i].word, got, cases[i].want);
+        CHECK((got & cases[i].not) == 0, "'%s': classes %#x include %#x", cases[i].word, got, got & cases[i].not);
+    }
+    cwqso_close(&q, 0);
+}
+
+static void checkStream(void) {
+    remove(LOG_CSV);
+    CwQso q;
+    memset(&q, 0, sizeof(q));
+    CHECK_ALLOC(cwqso_compile(&q) == 0);
+    CHECK(cwqso_open(&q, LOG_CSV, 1) == 0, "cannot create %s", LOG_CSV);
+    const char *text = "K1ABC DE W1AW UR RST 5NN NAME BOB QTH BOSTON TU ";
+    for (const char *p = text; *p; p++) cwqso_char(&q, *p, 1000);
+    CHECK(cwqso_close(&q, 2000) == 0, "cannot close %s", LOG_CSV);
+    CHECK(q.logged == 1, "logged %u QSOs, expected 1", q.logged);
+
+    const char *log = readFile(LOG_CSV);
+    CHECK(startsWith(log, CWQSO_CSV_HEADER), "new log has no header");
+    const char *line = log + strlen(CWQSO_CSV_HEADER);
+    CHECK(strstr(line, ",K1ABC,W1AW,599,,,,,,BOB,BOSTON\n") != NULL, "logged '%s'", line);
+    remove(LOG_CSV);
+}
+
+static void checkOpen(void) {
+    long trimmed;
+    const char *wsjtx = "WSJT-X ADIF Export<eoh>\n"
+                        "<call:5>K1ABC <gridsquare:4>FN42 <mode:3>FT8 <eor>\n"
+                        "<call:4>W1AW <gridsquare:4>FN31 <mode:3>FT8 <eor>\n";
+
+    // Someone else's ADIF, lower-case tags: never trimmed
+    writeFile(LOG_ADI, wsjtx);
+    CHECK(reopen(LOG_ADI, &trimmed) == 0 && trimmed == 0, "WSJT-X log: trimmed %ld", trimmed);
+    CHECK(strcmp(readFile(LOG_ADI), wsjtx) == 0, "WSJT-X log changed");
+
+    // ...also without the last newline
+    char noNewline[512];
+    snprintf(noNewline, sizeof(noNewline), "%.*s", (int)strlen(wsjtx) - 1, wsjtx);
+    writeFile(LOG_ADI, noNewline);
+    CHECK(reopen(LOG_ADI, &trimmed) == 0 && trimmed == 0, "WSJT-X log without newline: trimmed %ld", trimmed);
+    CHECK(startsWith(readFile(LOG_ADI), noNewline), "WSJT-X log without newline changed");
+
+    // ...and refused, untouched, if it ends mid-record
+    char partial[512];
+    snprintf(partial, sizeof(partial), "%s<call:4>N0CA <mode:2>CW", wsjtx);
+    writeFile(LOG_ADI, partial);
+    CHECK(reopen(LOG_ADI, &trimmed) == -2, "WSJT-X log ending mid-record was not refused");
+    CHECK(strcmp(readFile(LOG_ADI), partial) == 0, "refused log changed");
+
+    // Our own ADIF with a record cut short: trimmed
+    char whole[512], cut[1024];
+    snprintf(whole, sizeof(whole), "%s<QSO_DATE:8>20260101 <CALL:5>K1ABC <MODE:2>CW <EOR>\n", CWQSO_ADIF_HEADER);
+    snprintf(cut, sizeof(cut), "%s<QSO_DATE:8>20260101 <TIME_ON:6>1200", whole);
+    writeFile(LOG_ADI, cut);
+    CHECK(reopen(LOG_ADI, &trimmed) == 0, "cannot reopen our cut ADIF log");
+    CHECK(trimmed == (long)(strlen(cut) - strlen(whole)), "our cut ADIF log: trimmed %ld", trimmed);
+    CHECK(strcmp(readFile(LOG_ADI), whole) == 0, "our cut ADIF log: '%s'", readFile(LOG_ADI));
+
+    // A header cut short is written again; a missing log gets one
+    writeFile(LOG_ADI, "CW Hotline QSO");
+    CHECK(reopen(LOG_ADI, &trimmed) == 0, "cannot reopen a cut header");
+    CHECK(strcmp(readFile(LOG_ADI), CWQSO_ADIF_HEADER) == 0, "cut header: '%s'", readFile(LOG_ADI));
+    remove(LOG_ADI);
+    CHECK(reopen(LOG_ADI, &trimmed) == 0 && strcmp(readFile(LOG_ADI), CWQSO_ADIF_HEADER) == 0, "new ADIF log");
+    remove(LOG_ADI);
+
+    // Someone else's CSV without a last newline: the line stays
+    writeFile(LOG_CSV, "call,name\nK1ABC,BOB");
+    CHECK(reopen(LOG_CSV, &trimmed) == 0 && trimmed == 0, "CSV without newline: trimmed %ld", trimmed);
+    CHECK(strcmp(readFile(LOG_CSV), "call,name\nK1ABC,BOB\n") == 0, "CSV without newline: '%s'", readFile(LOG_CSV));
+
+    // Our own CSV: a short line is a cut write, a whole one only lacks its newline
+    const char *entry = "20260101,120000,120500,K1ABC,W1AW,599,,,,,,BOB,BOSTON";
+    snprintf(whole, sizeof(whole), "%s%s\n", CWQSO_CSV_HEADER, entry);
+    snprintf(cut, sizeof(cut), "%s20260101,1210", whole);
+    writeFile(LOG_CSV, cut);
+    CHECK(reopen(LOG_CSV, &trimmed) == 0 && trimmed == 13, "our cut CSV log: trimmed %ld", trimmed);
+    CHECK(strcmp(readFile(LOG_CSV), whole) == 0, "our cut CSV log: '%s'", readFile(LOG_CSV));
+    snprintf(cut, sizeof(cut), "%s%s", CWQSO_CSV_HEADER, entry);
+    writeFile(LOG_CSV, cut);
+    CHECK(reopen(LOG_CSV, &trimmed) == 0 && trimmed == 0, "our CSV without newline: trimmed %ld", trimmed);
+    CHECK(strcmp(readFile(LOG_CSV), whole) == 0, "our CSV without newline: '%s'", readFile(LOG_CSV));
+    remove(LOG_CSV);
+}
+
+int main(void) {
+    checkClasses();
+    checkStream();
+    checkOpen();
+    return check_done("cw_qso");
+}
@@ -0,0 +1,140 @@
+/*
+ * morse_batch_test.c
+ * Checks for morse_batch.h: the vector kernel this build picked gives the
+ * same class bytes as morseClassifyOne() on cw_gen corpora, at every
+ * offset and tail length and right at the thresholds, and clean CW walks
+ * back to the text it was generated from.
+ *
+ * Build and run: make check
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../cw_batch.h"
+#include "../cw_gen.h"
+#include "../cw_score.h"
+#include "../morse_batch.h"
+#include "check.h"
+
+#define CORPUS_CHARS 1500
+
+static void collectElement(void *ctx, const CwArcElement *e) {
+    CHECK_ALLOC(cwbatch_push((CwElementList *)ctx, e->pause, e->length, e->arrivalMs) == 0);
+}
+
+static MorseTimingModel modelFor(const CwGenParams *p) {
+    int dot = (int)(1200.0 / p->wpm + 0.5);
+    MorseTimingModel m = morseModel(dot, (int)(dot * p->dahRatio + 0.5), NULL);
+    m.wordGap *= p->farnsworth;
+    morseModelPrepare(&m);
+    return m;
+}
+
+// Every start offset and every length up to two vectors past it, so each
+// kernel's main loop and scalar tail both run
+static void checkSame(const MorseTimingModel *m, const int32_t *pauses, const int32_t *lengths, size_t n,
+                      const char *what) {
+    uint8_t *classes = (uint8_t *)malloc(n + 1);
+    CHECK_ALLOC(classes);
+    morseClassifyBatch(m, pauses, lengths, classes, n);
+    size_t bad = n;
+    for (size_t i = 0; i < n && bad == n; i++) {
+        if (classes[i] != morseClassifyOne(m, pauses[i], lengths[i])) bad = i;
+    }
+    CHECK(bad == n, "%s: element %zu (pause %d, length %d) is %#x, scalar %#x", what, bad, bad < n ? pauses[bad] : 0,
+          bad < n ? lengths[bad] : 0, bad < n ? classes[bad] : 0, bad < n ? morseClassifyOne(m, pauses[bad], lengths[bad]) : 0);
+    for (size_t off = 0; off < 16 && off < n; off++) {
+        for (size_t len = 0; len <= 40 && off + len <= n; len++) {
+            memset(classes, 0xFF, n + 1);
+            morseClassifyBatch(m, pauses + off, lengths + off, classes, len);
+            int ok = classes[len] == 0xFF;   // Nothing written past the end
+            for (size_t i = 0; i < len && ok; i++) ok = classes[i] == morseClassifyOne(m, pauses[off + i], lengths[off + i]);
+            CHECK(ok, "%s: %zu elements from %zu differ from the scalar path", what, len, off);
+        }
+    }
+    free(classes);
+}
+
+static void checkCorpora(void) {
+    static const double wpm[] = { 5, 13, 20, 28, 40 };
+    static const double jitter[] = { 0.0, 0.2 };
+    static const double glitch[] = { 0.0, 0.05 };
+    static const double farnsworth[] = { 1.0, 2.5 };
+    uint64_t seed = 1;
+    for (size_t w = 0; w < sizeof(wpm) / sizeof(wpm[0]); w++)
+        for (size_t j = 0; j < 2; j++)
+            for (size_t g = 0; g < 2; g++)
+                for (size_t f = 0; f < 2; f++) {
+                    CwGenParams p;
+                    cwgen_default_params(&p);
+                    p.wpm = wpm[w];
+                    p.jitter = jitter[j];
+                    p.glitchRate = glitch[g];
+                    p.farnsworth = farnsworth[f];
+                    p.seed = seed++;
+                    CwGen gen;
+                    CwElementList l = { NULL, 0, 0 };
+                    cwgen_init(&gen, &p, collectElement, &l);
+                    char label[CORPUS_CHARS + 32];
+                    size_t labelLen = cwgen_words(&gen, label, CORPUS_CHARS);
+                    cwgen_text(&gen, label);
+
+                    int32_t *pauses = (int32_t *)malloc(sizeof(int32_t) * l.count);
+                    int32_t *lengths = (int32_t *)malloc(sizeof(int32_t) * l.count);
+                    uint8_t *classes = (uint8_t *)malloc(l.count);
+                    char *text = (char *)malloc(2 * l.count + 2);
+                    CHECK_ALLOC(pauses && lengths && classes && text);
+                    for (size_t i = 0; i < l.count; i++) {
+                        pauses[i] = (int32_t)l.el[i].pause;
+                        lengths[i] = (int32_t)l.el[i].length;
+                    }
+                    char what[64];
+                    snprintf(what, sizeof(what), "%.0f WPM j%.0f%% g%.0f%% f%.1f", p.wpm, p.jitter * 100,
+                             p.glitchRate * 100, p.farnsworth);
+                    MorseTimingModel m = modelFor(&p);
+                    checkSame(&m, pauses, lengths, l.count, what);
+
+                    // Clean CW at the model's own speed decodes exactly
+                    if (p.jitter == 0 && p.glitchRate == 0) {
+                        MorseWalk walk = { 0, 0, 0 };
+                        morseClassifyBatch(&m, pauses, lengths, classes, l.count);
+                        size_t n = morseWalkBatch(&walk, classes, l.count, text, 2 * l.count + 2);
+                        n += morseWalkBatch(&walk, NULL, 0, text + n, 2 * l.count + 2 - n);
+                        n = cwscore_normalize(text, n);
+                        CHECK(n == labelLen && memcmp(text, label, n) == 0 && walk.unknown == 0,
+                              "%s: walked %zu chars (%lu unknown) for %zu", what, n, walk.unknown, labelLen);
+                    }
+                    free(pauses);
+                    free(lengths);
+                    free(classes);
+                    free(text);
+                    cwbatch_free_list(&l);
+                }
+}
+
+// Every pause and length around the thresholds, including 0
+static void checkThresholds(void) {
+    MorseTimingModel m = morseModel(60, 180, NULL);
+    int32_t pauses[1024], lengths[1024];
+    int keys[] = { 0, m.minPulse, m.ditMax + 1, m.charGapMin, m.wordGapMin };
+    size_t n = 0;
+    for (int a = 0; a < 5; a++)
+        for (int b = 0; b < 5; b++)
+            for (int da = -2; da <= 2; da++)
+                for (int db = -2; db <= 2; db++) {
+                    if (n == 1024) break;
+                    int p = keys[a] + da, len = keys[b] + db;
+                    pauses[n] = p < 0 ? 0 : p;
+                    lengths[n++] = len < 0 ? 0 : len;
+                }
+    checkSame(&m, pauses, lengths, n, "thresholds");
+}
+
+int main(void) {
+    printf("[*] morse_batch kernel: %s\n", MORSE_BATCH_KERNEL);
+    checkCorpora();
+    checkThresholds();
+    return check_done("morse_batch");
+}